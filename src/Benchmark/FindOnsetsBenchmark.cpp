@@ -0,0 +1,35 @@
+#include <Core/String.h>
+
+#include <System/File.h>
+
+#include <stdio.h>
+
+// Times the onset detection of FindOnsets.cpp on a directory of reference songs, serially and on
+// all cores, and checks that both find the same onsets. Runs without the editor, the results are
+// written to stderr.
+//
+// usage: FindOnsetsBenchmark <dir>
+//
+// Every 16-bit wav file in dir is tested, the exit code is nonzero if none could be tested or if
+// the onsets of any of them differ.
+
+namespace Vortex {
+
+extern bool BenchmarkFindOnsets(StringRef dir);
+
+}; // namespace Vortex
+
+using namespace Vortex;
+
+int main(int argc, char** argv)
+{
+	String dir = (argc > 1) ? String(argv[1]) : String();
+	if(dir.empty() || !(Path(dir).attributes() & File::ATR_DIR))
+	{
+		fprintf(stderr, "usage: FindOnsetsBenchmark <dir>\n");
+		if(dir.len()) fprintf(stderr, "the directory %s does not exist\n", dir.str());
+		return 1;
+	}
+
+	return BenchmarkFindOnsets(dir) ? 0 : 1;
+}
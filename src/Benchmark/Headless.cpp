@@ -0,0 +1,219 @@
+#include <Core/Utils.h>
+#include <Core/StringUtils.h>
+
+#include <System/Debug.h>
+
+#include <Simfile/Chart.h>
+
+#include <Managers/StyleMan.h>
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <chrono>
+
+// Headless versions of the editor services that the simfile code uses. The benchmarks link these
+// instead of the system, manager and editor code, so they run without a window or Windows.
+
+namespace Vortex {
+
+// ================================================================================================
+// Debug logging, written to stderr so stdout only contains the benchmark results.
+
+namespace Debug {
+
+static bool sLogBlankLine = false;
+
+double getElapsedTime()
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<double>(now).count();
+}
+
+double getElapsedTime(double startTime)
+{
+	return getElapsedTime() - startTime;
+}
+
+void log(const char* fmt, ...)
+{
+	if(sLogBlankLine)
+	{
+		fputc('\n', stderr);
+		sLogBlankLine = false;
+	}
+	va_list args;
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+}
+
+void logBlankLine()
+{
+	sLogBlankLine = true;
+}
+
+void blockBegin(Type type, const char* title)
+{
+	static const char* names[] = {"INFO", "WARNING", "ERROR"};
+	logBlankLine();
+	log("[%s] %s\n", names[type], title);
+}
+
+void blockEnd()
+{
+	logBlankLine();
+}
+
+}; // namespace Debug.
+
+// ================================================================================================
+// Hud messages. Warnings and errors are written to the log, notes and info messages are not,
+// since the savers post one on every save.
+
+#define LOG_HUD_MESSAGE(type) \
+	va_list args; va_start(args, fmt); \
+	fprintf(stderr, "[%s] ", type); \
+	vfprintf(stderr, fmt, args); \
+	fputc('\n', stderr); \
+	va_end(args);
+
+void HudNote(const char* /*fmt*/, ...)
+{
+}
+
+void HudInfo(const char* /*fmt*/, ...)
+{
+}
+
+void HudWarning(const char* fmt, ...)
+{
+	LOG_HUD_MESSAGE("warning");
+}
+
+void HudError(const char* fmt, ...)
+{
+	LOG_HUD_MESSAGE("error");
+}
+
+// ================================================================================================
+// Styles, without the style definitions of the editor assets. The common styles are built in,
+// other styles are created when a simfile asks for them.
+
+namespace {
+
+struct HeadlessStyleMan : public StyleMan {
+
+Vector<Style*> myStyles;
+Style* myActiveStyle;
+
+HeadlessStyleMan()
+	: myActiveStyle(nullptr)
+{
+	addStyle("dance-single", 4, 1);
+	addStyle("dance-double", 8, 1);
+	addStyle("dance-couple", 8, 2);
+	addStyle("dance-solo", 6, 1);
+	addStyle("pump-single", 5, 1);
+	addStyle("pump-double", 10, 1);
+}
+
+virtual ~HeadlessStyleMan()
+{
+	for(auto style : myStyles)
+	{
+		delete style;
+	}
+}
+
+Style* addStyle(StringRef id, int numCols, int numPlayers)
+{
+	Style* style = new Style;
+	style->index = myStyles.size();
+	style->id = id;
+	if(id.empty()) style->id = Str::fmt("kb%1-single").arg(numCols);
+	style->name = style->id;
+	style->numCols = clamp<int>(numCols, 1, SIM_MAX_COLUMNS);
+	style->numPlayers = clamp<int>(numPlayers, 1, SIM_MAX_PLAYERS);
+	style->mirrorTableH = nullptr;
+	style->mirrorTableV = nullptr;
+	style->padWidth = 0;
+	style->padHeight = 0;
+	style->padColPositions = nullptr;
+	style->padInitialFeetCols = nullptr;
+	myStyles.push_back(style);
+	return style;
+}
+
+void update(Chart* chart)
+{
+	myActiveStyle = (Style*)(chart ? chart->style : nullptr);
+}
+
+const Style* findStyle(StringRef id)
+{
+	for(auto style : myStyles)
+	{
+		if(style->id == id) return style;
+	}
+	return nullptr;
+}
+
+const Style* findStyle(StringRef /*chartName*/, int numCols, int numPlayers)
+{
+	for(auto style : myStyles)
+	{
+		if(style->numCols == numCols && style->numPlayers == numPlayers) return style;
+	}
+	return addStyle(String(), numCols, numPlayers);
+}
+
+const Style* findStyle(StringRef chartName, int numCols, int numPlayers, StringRef id)
+{
+	if(id.empty()) return findStyle(chartName, numCols, numPlayers);
+	auto style = findStyle(id);
+	return style ? style : addStyle(id, numCols, numPlayers);
+}
+
+int getNumStyles() const
+{
+	return myStyles.size();
+}
+
+int getNumCols() const
+{
+	return myActiveStyle ? myActiveStyle->numCols : 0;
+}
+
+int getNumPlayers() const
+{
+	return myActiveStyle ? myActiveStyle->numPlayers : 0;
+}
+
+Style* get(int index) const
+{
+	return myStyles[index];
+}
+
+Style* get() const
+{
+	return myActiveStyle;
+}
+
+}; // HeadlessStyleMan.
+
+}; // anonymous namespace.
+
+StyleMan* gStyle = nullptr;
+
+void StyleMan::create()
+{
+	gStyle = new HeadlessStyleMan;
+}
+
+void StyleMan::destroy()
+{
+	delete (HeadlessStyleMan*)gStyle;
+	gStyle = nullptr;
+}
+
+}; // namespace Vortex
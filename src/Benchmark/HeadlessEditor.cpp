@@ -0,0 +1,455 @@
+#include <Core/Utils.h>
+#include <Core/Vector.h>
+
+#include <Simfile/Chart.h>
+#include <Simfile/Simfile.h>
+#include <Simfile/TimingData.h>
+
+#include <Managers/TempoMan.h>
+#include <Managers/SimfileMan.h>
+
+#include <Editor/Editor.h>
+#include <Editor/History.h>
+#include <Editor/Selection.h>
+#include <Editor/Editing.h>
+#include <Editor/View.h>
+#include <Editor/Common.h>
+
+// Headless versions of the editor services that the note manager uses, so the benchmarks can
+// expand notes and apply note edits through the history without a window. Only the functions
+// that the note manager calls do something, the others are empty.
+
+namespace Vortex {
+
+// ================================================================================================
+// Clipboard, there is none. Row types are needed to select notes by quantization.
+
+void SetClipboardData(StringRef /*tag*/, const uchar* /*data*/, int /*size*/)
+{
+}
+
+Vector<uchar> GetClipboardData(StringRef /*tag*/)
+{
+	return Vector<uchar>();
+}
+
+RowType ToRowType(int rowIndex)
+{
+	static RowType map[192] = {};
+	static bool init = false;
+	if(!init)
+	{
+		init = true;
+		int mod[8] = {48, 24, 16, 12, 8, 6, 4, 3};
+		for(int i = 0; i < 192; ++i)
+		{
+			for(int j = 0; j < 8 && i % mod[j] != 0; ++j)
+			{
+				map[i] = (RowType)(map[i] + 1);
+			}
+		}
+	}
+	return map[rowIndex % 192];
+}
+
+namespace {
+
+// ================================================================================================
+// Editor, changes are not handled by anyone.
+
+struct HeadlessEditor : public Editor {
+
+virtual ~HeadlessEditor() {}
+
+void tick() {}
+bool closeSimfile() { return true; }
+bool openSimfile() { return false; }
+bool openSimfile(StringRef /*path*/) { return false; }
+bool openSimfile(int /*recentFileIndex*/) { return false; }
+bool openNextSimfile(bool /*iterateForward*/) { return false; }
+bool saveSimfile(bool /*showSaveAsDialog*/) { return false; }
+void clearRecentFiles() {}
+int getNumRecentFiles() { return 0; }
+StringRef getRecentFile(int /*recentFileIndex*/) { static String none; return none; }
+void reportChanges(int /*changes*/) {}
+void reportChanges(int /*changes*/, int /*beginRow*/, int /*endRow*/) {}
+void subscribe(const char* /*name*/, int /*mask*/, ChangeHandler /*handler*/) {}
+void openDialog(int /*dialogId*/) {}
+void onDialogClosed(int /*dialogId*/) {}
+void onCommandLineArgs(const String* /*args*/, int /*numArgs*/) {}
+void onMenuAction(int /*action*/) {}
+void onExitProgram() {}
+GuiContext* getGui() const { return nullptr; }
+bool hasMultithreading() const { return false; }
+void setBackgroundStyle(int /*style*/) {}
+int getBackgroundStyle() const { return 0; }
+int getDefaultSaveFormat() const { return 0; }
+void toggleProfiler() {}
+bool isProfilerVisible() const { return false; }
+void exportProfilerTrace() {}
+
+}; // HeadlessEditor.
+
+// ================================================================================================
+// History, keeps every entry in memory and applies it the same way as the editor history. Undo
+// and redo are triggered with Ctrl+Z and Ctrl+Y key presses.
+
+struct HeadlessHistory : public History {
+
+struct Callback
+{
+	ApplyFunc apply;
+	ReleaseFunc release;
+};
+
+struct Entry
+{
+	EditId id;
+	Chart* chart;
+	Tempo* tempo;
+	Vector<uchar> data;
+};
+
+Vector<Callback> myCallbacks;
+Vector<Entry*> myEntries;
+int myAppliedEntries;
+
+HeadlessHistory()
+	: myAppliedEntries(0)
+{
+	// Id zero is reserved for chains of entries, which the benchmarks do not use.
+	myCallbacks.push_back({nullptr, nullptr});
+}
+
+virtual ~HeadlessHistory()
+{
+	clearEntries(0);
+}
+
+void clearEntries(int begin)
+{
+	for(int i = myEntries.size() - 1; i >= begin; --i)
+	{
+		Entry* entry = myEntries[i];
+		auto release = myCallbacks[entry->id].release;
+		if(release)
+		{
+			ReadStream stream(entry->data.begin(), entry->data.size());
+			release(stream, i < myAppliedEntries);
+		}
+		delete entry;
+	}
+	myEntries.truncate(begin);
+	myAppliedEntries = min(myAppliedEntries, begin);
+}
+
+String applyEntry(Entry* entry, bool undo, bool redo)
+{
+	Bindings bound = {nullptr, entry->chart, entry->tempo};
+	ReadStream stream(entry->data.begin(), entry->data.size());
+	return myCallbacks[entry->id].apply(stream, bound, undo, redo);
+}
+
+void saveSettings(XmrNode& /*settings*/) {}
+
+EditId addCallback(ApplyFunc apply, ReleaseFunc release)
+{
+	EditId out = myCallbacks.size();
+	myCallbacks.push_back({apply, release});
+	return out;
+}
+
+void addEntry(EditId id, const void* data, uint size, Chart* chart, Tempo* tempo)
+{
+	if(id == 0 || id >= (uint)myCallbacks.size())
+	{
+		HudError("History edit has invalid ID!");
+		return;
+	}
+	clearEntries(myAppliedEntries);
+
+	Entry* entry = new Entry;
+	entry->id = id;
+	entry->chart = chart;
+	entry->tempo = tempo;
+	entry->data.resize(size);
+	memcpy(entry->data.begin(), data, size);
+	myEntries.push_back(entry);
+	++myAppliedEntries;
+
+	applyEntry(entry, false, false);
+}
+
+void addEntry(EditId id, const void* data, uint size)
+{
+	addEntry(id, data, size, nullptr, nullptr);
+}
+
+void addEntry(EditId id, const void* data, uint size, Tempo* targetTempo)
+{
+	addEntry(id, data, size, nullptr, targetTempo);
+}
+
+void addEntry(EditId id, const void* data, uint size, Chart* targetChart)
+{
+	addEntry(id, data, size, targetChart, nullptr);
+}
+
+void onKeyPress(KeyPress& evt)
+{
+	if(evt.handled == false && (evt.keyflags & Keyflag::CTRL))
+	{
+		if(evt.key == Key::Z && myAppliedEntries > 0)
+		{
+			--myAppliedEntries;
+			applyEntry(myEntries[myAppliedEntries], true, false);
+		}
+		else if(evt.key == Key::Y && myAppliedEntries < myEntries.size())
+		{
+			applyEntry(myEntries[myAppliedEntries], false, true);
+			++myAppliedEntries;
+		}
+	}
+}
+
+void startChain() {}
+void finishChain(String /*message*/) {}
+void onFileOpen(Simfile* /*simfile*/) {}
+void onFileClosed() { clearEntries(0); }
+void onFileSaved() {}
+bool hasUnsavedChanges() const { return myAppliedEntries > 0; }
+
+Stats getStats()
+{
+	Stats stats = {myEntries.size(), 0, 0, 0};
+	for(auto entry : myEntries)
+	{
+		stats.residentBytes += entry->data.size();
+	}
+	return stats;
+}
+
+}; // HeadlessHistory.
+
+// ================================================================================================
+// Selection, only keeps track of the selection type.
+
+struct HeadlessSelection : public Selection {
+
+Type myType;
+
+HeadlessSelection()
+	: myType(NONE)
+{
+}
+
+virtual ~HeadlessSelection() {}
+
+void setType(Type type) { myType = type; }
+Type getType() const { return myType; }
+void drawRegionSelection() {}
+void drawSelectionBox() {}
+void selectAllNotes() {}
+int selectNotes(NotesMan::Filter /*filter*/) { return 0; }
+int selectNotes(RowType /*rowType*/) { return 0; }
+int selectNotes(SelectModifier /*t*/, RowCol /*begin*/, RowCol /*end*/) { return 0; }
+int selectNotes(SelectModifier /*t*/, const Vector<RowCol>& /*indices*/) { return 0; }
+int getSelectedNotes(NoteList& /*out*/) { return 0; }
+void selectRegion() {}
+void selectRegion(int /*row*/, int /*endrow*/) {}
+SelectionRegion getSelectedRegion() { return {0, 0}; }
+
+}; // HeadlessSelection.
+
+// ================================================================================================
+// Editing, undo and redo do not move the view, since there is none.
+
+struct HeadlessEditing : public Editing {
+
+virtual ~HeadlessEditing() {}
+
+void saveSettings(XmrNode& /*settings*/) {}
+void onChanges(int /*changes*/) {}
+void drawGhostNotes() {}
+void deleteSelection() {}
+void changeNotesToType(NoteType /*type*/) {}
+void changeMinesToType(NoteType /*type*/) {}
+void changeFakesToType(NoteType /*type*/) {}
+void changeLiftsToType(NoteType /*type*/) {}
+void changeHoldsToType(NoteType /*type*/) {}
+void changeHoldsToRolls() {}
+void changePlayerNumber() {}
+void mirrorNotes(MirrorType /*type*/) {}
+void scaleNotes(int /*numerator*/, int /*denominator*/) {}
+void insertRows(int /*row*/, int /*numRows*/, bool /*curChartOnly*/) {}
+void convertCouplesToRoutine() {}
+void convertRoutineToCouples() {}
+void exportNotesAsLuaTable() {}
+void toggleJumpToNextNote() {}
+bool hasJumpToNextNote() { return false; }
+void toggleUndoRedoJump() {}
+bool hasUndoRedoJump() { return false; }
+void toggleTimeBasedCopy() {}
+bool hasTimeBasedCopy() { return false; }
+void setVisualSyncAnchor(VisualSyncAnchor /*anchor*/) {}
+VisualSyncAnchor getVisualSyncMode() { return VisualSyncAnchor::RECEPTORS; }
+void injectBoundingBpmChange() {}
+void shiftAnchorRowToMousePosition(bool /*is_destructive*/) {}
+
+}; // HeadlessEditing.
+
+// ================================================================================================
+// Tempo, keeps the timing data of the active chart up to date. Tempo edits are not supported.
+
+struct HeadlessTempoMan : public TempoMan {
+
+Tempo* myTempo;
+TimingData myTimingData;
+
+HeadlessTempoMan()
+	: myTempo(nullptr)
+{
+}
+
+virtual ~HeadlessTempoMan() {}
+
+void update(Simfile* simfile, Chart* chart)
+{
+	Tempo* tempo = nullptr;
+	if(chart && chart->hasTempo())
+	{
+		tempo = chart->getTempo(simfile);
+	}
+	else if(simfile)
+	{
+		tempo = simfile->tempo;
+	}
+	myTempo = tempo;
+	if(tempo)
+	{
+		myTimingData.update(tempo);
+	}
+	else
+	{
+		myTimingData = TimingData();
+	}
+}
+
+int timeToRow(double time) const { return myTimingData.timeToRow(time); }
+double timeToBeat(double time) const { return myTimingData.timeToBeat(time); }
+double rowToTime(int row) const { return myTimingData.rowToTime(row); }
+double beatToTime(double beat) const { return myTimingData.beatToTime(beat); }
+double beatToMeasure(double beat) const { return myTimingData.beatToMeasure(beat); }
+
+double getBpm(int row) const
+{
+	if(myTempo)
+	{
+		return myTempo->segments->getRecent<BpmChange>(row).bpm;
+	}
+	return SIM_DEFAULT_BPM;
+}
+
+void modify(const SegmentEdit& /*edit*/) {}
+void modify(const SegmentEdit& /*edit*/, bool /*clearRegion*/) {}
+void insertRows(int /*row*/, int /*numRows*/, bool /*curChartOnly*/) {}
+void removeSelectedSegments() {}
+void pasteFromClipboard(bool /*insert*/) {}
+void copyToClipboard() {}
+void setOffset(double /*offset*/) {}
+void setDefaultBpm() {}
+void setRandomBpm() {}
+void setCustomBpm(BpmRange /*range*/) {}
+void startTweakingOffset() {}
+void startTweakingBpm(int /*row*/) {}
+void startTweakingStop(int /*row*/) {}
+void setTweakValue(double /*value*/) {}
+void stopTweaking(bool /*apply*/) {}
+TweakMode getTweakMode() const { return TWEAK_NONE; }
+double getTweakValue() const { return 0.0; }
+int getTweakRow() const { return 0; }
+double getOffset() const { return myTempo ? myTempo->offset : 0.0; }
+TimingMode getTimingMode() const { return TIMING_UNIFIED; }
+DisplayBpm getDisplayBpmType() const { return myTempo ? myTempo->displayBpmType : BPM_ACTUAL; }
+BpmRange getDisplayBpmRange() const { return myTempo ? myTempo->displayBpmRange : BpmRange{0, 0}; }
+BpmRange getBpmRange() const { return {0, 0}; }
+const TimingData& getTimingData() const { return myTimingData; }
+const SegmentGroup* getSegments() const { return myTempo ? myTempo->segments : nullptr; }
+void injectBoundingBpmChange(const int /*target_row*/) {}
+void nonDestructiveShiftRowToTime(const int /*target_row*/, const double /*target_time*/) {}
+void destructiveShiftRowToTime(const int /*target_row*/, const double /*target_time*/) {}
+
+}; // HeadlessTempoMan.
+
+}; // anonymous namespace.
+
+// ================================================================================================
+// Creation and destruction.
+
+Editor* gEditor = nullptr;
+History* gHistory = nullptr;
+Selection* gSelection = nullptr;
+Editing* gEditing = nullptr;
+TempoMan* gTempo = nullptr;
+
+// Not used by the paths the benchmarks run, the note manager only needs them when undo and redo
+// jump to the edited notes, which the headless editing disables.
+SimfileMan* gSimfile = nullptr;
+View* gView = nullptr;
+
+void Editor::create()
+{
+	gEditor = new HeadlessEditor;
+}
+
+void Editor::destroy()
+{
+	delete (HeadlessEditor*)gEditor;
+	gEditor = nullptr;
+}
+
+void History::create(XmrNode& /*settings*/)
+{
+	gHistory = new HeadlessHistory;
+}
+
+void History::destroy()
+{
+	delete (HeadlessHistory*)gHistory;
+	gHistory = nullptr;
+}
+
+void Selection::create()
+{
+	gSelection = new HeadlessSelection;
+}
+
+void Selection::destroy()
+{
+	delete (HeadlessSelection*)gSelection;
+	gSelection = nullptr;
+}
+
+void Editing::create(XmrNode& /*settings*/)
+{
+	gEditing = new HeadlessEditing;
+}
+
+void Editing::destroy()
+{
+	delete (HeadlessEditing*)gEditing;
+	gEditing = nullptr;
+}
+
+void TempoMan::create()
+{
+	gTempo = new HeadlessTempoMan;
+}
+
+void TempoMan::destroy()
+{
+	delete (HeadlessTempoMan*)gTempo;
+	gTempo = nullptr;
+}
+
+}; // namespace Vortex
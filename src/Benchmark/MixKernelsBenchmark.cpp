@@ -0,0 +1,22 @@
+#include <Core/Core.h>
+
+// Times the scalar, SSE2 and AVX2 mixing kernels of MixKernels.cpp on synthetic stereo buffers,
+// and checks that every instruction set produces the same output as the scalar kernels. Runs
+// without the editor, the results are written to stderr.
+//
+// usage: MixKernelsBenchmark
+//
+// The exit code is nonzero if the output of any kernel differs.
+
+namespace Vortex {
+
+extern bool BenchmarkMixKernels();
+
+}; // namespace Vortex
+
+using namespace Vortex;
+
+int main()
+{
+	return BenchmarkMixKernels() ? 0 : 1;
+}
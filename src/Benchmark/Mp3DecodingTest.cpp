@@ -0,0 +1,34 @@
+#include <Core/String.h>
+
+#include <System/File.h>
+
+#include <stdio.h>
+
+// Checks that the parallel mp3 decoder produces exactly the same samples as the serial decoder.
+// Runs without the editor, the results are written to stderr.
+//
+// usage: Mp3DecodingTest <dir>
+//
+// Every mp3 file in dir is decoded, the exit code is nonzero if none could be compared or if any
+// of them differ.
+
+namespace Vortex {
+
+extern bool TestParallelMp3Decoding(StringRef dir);
+
+}; // namespace Vortex
+
+using namespace Vortex;
+
+int main(int argc, char** argv)
+{
+	String dir = (argc > 1) ? String(argv[1]) : String();
+	if(dir.empty() || !(Path(dir).attributes() & File::ATR_DIR))
+	{
+		fprintf(stderr, "usage: Mp3DecodingTest <dir>\n");
+		if(dir.len()) fprintf(stderr, "the directory %s does not exist\n", dir.str());
+		return 1;
+	}
+
+	return TestParallelMp3Decoding(dir) ? 0 : 1;
+}
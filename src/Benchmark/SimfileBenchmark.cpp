@@ -0,0 +1,394 @@
+#include <Core/Utils.h>
+#include <Core/StringUtils.h>
+#include <Core/ByteStream.h>
+#include <Core/Xmr.h>
+
+#include <System/Debug.h>
+#include <System/File.h>
+
+#include <Simfile/Simfile.h>
+#include <Simfile/Chart.h>
+#include <Simfile/Tempo.h>
+#include <Simfile/SegmentGroup.h>
+#include <Simfile/TimingData.h>
+#include <Simfile/Parsing.h>
+
+#include <Managers/StyleMan.h>
+#include <Managers/TempoMan.h>
+#include <Managers/NoteMan.h>
+
+#include <Editor/Editor.h>
+#include <Editor/History.h>
+#include <Editor/Selection.h>
+#include <Editor/Editing.h>
+
+#include <stdio.h>
+#include <float.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
+
+// Times the load, edit and save paths of generated simfiles. Runs without the editor, the log is
+// written to stderr and the results are written to stdout as JSON, for comparison between builds.
+//
+// usage: SimfileBenchmark [dir]
+//
+// The generated simfiles are saved to dir, which is the working directory by default. The note
+// manager and the edit history run on the headless editor services of HeadlessEditor.cpp. The
+// size of a result is its number of notes, or its number of tempo segments for the timing data
+// lookups. The exit code is nonzero if the timing data lookups give different results.
+
+namespace Vortex {
+namespace {
+
+// Each measurement is repeated at least this many times, and until this much time has passed.
+static const int MIN_ITERATIONS = 3;
+static const int MAX_ITERATIONS = 1000;
+static const double MIN_MEASURE_TIME = 0.25;
+
+// Note counts of the generated charts, from a short chart to a marathon.
+static const int CORPUS_SIZES[] = {100, 1000, 10000, 50000};
+
+// Segment counts of the generated tempos, and the number of conversions per timing measurement.
+static const int TEMPO_SIZES[] = {100, 10000};
+static const int NUM_LOOKUPS = 1 << 16;
+
+struct BenchmarkResult
+{
+	const char* name;
+	int size;
+	int iterations;
+	double average, best;
+};
+
+struct Random
+{
+	uint32_t seed;
+	int operator()(int range) { seed = seed * 1664525 + 1013904223; return (int)((seed >> 8) % range); }
+};
+
+// Calls the given function repeatedly and adds its average and best time to the results.
+template <typename Function>
+static void Measure(Vector<BenchmarkResult>& out, const char* name, int size, Function function)
+{
+	int iterations = 0;
+	double total = 0.0, best = DBL_MAX;
+	while(iterations < MIN_ITERATIONS || (total < MIN_MEASURE_TIME && iterations < MAX_ITERATIONS))
+	{
+		double start = Debug::getElapsedTime();
+		function();
+		double elapsed = Debug::getElapsedTime(start);
+		total += elapsed;
+		best = min(best, elapsed);
+		++iterations;
+	}
+	out.push_back({name, size, iterations, total / iterations, best});
+}
+
+// Fills a simfile with a single chart of the given number of notes, with steps, jumps, holds,
+// rolls and mines on 16th rows, and a tempo with regular BPM changes and stops.
+static void CreateSimfile(Simfile& sim, const Style* style, int numNotes, Random& random)
+{
+	sim.title = "Benchmark";
+	sim.artist = "ArrowVortex";
+	sim.tempo->offset = -0.1;
+
+	Chart* chart = new Chart;
+	chart->style = style;
+	chart->difficulty = DIFF_CHALLENGE;
+	chart->meter = 12;
+	sim.charts.push_back(chart);
+
+	int numCols = style->numCols;
+	Vector<int> busy(numCols, -1);
+	int row = 0;
+	while(chart->notes.size() < numNotes)
+	{
+		row += ROWS_PER_BEAT / 4 * (1 + random(2));
+		for(int col = 0; col < numCols && chart->notes.size() < numNotes; ++col)
+		{
+			if(busy[col] >= row || random(numCols) != 0) continue;
+			int endrow = row, type = NOTE_STEP_OR_HOLD;
+			switch(random(16))
+			{
+			case 0: case 1: endrow = row + ROWS_PER_BEAT * (1 + random(4)); break;
+			case 2: endrow = row + ROWS_PER_BEAT * (1 + random(4)); type = NOTE_ROLL; break;
+			case 3: type = NOTE_MINE; break;
+			}
+			chart->notes.append({row, endrow, (uint)col, 0, (uint)type, 16});
+			busy[col] = endrow;
+		}
+	}
+
+	auto segments = sim.tempo->segments;
+	segments->insert(BpmChange(0, 150.0));
+	for(int r = ROWS_PER_BEAT * 64; r < row; r += ROWS_PER_BEAT * 64)
+	{
+		segments->insert(BpmChange(r, 120.0 + random(120)));
+		segments->insert(Stop(r + ROWS_PER_BEAT * 16, 0.05 + random(10) * 0.05));
+	}
+}
+
+static void RunBenchmarks(StringRef dir, Vector<BenchmarkResult>& results)
+{
+	Random random = {12345};
+	const Style* style = gStyle->findStyle("dance-single");
+
+	for(int size : CORPUS_SIZES)
+	{
+		Simfile sim;
+		CreateSimfile(sim, style, size, random);
+		Chart* chart = sim.charts[0];
+		int n = chart->notes.size();
+
+		Path path(dir, Str::fmt("benchmark %1").arg(n));
+		sim.dir = path.dir();
+		sim.file = path.name();
+		String smPath = sim.dir + sim.file + ".sm";
+		String sscPath = sim.dir + sim.file + ".ssc";
+
+		// Saving and loading.
+		Measure(results, "save sm", n, [&] { SaveSimfile(sim, SIM_SM, false); });
+		Measure(results, "save ssc", n, [&] { SaveSimfile(sim, SIM_SSC, false); });
+		Measure(results, "parse sm", n, [&] { String text; ParseSimfile(text, smPath); });
+		Measure(results, "load sm", n, [&] { Simfile loaded; LoadSimfile(loaded, smPath); });
+		Measure(results, "load ssc", n, [&] { Simfile loaded; LoadSimfile(loaded, sscPath); });
+
+		// Sanitizing and timing, the notes are already valid so sanitizing leaves them unchanged.
+		NoteList notes(chart->notes);
+		Measure(results, "sanitize notes", n, [&] { notes.sanitize(chart); });
+
+		TimingData timing;
+		Measure(results, "update timing data", n, [&] { timing.update(sim.tempo); });
+
+		// Expansion of the notes by the note manager, when a chart is opened.
+		gTempo->update(&sim, chart);
+		Measure(results, "expand notes", n, [&] { gNotes->update(&sim, chart); });
+
+		// An edit that mirrors every note, which the note manager encodes into a history entry
+		// and applies. Each iteration undoes the edit again, so the next one starts from the
+		// same notes. Undo and redo decode the entry and apply it to the chart.
+		Vector<Note> mirrored;
+		for(Note note : chart->notes)
+		{
+			note.col = style->numCols - 1 - note.col;
+			mirrored.push_back(note);
+		}
+		std::sort(mirrored.begin(), mirrored.end(), [](const Note& a, const Note& b)
+		{
+			return (a.row != b.row) ? (a.row < b.row) : (a.col < b.col);
+		});
+		NoteEdit mirror;
+		for(auto& note : mirrored)
+		{
+			mirror.add.append(note);
+		}
+		KeyPress undo = {Key::Z, Keyflag::CTRL, false, false};
+		KeyPress redo = {Key::Y, Keyflag::CTRL, false, false};
+		Measure(results, "history encode note edit", n, [&]
+		{
+			gNotes->modify(mirror, true);
+			gHistory->onKeyPress(undo);
+		});
+		Measure(results, "history decode undo and redo", n, [&]
+		{
+			gHistory->onKeyPress(redo);
+			gHistory->onKeyPress(undo);
+		});
+		gHistory->onFileClosed();
+		gNotes->update(nullptr, nullptr);
+		gTempo->update(nullptr, nullptr);
+
+		// The time based note data that is copied to the clipboard.
+		WriteStream encodedTime;
+		chart->notes.encode(encodedTime, timing, true);
+		Measure(results, "encode notes by time", n, [&]
+		{
+			WriteStream out;
+			chart->notes.encode(out, timing, true);
+		});
+		Measure(results, "decode notes by time", n, [&]
+		{
+			ReadStream in(encodedTime.data(), encodedTime.size());
+			NoteList decoded;
+			decoded.decode(in, timing, 0.0);
+		});
+	}
+}
+
+// Fills a tempo with the given number of segments, mostly BPM changes with some stops, delays and
+// warps, at random rows.
+static int CreateTempo(Tempo& tempo, int numSegments, Random& random)
+{
+	int row = 0;
+	tempo.segments->insert(BpmChange(0, 120.0));
+	for(int i = 1; i < numSegments; ++i)
+	{
+		row += 1 + random(96);
+		switch(random(20))
+		{
+		case 0: tempo.segments->insert(Warp(row, 1 + random(48))); break;
+		case 1: tempo.segments->insert(Delay(row, random(100) * 0.001)); break;
+		case 2: case 3: tempo.segments->insert(Stop(row, random(500) * 0.001)); break;
+		default: tempo.segments->insert(BpmChange(row, 60.0 + random(240))); break;
+		}
+	}
+	return row;
+}
+
+// The binary search over the sorted events, which the search tree of the timing data replaced.
+static double BinarySearchRowToTime(const TimingData& timing, int row)
+{
+	const TimingData::Event* it = timing.events.begin();
+	int count = timing.events.size();
+	while(count > 1)
+	{
+		int step = count >> 1;
+		if(it[step].row <= row)
+		{
+			it += step;
+			count -= step;
+		}
+		else count = step;
+	}
+	return (row > it->row) ? it->endTime + (row - it->row) * it->spr : it->rowTime;
+}
+
+// Converts random rows and times with generated tempos, one at a time with the search tree and
+// the binary search it replaced, and in sorted batches. Returns the number of conversions for
+// which the lookups disagree.
+static int RunTimingBenchmarks(Vector<BenchmarkResult>& results)
+{
+	Random random = {12345};
+	int numMismatches = 0;
+
+	for(int size : TEMPO_SIZES)
+	{
+		Tempo tempo;
+		int endRow = CreateTempo(tempo, size, random) + ROWS_PER_BEAT;
+		TimingData timing;
+		timing.update(&tempo);
+
+		double endTime = timing.rowToTime(endRow);
+		Vector<int> rows(NUM_LOOKUPS, 0), outRows(NUM_LOOKUPS, 0);
+		Vector<double> times(NUM_LOOKUPS, 0.0), outTimes(NUM_LOOKUPS, 0.0);
+		for(int i = 0; i < NUM_LOOKUPS; ++i)
+		{
+			rows[i] = random(endRow);
+			times[i] = endTime * random(1 << 20) / (1 << 20);
+		}
+
+		double sum = 0.0;
+		Measure(results, "binary search row to time", size, [&]
+		{
+			for(int row : rows) sum += BinarySearchRowToTime(timing, row);
+		});
+		Measure(results, "row to time", size, [&]
+		{
+			for(int row : rows) sum += timing.rowToTime(row);
+		});
+		Measure(results, "time to row", size, [&]
+		{
+			for(double time : times) sum += timing.timeToRow(time);
+		});
+		Debug::log("timing lookups, %i segments, checksum: %f\n", size, sum);
+
+		std::sort(rows.begin(), rows.end());
+		std::sort(times.begin(), times.end());
+		Measure(results, "batched row to time", size, [&]
+		{
+			timing.rowToTime(rows.data(), outTimes.data(), NUM_LOOKUPS);
+		});
+		Measure(results, "batched time to row", size, [&]
+		{
+			timing.timeToRow(times.data(), outRows.data(), NUM_LOOKUPS);
+		});
+
+		for(int i = 0; i < NUM_LOOKUPS; ++i)
+		{
+			double time = timing.rowToTime(rows[i]);
+			numMismatches += (time != BinarySearchRowToTime(timing, rows[i]));
+			numMismatches += (time != outTimes[i]);
+			numMismatches += (timing.timeToRow(times[i]) != outRows[i]);
+		}
+	}
+
+	return numMismatches;
+}
+
+static void WriteResults(FILE* out, const Vector<BenchmarkResult>& results)
+{
+	fprintf(out, "{\"benchmarks\":[\n");
+	for(int i = 0; i < results.size(); ++i)
+	{
+		auto& r = results[i];
+		fprintf(out, "%s{\"name\":\"%s\",\"size\":%i,\"iterations\":%i,\"average_ms\":%.4f,\"best_ms\":%.4f}",
+			i ? ",\n" : "", r.name, r.size, r.iterations, r.average * 1000.0, r.best * 1000.0);
+	}
+	fprintf(out, "\n]}\n");
+}
+
+}; // anonymous namespace
+}; // namespace Vortex
+
+using namespace Vortex;
+
+int main(int argc, char** argv)
+{
+	// Relative directories are resolved against the working directory, since an empty path, which
+	// is what "." becomes, does not refer to a directory.
+	char cwd[4096];
+	if(!getcwd(cwd, sizeof(cwd)))
+	{
+		fprintf(stderr, "could not get the working directory\n");
+		return 1;
+	}
+	String dir = Path(cwd, (argc > 1) ? argv[1] : ".").str;
+	if(!(Path(dir).attributes() & File::ATR_DIR))
+	{
+		fprintf(stderr, "usage: SimfileBenchmark [dir]\n");
+		fprintf(stderr, "the directory %s does not exist\n", dir.str());
+		return 1;
+	}
+
+	XmrNode settings = {};
+	StyleMan::create();
+	Editor::create();
+	History::create(settings);
+	Selection::create();
+	Editing::create(settings);
+	TempoMan::create();
+	NotesMan::create();
+
+	Vector<BenchmarkResult> results;
+	RunBenchmarks(dir, results);
+	int numMismatches = RunTimingBenchmarks(results);
+
+	Debug::blockBegin(Debug::INFO, "simfile benchmark");
+	for(auto& r : results)
+	{
+		Debug::log("%s, size %i: %.3f ms avg, %.3f ms best (%i iterations)\n",
+			r.name, r.size, r.average * 1000.0, r.best * 1000.0, r.iterations);
+	}
+	if(numMismatches)
+	{
+		Debug::log("timing data lookups: %i MISMATCHES\n", numMismatches);
+	}
+	Debug::blockEnd();
+
+	WriteResults(stdout, results);
+
+	NotesMan::destroy();
+	TempoMan::destroy();
+	Editing::destroy();
+	Selection::destroy();
+	History::destroy();
+	Editor::destroy();
+	StyleMan::destroy();
+	return numMismatches ? 1 : 0;
+}
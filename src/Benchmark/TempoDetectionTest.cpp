@@ -0,0 +1,40 @@
+#include <Core/String.h>
+
+#include <System/File.h>
+
+#include <stdio.h>
+
+// Runs the BPM detection of FindTempo.cpp on a directory of reference songs and compares the
+// results with the references stored next to them in "<file>.bpm.txt". Runs without the editor,
+// the results are written to stderr.
+//
+// usage: TempoDetectionTest <dir>
+//
+// Every 16-bit wav file in dir is tested, files without a reference get one. The exit code is
+// nonzero if none could be tested or if the results of any of them changed.
+
+namespace Vortex {
+
+class Music;
+
+// The editor's detector reads the music through gMusic, the regression test does not.
+Music* gMusic = nullptr;
+
+extern bool RegressionTestTempoDetection(StringRef dir);
+
+}; // namespace Vortex
+
+using namespace Vortex;
+
+int main(int argc, char** argv)
+{
+	String dir = (argc > 1) ? String(argv[1]) : String();
+	if(dir.empty() || !(Path(dir).attributes() & File::ATR_DIR))
+	{
+		fprintf(stderr, "usage: TempoDetectionTest <dir>\n");
+		if(dir.len()) fprintf(stderr, "the directory %s does not exist\n", dir.str());
+		return 1;
+	}
+
+	return RegressionTestTempoDetection(dir) ? 0 : 1;
+}
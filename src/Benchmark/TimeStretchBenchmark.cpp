@@ -0,0 +1,22 @@
+#include <Core/Core.h>
+
+// Times the time stretching of TimeStretch.cpp on a synthetic song at several playback speeds, in
+// blocks of the size requested by the mixer thread. Runs without the editor, the results are
+// written to stderr.
+//
+// usage: TimeStretchBenchmark
+//
+// The exit code is nonzero if the worst block of any speed takes longer than playing it.
+
+namespace Vortex {
+
+extern bool BenchmarkTimeStretch();
+
+}; // namespace Vortex
+
+using namespace Vortex;
+
+int main()
+{
+	return BenchmarkTimeStretch() ? 0 : 1;
+}
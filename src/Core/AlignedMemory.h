@@ -1,16 +1,32 @@
 #pragma once
 
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 template <typename T>
 inline T* AlignedMalloc(size_t count)
 {
+#ifdef _WIN32
     return static_cast<T*>(_aligned_malloc(count * sizeof(T), 16));
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, 16, count * sizeof(T)) != 0) return nullptr;
+    return static_cast<T*>(ptr);
+#endif
 }
 
 inline void AlignedFree(void* ptr)
 {
     if (ptr)
     {
+#ifdef _WIN32
         _aligned_free(ptr);
+#else
+        free(ptr);
+#endif
         ptr = nullptr;
     }
 }
@@ -22,34 +22,15 @@ public:
 	void writeNum(uint num);
 	void writeStr(StringRef str);
 
+	// The size is a constant, so only one of the branches remains.
 	template <unsigned int S>
 	inline void writeSz(const void* val)
 	{
-		write(val, S);
-	}
-
-	template <>
-	inline void writeSz<1>(const void* val)
-	{
-		write8(val);
-	}
-
-	template <>
-	inline void writeSz<2>(const void* val)
-	{
-		write16(val);
-	}
-
-	template <>
-	inline void writeSz<4>(const void* val)
-	{
-		write32(val);
-	}
-
-	template <>
-	inline void writeSz<8>(const void* val)
-	{
-		write64(val);
+		     if(S == 1) write8(val);
+		else if(S == 2) write16(val);
+		else if(S == 4) write32(val);
+		else if(S == 8) write64(val);
+		else write(val, S);
 	}
 
 	template <typename T>
@@ -94,34 +75,15 @@ public:
 	void readNum(uint& num);
 	void readStr(String& str);
 
+	// The size is a constant, so only one of the branches remains.
 	template <size_t S>
 	inline void readSz(void* out)
 	{
-		read(out, S);
-	}
-
-	template <>
-	inline void readSz<1>(void* out)
-	{
-		read8(out);
-	}
-
-	template <>
-	inline void readSz<2>(void* out)
-	{
-		read16(out);
-	}
-
-	template <>
-	inline void readSz<4>(void* out)
-	{
-		read32(out);
-	}
-
-	template <>
-	inline void readSz<8>(void* out)
-	{
-		read64(out);
+		     if(S == 1) read8(out);
+		else if(S == 2) read16(out);
+		else if(S == 4) read32(out);
+		else if(S == 8) read64(out);
+		else read(out, (int)S);
 	}
 
 	template <typename T>
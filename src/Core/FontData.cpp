@@ -76,6 +76,7 @@ static void ReleaseCache(GlyphCache* cache)
 {
 	if(cache)
 	{
+		++FontData::glyphGeneration;
 		TextureManager::release(cache->tex);
 
 		for(auto& g : cache->glyphs) free(g.second);
@@ -96,6 +97,7 @@ static void UpdateCache(GlyphCache* cache, float dt)
 		glyph->timeSinceLastUse += dt;
 		if(glyph->timeSinceLastUse > maxUnusedCacheTime)
 		{
+			++FontData::glyphGeneration;
 			if(glyph->box.w * glyph->box.h > 0)
 			{
 				cache->unusedGlyphs.insert(glyph);
@@ -297,6 +299,8 @@ Glyph* RenderGlyph(FontData* font, GlyphCache* cache, int size, int charcode)
 // ================================================================================================
 // FontData functions
 
+uint FontData::glyphGeneration = 0;
+
 FontData::FontData(void* inFtface, const char* inPath, Text::Hinting inHinting)
 {
 	FT_Select_Charmap((FT_Face)inFtface, FT_ENCODING_UNICODE);
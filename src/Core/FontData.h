@@ -66,6 +66,9 @@ struct FontData
 
 	TextureHandle getActiveTexture(int size, vec2i& outTexSize);
 
+	/// Incremented whenever glyphs are removed from a cache, which invalidates pointers to them.
+	static uint glyphGeneration;
+
 	std::map<FontSize, GlyphCache*> caches;
 	GlyphCache* currentCache;
 	int currentSize;
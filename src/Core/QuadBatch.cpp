@@ -63,6 +63,16 @@ void BatchSprite::mirrorUVs(Mirror m)
 		SwapUVs(uvs, 6, 7, 4, 5, 2, 3, 0, 1);
 }
 
+void BatchSprite::mapUVs(const areaf& region)
+{
+	float w = region.r - region.l, h = region.b - region.t;
+	for(int i = 0; i < 8; i += 2)
+	{
+		uvs[i + 0] = region.l + uvs[i + 0] * w;
+		uvs[i + 1] = region.t + uvs[i + 1] * h;
+	}
+}
+
 void BatchSprite::draw(QuadBatchT* out, int x, int y)
 {
 	int w = width * DrawScale / 512;
@@ -20,6 +20,10 @@ struct BatchSprite
 	void rotateUVs(Rotation r);
 	void mirrorUVs(Mirror m);
 
+	/// Maps the texture coordinates from a whole texture to a region of a texture, for example
+	/// an image in a texture atlas.
+	void mapUVs(const areaf& region);
+
 	void draw(QuadBatchT* batch, int x, int y);
 	void draw(QuadBatchT* batch, int x, int y, int y2);
 
@@ -1,17 +1,26 @@
 #include <Core/Gui.h>
 
 #include <Core/Vector.h>
+#include <Core/Utils.h>
 #include <Core/Shader.h>
 #include <Core/Renderer.h>
 #include <Core/Draw.h>
 #include <Core/Canvas.h>
 
 #include <System/Debug.h>
+#include <System/Profiler.h>
 #include <System/OpenGL.h>
 
+#include <stddef.h>
+#include <algorithm>
+
 namespace Vortex {
 
-static const int BATCH_QUAD_LIMIT = 256;
+// Maximum number of quads that are drawn with a single draw call.
+static const int BATCH_QUAD_LIMIT = 1 << 15;
+
+// Size of the vertex buffer that the quads of each draw call are streamed into.
+static const int RING_BUFFER_SIZE = 1 << 23;
 
 static const int VB_POS_STRIDE = sizeof(uint) * 8;
 static const int VB_UVS_STRIDE = sizeof(float) * 8;
@@ -21,21 +30,85 @@ static const int VB_POS_SIZE = VB_POS_STRIDE * BATCH_QUAD_LIMIT;
 static const int VB_UVS_SIZE = VB_UVS_STRIDE * BATCH_QUAD_LIMIT;
 static const int VB_COL_SIZE = VB_COL_STRIDE * BATCH_QUAD_LIMIT;
 
+// Shader index used when a shader other than the default shaders is bound.
+static const int SHADER_EXTERNAL = -1;
+
+// ================================================================================================
+// Vertex buffer extensions.
+
+#define EXT(name, result) static result(APIENTRY* name)
+
+#define PROC(name) name = (decltype(name))wglGetProcAddress(#name); if(!name) { missing.push_back(#name); }
+
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_STREAM_DRAW 0x88E0
+#define GL_STATIC_DRAW 0x88E4
+
+EXT(glGenBuffers, void)(GLsizei n, GLuint* buffers);
+EXT(glDeleteBuffers, void)(GLsizei n, const GLuint* buffers);
+EXT(glBindBuffer, void)(GLenum target, GLuint buffer);
+EXT(glBufferData, void)(GLenum target, ptrdiff_t size, const void* data, GLenum usage);
+EXT(glBufferSubData, void)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void* data);
+
 // ================================================================================================
 // Renderer singleton.
 
 namespace {
 
+// Quads of the draw list that share a layer, shader and texture.
+struct DrawCommand
+{
+	int layer;
+	int shader;
+	TextureHandle texture;
+	int first, count;
+};
+
+// Vertex arrays of quads that are about to be drawn.
+struct QuadArrays
+{
+	const uchar* pos;
+	const uchar* uvs;
+	const uchar* col;
+	const uint* indices;
+};
+
 struct RendererInstance
 {
 	Shader shaders[4];
 	Vector<recti> scissorStack;
 	uint* quadIndices;
 
+	// Quads that are waiting to be drawn. Consecutive batches and quads are merged into a single
+	// draw call, until the texture, shader or scissor region changes.
 	uchar* batchPos;
 	uchar* batchCol;
 	uchar* batchUvs;
-	int quadsLeft;
+	int numQuads;
+
+	// Draw list, the pending quads are recorded as commands which are sorted by layer, shader and
+	// texture before they are drawn. The sorted quads are copied to a second set of buffers.
+	Vector<DrawCommand> drawList;
+	bool recordDrawList;
+	int drawLayer;
+	uchar* sortedPos;
+	uchar* sortedCol;
+	uchar* sortedUvs;
+
+	// Render state set through the renderer.
+	TextureHandle texture;
+	int shader;
+	color32 color;
+	bool bindingShader;
+
+	// Vertex buffer objects, zero if vertex buffers are not supported.
+	GLuint vertexBuffer;
+	GLuint indexBuffer;
+	int ringOffset;
+
+	Renderer::FrameStats stats;
+	Renderer::FrameStats prevStats;
 
 	TileRect roundedBox;
 };
@@ -49,10 +122,24 @@ static RendererInstance* RI;
 
 static void createBatchData()
 {
-	RI->batchPos = (uchar*)malloc(VB_POS_SIZE + VB_UVS_SIZE + VB_COL_SIZE);
+	RI->batchPos = (uchar*)malloc((VB_POS_SIZE + VB_UVS_SIZE + VB_COL_SIZE) * 2);
 	RI->batchUvs = RI->batchPos + VB_POS_SIZE;
 	RI->batchCol = RI->batchUvs + VB_UVS_SIZE;
-	RI->quadsLeft = BATCH_QUAD_LIMIT;
+	RI->numQuads = 0;
+
+	RI->sortedPos = RI->batchCol + VB_COL_SIZE;
+	RI->sortedUvs = RI->sortedPos + VB_POS_SIZE;
+	RI->sortedCol = RI->sortedUvs + VB_UVS_SIZE;
+	RI->recordDrawList = false;
+	RI->drawLayer = 0;
+
+	RI->texture = 0;
+	RI->shader = Shader::isSupported() ? SHADER_EXTERNAL : Renderer::SH_COLOR;
+	RI->color = RGBAtoColor32(255, 255, 255, 255);
+	RI->bindingShader = false;
+
+	RI->stats = {0, 0};
+	RI->prevStats = {0, 0};
 }
 
 static void createQuadIndices()
@@ -69,6 +156,42 @@ static void createQuadIndices()
 	}
 }
 
+static void createVertexBuffers()
+{
+	RI->vertexBuffer = 0;
+	RI->indexBuffer = 0;
+	RI->ringOffset = 0;
+
+	Vector<String> missing;
+	PROC(glGenBuffers);
+	PROC(glDeleteBuffers);
+	PROC(glBindBuffer);
+	PROC(glBufferData);
+	PROC(glBufferSubData);
+
+	if(missing.size())
+	{
+		Debug::blockBegin(Debug::WARNING, "some vertex buffer extensions are not supported");
+		for(auto& name : missing) Debug::log("missing: %s\n", name.str());
+		Debug::log("vertex buffer support :: MISSING, using vertex arrays\n");
+		Debug::blockEnd();
+		return;
+	}
+	Debug::log("vertex buffer support :: OK\n");
+
+	// The quad indices never change, so they are uploaded once.
+	glGenBuffers(1, &RI->indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, RI->indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * BATCH_QUAD_LIMIT * 6, RI->quadIndices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	// The vertices are streamed into a ring buffer, which is orphaned every time it wraps around.
+	glGenBuffers(1, &RI->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, RI->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, RING_BUFFER_SIZE, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
 static void loadShaders()
 {
 	const char* colorShaderVert =
@@ -127,6 +250,7 @@ void Renderer::create()
 
 	createBatchData();
 	createQuadIndices();
+	createVertexBuffers();
 	loadShaders();
 
 	Canvas roundedBox(16, 16, 1.0f);
@@ -141,6 +265,9 @@ void Renderer::create()
 
 void Renderer::destroy()
 {
+	if(RI->vertexBuffer) glDeleteBuffers(1, &RI->vertexBuffer);
+	if(RI->indexBuffer) glDeleteBuffers(1, &RI->indexBuffer);
+
 	free(RI->batchPos);
 	free(RI->quadIndices);
 
@@ -148,6 +275,232 @@ void Renderer::destroy()
 	RI = nullptr;
 }
 
+// ================================================================================================
+// Batch submission.
+
+// Enables the vertex arrays, and uploads the quads to the vertex buffer if it is supported.
+static QuadArrays BeginQuads(const uchar* pos, const uchar* uvs, const uchar* col, int numQuads)
+{
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+
+	QuadArrays out = {pos, uvs, col, RI->quadIndices};
+	if(RI->vertexBuffer)
+	{
+		int posSize = numQuads * VB_POS_STRIDE;
+		int uvsSize = numQuads * VB_UVS_STRIDE;
+		int colSize = numQuads * VB_COL_STRIDE;
+		int totalSize = posSize + uvsSize + colSize;
+
+		glBindBuffer(GL_ARRAY_BUFFER, RI->vertexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, RI->indexBuffer);
+
+		// When the ring buffer is full, the driver is given a new buffer to write to, so the next
+		// upload does not have to wait for the draw calls that still use the previous one.
+		if(RI->ringOffset + totalSize > RING_BUFFER_SIZE)
+		{
+			glBufferData(GL_ARRAY_BUFFER, RING_BUFFER_SIZE, nullptr, GL_STREAM_DRAW);
+			RI->ringOffset = 0;
+		}
+
+		int offset = RI->ringOffset;
+		glBufferSubData(GL_ARRAY_BUFFER, offset, posSize, pos);
+		glBufferSubData(GL_ARRAY_BUFFER, offset + posSize, uvsSize, uvs);
+		glBufferSubData(GL_ARRAY_BUFFER, offset + posSize + uvsSize, colSize, col);
+		RI->ringOffset += totalSize;
+
+		// With a bound vertex buffer, the pointers are offsets into the buffer.
+		out.pos = (const uchar*)(size_t)offset;
+		out.uvs = out.pos + posSize;
+		out.col = out.uvs + uvsSize;
+		out.indices = nullptr;
+	}
+	return out;
+}
+
+// Draws a range of the quads that were passed to BeginQuads.
+static void DrawQuadRange(const QuadArrays& arrays, int first, int count)
+{
+	glVertexPointer(2, GL_INT, 0, arrays.pos + first * VB_POS_STRIDE);
+	glTexCoordPointer(2, GL_FLOAT, 0, arrays.uvs + first * VB_UVS_STRIDE);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, arrays.col + first * VB_COL_STRIDE);
+	glDrawElements(GL_TRIANGLES, count * 6, GL_UNSIGNED_INT, arrays.indices);
+
+	++RI->stats.drawCalls;
+	RI->stats.quads += count;
+}
+
+// The remaining draw functions use vertex arrays, which requires the buffers to be unbound.
+static void EndQuads()
+{
+	if(RI->vertexBuffer)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+}
+
+// Binds one of the default shaders, without drawing the pending quads.
+static void ApplyShader(int shader)
+{
+	if(shader != SHADER_EXTERNAL && Shader::isSupported())
+	{
+		RI->bindingShader = true;
+		RI->shaders[shader].bind();
+		RI->bindingShader = false;
+	}
+}
+
+static bool DrawCommandLess(const DrawCommand& a, const DrawCommand& b)
+{
+	if(a.layer != b.layer) return a.layer < b.layer;
+	if(a.shader != b.shader) return a.shader < b.shader;
+	return a.texture < b.texture;
+}
+
+// Sorts the recorded draw commands, and draws each run of commands with the same shader and
+// texture with a single draw call.
+static void SubmitDrawList()
+{
+	auto& list = RI->drawList;
+	std::stable_sort(list.begin(), list.end(), DrawCommandLess);
+
+	// Copy the quads to the sorted buffers, in the order of the commands.
+	int numQuads = 0;
+	for(auto& cmd : list)
+	{
+		memcpy(RI->sortedPos + numQuads * VB_POS_STRIDE,
+			RI->batchPos + cmd.first * VB_POS_STRIDE, cmd.count * VB_POS_STRIDE);
+		memcpy(RI->sortedUvs + numQuads * VB_UVS_STRIDE,
+			RI->batchUvs + cmd.first * VB_UVS_STRIDE, cmd.count * VB_UVS_STRIDE);
+		memcpy(RI->sortedCol + numQuads * VB_COL_STRIDE,
+			RI->batchCol + cmd.first * VB_COL_STRIDE, cmd.count * VB_COL_STRIDE);
+		cmd.first = numQuads;
+		numQuads += cmd.count;
+	}
+
+	QuadArrays arrays = BeginQuads(RI->sortedPos, RI->sortedUvs, RI->sortedCol, numQuads);
+	for(int i = 0, n = list.size(); i < n;)
+	{
+		const DrawCommand& cmd = list[i];
+		int count = cmd.count;
+		for(++i; i < n && list[i].shader == cmd.shader && list[i].texture == cmd.texture; ++i)
+		{
+			count += list[i].count;
+		}
+		glBindTexture(GL_TEXTURE_2D, cmd.texture);
+		ApplyShader(cmd.shader);
+		DrawQuadRange(arrays, cmd.first, count);
+	}
+	EndQuads();
+
+	// Restore the render state that was set before the list was drawn.
+	glBindTexture(GL_TEXTURE_2D, RI->texture);
+	ApplyShader(RI->shader);
+	list.clear();
+}
+
+// Draws the pending quads, with a single draw call unless a draw list is recorded.
+static void SubmitQuads()
+{
+	int numQuads = RI->numQuads;
+	if(numQuads == 0) return;
+
+	VortexProfileZone("renderer flush");
+
+	if(RI->drawList.size())
+	{
+		SubmitDrawList();
+	}
+	else
+	{
+		// Texture uploads can change the bound texture in between batches, so it is bound again.
+		glBindTexture(GL_TEXTURE_2D, RI->texture);
+
+		QuadArrays arrays = BeginQuads(RI->batchPos, RI->batchUvs, RI->batchCol, numQuads);
+		DrawQuadRange(arrays, 0, numQuads);
+		EndQuads();
+	}
+
+	RI->numQuads = 0;
+}
+
+// Reserves space for the given number of quads and returns the index of the first quad.
+static int ReserveQuads(int numQuads)
+{
+	if(RI->numQuads + numQuads > BATCH_QUAD_LIMIT) SubmitQuads();
+	int offset = RI->numQuads;
+	RI->numQuads += numQuads;
+
+	// While recording a draw list, the quads are added to the command of the current state.
+	if(RI->recordDrawList)
+	{
+		auto& list = RI->drawList;
+		if(list.size())
+		{
+			DrawCommand& last = list.back();
+			if(last.layer == RI->drawLayer && last.shader == RI->shader &&
+				last.texture == RI->texture && last.first + last.count == offset)
+			{
+				last.count += numQuads;
+				return offset;
+			}
+		}
+		list.push_back({RI->drawLayer, RI->shader, RI->texture, offset, numQuads});
+	}
+
+	return offset;
+}
+
+// Ends a batch. While a default shader is bound the quads are kept, so they can be merged with
+// the next batch. Other shaders can have uniforms that change in between draw calls.
+static void EndBatch()
+{
+	if(RI->shader == SHADER_EXTERNAL) SubmitQuads();
+}
+
+// Copies quads to the pending quads. Missing texture coordinates are set to zero, and missing
+// colors are set to the current color, which matches the defaults of the disabled arrays.
+static void AppendQuads(int numQuads, const int* pos, const float* uvs, const color32* col)
+{
+	while(numQuads > 0)
+	{
+		int n = min(numQuads, BATCH_QUAD_LIMIT);
+		int offset = ReserveQuads(n);
+
+		memcpy(RI->batchPos + offset * VB_POS_STRIDE, pos, n * VB_POS_STRIDE);
+		pos += n * 8;
+
+		float* dstUvs = (float*)(RI->batchUvs + offset * VB_UVS_STRIDE);
+		if(uvs)
+		{
+			memcpy(dstUvs, uvs, n * VB_UVS_STRIDE);
+			uvs += n * 8;
+		}
+		else
+		{
+			memset(dstUvs, 0, n * VB_UVS_STRIDE);
+		}
+
+		color32* dstCol = (color32*)(RI->batchCol + offset * VB_COL_STRIDE);
+		if(col)
+		{
+			memcpy(dstCol, col, n * VB_COL_STRIDE);
+			col += n * 4;
+		}
+		else
+		{
+			for(int i = 0; i < n * 4; ++i) dstCol[i] = RI->color;
+		}
+
+		numQuads -= n;
+	}
+	EndBatch();
+}
+
+// ================================================================================================
+// Frames.
+
 void Renderer::startFrame()
 {
 	vec2i view = GuiMain::getViewSize();
@@ -157,8 +510,40 @@ void Renderer::startFrame()
 
 void Renderer::endFrame()
 {
+	SubmitQuads();
+	RI->recordDrawList = false;
+
 	glDisable(GL_SCISSOR_TEST);
 	RI->scissorStack.clear();
+
+	RI->prevStats = RI->stats;
+	RI->stats = {0, 0};
+}
+
+Renderer::FrameStats Renderer::getFrameStats()
+{
+	return RI->prevStats;
+}
+
+// ================================================================================================
+// Draw lists.
+
+void Renderer::beginDrawList()
+{
+	SubmitQuads();
+	RI->recordDrawList = true;
+	RI->drawLayer = 0;
+}
+
+void Renderer::setDrawLayer(int layer)
+{
+	RI->drawLayer = layer;
+}
+
+void Renderer::endDrawList()
+{
+	SubmitQuads();
+	RI->recordDrawList = false;
 }
 
 // ================================================================================================
@@ -166,36 +551,48 @@ void Renderer::endFrame()
 
 void Renderer::bindTexture(TextureHandle texture)
 {
+	if(texture != RI->texture && !RI->recordDrawList) SubmitQuads();
 	glBindTexture(GL_TEXTURE_2D, texture);
+	RI->texture = texture;
 }
 
 void Renderer::unbindTexture()
 {
-	glBindTexture(GL_TEXTURE_2D, 0);
+	bindTexture(0);
 }
 
 void Renderer::bindShader(DefaultShader shader)
 {
-	if(Shader::isSupported())
-	{
-		RI->shaders[shader].bind();
-	}
+	if(shader == RI->shader) return;
+	if(!RI->recordDrawList) SubmitQuads();
+	ApplyShader(shader);
+	RI->shader = shader;
+}
+
+void Renderer::invalidateShader()
+{
+	if(!RI || RI->bindingShader) return;
+	SubmitQuads();
+	RI->shader = SHADER_EXTERNAL;
 }
 
 void Renderer::setColor(colorf color)
 {
 	glColor4f(color.r, color.g, color.b, color.a);
+	RI->color = ToColor32(color);
 }
 
 void Renderer::setColor(color32 color)
 {
 	uchar* c = (uchar*)&color;
 	glColor4ub(c[0], c[1], c[2], c[3]);
+	RI->color = color;
 }
 
 void  Renderer::resetColor()
 {
 	glColor4ub(255, 255, 255, 255);
+	RI->color = RGBAtoColor32(255, 255, 255, 255);
 }
 
 void Renderer::pushScissorRect(const recti& r)
@@ -205,6 +602,8 @@ void Renderer::pushScissorRect(const recti& r)
 
 void Renderer::pushScissorRect(int x, int y, int w, int h)
 {
+	SubmitQuads();
+
 	auto& stack = RI->scissorStack;
 	w = max(w, 0), h = max(h, 0);
 	if(stack.empty())
@@ -231,6 +630,8 @@ void Renderer::pushScissorRect(int x, int y, int w, int h)
 
 void Renderer::popScissorRect()
 {
+	SubmitQuads();
+
 	auto& stack = RI->scissorStack;
 	if(stack.size() == 1)
 	{
@@ -249,98 +650,67 @@ void Renderer::popScissorRect()
 // ================================================================================================
 // Core rendering functions.
 
-static int FlushQuads(GLint vertexType, const void* pos,
-	const float* uvs = nullptr, const color32* col = nullptr)
-{
-	glDrawElements(GL_TRIANGLES, BATCH_QUAD_LIMIT * 6, GL_UNSIGNED_INT, RI->quadIndices);
-	pos = (int*)pos + BATCH_QUAD_LIMIT * 8;
-	glVertexPointer(2, vertexType, 0, pos);
-	if(uvs)
-	{
-		uvs += BATCH_QUAD_LIMIT * 8;
-		glTexCoordPointer(2, GL_FLOAT, 0, uvs);
-	}
-	if(col)
-	{
-		col += BATCH_QUAD_LIMIT * 4;
-		glColorPointer(4, GL_UNSIGNED_BYTE, 0, col);
-	}
-	return BATCH_QUAD_LIMIT;
-}
-
 void Renderer::drawQuads(int numQuads, const int* pos)
 {
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-	glDisableClientState(GL_COLOR_ARRAY);
-
-	glVertexPointer(2, GL_INT, 0, pos);
-
-	while(numQuads > BATCH_QUAD_LIMIT) numQuads -= FlushQuads(GL_INT, pos);
-	glDrawElements(GL_TRIANGLES, numQuads * 6, GL_UNSIGNED_INT, RI->quadIndices);
+	AppendQuads(numQuads, pos, nullptr, nullptr);
 }
 
 void Renderer::drawQuads(int numQuads, const int* pos, const color32* col)
 {
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
-
-	glVertexPointer(2, GL_INT, 0, pos);
-	glColorPointer(4, GL_UNSIGNED_BYTE, 0, col);
-
-	while(numQuads > BATCH_QUAD_LIMIT) numQuads -= FlushQuads(GL_INT, pos, nullptr, col);
-	glDrawElements(GL_TRIANGLES, numQuads * 6, GL_UNSIGNED_INT, RI->quadIndices);
+	AppendQuads(numQuads, pos, nullptr, col);
 }
 
 void Renderer::drawQuads(int numQuads, const int* pos, const float* uvs)
 {
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glDisableClientState(GL_COLOR_ARRAY);
-
-	glVertexPointer(2, GL_INT, 0, pos);
-	glTexCoordPointer(2, GL_FLOAT, 0, uvs);
-
-	while(numQuads > BATCH_QUAD_LIMIT) numQuads -= FlushQuads(GL_INT, pos, uvs);
-	glDrawElements(GL_TRIANGLES, numQuads * 6, GL_UNSIGNED_INT, RI->quadIndices);
+	AppendQuads(numQuads, pos, uvs, nullptr);
 }
 
 void Renderer::drawQuads(int numQuads, const int* pos, const float* uvs, const color32* col)
 {
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
-
-	glVertexPointer(2, GL_INT, 0, pos);
-	glTexCoordPointer(2, GL_FLOAT, 0, uvs);	
-	glColorPointer(4, GL_UNSIGNED_BYTE, 0, col);
-	
-	while(numQuads > BATCH_QUAD_LIMIT) numQuads -= FlushQuads(GL_INT, pos, uvs, col);
-	glDrawElements(GL_TRIANGLES, numQuads * 6, GL_UNSIGNED_INT, RI->quadIndices);
+	AppendQuads(numQuads, pos, uvs, col);
 }
 
 void Renderer::drawQuads(int numQuads, const float* pos, const float* uvs, const color32* col)
 {
+	SubmitQuads();
+
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 	glEnableClientState(GL_COLOR_ARRAY);
 
-	glVertexPointer(2, GL_FLOAT, 0, pos);
-	glTexCoordPointer(2, GL_FLOAT, 0, uvs);
-	glColorPointer(4, GL_INT, 0, col);
+	while(numQuads > 0)
+	{
+		int n = min(numQuads, BATCH_QUAD_LIMIT);
+
+		glVertexPointer(2, GL_FLOAT, 0, pos);
+		glTexCoordPointer(2, GL_FLOAT, 0, uvs);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, col);
+		glDrawElements(GL_TRIANGLES, n * 6, GL_UNSIGNED_INT, RI->quadIndices);
 
-	while(numQuads > BATCH_QUAD_LIMIT) numQuads -= FlushQuads(GL_FLOAT, pos, uvs, col);
-	glDrawElements(GL_TRIANGLES, numQuads * 6, GL_UNSIGNED_INT, RI->quadIndices);
+		++RI->stats.drawCalls;
+		RI->stats.quads += n;
+
+		pos += n * 8, uvs += n * 8, col += n * 4;
+		numQuads -= n;
+	}
 }
 
 void Renderer::drawTris(int numTris, const uint* indices, const int* pos)
 {
+	SubmitQuads();
+
 	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 
 	glVertexPointer(2, GL_INT, 0, pos);
 
 	glDrawElements(GL_TRIANGLES, numTris * 3, GL_UNSIGNED_INT, indices);
+	++RI->stats.drawCalls;
 }
 
 void Renderer::drawTris(int numTris, const uint* indices, const int* pos, const float* uvs)
 {
+	SubmitQuads();
+
 	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 	glDisableClientState(GL_COLOR_ARRAY);
 
@@ -348,57 +718,36 @@ void Renderer::drawTris(int numTris, const uint* indices, const int* pos, const
 	glTexCoordPointer(2, GL_FLOAT, 0, uvs);
 	
 	glDrawElements(GL_TRIANGLES, numTris * 3, GL_UNSIGNED_INT, indices);
+	++RI->stats.drawCalls;
 }
 
 // ================================================================================================
 // Batch rendering.
 
-static void FlushIC()
-{
-	Renderer::drawQuads(BATCH_QUAD_LIMIT - RI->quadsLeft,
-		(int*)RI->batchPos, (color32*)RI->batchCol);
-	RI->quadsLeft = BATCH_QUAD_LIMIT;
-}
-
-static void FlushIT()
-{
-	Renderer::drawQuads(BATCH_QUAD_LIMIT - RI->quadsLeft,
-		(int*)RI->batchPos, (float*)RI->batchUvs);
-	RI->quadsLeft = BATCH_QUAD_LIMIT;
-}
-
-static void FlushITC()
-{
-	Renderer::drawQuads(BATCH_QUAD_LIMIT - RI->quadsLeft,
-		(int*)RI->batchPos, (float*)RI->batchUvs, (color32*)RI->batchCol);
-	RI->quadsLeft = BATCH_QUAD_LIMIT;
-}
-
 void QuadBatchC::push(int numQuads)
 {
-	if(RI->quadsLeft < numQuads) FlushIC();
-	int offset = BATCH_QUAD_LIMIT - RI->quadsLeft;
-	RI->quadsLeft -= numQuads;
+	int offset = ReserveQuads(numQuads);
 
 	pos = (int*)(RI->batchPos + offset * VB_POS_STRIDE);
 	col = (color32*)(RI->batchCol + offset * VB_COL_STRIDE);
+
+	memset(RI->batchUvs + offset * VB_UVS_STRIDE, 0, numQuads * VB_UVS_STRIDE);
 }
 
 void QuadBatchT::push(int numQuads)
 {
-	if(RI->quadsLeft < numQuads) FlushIT();
-	int offset = BATCH_QUAD_LIMIT - RI->quadsLeft;
-	RI->quadsLeft -= numQuads;
+	int offset = ReserveQuads(numQuads);
 
 	pos = (int*)(RI->batchPos + offset * VB_POS_STRIDE);
 	uvs = (float*)(RI->batchUvs + offset * VB_UVS_STRIDE);
+
+	color32* c = (color32*)(RI->batchCol + offset * VB_COL_STRIDE);
+	for(int i = 0; i < numQuads * 4; ++i) c[i] = RI->color;
 }
 
 void QuadBatchTC::push(int numQuads)
 {
-	if(RI->quadsLeft < numQuads) FlushITC();
-	int offset = BATCH_QUAD_LIMIT - RI->quadsLeft;
-	RI->quadsLeft -= numQuads;
+	int offset = ReserveQuads(numQuads);
 
 	pos = (int*)(RI->batchPos + offset * VB_POS_STRIDE);
 	uvs = (float*)(RI->batchUvs + offset * VB_UVS_STRIDE);
@@ -407,17 +756,17 @@ void QuadBatchTC::push(int numQuads)
 
 void QuadBatchC::flush()
 {
-	FlushIC();
+	EndBatch();
 }
 
 void QuadBatchT::flush()
 {
-	FlushIT();
+	EndBatch();
 }
 
 void QuadBatchTC::flush()
 {
-	FlushITC();
+	EndBatch();
 }
 
 QuadBatchC Renderer::batchC()
@@ -47,17 +47,43 @@ namespace Renderer
 		SH_TEXTURE_ALPHA,
 	};
 
+	/// Number of draw calls and quads of a frame.
+	struct FrameStats
+	{
+		int drawCalls;
+		int quads;
+	};
+
 	void create();
 	void destroy();
 
 	void startFrame();
 	void endFrame();
 
+	/// Returns the number of draw calls and quads of the previous frame.
+	FrameStats getFrameStats();
+
+	/// Starts recording a draw list. The quads of a draw list are not drawn in the order they are
+	/// submitted, but sorted by layer, shader and texture, so quads that use the same texture can
+	/// share a draw call. Quads with the same layer, shader and texture keep their order. Changing
+	/// the scissor region or binding a shader outside of the renderer draws the quads so far.
+	void beginDrawList();
+
+	/// Sets the layer of the quads that are recorded next, higher layers are drawn on top.
+	void setDrawLayer(int layer);
+
+	/// Draws the recorded quads and stops recording.
+	void endDrawList();
+
 	void bindTexture(TextureHandle texture);
 	void unbindTexture();
 
 	void bindShader(DefaultShader shader);
 
+	/// Draws the pending quads and stops merging quads into larger draw calls until a default
+	/// shader is bound again. Called when a shader is bound outside of the renderer.
+	void invalidateShader();
+
 	void setColor(colorf color);
 	void setColor(color32 color);
 	void resetColor();
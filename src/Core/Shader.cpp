@@ -2,6 +2,7 @@
 
 #include <Core/Utils.h>
 #include <Core/StringUtils.h>
+#include <Core/Renderer.h>
 
 #include <System/File.h>
 #include <System/Debug.h>
@@ -217,11 +218,13 @@ bool Shader::load(const char* vertexCode, const char* fragmentCode, const char*
 
 void Shader::bind()
 {
+	Renderer::invalidateShader();
 	glUseProgram(program_id_);
 }
 
 void Shader::unbind()
 {
+	Renderer::invalidateShader();
 	glUseProgram(0);
 }
 
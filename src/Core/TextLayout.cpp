@@ -8,13 +8,48 @@
 
 #include <cctype>
 #include <stdint.h>
+#include <unordered_map>
 
 namespace Vortex {
 namespace {
 
 enum { NO_MAX_LINE_WIDTH = -1 };
 
+// Number of frames after which an unused layout is removed from the layout cache.
+static const int CACHE_MAX_AGE = 60;
+
+// Arranged text that is kept across frames, so labels that are arranged every frame only have
+// to be laid out once. The glyph pointers are only valid for the glyph generation it was made in.
+struct CachedLayout
+{
+	String text;
+	FontData* font;
+	int fontSize, maxLineW;
+	uint flags;
+	color32 textColor, shadowColor;
+	Text::Align align;
+
+	uint glyphGeneration;
+	int lastUsedFrame;
+
+	int textW, textH;
+	int lineTop, lineBottom;
+	Vector<LQuad> fgQuads;
+	Vector<LQuad> bgQuads;
+	Vector<LGlyph> glyphs;
+	Vector<LMarkup> markup;
+	Vector<LLine> lines;
+};
+
+struct LayoutCache
+{
+	std::unordered_map<uint64_t, CachedLayout*> layouts;
+	TextLayout::CacheStats frameStats, prevFrameStats;
+	int frame;
+};
+
 static LLayout* LD = nullptr;
+static LayoutCache* LC = nullptr;
 
 }; // anonymous namespace
 
@@ -601,6 +636,100 @@ static void AlignText()
 	};
 }
 
+// ================================================================================================
+// Layout cache functions
+
+static uint64_t HashLayout(const TextStyle& style, int maxLineW, Text::Align align, const char* str, int len)
+{
+	// 64-bit FNV-1a over the text, followed by the style parameters that affect the layout.
+	uint64_t h = 14695981039346656037ULL;
+	auto add = [&h](uint64_t v) { h = (h ^ v) * 1099511628211ULL; };
+	for(int i = 0; i < len; ++i) add((uchar)str[i]);
+	add((uint64_t)(uintptr_t)style.font.data());
+	add((uint)style.fontSize);
+	add(style.textFlags);
+	add(style.textColor);
+	add(style.shadowColor);
+	add((uint)maxLineW);
+	add(align);
+	return h;
+}
+
+static bool MatchesLayout(const CachedLayout* entry, const TextStyle& style, int maxLineW,
+	Text::Align align, const char* str, int len)
+{
+	return entry->glyphGeneration == FontData::glyphGeneration
+		&& entry->font == (FontData*)style.font.data()
+		&& entry->fontSize == style.fontSize
+		&& entry->flags == style.textFlags
+		&& entry->textColor == style.textColor
+		&& entry->shadowColor == style.shadowColor
+		&& entry->maxLineW == maxLineW
+		&& entry->align == align
+		&& entry->text.len() == len
+		&& memcmp(entry->text.str(), str, len) == 0;
+}
+
+static void StoreLayout(CachedLayout* entry, const TextStyle& style, int maxLineW, const char* str, int len)
+{
+	entry->text = String(str, len);
+	entry->font = (FontData*)style.font.data();
+	entry->fontSize = style.fontSize;
+	entry->flags = style.textFlags;
+	entry->textColor = style.textColor;
+	entry->shadowColor = style.shadowColor;
+	entry->maxLineW = maxLineW;
+	entry->align = LD->align;
+	entry->glyphGeneration = FontData::glyphGeneration;
+	entry->textW = LD->textW;
+	entry->textH = LD->textH;
+	entry->lineTop = LD->lineTop;
+	entry->lineBottom = LD->lineBottom;
+	entry->fgQuads.assign(LD->fgQuads);
+	entry->bgQuads.assign(LD->bgQuads);
+	entry->glyphs.assign(LD->glyphs);
+	entry->markup.assign(LD->markup);
+	entry->lines.assign(LD->lines);
+}
+
+static void RestoreLayout(const CachedLayout* entry)
+{
+	LD->textW = entry->textW;
+	LD->textH = entry->textH;
+	LD->lineTop = entry->lineTop;
+	LD->lineBottom = entry->lineBottom;
+	LD->fgQuads.assign(entry->fgQuads);
+	LD->bgQuads.assign(entry->bgQuads);
+	LD->glyphs.assign(entry->glyphs);
+	LD->markup.assign(entry->markup);
+	LD->lines.assign(entry->lines);
+
+	// Mark the glyphs as used, otherwise the font would release them while they are still drawn.
+	for(auto& item : LD->glyphs)
+	{
+		const_cast<Glyph*>(item.glyph)->timeSinceLastUse = 0;
+	}
+}
+
+static void EvictOldLayouts()
+{
+	for(auto it = LC->layouts.begin(); it != LC->layouts.end();)
+	{
+		if(LC->frame - it->second->lastUsedFrame > CACHE_MAX_AGE)
+		{
+			delete it->second;
+			it = LC->layouts.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+// ================================================================================================
+// Text arrangement
+
 static vec2i ArrangeText(const TextStyle& style, int maxLineWidth, Text::Align align, const char* str)
 {
 	LD->style = style;
@@ -622,10 +751,26 @@ static vec2i ArrangeText(const TextStyle& style, int maxLineWidth, Text::Align a
 
 	LD->stringLength = strlen(str);
 
-	ClearLayout();
-	SetLineMetrics();
-	CreateLayout(str);
-	AlignText();
+	// Reuse the arrangement of a previous call with the same text and style, if there is one.
+	uint64_t hash = HashLayout(style, maxLineWidth, align, str, LD->stringLength);
+	CachedLayout*& entry = LC->layouts[hash];
+	if(entry && MatchesLayout(entry, style, maxLineWidth, align, str, LD->stringLength))
+	{
+		++LC->frameStats.hits;
+		RestoreLayout(entry);
+	}
+	else
+	{
+		++LC->frameStats.misses;
+		ClearLayout();
+		SetLineMetrics();
+		CreateLayout(str);
+		AlignText();
+
+		if(!entry) entry = new CachedLayout;
+		StoreLayout(entry, style, maxLineWidth, str, LD->stringLength);
+	}
+	entry->lastUsedFrame = LC->frame;
 
 	return {LD->textW, LD->textH};
 }
@@ -655,10 +800,18 @@ void TextLayout::create()
 	LD = new LLayout;
 	LD->fgQuad.enabled = false;
 	LD->fgQuad.enabled = false;
+
+	LC = new LayoutCache;
+	LC->frameStats = LC->prevFrameStats = {0, 0, 0};
+	LC->frame = 0;
 }
 
 void TextLayout::destroy()
 {
+	for(auto& it : LC->layouts) delete it.second;
+	delete LC;
+	LC = nullptr;
+
 	delete LD;
 	LD = nullptr;
 }
@@ -666,6 +819,12 @@ void TextLayout::destroy()
 void TextLayout::endFrame()
 {
 	LD->lines.clear();
+
+	EvictOldLayouts();
+	LC->frameStats.entries = LC->layouts.size();
+	LC->prevFrameStats = LC->frameStats;
+	LC->frameStats = {0, 0, 0};
+	++LC->frame;
 }
 
 LLayout& TextLayout::get()
@@ -673,6 +832,11 @@ LLayout& TextLayout::get()
 	return *LD;
 }
 
+TextLayout::CacheStats TextLayout::getCacheStats()
+{
+	return LC->prevFrameStats;
+}
+
 vec2i TextLayout::getTextPos(recti r)
 {
 	int x = r.x, y = r.y, w = r.w, h = r.h;
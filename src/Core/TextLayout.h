@@ -96,6 +96,9 @@ struct LLayout
 
 struct TextLayout {
 
+// Layout cache counters of the previous frame.
+struct CacheStats { int hits, misses, entries; };
+
 static void create();
 static void destroy();
 static void endFrame();
@@ -105,6 +108,8 @@ static LLayout& get();
 static vec2i getTextPos(recti rect);
 static recti getTextBB(vec2i pos);
 
+static CacheStats getCacheStats();
+
 }; // TextArranger.
 
 }; // namespace Vortex
@@ -0,0 +1,112 @@
+#include <Core/TextureAtlas.h>
+
+#include <Core/Utils.h>
+#include <Core/ImageLoader.h>
+
+namespace Vortex {
+
+// Width of the border of repeated edge pixels around each image.
+static const int PADDING = 2;
+
+// Size of the pages of the shared atlas, the interface sprites are small.
+static const int SHARED_PAGE_SIZE = 512;
+
+// Copies an image into a buffer with a border of repeated edge pixels on each side.
+static void ExtrudeImage(Vector<uint>& out, int w, int h, const uchar* pixels)
+{
+	int pw = w + PADDING * 2, ph = h + PADDING * 2;
+	out.resize(pw * ph);
+
+	const uint* src = (const uint*)pixels;
+	uint* dst = out.data();
+	for(int y = 0; y < ph; ++y)
+	{
+		const uint* row = src + clamp(y - PADDING, 0, h - 1) * w;
+		for(int x = 0; x < pw; ++x, ++dst)
+		{
+			*dst = row[clamp(x - PADDING, 0, w - 1)];
+		}
+	}
+}
+
+TextureAtlas::~TextureAtlas()
+{
+}
+
+TextureAtlas::TextureAtlas(int pageSize)
+	: page_size_(pageSize)
+{
+}
+
+bool TextureAtlas::add(const char* path, Region& out)
+{
+	ImageLoader::Data img = ImageLoader::load(path, ImageLoader::RGBA);
+	if(!img.pixels) return false;
+
+	add(img.width, img.height, img.pixels, out);
+	ImageLoader::release(img);
+
+	return true;
+}
+
+void TextureAtlas::add(int w, int h, const uchar* pixels, Region& out)
+{
+	Vector<uint> padded;
+	ExtrudeImage(padded, w, h, pixels);
+	int pw = w + PADDING * 2, ph = h + PADDING * 2;
+
+	Page* page = nullptr;
+	vec2i pos = {0, 0};
+	if(pw > page_size_ || ph > page_size_)
+	{
+		// Images that do not fit in a page get a texture of their own, which is marked as full.
+		page = &pages_.append();
+		page->texture = Texture(pw, ph, (const uchar*)padded.data());
+		page->shelfX = page->shelfH = 0;
+		page->shelfY = page_size_;
+	}
+	else
+	{
+		// If the image does not fit on the current shelf, we close the shelf and open a new one.
+		page = pages_.empty() ? nullptr : &pages_.back();
+		if(page && page->shelfX + pw > page_size_)
+		{
+			page->shelfY += page->shelfH;
+			page->shelfX = page->shelfH = 0;
+		}
+
+		// If the new shelf exceeds the page height, we start a new page.
+		if(!page || page->shelfY + ph > page_size_)
+		{
+			page = &pages_.append();
+			page->texture = Texture(page_size_, page_size_);
+			page->shelfX = page->shelfY = page->shelfH = 0;
+		}
+
+		pos = {page->shelfX, page->shelfY};
+		page->shelfX += pw;
+		page->shelfH = max(page->shelfH, ph);
+		page->texture.modify(pos.x, pos.y, pw, ph, (const uchar*)padded.data());
+	}
+
+	vec2i size = page->texture.size();
+	float rw = 1.f / max(size.x, 1);
+	float rh = 1.f / max(size.y, 1);
+
+	out.page = page->texture;
+	out.rect = {pos.x + PADDING, pos.y + PADDING, w, h};
+	out.uvs = {out.rect.x * rw, out.rect.y * rh, (out.rect.x + w) * rw, (out.rect.y + h) * rh};
+}
+
+int TextureAtlas::getNumPages() const
+{
+	return pages_.size();
+}
+
+TextureAtlas& TextureAtlas::shared()
+{
+	static TextureAtlas atlas(SHARED_PAGE_SIZE);
+	return atlas;
+}
+
+}; // namespace Vortex
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Core/Texture.h>
+#include <Core/Vector.h>
+
+namespace Vortex {
+
+/// Packs images into a few large textures, so sprites from different images can be drawn with
+/// the same texture and end up in the same draw call. Images are placed on shelves, like the
+/// glyphs of a glyph cache, and are surrounded by a border of repeated edge pixels so linear
+/// filtering does not pick up the neighbouring images.
+class TextureAtlas
+{
+public:
+	/// Location of an image in the atlas.
+	struct Region
+	{
+		Texture page; ///< The texture that contains the image.
+		areaf uvs;    ///< Texture coordinates of the image.
+		recti rect;   ///< Pixel rectangle of the image in the texture.
+	};
+
+	~TextureAtlas();
+
+	/// Creates an empty atlas with square textures of the given size. Images that are larger
+	/// than a page get a texture of their own.
+	TextureAtlas(int pageSize = 1024);
+
+	/// Adds an image file to the atlas. Returns false if the image could not be loaded.
+	bool add(const char* path, Region& out);
+
+	/// Adds an image from a buffer of [w * h * 4] RGBA pixel values.
+	void add(int w, int h, const uchar* pixels, Region& out);
+
+	/// Returns the number of textures that are used by the atlas.
+	int getNumPages() const;
+
+	/// Returns the atlas that is shared by the sprites of the editor interface.
+	static TextureAtlas& shared();
+
+private:
+	struct Page
+	{
+		Texture texture;
+		int shelfX, shelfY, shelfH;
+	};
+
+	Vector<Page> pages_;
+	int page_size_;
+};
+
+}; // namespace Vortex
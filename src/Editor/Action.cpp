@@ -255,6 +255,8 @@ void Action::perform(Type action)
 		gMusic->setSpeed(gMusic->getSpeed() + 10);
 	CASE(SPEED_DECREASE)
 		gMusic->setSpeed(gMusic->getSpeed() - 10);
+	CASE(SPEED_PRESERVE_PITCH)
+		gMusic->togglePreservePitch();
 
 	CASE(TOGGLE_BEAT_TICK)
 		gMusic->toggleBeatTick();
@@ -366,6 +368,10 @@ void Action::perform(Type action)
 		gTextOverlay->show(TextOverlay::MESSAGE_LOG);
 	CASE(SHOW_DEBUG_LOG)
 		gTextOverlay->show(TextOverlay::DEBUG_LOG);
+	CASE(SHOW_PROFILER)
+		gEditor->toggleProfiler();
+	CASE(EXPORT_PROFILER_TRACE)
+		gEditor->exportProfilerTrace();
 	CASE(SHOW_ABOUT)
 		gTextOverlay->show(TextOverlay::ABOUT);
 	}};
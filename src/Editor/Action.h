@@ -141,6 +141,7 @@ namespace Action {
 	SPEED_RESET,
 	SPEED_INCREASE,
 	SPEED_DECREASE,
+	SPEED_PRESERVE_PITCH,
 	
 	TOGGLE_BEAT_TICK,
 	TOGGLE_NOTE_TICK,
@@ -204,6 +205,8 @@ namespace Action {
 	SHOW_SHORTCUTS,
 	SHOW_MESSAGE_LOG,
 	SHOW_DEBUG_LOG,
+	SHOW_PROFILER,
+	EXPORT_PROFILER_TRACE,
 	SHOW_ABOUT,
 	};
 
@@ -0,0 +1,350 @@
+#include <Editor/BatchProcess.h>
+
+#include <Core/Utils.h>
+#include <Core/StringUtils.h>
+
+#include <System/Debug.h>
+#include <System/File.h>
+#include <System/Thread.h>
+
+#include <Simfile/Simfile.h>
+#include <Simfile/Chart.h>
+#include <Simfile/Tempo.h>
+#include <Simfile/SegmentGroup.h>
+#include <Simfile/TimingData.h>
+#include <Simfile/Parsing.h>
+
+#include <Editor/Common.h>
+#include <Editor/Sound.h>
+#include <Editor/FindTempo.h>
+#include <Editor/ConvertToOgg.h>
+#include <Editor/RatingEstimator.h>
+
+#include <algorithm>
+
+namespace Vortex {
+
+namespace {
+
+// Stages of the processing of a song, which are timed separately.
+enum Stage
+{
+	STAGE_LOAD,
+	STAGE_NORMALIZE,
+	STAGE_RATING,
+	STAGE_AUDIO,
+	STAGE_BPM,
+	STAGE_OGG,
+	STAGE_SAVE,
+
+	NUM_STAGES
+};
+
+static const char* sStageNames[NUM_STAGES] =
+{
+	"load", "normalize", "rating", "audio", "bpm", "ogg", "save"
+};
+
+// The music of each worker is loaded in memory, so 32-bit builds use fewer workers for audio.
+static const int MAX_AUDIO_THREADS_32BIT = 4;
+
+struct SongResult
+{
+	String path;
+	String error;
+	Vector<String> report;
+	double times[NUM_STAGES];
+	double total;
+	int thread;
+};
+
+// Returns the simfile with the most preferred format in the given directory, or an empty string.
+static String FindSimfile(StringRef dir)
+{
+	static const char* extList[] = {"ssc", "sm", "dwi", "osu"};
+	static const char** extEnd = extList + 4;
+
+	String out;
+	auto curPriority = extEnd;
+	for(auto& file : File::findFiles(dir, false))
+	{
+		String ext = file.ext();
+		Str::toLower(ext);
+		auto priority = std::find(extList, extEnd, ext);
+		if(priority < curPriority)
+		{
+			curPriority = priority;
+			out = file.str;
+		}
+	}
+	return out;
+}
+
+struct BatchThreads : public ParallelThreads
+{
+	void exec(int item, int thread) override;
+	void processSong(SongResult& out, double& stageStart);
+	void logSong(const SongResult& song);
+
+	const BatchOptions* options;
+	const RatingEstimator* estimator;
+	Vector<SongResult> songs;
+	CriticalSection logLock;
+	int numLogged;
+};
+
+void BatchThreads::exec(int item, int thread)
+{
+	SongResult& song = songs[item];
+	song.thread = thread;
+	for(double& t : song.times) t = -1.0;
+
+	// The hud messages of the loaders and savers are reported with the song.
+	CaptureHudMessages(&song.report);
+	double start = Debug::getElapsedTime(), stageStart = start;
+	processSong(song, stageStart);
+	song.total = Debug::getElapsedTime(start);
+	CaptureHudMessages(nullptr);
+
+	logSong(song);
+}
+
+void BatchThreads::processSong(SongResult& out, double& stageStart)
+{
+	int steps = options->steps;
+	auto endStage = [&](Stage stage)
+	{
+		double now = Debug::getElapsedTime();
+		out.times[stage] = now - stageStart;
+		stageStart = now;
+	};
+
+	Simfile sim;
+	if(!LoadSimfile(sim, out.path))
+	{
+		out.error = "could not load the simfile";
+		return;
+	}
+	endStage(STAGE_LOAD);
+
+	bool modified = false;
+	if(steps & BATCH_NORMALIZE)
+	{
+		sim.sanitize();
+		modified = true;
+		endStage(STAGE_NORMALIZE);
+	}
+
+	if(steps & BATCH_RATING)
+	{
+		for(auto chart : sim.charts)
+		{
+			TimingData timing;
+			timing.update(chart->getTempo(&sim));
+			double rating = estimator->estimateRating(chart, timing);
+			out.report.push_back(Str::fmt("%1: estimated rating %2")
+				.arg(chart->description()).arg(rating, 1, 1));
+		}
+		endStage(STAGE_RATING);
+	}
+
+	if(steps & (BATCH_BPM | BATCH_OGG))
+	{
+		Sound music;
+		String title, artist;
+		Path musicPath(sim.dir, sim.music);
+		if(sim.music.empty() || !music.load(musicPath.str.str(), false, title, artist))
+		{
+			out.report.push_back("could not load the music, skipped the audio steps");
+		}
+		else
+		{
+			endStage(STAGE_AUDIO);
+
+			// The songs already run in parallel, so the detection uses a single thread.
+			if(steps & BATCH_BPM)
+			{
+				Vector<TempoResult> tempo;
+				if(TempoDetector::detect(music, tempo, 1) && tempo.size())
+				{
+					double bpm = sim.tempo->segments->getRecent<BpmChange>(0).bpm;
+					out.report.push_back(Str::fmt("%1 BPM, offset %2; detected %3 BPM, offset %4")
+						.arg(bpm, 3, 3).arg(sim.tempo->offset, 3, 3)
+						.arg(tempo[0].bpm, 3, 3).arg(-tempo[0].offset, 3, 3));
+				}
+				else
+				{
+					out.report.push_back("could not detect the BPM");
+				}
+				endStage(STAGE_BPM);
+			}
+
+			if((steps & BATCH_OGG) && !musicPath.hasExt("ogg"))
+			{
+				Path oggPath = musicPath;
+				oggPath.dropExt();
+				Str::append(oggPath.str, ".ogg");
+
+				OggConversionThread conversion;
+				conversion.source = &music;
+				conversion.outPath = oggPath;
+				conversion.exec();
+				if(conversion.error.empty())
+				{
+					sim.music = oggPath.filename();
+					modified = true;
+				}
+				else
+				{
+					out.report.push_back(Str::fmt("ogg conversion failed: %1").arg(conversion.error));
+				}
+				endStage(STAGE_OGG);
+			}
+		}
+	}
+
+	if(modified || (steps & BATCH_SSC))
+	{
+		SimFormat format = sim.format;
+		if((steps & BATCH_SSC) || (format != SIM_SM && format != SIM_OSU)) format = SIM_SSC;
+		if(!SaveSimfile(sim, format, true))
+		{
+			out.error = "could not save the simfile";
+		}
+		endStage(STAGE_SAVE);
+	}
+}
+
+void BatchThreads::logSong(const SongResult& song)
+{
+	String stages;
+	for(int i = 0; i < NUM_STAGES; ++i)
+	{
+		if(song.times[i] < 0.0) continue;
+		if(stages.len()) Str::append(stages, ", ");
+		String stage = Str::fmt("%1 %2 ms").arg(sStageNames[i]).arg(song.times[i] * 1000.0, 0, 0);
+		Str::append(stages, stage);
+	}
+
+	// The lines of a song are logged together, without lines of other songs in between.
+	logLock.lock();
+	++numLogged;
+	Debug::log("[%i/%i] %s: %.0f ms on thread %i\n", numLogged, songs.size(), song.path.str(),
+		song.total * 1000.0, song.thread);
+	if(stages.len()) Debug::log("    %s\n", stages.str());
+	for(auto& line : song.report) Debug::log("    %s\n", line.str());
+	if(song.error.len()) Debug::log("    error: %s\n", song.error.str());
+	logLock.unlock();
+}
+
+}; // anonymous namespace
+
+// ================================================================================================
+// Batch processing.
+
+bool IsBatchCommandLine(const String* args, int numArgs)
+{
+	return numArgs >= 2 && Str::equal(args[1], "--batch");
+}
+
+bool ParseBatchArgs(const String* args, int numArgs, StringRef runDir, BatchOptions& out)
+{
+	if(!IsBatchCommandLine(args, numArgs) || numArgs < 3 || Str::startsWith(args[2], "--"))
+	{
+		Debug::blockBegin(Debug::ERROR, "invalid batch command line");
+		Debug::log("usage: ArrowVortex --batch <dir> [--normalize] [--rating] [--bpm] [--ogg] "
+			"[--ssc] [--threads=N]\n");
+		Debug::blockEnd();
+		return false;
+	}
+
+	out.dir = Path(runDir, args[2]);
+	out.steps = 0;
+	out.numThreads = ParallelThreads::concurrency();
+
+	for(int i = 3; i < numArgs; ++i)
+	{
+		const String& arg = args[i];
+		     if(arg == "--normalize") out.steps |= BATCH_NORMALIZE;
+		else if(arg == "--rating") out.steps |= BATCH_RATING;
+		else if(arg == "--bpm") out.steps |= BATCH_BPM;
+		else if(arg == "--ogg") out.steps |= BATCH_OGG;
+		else if(arg == "--ssc") out.steps |= BATCH_SSC;
+		else if(Str::startsWith(arg, "--threads="))
+		{
+			out.numThreads = max(1, Str::readInt(Str::substr(arg, 10), 1));
+		}
+		else
+		{
+			Debug::blockBegin(Debug::WARNING, "unknown batch argument");
+			Debug::log("argument: %s\n", arg.str());
+			Debug::blockEnd();
+		}
+	}
+
+	return true;
+}
+
+int RunBatch(const BatchOptions& options)
+{
+	BatchThreads threads;
+	threads.options = &options;
+	threads.numLogged = 0;
+
+	// Each song directory is expected to contain one simfile.
+	Vector<Path> dirs = File::findDirs(options.dir, true);
+	dirs.insert(0, Path(options.dir), 1);
+	for(auto& dir : dirs)
+	{
+		String path = FindSimfile(dir);
+		if(path.empty()) continue;
+		threads.songs.append().path = path;
+	}
+
+	RatingEstimator estimator("assets/rating estimate data.txt");
+	threads.estimator = &estimator;
+
+	int numThreads = clamp(options.numThreads, 1, max(threads.songs.size(), 1));
+	if(sizeof(void*) == 4 && (options.steps & (BATCH_BPM | BATCH_OGG)))
+	{
+		numThreads = min(numThreads, MAX_AUDIO_THREADS_32BIT);
+	}
+
+	Debug::blockBegin(Debug::INFO, "batch processing");
+	Debug::log("directory: %s\n", options.dir.str());
+	Debug::log("songs: %i, threads: %i\n", threads.songs.size(), numThreads);
+
+	double start = Debug::getElapsedTime();
+	threads.run(threads.songs.size(), numThreads);
+	double elapsed = Debug::getElapsedTime(start);
+
+	// Summarize the results.
+	int numFailed = 0;
+	double work = 0.0, stageTotals[NUM_STAGES] = {};
+	for(auto& song : threads.songs)
+	{
+		if(song.error.len()) ++numFailed;
+		work += song.total;
+		for(int i = 0; i < NUM_STAGES; ++i)
+		{
+			stageTotals[i] += max(song.times[i], 0.0);
+		}
+	}
+
+	int numSongs = threads.songs.size();
+	Debug::log("processed %i songs, %i failed\n", numSongs - numFailed, numFailed);
+	Debug::log("elapsed: %.2f s, work: %.2f s on %i threads (%.2fx)\n",
+		elapsed, work, numThreads, work / max(elapsed, 1e-6));
+	Debug::log("throughput: %.2f songs per second\n", numSongs / max(elapsed, 1e-6));
+	for(int i = 0; i < NUM_STAGES; ++i)
+	{
+		if(stageTotals[i] == 0.0) continue;
+		Debug::log("%s: %.2f s total, %.1f ms per song\n", sStageNames[i],
+			stageTotals[i], stageTotals[i] * 1000.0 / max(numSongs, 1));
+	}
+	Debug::blockEnd();
+
+	return numFailed;
+}
+
+}; // namespace Vortex
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Core/String.h>
+
+namespace Vortex {
+
+/// Steps that can be performed on each simfile during batch processing.
+enum BatchStep
+{
+	BATCH_NORMALIZE = 1 << 0, ///< Sanitize the notes and tempo of each chart.
+	BATCH_RATING    = 1 << 1, ///< Report the estimated rating of each chart.
+	BATCH_BPM       = 1 << 2, ///< Report the detected BPM and offset of the music.
+	BATCH_OGG       = 1 << 3, ///< Convert the music to Ogg Vorbis, and point the simfile to it.
+	BATCH_SSC       = 1 << 4, ///< Save the simfile in the ssc format.
+};
+
+/// Settings of a batch processing run.
+struct BatchOptions
+{
+	String dir;     ///< Directory that is searched for simfiles, including its subdirectories.
+	int steps;      ///< Combination of BatchStep flags.
+	int numThreads; ///< Number of songs that are processed concurrently.
+};
+
+/// Returns true if the command line arguments start with --batch. In that case the program runs
+/// the batch processing without a window, instead of the editor.
+bool IsBatchCommandLine(const String* args, int numArgs);
+
+/// Reads batch processing settings from command line arguments of the form
+/// "--batch <dir> [--normalize] [--rating] [--bpm] [--ogg] [--ssc] [--threads=N]". Relative
+/// directories are relative to runDir. Returns false and logs the usage if the arguments are not
+/// a valid batch command line.
+bool ParseBatchArgs(const String* args, int numArgs, StringRef runDir, BatchOptions& out);
+
+/// Processes every simfile in the directory without opening it in the editor. The songs are
+/// distributed over worker threads, and the timings of each song and a summary are written to
+/// the log. Simfiles that are modified or converted are saved with a backup of the old file.
+/// Returns the number of songs that failed.
+int RunBatch(const BatchOptions& options);
+
+}; // namespace Vortex
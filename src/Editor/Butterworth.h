@@ -8,7 +8,8 @@ extern void ButterLowPassCoefs(int order, double frequency, double* outB, double
 // Writes order + 1 coefficients to b and a.
 extern void ButterHighPassCoefs(int order, double frequency, double* outB, double* outA);
 
-void FilterOrder3(const double* b, const double* a, const short* in, short* out, int size)
+// Applies a third order filter without normalizing the output. Returns the largest output value.
+short FilterOrder3Raw(const double* b, const double* a, const short* in, short* out, int size)
 {
 	short maxAmp = 1;
 	double Xi, Yi, z0 = 0.0, z1 = 0.0, z2 = 0.0;
@@ -24,13 +25,27 @@ void FilterOrder3(const double* b, const double* a, const short* in, short* out,
 		*dst = (short)Yi;
 		maxAmp = max(*dst, maxAmp);
 	}
-	int scalar = (SHRT_MAX << 16) / (int)maxAmp;
-	for(short* dst = out, *end = dst + size; dst != end; ++dst)
+	return maxAmp;
+}
+
+// Scales the samples so that maxAmp is mapped to the largest sample value. The maximum amplitude
+// can be an estimate, so samples that end up above it are clamped to the sample range.
+void NormalizeAmplitude(short* samples, int size, short maxAmp)
+{
+	int64_t scalar = ((int64_t)SHRT_MAX << 16) / max((int)maxAmp, 1);
+	for(short* dst = samples, *end = dst + size; dst != end; ++dst)
 	{
-		*dst = (short)clamp((((int)*dst) * scalar) >> 16, SHRT_MIN, SHRT_MAX);
+		int64_t v = (((int64_t)*dst) * scalar) >> 16;
+		*dst = (short)clamp(v, (int64_t)SHRT_MIN, (int64_t)SHRT_MAX);
 	}
 }
 
+void FilterOrder3(const double* b, const double* a, const short* in, short* out, int size)
+{
+	short maxAmp = FilterOrder3Raw(b, a, in, out, size);
+	NormalizeAmplitude(out, size, maxAmp);
+}
+
 void LowPassFilter(short* out, const short* in, int numFrames, double freq)
 {
 	double coefB[4], coefA[4];
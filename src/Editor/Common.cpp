@@ -8,6 +8,7 @@
 
 #include <System/Debug.h>
 #include <System/System.h>
+#include <System/Thread.h>
 
 #include <Editor/TextOverlay.h>
 
@@ -184,28 +185,78 @@ RowType ToRowType(int rowIndex)
 	if(len < 0 || len > 511) len = 511; \
 	buffer[len] = 0; va_end(args); \
 
+// Messages can also be posted from worker threads, e.g. during batch processing. The text overlay
+// is only accessed by the main thread, so the messages are queued until the overlay collects them.
+struct QueuedHudMessage
+{
+	String msg;
+	TextOverlay::MessageType type;
+};
+
+static CriticalSection sHudLock;
+static Vector<QueuedHudMessage> sHudQueue;
+static thread_local Vector<String>* sHudCapture = nullptr;
+
+static const char* sHudPrefixes[] = {"note", "info", "warning", "error"};
+
+void CaptureHudMessages(Vector<String>* messages)
+{
+	sHudCapture = messages;
+}
+
+void FlushHudMessages()
+{
+	Vector<QueuedHudMessage> messages;
+	sHudLock.lock();
+	messages.swap(sHudQueue);
+	sHudLock.unlock();
+
+	for(auto& m : messages)
+	{
+		gTextOverlay->addMessage(m.msg.str(), m.type);
+	}
+}
+
+static void AddHudMessage(const char* msg, TextOverlay::MessageType type)
+{
+	if(sHudCapture)
+	{
+		sHudCapture->push_back(Str::fmt("%1: %2").arg(sHudPrefixes[type]).arg(msg));
+	}
+	else if(gTextOverlay)
+	{
+		sHudLock.lock();
+		sHudQueue.push_back({String(msg), type});
+		sHudLock.unlock();
+	}
+	else
+	{
+		Debug::log("[%s] %s\n", sHudPrefixes[type], msg);
+	}
+}
+
 void HudNote(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::NOTE);
+	AddHudMessage(buffer, TextOverlay::NOTE);
 }
 
 void HudInfo(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::INFO);
+	AddHudMessage(buffer, TextOverlay::INFO);
 }
 
 void HudWarning(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::WARNING);
+	AddHudMessage(buffer, TextOverlay::WARNING);
 }
 
 void HudError(const char* fmt, ...)
 {
 	PRINT_TO_BUFFER;
-	if(gTextOverlay) gTextOverlay->addMessage(buffer, TextOverlay::ERROR);
+	AddHudMessage(buffer, TextOverlay::ERROR);
 }
 
 }; // namespace Vortex
@@ -149,4 +149,12 @@ color32 ToColor(Difficulty dt);
 // Translates a row index to a row type.
 RowType ToRowType(int rowIndex);
 
+// Redirects the hud messages posted on the calling thread to a list, or stops redirecting them if
+// the list is null. Without a redirect or a text overlay, the messages are written to the log.
+void CaptureHudMessages(Vector<String>* messages);
+
+// Passes the hud messages that were posted since the last call to the text overlay. Must be called
+// from the main thread, which is the only thread that accesses the text overlay.
+void FlushHudMessages();
+
 }; // namespace Vortex
@@ -87,11 +87,12 @@ struct OggConversionPipe : public System::CommandPipe
 OggConversionThread::OggConversionThread()
 {
 	progress = 0;
+	source = nullptr;
 }
 
 void OggConversionThread::exec()
 {
-	const Sound& music = gMusic->getSamples();
+	const Sound& music = source ? *source : gMusic->getSamples();
 	
 	// Create a pipe that feeds audio data to oggenc.	
 	auto pipe = new OggConversionPipe;
@@ -7,11 +7,14 @@
 
 namespace Vortex {
 
+class Sound;
+
 struct OggConversionThread : public BackgroundThread
 {
 	OggConversionThread();
 	uchar progress;
 	String outPath, error;
+	const Sound* source; ///< The audio to convert, or null to convert the music of the editor.
 	void exec() override;
 };
 
@@ -1,16 +1,20 @@
 #include <Editor/Editor.h>
 
 #include <map>
+#include <algorithm>
 
 #include <Core/Xmr.h>
 #include <Core/Gui.h>
 #include <Core/Draw.h>
+#include <Core/Text.h>
+#include <Core/TextLayout.h>
 #include <Core/Shader.h>
 #include <Core/StringUtils.h>
 
 #include <System/System.h>
 #include <System/File.h>
 #include <System/Debug.h>
+#include <System/Profiler.h>
 
 #include <Editor/Music.h>
 #include <Editor/Menubar.h>
@@ -63,6 +67,20 @@ struct DialogEntry
 	bool requestOpen;
 };
 
+struct ChangeSubscriber
+{
+	const char* name;
+	int mask;
+	ChangeHandler handler;
+	int numCalls;
+	double lastTime, totalTime, worstTime;
+};
+
+// Change notifications that take longer than this are logged, with the time of each handler.
+static const double SLOW_NOTIFICATION_TIME = 0.02;
+
+static const ChangeEvent NO_CHANGES = {0, INT_MAX, 0, nullptr};
+
 static const char loadFilters[] =
 	"Supported Media (*.sm, *.ssc, *.dwi, *.osu, *.osz, *.ogg, *.mp3, *.wav)\0*.sm;*.ssc;*.dwi;*.osu;*.osz;*.ogg;*.mp3;*.wav\0"
 	"Stepmania/ITG (*.sm)\0*.sm\0"
@@ -80,6 +98,10 @@ static const char saveFilters[] =
 	"Osu!mania (*.osu)\0*.osu\0"
 	"All Files (*.*)\0*.*\0";
 
+static const char traceFilters[] =
+	"Chrome Trace (*.json)\0*.json\0"
+	"All Files (*.*)\0*.*\0";
+
 static const int MAX_RECENT_FILES = 10;
 
 static String ClipboardGet()
@@ -127,7 +149,8 @@ struct EditorImpl : public Editor, public InputHandler {
 
 GuiContext* gui_;
 DialogEntry myDialogs[NUM_DIALOG_IDS];
-int myChanges;
+Vector<ChangeSubscriber> mySubscribers;
+ChangeEvent myChanges;
 Texture myLogo;
 Vector<String> myRecentFiles;
 
@@ -136,6 +159,7 @@ String myFontPath;
 
 bool myUseMultithreading;
 bool myUseVerticalSync;
+bool myShowProfiler;
 
 BackgroundStyle myBackgroundStyle;
 SimFormat myDefaultSaveFormat;
@@ -158,10 +182,11 @@ EditorImpl()
 	}
 
 	gui_ = nullptr;
-	myChanges = 0;
+	myChanges = NO_CHANGES;
 
 	myUseMultithreading = true;
 	myUseVerticalSync = true;
+	myShowProfiler = false;
 
 	myBackgroundStyle = BG_STYLE_STRETCH;
 	myDefaultSaveFormat = SIM_SM;
@@ -203,7 +228,7 @@ void init()
 	TextOverlay::create();
 
 	// Create the history, because simfile components have to register their callbacks.
-	History::create();
+	History::create(settings);
 
 	// Create the simfile components.
 	StyleMan::create();
@@ -227,6 +252,30 @@ void init()
 	Minimap::create();
 	Menubar::create();
 
+	// Subscribe the components to change notifications, in the order in which they handle them.
+	// Each mask holds the changes the component reacts to. The dialogs are subscribed to all
+	// changes, since each dialog filters them itself.
+	subscribe("dialogs", VCM_ALL_CHANGES, [](const ChangeEvent& e)
+	{
+		static_cast<EditorImpl*>(gEditor)->notifyDialogs(e.changes);
+	});
+	subscribe("simfile", VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED | VCM_MUSIC_IS_LOADED,
+		[](const ChangeEvent& e) { gSimfile->onChanges(e.changes); });
+	subscribe("view", VCM_TEMPO_CHANGED,
+		[](const ChangeEvent& e) { gView->onChanges(e.changes); });
+	subscribe("music", VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED | VCM_END_ROW_CHANGED | VCM_CHART_CHANGED,
+		[](const ChangeEvent& e) { gMusic->onChanges(e); });
+	subscribe("minimap", VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED | VCM_VIEW_CHANGED | VCM_END_ROW_CHANGED
+		| VCM_SELECTION_CHANGED, [](const ChangeEvent& e) { gMinimap->onChanges(e); });
+	subscribe("editing", VCM_CHART_CHANGED,
+		[](const ChangeEvent& e) { gEditing->onChanges(e.changes); });
+	subscribe("notefield", VCM_BACKGROUND_PATH_CHANGED | VCM_ZOOM_CHANGED | VCM_MUSIC_IS_LOADED,
+		[](const ChangeEvent& e) { gNotefield->onChanges(e.changes); });
+	subscribe("tempo boxes", VCM_TEMPO_CHANGED,
+		[](const ChangeEvent& e) { gTempoBoxes->onChanges(e.changes); });
+	subscribe("waveform", VCM_MUSIC_IS_LOADED,
+		[](const ChangeEvent& e) { gWaveform->onChanges(e.changes); });
+
 	// Load the editor logo.
 	myLogo = Texture("assets/arrow vortex logo.png", false, Texture::ALPHA);
 
@@ -254,6 +303,7 @@ void shutdown()
 	gTempoBoxes->saveSettings(settings);
 	gView->saveSettings(settings);
 	gMusic->saveSettings(settings);
+	gHistory->saveSettings(settings);
 	gNoteskin->saveSettings(settings);
 	saveDialogSettings(settings);
 
@@ -813,25 +863,65 @@ void onExitProgram()
 	}
 }
 
+void notifyDialogs(int changes)
+{
+	for(auto dialog : myDialogs)
+	{
+		if(dialog.ptr) dialog.ptr->onChanges(changes);
+	}
+}
+
 void notifyChanges()
 {
-	if(!myChanges) return;
+	if(!myChanges.changes) return;
 
-	for(auto dialog : myDialogs)
+	ChangeEvent event = myChanges;
+	event.chart = gChart->get();
+
+	double startTime = Debug::getElapsedTime();
+	for(auto& sub : mySubscribers)
 	{
-		if(dialog.ptr) dialog.ptr->onChanges(myChanges);
+		sub.lastTime = 0.0;
+		if(event.changes & sub.mask)
+		{
+			VortexProfileZone(sub.name);
+			double handlerTime = Debug::getElapsedTime();
+			sub.handler(event);
+			sub.lastTime = Debug::getElapsedTime(handlerTime);
+			sub.totalTime += sub.lastTime;
+			sub.worstTime = max(sub.worstTime, sub.lastTime);
+			++sub.numCalls;
+		}
 	}
+	double elapsed = Debug::getElapsedTime(startTime);
+	if(elapsed > SLOW_NOTIFICATION_TIME) logSlowNotification(event, elapsed);
+
+	myChanges = NO_CHANGES;
+}
 
-	gSimfile->onChanges(myChanges);
-	gView->onChanges(myChanges);
-	gMusic->onChanges(myChanges);
-	gMinimap->onChanges(myChanges);
-	gEditing->onChanges(myChanges);
-	gNotefield->onChanges(myChanges);
-	gTempoBoxes->onChanges(myChanges);
-	gWaveform->onChanges(myChanges);
+// Logs the time spent by each handler on the last notification, slowest handler first.
+void logSlowNotification(const ChangeEvent& event, double elapsed)
+{
+	Vector<const ChangeSubscriber*> subs;
+	for(auto& sub : mySubscribers)
+	{
+		if(sub.lastTime > 0.0) subs.push_back(&sub);
+	}
+	std::sort(subs.begin(), subs.end(), [](const ChangeSubscriber* a, const ChangeSubscriber* b)
+	{
+		return a->lastTime > b->lastTime;
+	});
 
-	myChanges = 0;
+	Debug::blockBegin(Debug::INFO, "slow change notification");
+	Debug::log("changes %X, rows %i to %i, %.2f ms\n",
+		event.changes, event.beginRow, event.endRow, elapsed * 1000.0);
+	for(auto sub : subs)
+	{
+		Debug::log("%s: %.2f ms (average %.2f ms, worst %.2f ms, %i calls)\n", sub->name,
+			sub->lastTime * 1000.0, sub->totalTime * 1000.0 / sub->numCalls,
+			sub->worstTime * 1000.0, sub->numCalls);
+	}
+	Debug::blockEnd();
 }
 
 void onKeyPress(KeyPress& press)
@@ -847,7 +937,22 @@ void onKeyPress(KeyPress& press)
 
 void reportChanges(int changes)
 {
-	myChanges |= changes;
+	reportChanges(changes, 0, INT_MAX);
+}
+
+void reportChanges(int changes, int beginRow, int endRow)
+{
+	myChanges.changes |= changes;
+	if((changes & (VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED)) && beginRow < endRow)
+	{
+		myChanges.beginRow = min(myChanges.beginRow, beginRow);
+		myChanges.endRow = max(myChanges.endRow, endRow);
+	}
+}
+
+void subscribe(const char* name, int mask, ChangeHandler handler)
+{
+	mySubscribers.push_back({name, mask, handler, 0, 0.0, 0.0, 0.0});
 }
 
 void updateTitle()
@@ -882,6 +987,41 @@ void drawLogo()
 	Draw::sprite(myLogo, {size.x / 2, size.y / 2}, RGBAtoColor32(255, 255, 255, 26));
 }
 
+// Draws the average and 99th percentile frame time of each profiler zone, nested zones indented.
+void drawProfiler()
+{
+	Vector<Profiler::ZoneStats> zones;
+	Profiler::getStats(zones);
+
+	String str = "{tc:888}average / 99th percentile (ms){tc}";
+	for(auto& zone : zones)
+	{
+		str += "\n";
+		for(int i = 0; i < zone.depth; ++i) str += "    ";
+		String line = Str::fmt("%1: %2 / %3").arg(zone.name)
+			.arg(zone.average * 1000.0, 2, 2).arg(zone.p99 * 1000.0, 2, 2);
+		str += line;
+	}
+
+	auto layouts = TextLayout::getCacheStats();
+	String line = Str::fmt("\n{tc:888}text layouts: %1 hits, %2 misses, %3 cached{tc}")
+		.arg(layouts.hits).arg(layouts.misses).arg(layouts.entries);
+	str += line;
+
+	auto renderer = Renderer::getFrameStats();
+	line = Str::fmt("\n{tc:888}renderer: %1 draw calls, %2 quads{tc}")
+		.arg(renderer.drawCalls).arg(renderer.quads);
+	str += line;
+
+	TextStyle textStyle;
+	textStyle.textFlags = Text::MARKUP;
+	Text::arrange(Text::TL, textStyle, str.str());
+
+	vec2i size = Text::getSize();
+	Draw::fill({8, 32, size.x + 16, size.y + 16}, Color32(0, 192));
+	Text::draw(vec2i{16, 40});
+}
+
 void tick()
 {
 	InputEvents& events = gSystem->getEvents();
@@ -900,7 +1040,10 @@ void tick()
 
 	handleDialogs();
 
-	gui_->tick({ 0, 0, view.x, view.y }, deltaTime, events);
+	{
+		VortexProfileZone("gui tick");
+		gui_->tick({ 0, 0, view.x, view.y }, deltaTime, events);
+	}
 
 	if (!GuiMain::isCapturingText())
 	{
@@ -967,10 +1110,15 @@ void tick()
 		drawLogo();
 	}
 
-	gui_->draw();
+	{
+		VortexProfileZone("gui draw");
+		gui_->draw();
+	}
 
 	gTextOverlay->draw();
 
+	if(myShowProfiler) drawProfiler();
+
 	GuiMain::frameEnd();
 }
 
@@ -995,6 +1143,32 @@ int getDefaultSaveFormat() const
 	return myDefaultSaveFormat;
 }
 
+void toggleProfiler()
+{
+	myShowProfiler = !myShowProfiler;
+}
+
+bool isProfilerVisible() const
+{
+	return myShowProfiler;
+}
+
+void exportProfilerTrace()
+{
+	String filters(traceFilters, sizeof(traceFilters));
+	String path = gSystem->saveFileDlg("export profiler trace", "ArrowVortex trace.json", filters);
+	if(path.empty()) return;
+
+	if(Profiler::exportTrace(path))
+	{
+		HudNote("Exported profiler trace to: %s", path.str());
+	}
+	else
+	{
+		HudError("Could not export profiler trace.");
+	}
+}
+
 GuiContext* getGui() const
 {
 	return gui_;
@@ -4,6 +4,23 @@
 
 namespace Vortex {
 
+/// The changes reported since the previous change notification.
+struct ChangeEvent
+{
+	/// Combination of flags from "VortexChangesMade".
+	int changes;
+
+	/// The range of rows [beginRow, endRow) of which the notes or timing changed. The range is
+	/// empty if no changes to the notes or tempo were reported.
+	int beginRow, endRow;
+
+	/// The active chart at the time of the notification, or null if no chart is open.
+	const Chart* chart;
+};
+
+/// Function that handles a change notification.
+typedef void (*ChangeHandler)(const ChangeEvent& event);
+
 struct Editor
 {
 	static void create();
@@ -43,8 +60,16 @@ struct Editor
 	virtual StringRef getRecentFile(int recentFileIndex) = 0;
 
 	/// Use this to report changes in the simfile (combination of flags from "VortexChangesMade").
+	/// Changes to the notes or tempo reported this way affect every row.
 	virtual void reportChanges(int changes) = 0;
 
+	/// Reports changes to the notes or tempo that only affect the rows in [beginRow, endRow).
+	virtual void reportChanges(int changes, int beginRow, int endRow) = 0;
+
+	/// Registers a handler that is called when changes that overlap the mask are reported. The
+	/// handlers are called in order of registration, the name is used in the timing log.
+	virtual void subscribe(const char* name, int mask, ChangeHandler handler) = 0;
+
 	/// Opens the dialog window with the given id, if it's currently closed.
 	virtual void openDialog(int dialogId) = 0;
 
@@ -74,6 +99,15 @@ struct Editor
 
 	/// Returns the tags export mode set in the editor settings.
 	virtual int getDefaultSaveFormat() const = 0;
+
+	/// Shows or hides the overlay with the frame time of each profiler zone.
+	virtual void toggleProfiler() = 0;
+
+	/// Returns true if the profiler overlay is shown.
+	virtual bool isProfilerVisible() const = 0;
+
+	/// Prompts the user for a path and exports the recent profiler zones as a Chrome trace.
+	virtual void exportProfilerTrace() = 0;
 };
 
 extern Editor* gEditor;
@@ -14,6 +14,12 @@
 
 //#define DEBUG_INFO
 
+#ifdef ENABLE_BENCHMARK
+#include <Editor/Sound.h>
+#include <System/File.h>
+#include <System/Debug.h>
+#endif
+
 typedef double real;
 
 namespace Vortex {
@@ -1029,88 +1035,200 @@ static void aubio_onset_do(aubio_onset_t *o, fvec_t * input, fvec_t * onset)
 	return;
 }
 
-static uint_t aubio_onset_get_last(aubio_onset_t *o)
-{
-	return o->last_onset - o->delay;
-}
-
 }; // anonymous namespace
 
 // ================================================================================================
 // Main function.
 
-void FindOnsets(const float* samples, int samplerate, int numFrames, int numThreads, Vector<Onset>& out)
+static const int windowlen = 256;
+static const int bufsize = windowlen * 4;
+static char* method = "complex";
+
+// Number of hops that are processed before the start of a segment. The phase vocoder, spectral
+// descriptor and peak picker only remember the last few hops, so after the warm-up their state is
+// identical to that of a serial run over the entire signal.
+static const int warmupHops = 32;
+
+// Minimum number of hops per segment, so the warm-up stays a small part of the work.
+static const int minSegmentHops = 1024;
+
+// An onset detected by the peak picker, before the minimum inter-onset interval is applied.
+struct OnsetCandidate { uint_t frame; bool first; };
+
+// Runs the onset tracker over the hops [beginHop, endHop) and stores the detected candidates. The
+// minimum inter-onset interval is disabled, since it depends on every onset accepted before it.
+static void FindOnsetCandidates(const float* samples, int samplerate, int beginHop, int endHop,
+	Vector<OnsetCandidate>& out)
 {
-	static const int windowlen = 256;
-	static const int bufsize = windowlen * 4;
-	static char* method = "complex";
+	auto onset = new_aubio_onset(method, bufsize, windowlen, samplerate);
+	aubio_onset_set_minioi(onset, 0);
+	fvec_t* samplevec = new_fvec(windowlen), *beatvec = new_fvec(2);
 
-	if(numThreads > 1)
+	int warmupHop = max(beginHop - warmupHops, 0);
+	onset->total_frames = warmupHop * windowlen;
+	for(int hop = warmupHop; hop < endHop; ++hop)
+	{
+		memcpy(samplevec->data, samples + hop * windowlen, sizeof(float) * windowlen);
+		aubio_onset_do(onset, samplevec, beatvec);
+		if(beatvec->data[0] > 0 && hop >= beginHop)
+		{
+			out.push_back({onset->last_onset, hop == 0});
+		}
+	}
+
+	del_fvec(samplevec);
+	del_fvec(beatvec);
+	del_aubio_onset(onset);
+}
+
+void FindOnsets(const float* samples, int samplerate, int numFrames, int numThreads, Vector<Onset>& out)
+{
+	int numHops = (numFrames < windowlen) ? 0 : (numFrames - windowlen) / windowlen + 1;
+	int numSegments = max(1, min(numThreads * 4, numHops / minSegmentHops));
+	if(numThreads <= 1) numSegments = 1;
+
+	// Find the onset candidates of each segment, in parallel if there is more than one segment.
+	Vector<Vector<OnsetCandidate>> candidates;
+	candidates.resize(numSegments);
+	if(numSegments > 1)
 	{
 		struct OnsetThreads : public ParallelThreads
 		{
-			CriticalSection lock;
 			const float* samples;
-			int numFrames, numThreads, samplerate;
-			Vector<Onset> onsets;
+			int samplerate, numHops, numSegments;
+			Vector<OnsetCandidate>* candidates;
 
-			OnsetThreads(const float* inSamples, int inFrames, int inThreads, int inSamplerate)
-			{
-				samples = inSamples;
-				numFrames = inFrames;
-				numThreads = inThreads;
-				samplerate = inSamplerate;
-			}
 			void exec(int item, int thread) override
 			{
-				int framesPerThread = numFrames / numThreads;
-				auto onset = new_aubio_onset(method, bufsize, windowlen, samplerate);
-				fvec_t* samplevec = new_fvec(windowlen), *beatvec = new_fvec(2);
-				int beginPos = framesPerThread * (thread + 0);
-				int endPos = framesPerThread * (thread + 1);
-				int paddedBegin = max(beginPos - bufsize, 0);
-				int paddedEnd = min(endPos + bufsize, numFrames - windowlen);
-				for(int i = paddedBegin; i < paddedEnd; i += windowlen)
-				{
-					memcpy(samplevec->data, samples + i, sizeof(float) * windowlen);
-					aubio_onset_do(onset, samplevec, beatvec);
-					if(beatvec->data[0] > 0)
-					{
-						int pos = aubio_onset_get_last(onset) + paddedBegin;
-						if(pos >= beginPos && pos < endPos)
-						{
-							lock.lock();
-							onsets.push_back({pos, 1.0});
-							lock.unlock();
-						}
-					}
-				}
-				del_fvec(samplevec);
-				del_fvec(beatvec);
-				del_aubio_onset(onset);
+				int beginHop = (int)((int64_t)numHops * (item + 0) / numSegments);
+				int endHop = (int)((int64_t)numHops * (item + 1) / numSegments);
+				FindOnsetCandidates(samples, samplerate, beginHop, endHop, candidates[item]);
 			}
 		};
-		OnsetThreads threads = {samples, numFrames, numThreads, samplerate};
-		threads.run(numThreads);
+		OnsetThreads threads;
+		threads.samples = samples;
+		threads.samplerate = samplerate;
+		threads.numHops = numHops;
+		threads.numSegments = numSegments;
+		threads.candidates = candidates.data();
+		threads.run(numSegments, numThreads);
 	}
 	else
 	{
-		auto onset = new_aubio_onset(method, bufsize, windowlen, samplerate);
-		fvec_t* samplevec = new_fvec(windowlen), *beatvec = new_fvec(2);
-		for(int i = 0; i <= numFrames - windowlen; i += windowlen)
+		FindOnsetCandidates(samples, samplerate, 0, numHops, candidates[0]);
+	}
+
+	// Apply the minimum inter-onset interval in order, the same way aubio_onset_do would.
+	auto onset = new_aubio_onset(method, bufsize, windowlen, samplerate);
+	uint_t minioi = onset->minioi, delay = onset->delay, last = 0;
+	del_aubio_onset(onset);
+
+	for(auto& segment : candidates)
+	{
+		for(auto& candidate : segment)
 		{
-			memcpy(samplevec->data, samples + i, sizeof(float) * windowlen);
-			aubio_onset_do(onset, samplevec, beatvec);
-			if(beatvec->data[0] > 0)
+			if(candidate.first || last + minioi < candidate.frame)
 			{
-				int pos = aubio_onset_get_last(onset);
+				last = candidate.frame;
+				int pos = (int)(last - delay);
 				if(pos >= 0) out.push_back({pos, 1.0});
 			}
 		}
-		del_fvec(samplevec);
-		del_fvec(beatvec);
-		del_aubio_onset(onset);
 	}
 }
 
+// ================================================================================================
+// Benchmark.
+
+#ifdef ENABLE_BENCHMARK
+
+SoundSource* LoadWav(FileReader* file, String& title, String& artist); // Defined in "LoadWav.cpp".
+
+// Reads a 16-bit mono or stereo wav file, and mixes it down to mono samples in [-1, 1].
+static bool ReadWavSamples(const Path& path, Vector<float>& out, int& frequency)
+{
+	FileReader* file = new FileReader;
+	String title, artist;
+	SoundSource* source = file->open(path) ? LoadWav(file, title, artist) : nullptr;
+	if(!source)
+	{
+		delete file;
+		return false;
+	}
+
+	int numFrames = source->getNumFrames();
+	int numChannels = source->getNumChannels();
+	bool supported = (source->getBytesPerSample() == 2 && numChannels >= 1 && numChannels <= 2);
+	if(supported)
+	{
+		Vector<short> frames(numFrames * numChannels, 0);
+		numFrames = source->readFrames(numFrames, frames.data());
+		frequency = source->getFrequency();
+		out.resize(numFrames);
+		for(int i = 0; i < numFrames; ++i)
+		{
+			const short* frame = frames.data() + i * numChannels;
+			int sum = (numChannels == 2) ? ((int)frame[0] + (int)frame[1]) : (int)frame[0] * 2;
+			out[i] = (float)sum / 65536.0f;
+		}
+	}
+	delete source;
+	return supported;
+}
+
+// Runs onset detection on every 16-bit wav file in a directory, once serially and once on all
+// cores, and logs the wall time of both runs and whether they found the same onsets. Returns
+// false if no file could be tested, or if any file gave different onsets.
+bool BenchmarkFindOnsets(StringRef dir)
+{
+	int numThreads = ParallelThreads::concurrency();
+	int numTested = 0;
+	bool allMatch = true;
+
+	Debug::blockBegin(Debug::INFO, "find onsets benchmark");
+	Debug::log("threads: %i\n", numThreads);
+	for(auto& path : File::findFiles(dir, false, "wav"))
+	{
+		Vector<float> samples;
+		int frequency = 0;
+		if(!ReadWavSamples(path, samples, frequency))
+		{
+			Debug::log("%s: skipped, not a 16-bit mono or stereo wav file\n", path.filename().str());
+			continue;
+		}
+		int numFrames = samples.size();
+
+		Vector<Onset> serial, parallel;
+		double start = Debug::getElapsedTime();
+		FindOnsets(samples.data(), frequency, numFrames, 1, serial);
+		double serialTime = Debug::getElapsedTime(start);
+
+		start = Debug::getElapsedTime();
+		FindOnsets(samples.data(), frequency, numFrames, numThreads, parallel);
+		double parallelTime = Debug::getElapsedTime(start);
+
+		bool matches = (serial.size() == parallel.size());
+		for(int i = 0; matches && i < serial.size(); ++i)
+		{
+			matches = (serial[i].pos == parallel[i].pos);
+		}
+
+		Debug::log("%s: %i onsets, serial %.0f ms, parallel %.0f ms (%.1fx)%s\n",
+			path.filename().str(), serial.size(), serialTime * 1000.0, parallelTime * 1000.0,
+			serialTime / max(parallelTime, 1e-9), matches ? "" : " (MISMATCH)");
+
+		allMatch = allMatch && matches;
+		++numTested;
+	}
+	if(numTested == 0)
+	{
+		Debug::log("no wav files were found in %s\n", dir.str());
+	}
+	Debug::blockEnd();
+
+	return allMatch && numTested > 0;
+}
+
+#endif // ENABLE_BENCHMARK
+
 }; // namespace Vortex
\ No newline at end of file
@@ -10,11 +10,19 @@
 #include <Editor/FindTempo.h>
 #include <Editor/FindOnsets.h>
 #include <Editor/Music.h>
+#include <Editor/Sound.h>
 
 #include <algorithm>
 #include <functional>
 #include <atomic>
 
+#ifdef ENABLE_REGRESSION_TEST
+#include <Core/StringUtils.h>
+#include <System/File.h>
+#include <System/Debug.h>
+#include <stdio.h>
+#endif
+
 #define MarkProgress(number, text) { if(*data->terminate) {return;} data->progress = number; }
 
 typedef double real;
@@ -58,7 +66,10 @@ struct GapData
 	const Onset* onsets;
 	int* wrappedPos;
 	real* wrappedOnsets;
-	real* window;
+	real* windowCos;
+	real* windowSin;
+	real* prefixSums;
+	real* gapConfidence;
 	int bufferSize, numOnsets, windowSize, downsample;
 };
 
@@ -81,13 +92,6 @@ struct IntervalTester
 // ================================================================================================
 // Audio processing
 
-// Creates weights for a hamming window of length n.
-static void CreateHammingWindow(real* out, int n)
-{
-	const real t = 6.2831853071795864 / (real)(n - 1);
-	for(int i = 0; i < n; ++i) out[i] = 0.54 - 0.46 * cos((real)i * t);
-}
-
 // Normalizes the given fitness value based the given 3rd order poly coefficients and interval.
 static void NormalizeFitness(real& fitness, const real* coefs, real interval)
 {
@@ -105,60 +109,112 @@ GapData::GapData(int numThreads, int bufferSize, int downsample, int numOnsets,
 	, windowSize(2048 >> downsample)
 	, bufferSize(bufferSize)
 {
-	window = AlignedMalloc<real>(windowSize);
+	int tableSize = bufferSize + windowSize;
+	windowCos = AlignedMalloc<real>(tableSize);
+	windowSin = AlignedMalloc<real>(tableSize);
 	wrappedPos = AlignedMalloc<int>(numOnsets * numThreads);
 	wrappedOnsets = AlignedMalloc<real>(bufferSize * numThreads);
-	CreateHammingWindow(window, windowSize);
+	prefixSums = AlignedMalloc<real>((tableSize + 1) * 3 * numThreads);
+	gapConfidence = AlignedMalloc<real>((bufferSize + 1) * numThreads);
+
+	// The gap window is a hamming window, w[i] = 0.54 - 0.46 * cos(i * t). The cosine term of a
+	// window starting at position p is expanded as cos(i * t - p * t), which only needs the cosine
+	// and sine of the absolute positions.
+	const real t = 6.2831853071795864 / (real)(windowSize - 1);
+	for(int i = 0; i < tableSize; ++i)
+	{
+		windowCos[i] = cos((real)i * t);
+		windowSin[i] = sin((real)i * t);
+	}
 }
 
 GapData::~GapData()
 {
-	AlignedFree(window);
+	AlignedFree(windowCos);
+	AlignedFree(windowSin);
 	AlignedFree(wrappedPos);
 	AlignedFree(wrappedOnsets);
+	AlignedFree(prefixSums);
+	AlignedFree(gapConfidence);
 }
 
-// Returns the confidence value that indicates how many onsets are close to the given gap position.
-static real GapConfidence(const GapData& gapdata, int threadId, int gapPos, int interval)
+// Computes the confidence value for every gap position in [0, interval], which indicates how many
+// onsets are close to the gap position. It is the sum of the onset histogram around the position,
+// weighted by a hamming window that wraps around at the end of the interval. The windowed sums are
+// taken from prefix sums of the histogram, so the cost does not depend on the window size.
+static void ComputeGapConfidence(const GapData& gapdata, int threadId, int interval)
 {
-	int numOnsets = gapdata.numOnsets;
 	int windowSize = gapdata.windowSize;
 	int halfWindowSize = windowSize / 2;
-	const real* window = gapdata.window;
+	int tableSize = gapdata.bufferSize + windowSize;
 	const real* wrappedOnsets = gapdata.wrappedOnsets + gapdata.bufferSize * threadId;
-	real area = 0.0;
-
-	int beginOnset = gapPos - halfWindowSize;
-	int endOnset = gapPos + halfWindowSize;
+	const real* windowCos = gapdata.windowCos;
+	const real* windowSin = gapdata.windowSin;
+	real* confidence = gapdata.gapConfidence + (gapdata.bufferSize + 1) * threadId;
+
+	// Prefix sums of the histogram repeated over [0, interval + windowSize), with and without the
+	// cosine and sine factors.
+	real* sum = gapdata.prefixSums + (tableSize + 1) * 3 * threadId;
+	real* sumCos = sum + tableSize + 1;
+	real* sumSin = sumCos + tableSize + 1;
+	sum[0] = sumCos[0] = sumSin[0] = 0.0;
+	for(int i = 0, j = 0, n = interval + windowSize; i < n; ++i, ++j)
+	{
+		if(j == interval) j = 0;
+		real v = wrappedOnsets[j];
+		sum[i + 1] = sum[i] + v;
+		sumCos[i + 1] = sumCos[i] + v * windowCos[i];
+		sumSin[i + 1] = sumSin[i] + v * windowSin[i];
+	}
 
-	if(beginOnset < 0)
+	// Sum of the histogram in [begin, begin + length), weighted by the first length window values.
+	auto windowedSum = [&](int begin, int length)
 	{
-		int wrappedBegin = beginOnset + interval;
-		for(int i = wrappedBegin; i < interval; ++i)
-		{
-			int windowIndex = i - wrappedBegin;
-			area += wrappedOnsets[i] * window[windowIndex];
-		}
-		beginOnset = 0;
+		int end = begin + length;
+		real c = sumCos[end] - sumCos[begin];
+		real s = sumSin[end] - sumSin[begin];
+		return 0.54 * (sum[end] - sum[begin]) - 0.46 * (windowCos[begin] * c + windowSin[begin] * s);
+	};
+
+	// Windows that start before the interval wrap around to its end. The part that does not wrap
+	// is weighted from the first window value again, which matches the original direct evaluation
+	// and keeps the detected BPM and offset values the same.
+	int numWrapped = std::min(halfWindowSize, interval + 1);
+	for(int pos = 0; pos < numWrapped; ++pos)
+	{
+		confidence[pos] = windowedSum(interval + pos - halfWindowSize, halfWindowSize - pos)
+			+ windowedSum(0, pos + halfWindowSize);
 	}
-	if(endOnset > interval)
+	for(int pos = numWrapped; pos <= interval; ++pos)
 	{
-		int wrappedEnd = endOnset - interval;
-		int indexOffset = windowSize - wrappedEnd;
-		for(int i = 0; i < wrappedEnd; ++i)
-		{
-			int windowIndex = i + indexOffset;
-			area += wrappedOnsets[i] * window[windowIndex];
-		}
-		endOnset = interval;
+		confidence[pos] = windowedSum(pos - halfWindowSize, windowSize);
 	}
-	for(int i = beginOnset; i < endOnset; ++i)
+}
+
+// Returns the highest confidence of the onset positions combined with their offbeat positions.
+static real GetHighestConfidence(const GapData& gapdata, int threadId, int interval, int* outPos)
+{
+	const int* wrappedPos = gapdata.wrappedPos + gapdata.numOnsets * threadId;
+	const real* gapConfidence = gapdata.gapConfidence + (gapdata.bufferSize + 1) * threadId;
+
+	real highestConfidence = 0.0;
+	int highestPos = 0;
+	for(int i = 0; i < gapdata.numOnsets; ++i)
 	{
-		int windowIndex = i - beginOnset;
-		area += wrappedOnsets[i] * window[windowIndex];
+		int pos = wrappedPos[i];
+		real confidence = gapConfidence[pos];
+		int offbeatPos = (pos + interval / 2) % interval;
+		confidence += gapConfidence[offbeatPos] * 0.5;
+
+		if(confidence > highestConfidence)
+		{
+			highestConfidence = confidence;
+			highestPos = pos;
+		}
 	}
 
-	return area;
+	if(outPos) *outPos = highestPos;
+	return highestConfidence;
 }
 
 // Returns the confidence of the best gap value for the given interval.
@@ -182,21 +238,8 @@ static real GetConfidenceForInterval(const GapData& gapdata, int threadId, int i
 	}
 
 	// Record the amount of support for each gap value.
-	real highestConfidence = 0.0;
-	for(int i = 0; i < numOnsets; ++i)
-	{
-		int pos = wrappedPos[i];
-		real confidence = GapConfidence(gapdata, threadId, pos, reducedInterval);
-		int offbeatPos = (pos + reducedInterval / 2) % reducedInterval;
-		confidence += GapConfidence(gapdata, threadId, offbeatPos, reducedInterval) * 0.5;
-
-		if(confidence > highestConfidence)
-		{
-			highestConfidence = confidence;
-		}
-	}
-
-	return highestConfidence;
+	ComputeGapConfidence(gapdata, threadId, reducedInterval);
+	return GetHighestConfidence(gapdata, threadId, reducedInterval, nullptr);
 }
 
 // Returns the confidence of the best gap value for the given BPM value.
@@ -220,19 +263,8 @@ static real GetConfidenceForBPM(const GapData& gapdata, int threadId, IntervalTe
 	}
 
 	// Record the amount of support for each gap value.
-	real highestConfidence = 0.0;
-	for(int i = 0; i < numOnsets; ++i)
-	{
-		int pos = wrappedPos[i];
-		real confidence = GapConfidence(gapdata, threadId, pos, interval);
-		int offbeatPos = (pos + interval / 2) % interval;
-		confidence += GapConfidence(gapdata, threadId, offbeatPos, interval) * 0.5;
-
-		if(confidence > highestConfidence)
-		{
-			highestConfidence = confidence;
-		}
-	}
+	ComputeGapConfidence(gapdata, threadId, interval);
+	real highestConfidence = GetHighestConfidence(gapdata, threadId, interval, nullptr);
 
 	// Normalize the confidence value.
 	NormalizeFitness(highestConfidence, test.coefs, intervalf);
@@ -493,21 +525,9 @@ static real GetBaseOffsetValue(const GapData& gapdata, int samplerate, real bpm)
 	}
 
 	// Record the amount of support for each gap value.
-	real highestConfidence = 0.0;
 	int offsetPos = 0;
-	for(int i = 0; i < numOnsets; ++i)
-	{
-		int pos = wrappedPos[i];
-		real confidence = GapConfidence(gapdata, 0, pos, interval);
-		int offbeatPos = (pos + interval / 2) % interval;
-		confidence += GapConfidence(gapdata, 0, offbeatPos, interval) * 0.5;
-
-		if(confidence > highestConfidence)
-		{
-			highestConfidence = confidence;
-			offsetPos = pos;
-		}
-	}
+	ComputeGapConfidence(gapdata, 0, interval);
+	GetHighestConfidence(gapdata, 0, interval, &offsetPos);
 
 	return (real)offsetPos / (real)samplerate;
 }
@@ -563,6 +583,39 @@ static void CalculateOffset(SerializedTempo* data, Onset* onsets, int numOnsets)
 		t.offset = AdjustForOffbeats(data, t.offset, t.bpm);
 }
 
+// ================================================================================================
+// Tempo detection
+
+// Runs all stages of the BPM detection on the samples in data, and stores the results.
+static void DetectTempo(SerializedTempo* data)
+{
+	// Run the aubio onset tracker to find note onsets.
+	Vector<Onset> onsets;
+	FindOnsets(data->samples, data->samplerate, data->numFrames, data->numThreads, onsets);
+	MarkProgress(1, "Find onsets");
+
+	for(int i = 0; i < std::min(onsets.size(), 100); ++i)
+	{
+		int a = std::max(0, onsets[i].pos - 100);
+		int b = std::min(data->numFrames, onsets[i].pos + 100);
+		float v = 0.0f;
+		for(int j = a; j < b; ++j)
+		{
+			v += abs(data->samples[j]);
+		}
+		v /= (float)std::max(1, b - a);
+		onsets[i].strength = v;
+	}
+
+	// Find BPM values.
+	CalculateBPM(data, onsets.data(), onsets.size());
+	MarkProgress(4, "Find BPM");
+
+	// Find offset values.
+	CalculateOffset(data, onsets.data(), onsets.size());
+	MarkProgress(5, "Find offsets");
+}
+
 // ================================================================================================
 // BPM testing wrapper class
 
@@ -627,33 +680,7 @@ TempoDetectorImp::~TempoDetectorImp()
 
 void TempoDetectorImp::exec()
 {
-	SerializedTempo* data = &data_;
-
-	// Run the aubio onset tracker to find note onsets.
-	Vector<Onset> onsets;
-	FindOnsets(data->samples, data->samplerate, data->numFrames, 1, onsets);
-	MarkProgress(1, "Find onsets");
-
-	for(int i = 0; i < std::min(onsets.size(), 100); ++i)
-	{
-		int a = std::max(0, onsets[i].pos - 100);
-		int b = std::min(data->numFrames, onsets[i].pos + 100);
-		float v = 0.0f;
-		for(int j = a; j < b; ++j)
-		{
-			v += abs(data->samples[j]);
-		}
-		v /= (float)std::max(1, b - a);
-		onsets[i].strength = v;
-	}
-
-	// Find BPM values.
-	CalculateBPM(data, onsets.data(), onsets.size());
-	MarkProgress(4, "Find BPM");
-
-	// Find offset values.
-	CalculateOffset(data, onsets.data(), onsets.size());
-	MarkProgress(5, "Find offsets");
+	DetectTempo(&data_);
 }
 
 }; // anonymous namespace
@@ -691,4 +718,147 @@ TempoDetector* TempoDetector::New(double time, double len)
 	return detector;
 }
 
+// Runs the BPM detection on planar 16-bit samples and waits for the results.
+static bool DetectSamples(const short* l, const short* r, int numFrames, int samplerate,
+	Vector<TempoResult>& out, int numThreads)
+{
+	uchar terminate = 0;
+	SerializedTempo data;
+	data.terminate = &terminate;
+	data.progress = 0;
+	data.numThreads = numThreads;
+	data.numFrames = numFrames;
+	data.samplerate = samplerate;
+	data.samples = AlignedMalloc<float>(numFrames);
+	if(!data.samples) return false;
+
+	for(int i = 0; i < numFrames; ++i)
+	{
+		data.samples[i] = (float)((int)l[i] + (int)r[i]) / 65536.0f;
+	}
+
+	DetectTempo(&data);
+	AlignedFree(data.samples);
+
+	out.swap(data.result);
+	return true;
+}
+
+bool TempoDetector::detect(const Sound& sound, Vector<TempoResult>& out, int numThreads)
+{
+	return DetectSamples(sound.samplesL(), sound.samplesR(), sound.getNumFrames(),
+		sound.getFrequency(), out, numThreads);
+}
+
+// ================================================================================================
+// Regression test.
+
+#ifdef ENABLE_REGRESSION_TEST
+
+SoundSource* LoadWav(FileReader* file, String& title, String& artist); // Defined in "LoadWav.cpp".
+
+// Reads a 16-bit mono or stereo wav file into planar buffers, mono files are copied to both.
+static bool ReadWavSamples(const Path& path, Vector<short>& l, Vector<short>& r, int& frequency)
+{
+	FileReader* file = new FileReader;
+	String title, artist;
+	SoundSource* source = file->open(path) ? LoadWav(file, title, artist) : nullptr;
+	if(!source)
+	{
+		delete file;
+		return false;
+	}
+
+	int numFrames = source->getNumFrames();
+	int numChannels = source->getNumChannels();
+	bool supported = (source->getBytesPerSample() == 2 && numChannels >= 1 && numChannels <= 2);
+	if(supported)
+	{
+		Vector<short> frames(numFrames * numChannels, 0);
+		numFrames = source->readFrames(numFrames, frames.data());
+		frequency = source->getFrequency();
+		l.resize(numFrames);
+		r.resize(numFrames);
+		for(int i = 0; i < numFrames; ++i)
+		{
+			const short* frame = frames.data() + i * numChannels;
+			l[i] = frame[0];
+			r[i] = frame[numChannels - 1];
+		}
+	}
+	delete source;
+	return supported;
+}
+
+// Returns true if a and b are equal up to rounding differences between compilers.
+static bool IsClose(double a, double b)
+{
+	return abs(a - b) <= std::max(abs(a), abs(b)) * 1e-6;
+}
+
+// Runs BPM detection on every 16-bit wav file in a directory. The results of each file are
+// compared against the results stored next to it in "<file>.bpm.txt", or stored there if the file
+// does not exist yet. Returns false if no file could be tested, or if the results of any file
+// differ from its reference.
+bool RegressionTestTempoDetection(StringRef dir)
+{
+	int numTested = 0;
+	bool allMatch = true;
+
+	Debug::blockBegin(Debug::INFO, "tempo detection regression test");
+	for(auto& path : File::findFiles(dir, false, "wav"))
+	{
+		Vector<short> l, r;
+		int frequency = 0;
+		if(!ReadWavSamples(path, l, r, frequency))
+		{
+			Debug::log("%s: skipped, not a 16-bit mono or stereo wav file\n", path.filename().str());
+			continue;
+		}
+
+		Vector<TempoResult> result;
+		double start = Debug::getElapsedTime();
+		DetectSamples(l.data(), r.data(), l.size(), frequency, result, ParallelThreads::concurrency());
+		double elapsed = Debug::getElapsedTime(start);
+		++numTested;
+
+		String refPath = path.str;
+		Str::append(refPath, ".bpm.txt");
+
+		bool hasReference;
+		Vector<String> lines = File::getLines(refPath, &hasReference);
+		if(!hasReference)
+		{
+			FileWriter out;
+			if(out.open(refPath))
+			{
+				for(auto& t : result) out.printf("%.17g %.17g %.17g\n", t.bpm, t.offset, t.fitness);
+			}
+			Debug::log("%s: %.0f ms, stored reference\n", path.filename().str(), elapsed * 1000.0);
+			continue;
+		}
+
+		bool matches = (lines.size() == result.size());
+		for(int i = 0; matches && i < lines.size(); ++i)
+		{
+			const TempoResult& t = result[i];
+			double bpm = 0.0, offset = 0.0, fitness = 0.0;
+			matches = sscanf(lines[i].str(), "%lf %lf %lf", &bpm, &offset, &fitness) == 3 &&
+				IsClose(bpm, t.bpm) && IsClose(offset, t.offset) && IsClose(fitness, t.fitness);
+		}
+		Debug::log("%s: %.0f ms, %s\n", path.filename().str(), elapsed * 1000.0,
+			matches ? "unchanged" : "CHANGED");
+		allMatch = allMatch && matches;
+	}
+	if(numTested == 0)
+	{
+		Debug::log("no wav files were found in %s\n", dir.str());
+	}
+	Debug::blockEnd();
+
+	return allMatch && numTested > 0;
+}
+
+#endif // ENABLE_REGRESSION_TEST
+
 }; // namespace Vortex
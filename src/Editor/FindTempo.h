@@ -4,6 +4,8 @@
 
 namespace Vortex {
 
+class Sound;
+
 struct TempoResult
 {
 	double bpm, offset, fitness;
@@ -13,6 +15,10 @@ class TempoDetector
 {
 public:
 	static TempoDetector* New(double time, double len);
+
+	/// Runs the BPM detection on an entire sound and waits for the results, without using the
+	/// music of the editor. Returns false if there is insufficient memory.
+	static bool detect(const Sound& sound, Vector<TempoResult>& out, int numThreads);
 	virtual ~TempoDetector() {}
 
 	virtual const char* getProgress() const = 0;
@@ -3,11 +3,15 @@
 #include <Core/Draw.h>
 #include <Core/Text.h>
 #include <Core/Utils.h>
+#include <Core/Xmr.h>
 
 #include <System/System.h>
+#include <System/Thread.h>
 
 #include <Editor/Common.h>
 
+#include <stdio.h>
+
 #define HISTORY ((HistoryImpl*)gHistory)
 
 #define NO_SAVED_ENTRIES -1
@@ -15,6 +19,244 @@
 namespace Vortex {
 namespace {
 
+// Payloads smaller than this are not worth compressing or spilling.
+static const uint MIN_PACKED_PAYLOAD = 256;
+
+// ================================================================================================
+// Payload compression.
+
+// The codec is a byte-oriented LZ77 variant in the style of LZ4. The stream is a sequence of
+// tokens, each followed by a run of literals and a back-reference. The high nibble of the token
+// is the literal count and the low nibble is the match length minus four; a nibble of 15 is
+// extended by bytes that are added until a byte below 255. The last token has no back-reference.
+
+static const int PACK_HASH_BITS = 12;
+static const uint PACK_MIN_MATCH = 4;
+
+static uint Read32(const uchar* p)
+{
+	uint v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static uchar* PackLength(uchar* dst, const uchar* end, uint len)
+{
+	for(; len >= 255 && dst != end; len -= 255) *dst++ = 255;
+	if(dst != end) *dst++ = (uchar)len;
+	return dst;
+}
+
+// Writes a token with its literals and back-reference, or returns null if it does not fit.
+static uchar* PackSequence(uchar* dst, const uchar* end, const uchar* lit, uint numLit, uint offset, uint len)
+{
+	if((uint)(end - dst) < numLit + numLit / 255 + len / 255 + 5) return nullptr;
+
+	uint matchCode = (offset > 0) ? len - PACK_MIN_MATCH : 0;
+	*dst++ = (uchar)((min(numLit, 15u) << 4) | min(matchCode, 15u));
+	if(numLit >= 15) dst = PackLength(dst, end, numLit - 15);
+	memcpy(dst, lit, numLit);
+	dst += numLit;
+	if(offset > 0)
+	{
+		*dst++ = (uchar)(offset & 0xFF);
+		*dst++ = (uchar)(offset >> 8);
+		if(matchCode >= 15) dst = PackLength(dst, end, matchCode - 15);
+	}
+	return dst;
+}
+
+// Compresses src into dst. Returns the compressed size, or zero if it exceeds the capacity.
+static uint PackBytes(const uchar* src, uint size, uchar* dst, uint capacity)
+{
+	int table[1 << PACK_HASH_BITS];
+	for(int& pos : table) pos = -1;
+
+	uchar* out = dst, *end = dst + capacity;
+	uint pos = 0, anchor = 0;
+	while(pos + PACK_MIN_MATCH <= size)
+	{
+		uint seq = Read32(src + pos);
+		uint hash = (seq * 2654435761u) >> (32 - PACK_HASH_BITS);
+		int candidate = table[hash];
+		table[hash] = (int)pos;
+		if(candidate >= 0 && pos - candidate <= 0xFFFF && Read32(src + candidate) == seq)
+		{
+			uint len = PACK_MIN_MATCH;
+			while(pos + len < size && src[candidate + len] == src[pos + len]) ++len;
+			out = PackSequence(out, end, src + anchor, pos - anchor, pos - candidate, len);
+			if(!out) return 0;
+			pos += len;
+			anchor = pos;
+		}
+		else
+		{
+			++pos;
+		}
+	}
+	out = PackSequence(out, end, src + anchor, size - anchor, 0, 0);
+	return out ? (uint)(out - dst) : 0;
+}
+
+static bool UnpackLength(const uchar*& src, const uchar* end, uint& len)
+{
+	uchar v = 255;
+	while(v == 255)
+	{
+		if(src == end) return false;
+		v = *src++;
+		len += v;
+	}
+	return true;
+}
+
+// Decompresses src into dst, which holds exactly size bytes. Returns false on corrupt input.
+static bool UnpackBytes(const uchar* src, uint packedSize, uchar* dst, uint size)
+{
+	const uchar* in = src, *inEnd = src + packedSize;
+	uchar* out = dst, *outEnd = dst + size;
+	while(in != inEnd)
+	{
+		uint token = *in++;
+		uint numLit = token >> 4;
+		if(numLit == 15 && !UnpackLength(in, inEnd, numLit)) return false;
+		if((uint)(inEnd - in) < numLit || (uint)(outEnd - out) < numLit) return false;
+		memcpy(out, in, numLit);
+		in += numLit;
+		out += numLit;
+		if(in == inEnd) break;
+
+		if(inEnd - in < 2) return false;
+		uint offset = in[0] | (in[1] << 8);
+		in += 2;
+		uint len = token & 15;
+		if(len == 15 && !UnpackLength(in, inEnd, len)) return false;
+		len += PACK_MIN_MATCH;
+		if(offset == 0 || offset > (uint)(out - dst) || (uint)(outEnd - out) < len) return false;
+		for(const uchar* match = out - offset; len > 0; --len) *out++ = *match++;
+	}
+	return out == outEnd;
+}
+
+// ================================================================================================
+// Background compression.
+
+struct Payload;
+
+struct PackJob
+{
+	enum State { QUEUED, RUNNING, DONE };
+
+	State state;
+	Payload* payload; // Null if the entry was released while the job was pending.
+	uchar* src;
+	uint size;
+	uchar* packed;
+	uint packedSize;
+};
+
+struct PackQueue
+{
+	CriticalSection lock;
+	Vector<PackJob*> jobs;
+	bool hasWorker;
+
+	PackQueue() : hasWorker(false) {}
+
+	// Takes the first queued job. If there are no queued jobs left, the worker is marked as
+	// finished, so the next queued job starts a new worker.
+	PackJob* next()
+	{
+		PackJob* out = nullptr;
+		lock.lock();
+		for(auto job : jobs)
+		{
+			if(job->state == PackJob::QUEUED && job->payload)
+			{
+				job->state = PackJob::RUNNING;
+				out = job;
+				break;
+			}
+		}
+		if(!out) hasWorker = false;
+		lock.unlock();
+		return out;
+	}
+
+	void finish(PackJob* job)
+	{
+		lock.lock();
+		job->state = PackJob::DONE;
+		lock.unlock();
+	}
+};
+
+// A worker thread that compresses queued payloads until the queue is empty, and then terminates.
+struct PackWorker : public BackgroundThread
+{
+	PackQueue* queue;
+
+	PackWorker(PackQueue* queue) : queue(queue) {}
+
+	void exec() override
+	{
+		while(!terminationFlag_)
+		{
+			PackJob* job = queue->next();
+			if(!job) break;
+
+			// Only keep the compressed bytes if they save at least an eighth of the payload.
+			uint capacity = job->size - job->size / 8;
+			job->packed = (uchar*)malloc(capacity);
+			job->packedSize = PackBytes(job->src, job->size, job->packed, capacity);
+			if(job->packedSize == 0)
+			{
+				free(job->packed);
+				job->packed = nullptr;
+			}
+			queue->finish(job);
+		}
+	}
+};
+
+// ================================================================================================
+// Payload storage.
+
+// The spill file can grow beyond 2 GB, so it is addressed with 64-bit positions.
+static bool SeekSpillFile(FILE* file, int64_t pos)
+{
+#ifdef _WIN32
+	return _fseeki64(file, pos, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)pos, SEEK_SET) == 0;
+#endif
+}
+
+// The data of an entry is resident, compressed in memory, or spilled to the spill file, in which
+// case it is stored either compressed or as-is depending on packedSize.
+struct Payload
+{
+	uchar* data;        // Uncompressed bytes, null if the payload is compressed or spilled.
+	uchar* packed;      // Compressed bytes, null if the payload is resident or spilled.
+	uint size;          // Size of the uncompressed bytes.
+	uint packedSize;    // Size of the compressed bytes, zero if the payload is not compressed.
+	int64_t filePos;    // Position in the spill file, or -1 if the payload is not spilled.
+	PackJob* job;       // Pending compression job, or null.
+	bool isPackable;    // False if compression was tried and did not pay off.
+};
+
+// Returns true if enforceBudget has nothing left to compress in the payload.
+static bool IsPackSettled(const Payload& p)
+{
+	return !p.job && !(p.data && p.isPackable);
+}
+
+// Returns true if enforceBudget has nothing left to spill in the payload.
+static bool IsSpillSettled(const Payload& p)
+{
+	return p.filePos >= 0 || p.size < MIN_PACKED_PAYLOAD;
+}
+
 struct HistoryImpl : public History {
 
 // ================================================================================================
@@ -26,18 +268,18 @@ struct Callback
 	History::ReleaseFunc release;
 };
 
-struct Entry
+struct SpillRange
 {
-	Entry* next;
+	int64_t pos, size;
 };
 
-struct EntryData
+struct Entry
 {
+	Entry* next;
 	uint id;
 	Chart* chart;
 	Tempo* tempo;
-	uint size;
-	const uchar* data;
+	Payload payload;
 };
 
 struct EntryList
@@ -78,85 +320,85 @@ struct EntryList
 
 static Entry* CreateEntry(EditId id, const void* data, uint size, Chart* c, Tempo* t)
 {
-	bool hasChart = (c != nullptr);
-	bool hasTempo = (t != nullptr);
-
-	WriteStream header;
-	header.write<Entry>({nullptr});
-
-	uint flags = (id << 2) | (hasTempo << 1) | (hasChart << 0);
-	header.writeNum(flags);
-	if(hasChart) header.write(c);
-	if(hasTempo) header.write(t);
-	header.writeNum(size);
-
 #ifdef DEBUG
-	HudNote("Creating entry [header=%ib, data=%ib, chart:%c, tempo:%c",
-		header.size(), size,
-		hasChart ? 'y' : 'n',
-		hasTempo ? 'y' : 'n');
+	HudNote("Creating entry [data=%ib, chart:%c, tempo:%c",
+		size,
+		c ? 'y' : 'n',
+		t ? 'y' : 'n');
 #endif
 
-	uchar* mem = (uchar*)malloc(header.size() + size);
-	memcpy(mem, header.data(), header.size());
-	memcpy(mem + header.size(), data, size);
-
-	Entry* entry = (Entry*)mem;
+	Entry* entry = (Entry*)malloc(sizeof(Entry));
 	entry->next = nullptr;
-	return (Entry*)entry;
-}
-
-static EntryData DecodeEntry(const Entry* in)
-{
-	ReadStream header(in + 1, INT_MAX);
-
-	EntryData out = {0, nullptr, nullptr, 0, nullptr};
-
-	uint flags;
-	header.readNum(flags);
-	if(flags & 1) header.read(out.chart);
-	if(flags & 2) header.read(out.tempo);
-	out.id = flags >> 2;
-
-	header.readNum(out.size);
-	out.data = header.pos();
-
-	return out;
+	entry->id = id;
+	entry->chart = c;
+	entry->tempo = t;
+
+	Payload& p = entry->payload;
+	p.data = (uchar*)malloc(max(size, 1u));
+	memcpy(p.data, data, size);
+	p.packed = nullptr;
+	p.size = size;
+	p.packedSize = 0;
+	p.filePos = -1;
+	p.job = nullptr;
+	p.isPackable = (id != 0 && size >= MIN_PACKED_PAYLOAD);
+
+	HISTORY->myResidentBytes += size;
+	return entry;
 }
 
 static Entry* Advance(Entry* it, Bindings& bound)
 {
-	ReadStream header(it + 1, INT_MAX);
-
-	uint flags;
-	header.readNum(flags);
-	if(flags & 1) header.read(bound.chart);
-	if(flags & 2) header.read(bound.tempo);
-
+	if(it->chart) bound.chart = it->chart;
+	if(it->tempo) bound.tempo = it->tempo;
 	return it->next;
 }
 
 static void ReleaseEntry(Entry* in, bool hasBeenApplied)
 {
-	EntryData entry = DecodeEntry(in);
-	auto& callback = HISTORY->myCallbacks[entry.id];
+	auto& callback = HISTORY->myCallbacks[in->id];
 	if(callback.release)
 	{
-		ReadStream stream(entry.data, entry.size);
-		callback.release(stream, hasBeenApplied);
+		const uchar* data = HISTORY->acquirePayload(in->payload);
+		if(data)
+		{
+			ReadStream stream(data, in->payload.size);
+			callback.release(stream, hasBeenApplied);
+		}
 	}
+	HISTORY->releasePayload(in->payload);
 	free(in);
 }
 
-static String ApplyEntry(const Entry* in, Bindings bound, bool undo, bool redo)
+// Restores the payload of an entry, and of the entries in it if it is a chain, so applying it
+// can not fail halfway. Returns false if any of them could not be restored.
+static bool AcquireEntry(Entry* in)
+{
+	const uchar* data = HISTORY->acquirePayload(in->payload);
+	if(!data) return false;
+
+	if(in->id == 0)
+	{
+		ReadStream stream(data, in->payload.size);
+		auto list = stream.read<EntryList>();
+		for(auto it = list.head; it; it = it->next)
+		{
+			if(!HISTORY->acquirePayload(it->payload)) return false;
+		}
+	}
+	return true;
+}
+
+static String ApplyEntry(Entry* in, Bindings bound, bool undo, bool redo)
 {
-	EntryData entry = DecodeEntry(in);
+	if(in->chart) bound.chart = in->chart;
+	if(in->tempo) bound.tempo = in->tempo;
 
-	if(entry.chart) bound.chart = entry.chart;
-	if(entry.tempo) bound.tempo = entry.tempo;
+	const uchar* data = HISTORY->acquirePayload(in->payload);
+	if(!data) return String();
 
-	auto& callback = HISTORY->myCallbacks[entry.id];
-	ReadStream stream(entry.data, entry.size);
+	auto& callback = HISTORY->myCallbacks[in->id];
+	ReadStream stream(data, in->payload.size);
 	return callback.apply(stream, bound, undo, redo);
 }
 
@@ -176,12 +418,40 @@ int myOpenChains;
 
 Vector<Callback> myCallbacks;
 
+PackQueue myPackQueue;
+PackWorker* myPackWorker;
+
+FILE* mySpillFile;
+int64_t mySpillEnd;
+bool mySpillFailed;
+
+// Unused ranges of the spill file that are left by payloads that were paged back in or released.
+// The ranges are sorted by position, and neither touch each other nor the end of the file.
+Vector<SpillRange> mySpillHoles;
+
+int myMemoryBudgetMb;
+int mySpillThresholdMb;
+
+size_t myResidentBytes;
+size_t myPackingBytes;
+size_t myCompressedBytes;
+int64_t mySpilledBytes;
+
+// The most recent entry up to which enforceBudget has nothing left to compress or spill, or null.
+Entry* myPackedUntil;
+Entry* mySpilledUntil;
+
 // ================================================================================================
 // HistoryImpl :: constructor and destructor.
 
 ~HistoryImpl()
 {
 	clearEverything();
+
+	delete myPackWorker;
+	collectPackJobs();
+
+	if(mySpillFile) fclose(mySpillFile);
 }
 
 HistoryImpl()
@@ -189,10 +459,349 @@ HistoryImpl()
 	, myAppliedEntries(0)
 	, myTotalEntries(0)
 	, myOpenChains(0)
+	, myPackWorker(nullptr)
+	, mySpillFile(nullptr)
+	, mySpillEnd(0)
+	, mySpillFailed(false)
+	, myMemoryBudgetMb(64)
+	, mySpillThresholdMb(256)
+	, myResidentBytes(0)
+	, myPackingBytes(0)
+	, myCompressedBytes(0)
+	, mySpilledBytes(0)
+	, myPackedUntil(nullptr)
+	, mySpilledUntil(nullptr)
 {
 	myCallbacks.push_back({ApplyChain, ReleaseChain});
 }
 
+// ================================================================================================
+// HistoryImpl :: loading and saving settings.
+
+void loadSettings(XmrNode& settings)
+{
+	XmrNode* history = settings.child("history");
+	if(history)
+	{
+		history->get("memoryBudgetMb", &myMemoryBudgetMb);
+		history->get("spillThresholdMb", &mySpillThresholdMb);
+		myMemoryBudgetMb = max(myMemoryBudgetMb, 1);
+		mySpillThresholdMb = max(mySpillThresholdMb, myMemoryBudgetMb);
+	}
+}
+
+void saveSettings(XmrNode& settings)
+{
+	XmrNode* history = settings.addChild("history");
+
+	history->addAttrib("memoryBudgetMb", (long)myMemoryBudgetMb);
+	history->addAttrib("spillThresholdMb", (long)mySpillThresholdMb);
+}
+
+// ================================================================================================
+// HistoryImpl :: payload storage.
+
+// Returns the uncompressed bytes of a payload, paging it back in from the spill file and
+// decompressing it if necessary. The payload stays resident until the budget is enforced again.
+const uchar* acquirePayload(Payload& p)
+{
+	if(p.data) return p.data;
+
+	uchar* stored = p.packed;
+	uint storedSize = p.packedSize ? p.packedSize : p.size;
+	if(p.filePos >= 0)
+	{
+		stored = (uchar*)malloc(max(storedSize, 1u));
+		bool success = mySpillFile
+			&& SeekSpillFile(mySpillFile, p.filePos)
+			&& fread(stored, 1, storedSize, mySpillFile) == storedSize;
+		if(!success)
+		{
+			free(stored);
+			stored = nullptr;
+		}
+		mySpilledBytes -= storedSize;
+		freeSpillRange(p.filePos, storedSize);
+		p.filePos = -1;
+	}
+	else
+	{
+		myCompressedBytes -= p.packedSize;
+	}
+
+	if(stored && p.packedSize)
+	{
+		p.data = (uchar*)malloc(max(p.size, 1u));
+		if(!UnpackBytes(stored, p.packedSize, p.data, p.size))
+		{
+			free(p.data);
+			p.data = nullptr;
+		}
+		free(stored);
+	}
+	else
+	{
+		p.data = stored;
+	}
+	p.packed = nullptr;
+	p.packedSize = 0;
+
+	if(!p.data) return nullptr;
+
+	// The payload can be compressed and spilled again, so enforceBudget has to revisit it.
+	myPackedUntil = nullptr;
+	mySpilledUntil = nullptr;
+
+	myResidentBytes += p.size;
+	return p.data;
+}
+
+void releasePayload(Payload& p)
+{
+	if(p.job)
+	{
+		// The worker might be reading the data, so the job takes over ownership of it.
+		myPackQueue.lock.lock();
+		p.job->payload = nullptr;
+		myPackQueue.lock.unlock();
+		myResidentBytes -= p.size;
+		myPackingBytes -= p.size;
+		p.job = nullptr;
+		p.data = nullptr;
+	}
+	if(p.data)
+	{
+		myResidentBytes -= p.size;
+		free(p.data);
+	}
+	if(p.packed)
+	{
+		myCompressedBytes -= p.packedSize;
+		free(p.packed);
+	}
+	if(p.filePos >= 0)
+	{
+		uint storedSize = p.packedSize ? p.packedSize : p.size;
+		mySpilledBytes -= storedSize;
+		freeSpillRange(p.filePos, storedSize);
+	}
+}
+
+void queuePacking(Payload& p)
+{
+	auto job = new PackJob{PackJob::QUEUED, &p, p.data, p.size, nullptr, 0};
+	p.job = job;
+	myPackingBytes += p.size;
+
+	myPackQueue.lock.lock();
+	myPackQueue.jobs.push_back(job);
+	bool startWorker = !myPackQueue.hasWorker;
+	myPackQueue.hasWorker = true;
+	myPackQueue.lock.unlock();
+
+	// The previous worker has run out of jobs, so deleting it only waits for its thread to exit.
+	if(startWorker)
+	{
+		delete myPackWorker;
+		myPackWorker = new PackWorker(&myPackQueue);
+		myPackWorker->start();
+	}
+}
+
+void collectPackJobs()
+{
+	myPackQueue.lock.lock();
+	auto& jobs = myPackQueue.jobs;
+	int numPending = 0;
+	for(auto job : jobs)
+	{
+		if(job->state == PackJob::RUNNING || (job->state == PackJob::QUEUED && job->payload))
+		{
+			jobs[numPending++] = job;
+			continue;
+		}
+		if(job->payload)
+		{
+			Payload& p = *job->payload;
+			p.job = nullptr;
+			myPackingBytes -= p.size;
+			if(job->packed)
+			{
+				free(p.data);
+				p.data = nullptr;
+				p.packed = job->packed;
+				p.packedSize = job->packedSize;
+				myResidentBytes -= p.size;
+				myCompressedBytes += p.packedSize;
+			}
+			else
+			{
+				p.isPackable = false;
+			}
+		}
+		else
+		{
+			free(job->src);
+			free(job->packed);
+		}
+		delete job;
+	}
+	jobs.resize(numPending);
+	myPackQueue.lock.unlock();
+}
+
+bool spillPayload(Payload& p)
+{
+	if(!mySpillFile)
+	{
+		mySpillFile = tmpfile();
+		if(!mySpillFile)
+		{
+			HudError("Could not create the history spill file.");
+			mySpillFailed = true;
+			return false;
+		}
+	}
+
+	uchar* stored = p.packed ? p.packed : p.data;
+	uint storedSize = p.packed ? p.packedSize : p.size;
+	int64_t pos = allocSpillRange(storedSize);
+	if(!SeekSpillFile(mySpillFile, pos)
+		|| fwrite(stored, 1, storedSize, mySpillFile) != storedSize)
+	{
+		HudError("Could not write to the history spill file.");
+		mySpillFailed = true;
+		freeSpillRange(pos, storedSize);
+		return false;
+	}
+
+	if(p.packed) myCompressedBytes -= p.packedSize;
+	else myResidentBytes -= p.size;
+	free(stored);
+	p.data = nullptr;
+	p.packed = nullptr;
+
+	p.filePos = pos;
+	mySpilledBytes += storedSize;
+	return true;
+}
+
+// Returns the position of an unused range of the spill file. The first hole that is large enough
+// is reused, so paging payloads in and spilling them again does not keep growing the file.
+int64_t allocSpillRange(int64_t size)
+{
+	for(int i = 0; i < mySpillHoles.size(); ++i)
+	{
+		auto& hole = mySpillHoles[i];
+		if(hole.size < size) continue;
+		int64_t pos = hole.pos;
+		hole.pos += size;
+		hole.size -= size;
+		if(hole.size == 0) mySpillHoles.erase(i);
+		return pos;
+	}
+	int64_t pos = mySpillEnd;
+	mySpillEnd += size;
+	return pos;
+}
+
+// Marks a range of the spill file as unused, merging it with the neighbouring holes. A hole at the
+// end of the file is removed by moving the end back, so an empty spill file starts over at zero.
+void freeSpillRange(int64_t pos, int64_t size)
+{
+	int i = 0;
+	while(i < mySpillHoles.size() && mySpillHoles[i].pos < pos) ++i;
+	if(i > 0 && mySpillHoles[i - 1].pos + mySpillHoles[i - 1].size == pos)
+	{
+		--i;
+		mySpillHoles[i].size += size;
+	}
+	else
+	{
+		mySpillHoles.insert(i, {pos, size}, 1);
+	}
+	if(i + 1 < mySpillHoles.size())
+	{
+		auto& next = mySpillHoles[i + 1];
+		if(mySpillHoles[i].pos + mySpillHoles[i].size == next.pos)
+		{
+			mySpillHoles[i].size += next.size;
+			mySpillHoles.erase(i + 1);
+		}
+	}
+	if(mySpillHoles[i].pos + mySpillHoles[i].size == mySpillEnd)
+	{
+		mySpillEnd = mySpillHoles[i].pos;
+		mySpillHoles.erase(i);
+	}
+}
+
+// Calls visit for the payload of every entry after settledUntil, from oldest to most recent, until
+// it returns false. Chain entries are skipped, but the entries inside the chain are visited. As
+// long as every visited payload is settled afterwards, settledUntil is advanced past its entry,
+// so the next visit does not have to walk the oldest entries again.
+template <typename Visitor>
+void visitPayloads(Entry*& settledUntil, bool (*isSettled)(const Payload&), Visitor visit)
+{
+	bool isPrefixSettled = true;
+	for(auto it = settledUntil ? settledUntil->next : myEntries.head; it; it = it->next)
+	{
+		bool proceed = true, isEntrySettled = true;
+		if(it->id == 0)
+		{
+			ReadStream in(it->payload.data, it->payload.size);
+			auto list = in.read<EntryList>();
+			for(auto sub = list.head; sub && proceed; sub = sub->next)
+			{
+				proceed = visit(sub->payload);
+				isEntrySettled = isEntrySettled && isSettled(sub->payload) && (proceed || !sub->next);
+			}
+		}
+		else
+		{
+			proceed = visit(it->payload);
+			isEntrySettled = isSettled(it->payload);
+		}
+		isPrefixSettled = isPrefixSettled && isEntrySettled;
+		if(isPrefixSettled) settledUntil = it;
+		if(!proceed) return;
+	}
+}
+
+// Compresses the oldest entries until the resident bytes fit within the memory budget, and spills
+// the oldest compressed entries until the total bytes in memory fit within the spill threshold.
+void enforceBudget()
+{
+	collectPackJobs();
+
+	size_t budget = (size_t)myMemoryBudgetMb << 20;
+	if(myResidentBytes - myPackingBytes > budget)
+	{
+		visitPayloads(myPackedUntil, IsPackSettled, [&](Payload& p)
+		{
+			if(p.data && p.isPackable && !p.job) queuePacking(p);
+			return myResidentBytes - myPackingBytes > budget;
+		});
+	}
+
+	size_t threshold = (size_t)mySpillThresholdMb << 20;
+	if(!mySpillFailed && myResidentBytes + myCompressedBytes > threshold)
+	{
+		visitPayloads(mySpilledUntil, IsSpillSettled, [&](Payload& p)
+		{
+			bool isFinal = p.packed || (p.data && !p.isPackable);
+			if(isFinal && !p.job && p.size >= MIN_PACKED_PAYLOAD) spillPayload(p);
+			return !mySpillFailed && myResidentBytes + myCompressedBytes > threshold;
+		});
+	}
+}
+
+Stats getStats()
+{
+	collectPackJobs();
+	return {myTotalEntries, myResidentBytes, myCompressedBytes, mySpilledBytes};
+}
+
 // ================================================================================================
 // HistoryImpl :: adding callbacks.
 
@@ -217,6 +826,7 @@ void pushEntry(Entry* entry)
 	++myTotalEntries;
 
 	String msg = ApplyEntry(entry, bound, false, false);
+	enforceBudget();
 
 	if(msg.len()) HudNote("%s", msg.str());
 }
@@ -277,7 +887,15 @@ void redoEntry()
 		auto it = myEntries.head;
 		for(int i = 0; i < myAppliedEntries; ++i) it = Advance(it, bound);
 
+		if(!AcquireEntry(it))
+		{
+			HudError("Could not redo, the history entry could not be read back.");
+			enforceBudget();
+			return;
+		}
+
 		String msg = ApplyEntry(it, bound, false, true);
+		enforceBudget();
 
 		++myAppliedEntries;
 
@@ -295,7 +913,15 @@ void undoEntry()
 		auto it = myEntries.head;
 		for(int i = 0; i < myAppliedEntries - 1; ++i) it = Advance(it, bound);
 
+		if(!AcquireEntry(it))
+		{
+			HudError("Could not undo, the history entry could not be read back.");
+			enforceBudget();
+			return;
+		}
+
 		String msg = ApplyEntry(it, bound, true, false);
+		enforceBudget();
 
 		--myAppliedEntries;
 
@@ -439,6 +1065,12 @@ void clearUnappliedEntries()
 	myEntries.head = it;
 	myEntries.reverse();
 
+	if(unappliedEntries > 0)
+	{
+		myPackedUntil = nullptr;
+		mySpilledUntil = nullptr;
+	}
+
 	myTotalEntries = myAppliedEntries;
 	if(mySavedEntries > myAppliedEntries)
 	{
@@ -465,6 +1097,8 @@ void clearEverything()
 		it = next;
 	}
 	myEntries.head = nullptr;
+	myPackedUntil = nullptr;
+	mySpilledUntil = nullptr;
 
 	myAppliedEntries = 0;
 	mySavedEntries = 0;
@@ -479,9 +1113,10 @@ void clearEverything()
 
 History* gHistory = nullptr;
 
-void History::create()
+void History::create(XmrNode& settings)
 {
 	gHistory = new HistoryImpl;
+	((HistoryImpl*)gHistory)->loadSettings(settings);
 }
 
 void History::destroy()
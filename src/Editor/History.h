@@ -20,9 +20,20 @@ struct History : public InputHandler
 	typedef void (*ReleaseFunc)(ReadStream& in, bool hasBeenApplied);
 	typedef String(*ApplyFunc)(ReadStream& in, Bindings bound, bool undo, bool redo);
 
-	static void create();
+	/// Memory usage of the recorded entries.
+	struct Stats
+	{
+		int numEntries;
+		size_t residentBytes;
+		size_t compressedBytes;
+		int64_t spilledBytes;
+	};
+
+	static void create(XmrNode& settings);
 	static void destroy();
 
+	virtual void saveSettings(XmrNode& settings) = 0;
+
 	virtual EditId addCallback(ApplyFunc apply, ReleaseFunc release = nullptr) = 0;
 
 	virtual void addEntry(EditId id, const void* data, uint size) = 0;
@@ -37,6 +48,10 @@ struct History : public InputHandler
 	virtual void onFileSaved() = 0;
 
 	virtual bool hasUnsavedChanges() const = 0;
+
+	/// Returns the memory usage of the entries. Entries that exceed the memory budget are
+	/// compressed in the background, and spilled to a temporary file past the spill threshold.
+	virtual Stats getStats() = 0;
 };
 
 extern History* gHistory;
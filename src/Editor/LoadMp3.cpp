@@ -4,8 +4,15 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
+#include <atomic>
+
+#include <Core/Vector.h>
+#include <Core/Utils.h>
 
 #include <System/File.h>
+#include <System/Thread.h>
+#include <System/Debug.h>
 
 namespace Vortex {
 namespace {
@@ -190,22 +197,44 @@ fail:
 // ================================================================================================
 // MP3 loading.
 
+// The smallest number of mp3 frames that is decoded by a single parallel decoding job.
+static const int MIN_JOB_FRAMES = 256;
+
+// The number of bytes before the first output frame of a job at which decoding starts. The bit
+// reservoir of layer III reaches at most 511 bytes back, this leaves room for headers and side info.
+static const int PREROLL_BYTES = 2048;
+
+// Position of an mp3 frame in the file data.
+struct FrameIndex
+{
+	int offset;      // Byte offset of the frame header.
+	int firstSample; // Number of sample frames synthesized before the frame.
+};
+
 struct MP3Loader : public SoundSource
 {
 	MP3Loader();
 	~MP3Loader();
 
 	int getFrequency() override { return frequency; }
-	int getNumFrames() override { return 0; }
+	int getNumFrames() override { return numIndexedSamples; }
 	int getNumChannels() override { return numChannels; }
 	int getBytesPerSample() override { return 2; }
 	int readFrames(int frames, short* buffer) override;
+	bool readAllFrames(short* samplesL, short* samplesR, uchar* progress,
+		const uchar* terminate) override;
 
 	int fillInputBuffer();
 	bool decodeFirstFrame();
 	int decodeNextFrame();
 	void synthDecodedFrame();
 
+	bool buildFrameIndex();
+	bool decodeParallel(short* samplesL, short* samplesR, uchar* progress, const uchar* terminate);
+	bool decodeJob(int begin, int end, short* samplesL, short* samplesR, const uchar* terminate,
+		std::atomic_int* framesDone);
+	void decodeSerial(short* samplesL, short* samplesR, const uchar* terminate);
+
 	mad_stream madStream;
 	mad_frame madFrame;
 	mad_synth madSynth;
@@ -224,6 +253,12 @@ struct MP3Loader : public SoundSource
 	XingHeader xing;
 
 	FileReader* file;
+
+	// The entire file, followed by MAD_BUFFER_GUARD zeros. Only kept if the frame index is valid.
+	Vector<uchar> fileData;
+	Vector<FrameIndex> frameIndex;
+	int numIndexedSamples;
+	bool skipFirstFrame;
 };
 
 MP3Loader::MP3Loader()
@@ -241,6 +276,8 @@ MP3Loader::MP3Loader()
 	hasXingHeader = false;
 
 	numChannels = 0;
+	numIndexedSamples = 0;
+	skipFirstFrame = false;
 
 	memset(&xing, 0, sizeof(XingHeader));
 }
@@ -421,12 +458,300 @@ int MP3Loader::readFrames(int frames, short* buffer)
 
 		// Decode and synthesize more samples.
 		int ret = decodeNextFrame();
-		if(ret <= 0) return 0;
+		if(ret <= 0) break;
 		synthDecodedFrame();
 	}
 	return framesWritten;
 }
 
+// ================================================================================================
+// Parallel MP3 decoding.
+
+// Decodes the next frame from a stream that contains the entire file. Returns 1 on success, 0 if
+// the frame references reservoir bytes that are not available, and -1 on any other error.
+static int DecodeFrame(mad_stream* stream, mad_frame* frame)
+{
+	while(true)
+	{
+		if(mad_frame_decode(frame, stream) == 0) return 1;
+
+		if(stream->error == MAD_ERROR_BADDATAPTR) return 0;
+
+		if(stream->error == MAD_ERROR_LOSTSYNC)
+		{
+			const int tagsize = ID3TagQuery(stream->this_frame, stream->bufend - stream->this_frame);
+			if(tagsize)
+			{
+				mad_stream_skip(stream, tagsize);
+				continue;
+			}
+		}
+		return -1;
+	}
+}
+
+// Builds an index of the mp3 frames in the file. Files are only indexed if every frame can be
+// found by the same rules the serial decoder uses, and all frames share the same format. Other
+// files are left to the serial decoder.
+bool MP3Loader::buildFrameIndex()
+{
+	size_t size = file->size();
+	if(size == 0 || size > INT_MAX / 2) return false;
+
+	fileData.resize((int)size + MAD_BUFFER_GUARD, 0);
+	bool isRead = (file->read(fileData.data(), 1, size) == size);
+	file->seek(0, SEEK_SET);
+	if(!isRead) return false;
+
+	const uchar* data = fileData.data();
+
+	mad_stream stream;
+	mad_header header;
+	mad_stream_init(&stream);
+	mad_header_init(&header);
+	mad_stream_buffer(&stream, data, fileData.size());
+
+	// Store the number of samples per frame in the index for now.
+	bool isClean = true;
+	mad_header first = {};
+	while(isClean)
+	{
+		if(mad_header_decode(&header, &stream) == -1)
+		{
+			// The stream ends when the decoder runs into the guard bytes after the last frame.
+			if(stream.error == MAD_ERROR_BUFLEN || stream.this_frame >= data + size) break;
+
+			const int tagsize = (stream.error == MAD_ERROR_LOSTSYNC)
+				? ID3TagQuery(stream.this_frame, stream.bufend - stream.this_frame) : 0;
+			if(tagsize > 0)
+			{
+				mad_stream_skip(&stream, tagsize);
+				continue;
+			}
+			isClean = false;
+			break;
+		}
+		if(frameIndex.empty())
+		{
+			first = header;
+		}
+		else if(header.layer != first.layer || header.samplerate != first.samplerate ||
+			MAD_NCHANNELS(&header) != MAD_NCHANNELS(&first) ||
+			MAD_NSBSAMPLES(&header) != MAD_NSBSAMPLES(&first))
+		{
+			isClean = false;
+		}
+		frameIndex.push_back({(int)(stream.this_frame - data), 32 * (int)MAD_NSBSAMPLES(&header)});
+	}
+	mad_stream_finish(&stream);
+	mad_header_finish(&header);
+
+	// The first frame is skipped if it contains a Xing header, which requires decoding it.
+	if(isClean && frameIndex.size())
+	{
+		mad_frame frame;
+		mad_frame_init(&frame);
+		mad_stream_init(&stream);
+		mad_stream_buffer(&stream, data + frameIndex[0].offset, fileData.size() - frameIndex[0].offset);
+		if(DecodeFrame(&stream, &frame) >= 0 && stream.this_frame == data + frameIndex[0].offset)
+		{
+			XingHeader xingHeader;
+			xingHeader.flags = 0;
+			if(XingParse(&xingHeader, stream.anc_ptr, stream.anc_bitlen) == 0)
+			{
+				skipFirstFrame = (xingHeader.type == XingHeader::XING);
+			}
+		}
+		else
+		{
+			isClean = false;
+		}
+		mad_stream_finish(&stream);
+		mad_frame_finish(&frame);
+	}
+
+	if(!isClean || frameIndex.empty())
+	{
+		frameIndex.release();
+		fileData.release();
+		return false;
+	}
+
+	// Convert the frame sizes to sample offsets, with a sentinel at the end.
+	int numSamples = 0;
+	for(auto& frame : frameIndex)
+	{
+		int frameSamples = frame.firstSample;
+		frame.firstSample = numSamples;
+		if(&frame != frameIndex.begin() || !skipFirstFrame) numSamples += frameSamples;
+	}
+	frameIndex.push_back({(int)size, numSamples});
+	numIndexedSamples = numSamples;
+
+	return true;
+}
+
+// Decodes the mp3 frames [begin, end) into the output buffers. Decoding starts a few frames
+// earlier, so the bit reservoir, the overlap of the previous granule and the synthesis filter are
+// in the same state the serial decoder would have. Returns false if that could not be achieved.
+bool MP3Loader::decodeJob(int begin, int end, short* samplesL, short* samplesR,
+	const uchar* terminate, std::atomic_int* framesDone)
+{
+	const uchar* data = fileData.data();
+
+	int start = 0;
+	if(begin > 0)
+	{
+		start = max(begin - 3, 0);
+		while(start > 0 && frameIndex[begin - 2].offset - frameIndex[start].offset < PREROLL_BYTES)
+		{
+			--start;
+		}
+	}
+
+	struct Decoder { mad_stream stream; mad_frame frame; mad_synth synth; };
+	Decoder* dec = new Decoder;
+	mad_stream_init(&dec->stream);
+	mad_frame_init(&dec->frame);
+	mad_synth_init(&dec->synth);
+	mad_stream_buffer(&dec->stream, data + frameIndex[start].offset,
+		fileData.size() - frameIndex[start].offset);
+
+	// Each synthesized frame advances the phase of the synthesis filter by one per 32 samples.
+	dec->synth.phase = (frameIndex[start].firstSample / 32) % 16;
+
+	bool success = true;
+	for(int i = start; i < end; ++i)
+	{
+		if(*terminate)
+		{
+			success = false;
+			break;
+		}
+
+		// Frames that are written, and the two frames they depend on, must decode completely.
+		// Only the start of the file may reference missing reservoir bytes, like a cut mp3.
+		int res = DecodeFrame(&dec->stream, &dec->frame);
+		if(res < 0 || (res == 0 && begin > 0 && i >= begin - 2) ||
+			dec->stream.this_frame != data + frameIndex[i].offset)
+		{
+			success = false;
+			break;
+		}
+
+		if(i == 0 && skipFirstFrame) continue;
+
+		mad_synth_frame(&dec->synth, &dec->frame);
+		if(i < begin) continue;
+
+		const mad_fixed_t* l = dec->synth.pcm.samples[0];
+		const mad_fixed_t* r = dec->synth.pcm.samples[numChannels - 1];
+		short* dstL = samplesL + frameIndex[i].firstSample;
+		short* dstR = samplesR + frameIndex[i].firstSample;
+		for(int j = 0, n = dec->synth.pcm.length; j < n; ++j)
+		{
+			dstL[j] = ScaleSample(l[j]);
+			dstR[j] = ScaleSample(r[j]);
+		}
+		++*framesDone;
+	}
+
+	mad_synth_finish(&dec->synth);
+	mad_frame_finish(&dec->frame);
+	mad_stream_finish(&dec->stream);
+	delete dec;
+
+	return success;
+}
+
+// Splits the indexed frames into jobs that are decoded on all available cores.
+bool MP3Loader::decodeParallel(short* samplesL, short* samplesR, uchar* progress,
+	const uchar* terminate)
+{
+	int numFrames = frameIndex.size() - 1;
+	int numThreads = ParallelThreads::concurrency();
+	int numJobs = clamp(numFrames / MIN_JOB_FRAMES, 1, numThreads * 2);
+
+	struct DecodeThreads : public ParallelThreads
+	{
+		MP3Loader* loader;
+		short* samplesL;
+		short* samplesR;
+		uchar* progress;
+		const uchar* terminate;
+		std::atomic_int framesDone;
+		int numFrames, numJobs;
+		uchar failed;
+		void exec(int job, int thread)
+		{
+			int begin = (int)((int64_t)numFrames * job / numJobs);
+			int end = (int)((int64_t)numFrames * (job + 1) / numJobs);
+			if(!loader->decodeJob(begin, end, samplesL, samplesR, terminate, &framesDone))
+			{
+				failed = 1;
+			}
+			// The progress is polled by the thread that loads the sound.
+			*(volatile uchar*)progress = (uchar)((int64_t)100 * framesDone / numFrames);
+		}
+	};
+	DecodeThreads threads;
+	threads.loader = this;
+	threads.samplesL = samplesL;
+	threads.samplesR = samplesR;
+	threads.progress = progress;
+	threads.terminate = terminate;
+	threads.framesDone = 0;
+	threads.numFrames = numFrames;
+	threads.numJobs = numJobs;
+	threads.failed = 0;
+	threads.run(numJobs, min(numJobs, numThreads));
+
+	return !threads.failed && !*terminate;
+}
+
+// Decodes the remaining frames with the serial decoder, and fills the rest of the buffers with
+// silence if it produces fewer frames than indexed.
+void MP3Loader::decodeSerial(short* samplesL, short* samplesR, const uchar* terminate)
+{
+	short buffer[2048];
+	int numFrames = numIndexedSamples, pos = 0;
+	int blockSize = sizeof(buffer) / sizeof(short) / numChannels;
+	while(pos < numFrames && !*terminate)
+	{
+		int n = min(readFrames(min(blockSize, numFrames - pos), buffer), numFrames - pos);
+		if(n <= 0) break;
+		for(int i = 0; i < n; ++i, ++pos)
+		{
+			samplesL[pos] = buffer[i * numChannels];
+			samplesR[pos] = buffer[i * numChannels + numChannels - 1];
+		}
+	}
+	for(; pos < numFrames; ++pos)
+	{
+		samplesL[pos] = samplesR[pos] = 0;
+	}
+}
+
+bool MP3Loader::readAllFrames(short* samplesL, short* samplesR, uchar* progress,
+	const uchar* terminate)
+{
+	if(frameIndex.empty()) return false;
+
+	// The serial decoder has not read beyond the first frame, so it can take over if one of the
+	// jobs fails, in which case the output is exactly the same.
+	if(!decodeParallel(samplesL, samplesR, progress, terminate) && !*terminate)
+	{
+		Debug::log("parallel mp3 decoding failed, falling back to serial decoding\n");
+		decodeSerial(samplesL, samplesR, terminate);
+	}
+
+	fileData.release();
+	frameIndex.release();
+	*progress = 100;
+
+	return !*terminate;
+}
+
 }; // anonymous namespace.
 
 SoundSource* LoadMP3(FileReader* file, String& title, String& artist)
@@ -434,6 +759,9 @@ SoundSource* LoadMP3(FileReader* file, String& title, String& artist)
 	MP3Loader* loader = new MP3Loader;
 	loader->file = file;
 
+	// Index the frames, so the file can be decoded in parallel.
+	loader->buildFrameIndex();
+
 	// Decode and synth the first frame to check if the file is valid.
 	if(!loader->decodeFirstFrame())
 	{
@@ -446,4 +774,101 @@ SoundSource* LoadMP3(FileReader* file, String& title, String& artist)
 	return loader;
 }
 
+// ================================================================================================
+// Parallel decoding test.
+
+#ifdef ENABLE_MP3_TEST
+
+// Decodes every mp3 file in the given directory both serially and in parallel, and checks that
+// the parallel decoder produces exactly the same samples. Returns false if no file could be
+// compared, or if any file differs.
+// Built into the Mp3DecodingTest program of the CMake build, see src/Benchmark/Mp3DecodingTest.cpp.
+bool TestParallelMp3Decoding(StringRef dir)
+{
+	bool passed = true;
+	int numTested = 0;
+	Debug::blockBegin(Debug::INFO, "parallel mp3 decoding test");
+	for(auto& path : File::findFiles(dir, false, "mp3"))
+	{
+		String title, artist;
+		FileReader* file = new FileReader;
+		MP3Loader* loader = nullptr;
+		if(file->open(path.str)) loader = (MP3Loader*)LoadMP3(file, title, artist);
+		if(!loader)
+		{
+			Debug::log("%s: FAILED, could not be loaded\n", path.filename().str());
+			passed = false;
+			delete file;
+			continue;
+		}
+
+		int numFrames = loader->getNumFrames();
+		if(numFrames == 0)
+		{
+			Debug::log("%s: not indexed, decoded serially\n", path.filename().str());
+			delete loader;
+			continue;
+		}
+
+		++numTested;
+		Vector<short> parallelL(numFrames, 0), parallelR(numFrames, 0);
+		uchar progress = 0, terminate = 0;
+		double start = Debug::getElapsedTime();
+		bool decoded = loader->decodeParallel(parallelL.data(), parallelR.data(), &progress, &terminate);
+		double parallelTime = Debug::getElapsedTime(start);
+
+		// The serial decoder is not affected by the parallel decoder.
+		Vector<short> serialL, serialR;
+		short buffer[2048];
+		int channels = loader->getNumChannels();
+		start = Debug::getElapsedTime();
+		for(int n; (n = loader->readFrames(1024, buffer)) > 0;)
+		{
+			for(int i = 0; i < n; ++i)
+			{
+				serialL.push_back(buffer[i * channels]);
+				serialR.push_back(buffer[i * channels + channels - 1]);
+			}
+		}
+		double serialTime = Debug::getElapsedTime(start);
+
+		int mismatch = -1;
+		for(int i = 0; i < numFrames && i < serialL.size() && mismatch < 0; ++i)
+		{
+			if(serialL[i] != parallelL[i] || serialR[i] != parallelR[i]) mismatch = i;
+		}
+
+		if(!decoded)
+		{
+			Debug::log("%s: FAILED, parallel decoding failed\n", path.filename().str());
+			passed = false;
+		}
+		else if(serialL.size() != numFrames)
+		{
+			Debug::log("%s: FAILED, %i frames indexed, %i frames decoded\n",
+				path.filename().str(), numFrames, serialL.size());
+			passed = false;
+		}
+		else if(mismatch >= 0)
+		{
+			Debug::log("%s: FAILED, samples differ at frame %i\n", path.filename().str(), mismatch);
+			passed = false;
+		}
+		else
+		{
+			Debug::log("%s: identical, serial %.0f ms, parallel %.0f ms\n",
+				path.filename().str(), serialTime * 1000.0, parallelTime * 1000.0);
+		}
+		delete loader;
+	}
+	if(numTested == 0)
+	{
+		Debug::log("FAILED, no indexed mp3 files were found in %s\n", dir.str());
+	}
+	Debug::blockEnd();
+	return passed && numTested > 0;
+}
+
+#endif // ENABLE_MP3_TEST
+
 }; // namespace Vortex
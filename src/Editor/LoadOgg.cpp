@@ -46,10 +46,18 @@ OggLoader::~OggLoader()
 
 int OggLoader::readFrames(int frames, short* buffer)
 {
+	// A single ov_read call returns at most one packet, so keep reading until the buffer is full.
 	int bytesPerFrame = numChannels * 2;
-	int bytesRead = ov_read(vf, (char*)buffer, frames * bytesPerFrame, 0, 2, 1, &bitstream);
-	if(bytesRead < 0) bytesRead = 0;
-	return bytesRead / bytesPerFrame;
+	int bytesLeft = frames * bytesPerFrame;
+	char* dst = (char*)buffer;
+	while(bytesLeft > 0)
+	{
+		int bytesRead = ov_read(vf, dst, bytesLeft, 0, 2, 1, &bitstream);
+		if(bytesRead <= 0) break;
+		dst += bytesRead;
+		bytesLeft -= bytesRead;
+	}
+	return (int)(dst - (char*)buffer) / bytesPerFrame;
 }
 
 static size_t OvRead(void* ptr, size_t size, size_t nmemb, void* file)
@@ -18,6 +18,7 @@
 #include <Editor/Editing.h>
 #include <Editor/Minimap.h>
 #include <Editor/TempoBoxes.h>
+#include <Editor/Music.h>
 
 #include <System/System.h>
 #include <System/Debug.h>
@@ -43,6 +44,7 @@ Item* myMinimapMenu;
 Item* myBgStyleMenu;
 Item* myStatusMenu;
 Item* myEditMenu;
+Item* myAudioSpeedMenu;
 
 UpdateFunction myUpdateFunctions[NUM_PROPERTIES];
 
@@ -275,11 +277,13 @@ void init(Item* menu)
 	add(hAudioVol, VOLUME_MUTE, "Mute");
 
 	// Audio > Speed menu.
-	Item* hAudioSpeed = newMenu();
+	Item* hAudioSpeed = myAudioSpeedMenu = newMenu();
 	add(hAudioSpeed, SPEED_RESET, "Default");
 	sep(hAudioSpeed);
 	add(hAudioSpeed, SPEED_INCREASE, "Faster");
 	add(hAudioSpeed, SPEED_DECREASE, "Slower");
+	sep(hAudioSpeed);
+	add(hAudioSpeed, SPEED_PRESERVE_PITCH, "Preserve pitch");
 
 	// Audio menu.
 	Item* hAudio = newMenu();
@@ -384,6 +388,8 @@ void init(Item* menu)
 	add(hHelp, SHOW_SHORTCUTS, "Shortcuts...");
 	add(hHelp, SHOW_MESSAGE_LOG, "Message Log...");
 	add(hHelp, SHOW_DEBUG_LOG, "Debug Log...");
+	add(hHelp, SHOW_PROFILER, "Profiler");
+	add(hHelp, EXPORT_PROFILER_TRACE, "Export Profiler Trace...");
 	sep(hHelp);
 	add(hHelp, SHOW_ABOUT, "About...");
 
@@ -465,6 +471,10 @@ void registerUpdateFunctions()
 		MENU->myVisualSyncMenu->setChecked(SET_VISUAL_SYNC_CURSOR_ANCHOR, gEditing->getVisualSyncMode() == Editing::VisualSyncAnchor::CURSOR);
 		MENU->myVisualSyncMenu->setChecked(SET_VISUAL_SYNC_RECEPTOR_ANCHOR, gEditing->getVisualSyncMode() == Editing::VisualSyncAnchor::RECEPTORS);
 	};
+	myUpdateFunctions[AUDIO_PRESERVE_PITCH] = []
+	{
+		MENU->myAudioSpeedMenu->setChecked(SPEED_PRESERVE_PITCH, gMusic->hasPreservePitch());
+	};
 	myUpdateFunctions[USE_REVERSE_SCROLL] = []
 	{
 		MENU->myViewMenu->setChecked(TOGGLE_REVERSE_SCROLL, gView->hasReverseScroll());
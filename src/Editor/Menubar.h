@@ -31,6 +31,8 @@ struct Menubar
 
 	VISUAL_SYNC_ANCHOR,
 
+	AUDIO_PRESERVE_PITCH,
+
 	VIEW_MINIMAP,
 	VIEW_MODE,
 	VIEW_BACKGROUND,
@@ -1,11 +1,14 @@
 #include <Editor/Minimap.h>
 
 #include <math.h>
+#include <limits.h>
+#include <algorithm>
 
 #include <Core/Utils.h>
 
 #include <System/Debug.h>
 #include <System/System.h>
+#include <System/Profiler.h>
 
 #include <Core/Draw.h>
 #include <Core/Renderer.h>
@@ -57,28 +60,41 @@ static const color32 minecol =
 	RGBAtoColor32(192, 192, 192, 255), // Light gray
 };
 
-struct SetPixelData
+// A note as it appears on the minimap. In density mode, only the pixel row and density are used.
+struct MapNote
 {
-	uint* pixels;
-	int noteW;
-	double pixPerOfs, startOfs;
+	int y, endY, x;
+	color32 color, holdColor;
+	double density;
 };
 
-static void SetPixels(const SetPixelData& spd, int x, double tor, color32 color)
+static bool operator == (const MapNote& a, const MapNote& b)
 {
-	int y = clamp((int)((tor - spd.startOfs) * spd.pixPerOfs), 0, MAP_HEIGHT - 1);
-	uint* dst = spd.pixels + y * MAP_WIDTH + x;
-	for(int i = 0; i < spd.noteW; ++i, ++dst) *dst = color;
+	return a.y == b.y && a.endY == b.endY && a.x == b.x && a.color == b.color
+		&& a.holdColor == b.holdColor && a.density == b.density;
 }
 
-static void SetPixels(const SetPixelData& spd, int x, double tor, double end, color32 color)
+// The mapping of the chart onto the minimap. Everything is redrawn when the layout changes.
+struct MapLayout
 {
-	int yt = clamp((int)((tor - spd.startOfs) * spd.pixPerOfs), 0, MAP_HEIGHT - 1);
-	int yb = clamp((int)((end - spd.startOfs) * spd.pixPerOfs), 0, MAP_HEIGHT - 1);
-	for(int y = yt; y <= yb; ++y)
+	Minimap::Mode mode;
+	bool isTimeBased;
+	int numCols, height;
+	double beginOfs, endOfs;
+};
+
+static bool operator == (const MapLayout& a, const MapLayout& b)
+{
+	return a.mode == b.mode && a.isTimeBased == b.isTimeBased && a.numCols == b.numCols
+		&& a.height == b.height && a.beginOfs == b.beginOfs && a.endOfs == b.endOfs;
+}
+
+static void FillRows(uint* pixels, int x, int w, int y1, int y2, color32 color)
+{
+	for(int y = y1; y <= y2; ++y)
 	{
-		uint* dst = spd.pixels + y * MAP_WIDTH + x;
-		for(int i = 0; i < spd.noteW; ++i, ++dst) *dst = color;
+		uint* dst = pixels + y * MAP_WIDTH + x;
+		for(int i = 0; i < w; ++i, ++dst) *dst = color;
 	}
 }
 
@@ -98,6 +114,13 @@ double myChartEndOfs;
 bool myIsDragging;
 float myUvs[NUM_PIECES * 8];
 
+Vector<uint> myPixels;
+MapLayout myLayout;
+Vector<MapNote> myMapNotes;
+Vector<int> myRowStart;
+Vector<double> myDensityTable;
+int myMaxHoldH;
+
 // ================================================================================================
 // MinimapImpl :: constructor and destructor.
 
@@ -112,6 +135,11 @@ MinimapImpl()
 	myNotesH = 0;
 	myIsDragging = false;
 
+	myPixels.resize(MAP_HEIGHT * MAP_WIDTH, 0);
+	myLayout = {NOTES, false, 0, -1, 0.0, 0.0};
+	myRowStart.resize(MAP_HEIGHT + 1, 0);
+	myMaxHoldH = 0;
+
 	VortexAssert(TEXTURE_SIZE * TEXTURE_SIZE == MAP_HEIGHT * MAP_WIDTH);
 	// Split the texture area into vertical strips from left to right.
 	float u = 0.f, du = (float)MAP_WIDTH / (float)TEXTURE_SIZE;
@@ -123,52 +151,145 @@ MinimapImpl()
 }
 
 // ================================================================================================
-// MinimapImpl :: rendering functions.
+// MinimapImpl :: building the map notes.
 
-void renderNotes(SetPixelData& spd, const int* colx)
+int toPixelRow(double ofs, double pixPerOfs)
 {
-	if(gView->isTimeBased())
+	return clamp((int)((ofs - myChartBeginOfs) * pixPerOfs), 0, MAP_HEIGHT - 1);
+}
+
+void buildNotes(Vector<MapNote>& out, double pixPerOfs, const int* colx,
+	const ExpandedNote* begin, const ExpandedNote* end)
+{
+	bool timeBased = gView->isTimeBased();
+	out.reserve(out.size() + (end - begin));
+	for(auto it = begin; it != end; ++it)
 	{
-		for(auto& note : *gNotes)
+		auto& note = *it;
+		MapNote m = {0, 0, colx[note.col], 0, 0, 0.0};
+		m.y = toPixelRow(timeBased ? note.time : note.row, pixPerOfs);
+		m.endY = m.y;
+		if(note.endrow > note.row)
 		{
-			int rowtype = ToRowType(note.row);
-			if(note.endrow > note.row)
-			{
-				color32 color = (note.isRoll) ? rollcol : freezecol;
-				SetPixels(spd, colx[note.col], note.time, note.endtime, color);
-			}
-			color32 color;
-			if(note.isSelected)
-			{
-				color = RGBAtoColor32(255, 255, 255, 255);
-			}
-			else
-			{
-				color = (note.isMine) ? minecol : arrowcol[rowtype];
-			}
-			SetPixels(spd, colx[note.col], note.time, color);
+			m.endY = toPixelRow(timeBased ? note.endtime : note.endrow, pixPerOfs);
+			m.holdColor = (note.isRoll) ? rollcol : freezecol;
 		}
+		if(note.isSelected)
+		{
+			m.color = RGBAtoColor32(255, 255, 255, 255);
+		}
+		else
+		{
+			m.color = (note.isMine) ? minecol : arrowcol[ToRowType(note.row)];
+		}
+		out.push_back(m);
 	}
-	else
+}
+
+// The density of a note is based on the time between its neighbours; mines and warped notes have
+// no density, but they still count as neighbours.
+void buildDensity(Vector<MapNote>& out, double pixPerOfs)
+{
+	bool timeBased = gView->isTimeBased();
+	int height = min(myLayout.height, MAP_HEIGHT);
+	auto first = gNotes->begin(), end = gNotes->end(), last = end - 1;
+	for(auto it = first; it != end; ++it)
+	{
+		if(it->isMine || it->isWarped) continue;
+		int y = (int)floor(((timeBased ? it->time : it->row) - myChartBeginOfs) * pixPerOfs);
+		if(y < 0 || y >= height) continue;
+		double pre = (it > first) ? (it - 1)->time : (it->time - 1.0);
+		double post = (it < last) ? (it + 1)->time : (it->time + 1.0);
+		if(post > pre) out.push_back({y, y, 0, 0, 0, 2.0 / (post - pre)});
+	}
+}
+
+// Finds the pixel rows covered by the map notes that differ between the previous and current
+// map notes. Both lists are sorted by pixel row, so only the range between the common prefix and
+// common suffix has to be compared. The prefix and suffix start at the given number of map notes,
+// which are known to be equal.
+static void FindDirtyRows(const Vector<MapNote>& prev, const Vector<MapNote>& cur, int p, int s,
+	int& begin, int& end)
+{
+	int n0 = prev.size(), n1 = cur.size();
+	while(p < n0 && p < n1 && prev[p] == cur[p]) ++p;
+	while(s < n0 - p && s < n1 - p && prev[n0 - 1 - s] == cur[n1 - 1 - s]) ++s;
+
+	begin = MAP_HEIGHT, end = 0;
+	for(int i = p; i < n0 - s; ++i)
+	{
+		begin = min(begin, prev[i].y);
+		end = max(end, prev[i].endY + 1);
+	}
+	for(int i = p; i < n1 - s; ++i)
+	{
+		begin = min(begin, cur[i].y);
+		end = max(end, cur[i].endY + 1);
+	}
+}
+
+// Updates the index of the first map note on each pixel row, which is a prefix sum over the
+// number of notes per row, and the sparse table that gives the maximum density over a range.
+void updateIndex()
+{
+	int n = myMapNotes.size();
+	int* rowStart = myRowStart.data();
+	for(int y = 0, i = 0; y <= MAP_HEIGHT; ++y)
+	{
+		while(i < n && myMapNotes[i].y < y) ++i;
+		rowStart[y] = i;
+	}
+
+	myMaxHoldH = 0;
+	for(auto& m : myMapNotes) myMaxHoldH = max(myMaxHoldH, m.endY - m.y);
+
+	myDensityTable.clear();
+	if(myLayout.mode == DENSITY && n > 0)
 	{
-		for(auto& note : *gNotes)
+		int numLevels = 1;
+		while((1 << numLevels) <= n) ++numLevels;
+		myDensityTable.resize(n * numLevels);
+		double* table = myDensityTable.data();
+		for(int i = 0; i < n; ++i) table[i] = myMapNotes[i].density;
+		for(int level = 1; level < numLevels; ++level)
 		{
-			int rowtype = ToRowType(note.row);
-			if(note.endrow > note.row)
-			{
-				color32 color = (note.isRoll) ? rollcol : freezecol;
-				SetPixels(spd, colx[note.col], note.row, note.endrow, color);
-			}
-			color32 color;
-			if(note.isSelected)
-			{
-				color = RGBAtoColor32(255, 255, 255, 255);
-			}
-			else
-			{
-				color = (note.isMine) ? minecol : arrowcol[rowtype];
-			}
-			SetPixels(spd, colx[note.col], note.row, color);
+			const double* src = table + (level - 1) * n;
+			double* dst = table + level * n;
+			int half = 1 << (level - 1);
+			for(int i = 0; i + half * 2 <= n; ++i) dst[i] = max(src[i], src[i + half]);
+		}
+	}
+}
+
+double getMaxDensity(int begin, int end) const
+{
+	int level = 0;
+	while((2 << level) <= end - begin) ++level;
+	const double* table = myDensityTable.data() + level * myMapNotes.size();
+	return max(table[begin], table[end - (1 << level)]);
+}
+
+// ================================================================================================
+// MinimapImpl :: rendering functions.
+
+void renderNotes(int beginY, int endY)
+{
+	int cols = myLayout.numCols;
+	int colw = (cols <= 8) ? 2 : 1;
+
+	// Holds that start above the dirty rows can still reach into them.
+	uint* pixels = myPixels.data();
+	int first = myRowStart[max(beginY - myMaxHoldH, 0)];
+	for(int i = first, n = myMapNotes.size(); i < n && myMapNotes[i].y < endY; ++i)
+	{
+		auto& m = myMapNotes[i];
+		if(m.holdColor && m.endY >= beginY)
+		{
+			FillRows(pixels, m.x, colw, max(m.y, beginY), min(m.endY, endY - 1), m.holdColor);
+		}
+		if(m.y >= beginY)
+		{
+			FillRows(pixels, m.x, colw, m.y, m.y, m.color);
 		}
 	}
 }
@@ -201,46 +322,15 @@ static void SetDensityRow(uint* pixels, int y, double density)
 	for(int i = -w; i < w; ++i, ++dst) *dst = col;
 }
 
-void renderDensity(SetPixelData& spd, const int* colx)
+void renderDensity(int beginY, int endY)
 {
-	auto first = gNotes->begin(), end = gNotes->end(), it = first, last = end - 1;
-
-	if(gView->isTimeBased())
-	{
-		double sec = myChartBeginOfs;
-		double secPerPix = (double)(myChartEndOfs - myChartBeginOfs) / (double)myNotesH;
-		for(int y = 0; y < myNotesH; ++y)
-		{
-			double density = 0.0;
-			for(; it != end && it->time < sec; ++it);
-			for(; it != end && it->time < sec + secPerPix; ++it)
-			{
-				if(it->isMine || it->isWarped) continue;
-				double pre = (it > first) ? (it - 1)->time : (it->time - 1.0);
-				double post = (it < last) ? (it + 1)->time : (it->time + 1.0);
-				if(post > pre) density = max(density, 2.0 / (post - pre));
-			}
-			if(density > 0.0) SetDensityRow(spd.pixels, y, density);
-			sec += secPerPix;
-		}
-	}
-	else
+	for(int y = beginY; y < endY; ++y)
 	{
-		double row = myChartBeginOfs;
-		double rowPerPix = (double)(myChartEndOfs - myChartBeginOfs) / (double)myNotesH;
-		for(int y = 0; y < myNotesH; ++y)
+		int begin = myRowStart[y], end = myRowStart[y + 1];
+		if(begin < end)
 		{
-			double density = 0.0;
-			for(; it != end && it->row < row; ++it);
-			for(; it != end && it->row < row + rowPerPix; ++it)
-			{
-				if(it->isMine || it->isWarped) continue;
-				double pre = (it > first) ? (it - 1)->time : (it->time - 1.0);
-				double post = (it < last) ? (it + 1)->time : (it->time + 1.0);
-				if(post > pre) density = max(density, 2.0 / (post - pre));
-			}
-			if(density > 0.0) SetDensityRow(spd.pixels, y, density);
-			row += rowPerPix;
+			double density = getMaxDensity(begin, end);
+			if(density > 0.0) SetDensityRow(myPixels.data(), y, density);
 		}
 	}
 }
@@ -263,7 +353,7 @@ bool updateMinimapHeight()
 	if (rect.h != myNotesH)
 	{
 		myNotesH = min(MAP_HEIGHT, rect.h);
-		onChanges(VCM_VIEW_CHANGED);
+		updateMap(VCM_VIEW_CHANGED, 0, INT_MAX);
 		return true;
 	}
 
@@ -289,7 +379,13 @@ double myGetMapOffset(int y)
 	return tor;
 }
 
-void onChanges(int changes)
+void onChanges(const ChangeEvent& event)
+{
+	updateMap(event.changes, event.beginRow, event.endRow);
+}
+
+// Changes to the notes are limited to the rows in [beginRow, endRow).
+void updateMap(int changes, int beginRow, int endRow)
 {
 	int bits = VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED | VCM_VIEW_CHANGED | VCM_END_ROW_CHANGED;
 
@@ -297,8 +393,6 @@ void onChanges(int changes)
 
 	if((changes & bits) == 0) return;
 
-	Vector<uint> buffer(MAP_HEIGHT * MAP_WIDTH, 0);
-
 	// The height of the chart region is based on the time elapsed between the first and last row.
 	double timeStart = gTempo->rowToTime(0);
 	double timeEnd = gTempo->rowToTime(gSimfile->getEndRow());
@@ -314,38 +408,83 @@ void onChanges(int changes)
 		myChartEndOfs = (double)gSimfile->getEndRow();
 	}
 
-	if(gChart->isOpen())
+	auto rect = myGetMapRect();
+	int numCols = gChart->isOpen() ? gStyle->getNumCols() : 0;
+	MapLayout layout = {myMode, gView->isTimeBased(), numCols, rect.h, myChartBeginOfs, myChartEndOfs};
+	bool redrawAll = !(layout == myLayout);
+	myLayout = layout;
+
+	Vector<MapNote> mapNotes;
+	int prefix = 0, suffix = 0;
+	if(gChart->isOpen() && myChartEndOfs > myChartBeginOfs)
 	{
 		// Calculate the x-position of every note column.
-		int cols = gStyle->getNumCols();
-		int colw = (cols <= 8) ? 2 : 1;
-		int coldx = (cols <= 4) ? 3 : (cols <= 8) ? 2 : 1;
+		int coldx = (numCols <= 4) ? 3 : (numCols <= 8) ? 2 : 1;
 		int colx[SIM_MAX_COLUMNS] = {};
-		for(int c = 0; c < cols; ++c)
+		for(int c = 0; c < numCols; ++c)
 		{
-			colx[c] = MAP_WIDTH / 2 + (c - cols / 2) * coldx;
+			colx[c] = MAP_WIDTH / 2 + (c - numCols / 2) * coldx;
 		}
 
-		auto rect = myGetMapRect();
-		double pixPerOfs = (double) rect.h / (myChartEndOfs - myChartBeginOfs);
-		SetPixelData spd = {buffer.data(), colw, pixPerOfs, myChartBeginOfs};
-
+		double pixPerOfs = (double)rect.h / (myChartEndOfs - myChartBeginOfs);
+		auto first = gNotes->begin(), last = gNotes->end();
 		if(myMode == DENSITY)
 		{
-			renderDensity(spd, colx);
+			buildDensity(mapNotes, pixPerOfs);
+		}
+		else if(!redrawAll && (changes & bits) == VCM_NOTES_CHANGED)
+		{
+			// Each note has one map note, so only the map notes of the changed rows are rebuilt.
+			// The map notes before and after them are copied from the previous map notes.
+			auto lower = [](const ExpandedNote& n, int row) { return n.row < row; };
+			prefix = (int)(std::lower_bound(first, last, beginRow, lower) - first);
+			suffix = (int)(last - std::lower_bound(first, last, endRow, lower));
+			if(prefix + suffix <= min((int)(last - first), myMapNotes.size()))
+			{
+				mapNotes.reserve((int)(last - first));
+				mapNotes.insert(0, myMapNotes.data(), prefix);
+				buildNotes(mapNotes, pixPerOfs, colx, first + prefix, last - suffix);
+				mapNotes.insert(mapNotes.size(), myMapNotes.end() - suffix, suffix);
+			}
+			else
+			{
+				prefix = suffix = 0;
+				buildNotes(mapNotes, pixPerOfs, colx, first, last);
+			}
 		}
 		else
 		{
-			renderNotes(spd, colx);
+			buildNotes(mapNotes, pixPerOfs, colx, first, last);
 		}
 	}
 
-	// Update the texture strips.
-	for(int i = 0; i < NUM_PIECES; ++i)
+	// Only the pixel rows covered by notes that were added, removed or changed are redrawn.
+	int beginY = 0, endY = MAP_HEIGHT;
+	if(!redrawAll)
 	{
-		uint* buf = buffer.data();
-		auto src = (const uchar*)(buf + i * MAP_WIDTH * TEXTURE_SIZE);
-		myImage.modify(i * MAP_WIDTH, 0, MAP_WIDTH, TEXTURE_SIZE, src);
+		FindDirtyRows(myMapNotes, mapNotes, prefix, suffix, beginY, endY);
+		if(beginY >= endY) return;
+	}
+	myMapNotes.swap(mapNotes);
+	updateIndex();
+
+	memset(myPixels.data() + beginY * MAP_WIDTH, 0, sizeof(uint) * MAP_WIDTH * (endY - beginY));
+	if(myMode == DENSITY)
+	{
+		renderDensity(beginY, endY);
+	}
+	else
+	{
+		renderNotes(beginY, endY);
+	}
+
+	// Update the dirty rows of the texture strips.
+	for(int i = beginY / TEXTURE_SIZE; i <= (endY - 1) / TEXTURE_SIZE; ++i)
+	{
+		int stripY = i * TEXTURE_SIZE;
+		int y1 = max(beginY, stripY), y2 = min(endY, stripY + TEXTURE_SIZE);
+		auto src = (const uchar*)(myPixels.data() + y1 * MAP_WIDTH);
+		myImage.modify(i * MAP_WIDTH, y1 - stripY, MAP_WIDTH, y2 - y1, src);
 	}
 }
 
@@ -373,6 +512,8 @@ void onMouseRelease(MouseRelease& evt)
 
 void tick()
 {
+	VortexProfileZone("minimap tick");
+
 	vec2i size = gSystem->getWindowSize();
 	rect_ = { size.x - 32, 8, 24, size.y - 16 };
 
@@ -402,6 +543,8 @@ void drawRegion(int x, int w, double ofsA, double ofsB, color32 color)
 
 void draw()
 {
+	VortexProfileZone("minimap draw");
+
 	// If the text overlay is open, we hide the minimap to avoid clutter.
 	if(gTextOverlay->isOpen()) return;
 
@@ -472,7 +615,7 @@ void setMode(Mode mode)
 {
 	myMode = mode;
 	gMenubar->update(Menubar::VIEW_MINIMAP);
-	onChanges(VCM_ALL_CHANGES);
+	updateMap(VCM_ALL_CHANGES, 0, INT_MAX);
 }
 
 Minimap::Mode getMode() const
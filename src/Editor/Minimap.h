@@ -2,6 +2,8 @@
 
 #include <Core/Input.h>
 
+#include <Editor/Editor.h>
+
 namespace Vortex {
 
 struct Minimap : public InputHandler
@@ -18,7 +20,7 @@ struct Minimap : public InputHandler
 	virtual Mode getMode() const = 0;
 
 	/// Called by the editor when changes were made to the simfile.
-	virtual void onChanges(int changes) = 0;	
+	virtual void onChanges(const ChangeEvent& event) = 0;
 };
 
 extern Minimap* gMinimap;
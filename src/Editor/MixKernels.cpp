@@ -0,0 +1,550 @@
+#include <Editor/MixKernels.h>
+
+#include <Core/Utils.h>
+#include <Core/Vector.h>
+
+#include <System/Debug.h>
+
+#include <limits.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+// The SSE2 and AVX2 kernels are only available on x86, other processors use the scalar kernels.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIX_KERNELS_X86
+#endif
+
+#ifdef MIX_KERNELS_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif // MIX_KERNELS_X86
+
+namespace Vortex {
+
+// Interpolation weights have 14 bits, so that a pair of weights fits in two signed 16-bit values.
+static const int FRAC_BITS = 14;
+static const int FRAC_ONE = 1 << FRAC_BITS;
+
+// ================================================================================================
+// Shared helpers.
+
+static inline int Saturate(int v)
+{
+	return clamp(v, SHRT_MIN, SHRT_MAX);
+}
+
+static inline int FracOf(int64_t pos)
+{
+	return (int)((pos >> (32 - FRAC_BITS)) & (FRAC_ONE - 1));
+}
+
+static inline int Lerp(int s0, int s1, int frac)
+{
+	return (s0 * (FRAC_ONE - frac) + s1 * frac) >> FRAC_BITS;
+}
+
+// Returns the pair of interpolation weights as two 16-bit values, in the order used by madd.
+static inline int WeightPair(int frac)
+{
+	return (FRAC_ONE - frac) | (frac << 16);
+}
+
+// Loads two consecutive 16-bit samples as a single 32-bit value.
+static inline int LoadPair(const short* p)
+{
+	int v;
+	memcpy(&v, p, sizeof(int));
+	return v;
+}
+
+// ================================================================================================
+// Scalar kernels.
+
+static void InterleaveScalar(short* dst, const short* srcL, const short* srcR, int numFrames, int volume)
+{
+	if(volume >= MixKernels::UNITY_VOLUME)
+	{
+		for(int i = 0; i < numFrames; ++i)
+		{
+			*dst++ = *srcL++;
+			*dst++ = *srcR++;
+		}
+	}
+	else
+	{
+		for(int i = 0; i < numFrames; ++i)
+		{
+			*dst++ = (short)(((*srcL++) * volume) >> 15);
+			*dst++ = (short)(((*srcR++) * volume) >> 15);
+		}
+	}
+}
+
+static void AddInterleavedScalar(short* dst, const short* srcL, const short* srcR, int numFrames)
+{
+	for(int i = 0; i < numFrames; ++i, dst += 2)
+	{
+		dst[0] = (short)Saturate(dst[0] + *srcL++);
+		dst[1] = (short)Saturate(dst[1] + *srcR++);
+	}
+}
+
+static void ResampleScalar(short* dst, int numFrames, const short* src, int srcFrames,
+	int64_t pos, int64_t step)
+{
+	int last = srcFrames - 1;
+	for(int i = 0; i < numFrames; ++i, pos += step, dst += 2)
+	{
+		int index = (int)(pos >> 32);
+		int i0 = min(index, last) * 2;
+		int i1 = min(index + 1, last) * 2;
+		int frac = FracOf(pos);
+		dst[0] = (short)Lerp(src[i0 + 0], src[i1 + 0], frac);
+		dst[1] = (short)Lerp(src[i0 + 1], src[i1 + 1], frac);
+	}
+}
+
+static int AddResampledScalar(short* dst, int numFrames, const short* srcL, const short* srcR,
+	int srcFrames, int64_t pos, int64_t step)
+{
+	int i = 0, last = srcFrames - 1;
+	for(; i < numFrames; ++i, pos += step, dst += 2)
+	{
+		int i0 = (int)(pos >> 32);
+		if(i0 > last) break;
+		int i1 = min(i0 + 1, last);
+		int frac = FracOf(pos);
+		dst[0] = (short)Saturate(dst[0] + Lerp(srcL[i0], srcL[i1], frac));
+		dst[1] = (short)Saturate(dst[1] + Lerp(srcR[i0], srcR[i1], frac));
+	}
+	return i;
+}
+
+static void DeinterleaveScalar(short* dstL, short* dstR, const short* src, int numFrames)
+{
+	for(int i = 0; i < numFrames; ++i)
+	{
+		*dstL++ = *src++;
+		*dstR++ = *src++;
+	}
+}
+
+#ifdef MIX_KERNELS_X86
+
+// ================================================================================================
+// SSE2 kernels.
+
+// Computes (v * volume) >> 15 for eight 16-bit values, with volume below UNITY_VOLUME.
+static inline __m128i ScaleSSE2(__m128i v, __m128i volume)
+{
+	__m128i lo = _mm_mullo_epi16(v, volume);
+	__m128i hi = _mm_mulhi_epi16(v, volume);
+	__m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15);
+	__m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15);
+	return _mm_packs_epi32(a, b);
+}
+
+// Interpolates pairs of samples with pairs of weights, and packs the results to 16-bit values.
+static inline __m128i LerpPairsSSE2(__m128i pairsA, __m128i weightsA, __m128i pairsB, __m128i weightsB)
+{
+	__m128i a = _mm_srai_epi32(_mm_madd_epi16(pairsA, weightsA), FRAC_BITS);
+	__m128i b = _mm_srai_epi32(_mm_madd_epi16(pairsB, weightsB), FRAC_BITS);
+	return _mm_packs_epi32(a, b);
+}
+
+static void InterleaveSSE2(short* dst, const short* srcL, const short* srcR, int numFrames, int volume)
+{
+	int i = 0;
+	bool scale = (volume < MixKernels::UNITY_VOLUME);
+	__m128i vol = _mm_set1_epi16((short)min(volume, SHRT_MAX));
+	for(; i + 8 <= numFrames; i += 8)
+	{
+		__m128i l = _mm_loadu_si128((const __m128i*)(srcL + i));
+		__m128i r = _mm_loadu_si128((const __m128i*)(srcR + i));
+		if(scale)
+		{
+			l = ScaleSSE2(l, vol);
+			r = ScaleSSE2(r, vol);
+		}
+		_mm_storeu_si128((__m128i*)(dst + i * 2 + 0), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128((__m128i*)(dst + i * 2 + 8), _mm_unpackhi_epi16(l, r));
+	}
+	InterleaveScalar(dst + i * 2, srcL + i, srcR + i, numFrames - i, volume);
+}
+
+static void AddInterleavedSSE2(short* dst, const short* srcL, const short* srcR, int numFrames)
+{
+	int i = 0;
+	for(; i + 8 <= numFrames; i += 8)
+	{
+		__m128i l = _mm_loadu_si128((const __m128i*)(srcL + i));
+		__m128i r = _mm_loadu_si128((const __m128i*)(srcR + i));
+		__m128i* out = (__m128i*)(dst + i * 2);
+		__m128i a = _mm_adds_epi16(_mm_loadu_si128(out + 0), _mm_unpacklo_epi16(l, r));
+		__m128i b = _mm_adds_epi16(_mm_loadu_si128(out + 1), _mm_unpackhi_epi16(l, r));
+		_mm_storeu_si128(out + 0, a);
+		_mm_storeu_si128(out + 1, b);
+	}
+	AddInterleavedScalar(dst + i * 2, srcL + i, srcR + i, numFrames - i);
+}
+
+static void ResampleSSE2(short* dst, int numFrames, const short* src, int srcFrames,
+	int64_t pos, int64_t step)
+{
+	int i = 0, last = srcFrames - 1;
+	for(; i + 4 <= numFrames; i += 4)
+	{
+		// Without gather instructions, the frames are collected one by one.
+		int f0[4], f1[4], w[4];
+		for(int k = 0; k < 4; ++k, pos += step)
+		{
+			int index = (int)(pos >> 32);
+			f0[k] = LoadPair(src + min(index, last) * 2);
+			f1[k] = LoadPair(src + min(index + 1, last) * 2);
+			w[k] = WeightPair(FracOf(pos));
+		}
+		__m128i a = _mm_loadu_si128((const __m128i*)f0);
+		__m128i b = _mm_loadu_si128((const __m128i*)f1);
+		__m128i weights = _mm_loadu_si128((const __m128i*)w);
+
+		// Pairs of (frame0, frame1) samples for left and right, per frame.
+		__m128i lo = _mm_unpacklo_epi16(a, b);
+		__m128i hi = _mm_unpackhi_epi16(a, b);
+		__m128i wlo = _mm_unpacklo_epi32(weights, weights);
+		__m128i whi = _mm_unpackhi_epi32(weights, weights);
+		_mm_storeu_si128((__m128i*)(dst + i * 2), LerpPairsSSE2(lo, wlo, hi, whi));
+	}
+	ResampleScalar(dst + i * 2, numFrames - i, src, srcFrames, pos, step);
+}
+
+static int AddResampledSSE2(short* dst, int numFrames, const short* srcL, const short* srcR,
+	int srcFrames, int64_t pos, int64_t step)
+{
+	int i = 0, last = srcFrames - 1;
+	for(; i + 4 <= numFrames && (int)((pos + step * 3) >> 32) < last; i += 4)
+	{
+		int pl[4], pr[4], w[4];
+		for(int k = 0; k < 4; ++k, pos += step)
+		{
+			int index = (int)(pos >> 32);
+			pl[k] = LoadPair(srcL + index);
+			pr[k] = LoadPair(srcR + index);
+			w[k] = WeightPair(FracOf(pos));
+		}
+		__m128i l = _mm_loadu_si128((const __m128i*)pl);
+		__m128i r = _mm_loadu_si128((const __m128i*)pr);
+		__m128i weights = _mm_loadu_si128((const __m128i*)w);
+
+		__m128i lo = _mm_unpacklo_epi32(l, r);
+		__m128i hi = _mm_unpackhi_epi32(l, r);
+		__m128i wlo = _mm_unpacklo_epi32(weights, weights);
+		__m128i whi = _mm_unpackhi_epi32(weights, weights);
+		__m128i* out = (__m128i*)(dst + i * 2);
+		_mm_storeu_si128(out, _mm_adds_epi16(_mm_loadu_si128(out), LerpPairsSSE2(lo, wlo, hi, whi)));
+	}
+	return i + AddResampledScalar(dst + i * 2, numFrames - i, srcL, srcR, srcFrames, pos, step);
+}
+
+// The left samples are the sign extended low halves of each pair, the right samples the high halves.
+// Both fit in 16 bits, so packing them does not saturate.
+static void DeinterleaveSSE2(short* dstL, short* dstR, const short* src, int numFrames)
+{
+	int i = 0;
+	for(; i + 8 <= numFrames; i += 8)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(src + i * 2 + 0));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + i * 2 + 8));
+		__m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+		__m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+		_mm_storeu_si128((__m128i*)(dstL + i), l);
+		_mm_storeu_si128((__m128i*)(dstR + i), r);
+	}
+	DeinterleaveScalar(dstL + i, dstR + i, src + i * 2, numFrames - i);
+}
+
+// ================================================================================================
+// AVX2 kernels.
+
+// Most AVX2 instructions operate on the two 128-bit lanes separately. The unpack and pack steps
+// below keep the frames in order within each lane, so the results can be stored directly.
+
+TARGET_AVX2 static inline __m256i ScaleAVX2(__m256i v, __m256i volume)
+{
+	__m256i lo = _mm256_mullo_epi16(v, volume);
+	__m256i hi = _mm256_mulhi_epi16(v, volume);
+	__m256i a = _mm256_srai_epi32(_mm256_unpacklo_epi16(lo, hi), 15);
+	__m256i b = _mm256_srai_epi32(_mm256_unpackhi_epi16(lo, hi), 15);
+	return _mm256_packs_epi32(a, b);
+}
+
+TARGET_AVX2 static inline __m256i LerpPairsAVX2(__m256i pairsA, __m256i weightsA, __m256i pairsB, __m256i weightsB)
+{
+	__m256i a = _mm256_srai_epi32(_mm256_madd_epi16(pairsA, weightsA), FRAC_BITS);
+	__m256i b = _mm256_srai_epi32(_mm256_madd_epi16(pairsB, weightsB), FRAC_BITS);
+	return _mm256_packs_epi32(a, b);
+}
+
+TARGET_AVX2 static void InterleaveAVX2(short* dst, const short* srcL, const short* srcR, int numFrames, int volume)
+{
+	int i = 0;
+	bool scale = (volume < MixKernels::UNITY_VOLUME);
+	__m256i vol = _mm256_set1_epi16((short)min(volume, SHRT_MAX));
+	for(; i + 16 <= numFrames; i += 16)
+	{
+		__m256i l = _mm256_loadu_si256((const __m256i*)(srcL + i));
+		__m256i r = _mm256_loadu_si256((const __m256i*)(srcR + i));
+		if(scale)
+		{
+			l = ScaleAVX2(l, vol);
+			r = ScaleAVX2(r, vol);
+		}
+		__m256i lo = _mm256_unpacklo_epi16(l, r);
+		__m256i hi = _mm256_unpackhi_epi16(l, r);
+		_mm256_storeu_si256((__m256i*)(dst + i * 2 + 0), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(dst + i * 2 + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	InterleaveSSE2(dst + i * 2, srcL + i, srcR + i, numFrames - i, volume);
+}
+
+TARGET_AVX2 static void AddInterleavedAVX2(short* dst, const short* srcL, const short* srcR, int numFrames)
+{
+	int i = 0;
+	for(; i + 16 <= numFrames; i += 16)
+	{
+		__m256i l = _mm256_loadu_si256((const __m256i*)(srcL + i));
+		__m256i r = _mm256_loadu_si256((const __m256i*)(srcR + i));
+		__m256i lo = _mm256_unpacklo_epi16(l, r);
+		__m256i hi = _mm256_unpackhi_epi16(l, r);
+		__m256i* out = (__m256i*)(dst + i * 2);
+		__m256i a = _mm256_adds_epi16(_mm256_loadu_si256(out + 0), _mm256_permute2x128_si256(lo, hi, 0x20));
+		__m256i b = _mm256_adds_epi16(_mm256_loadu_si256(out + 1), _mm256_permute2x128_si256(lo, hi, 0x31));
+		_mm256_storeu_si256(out + 0, a);
+		_mm256_storeu_si256(out + 1, b);
+	}
+	AddInterleavedSSE2(dst + i * 2, srcL + i, srcR + i, numFrames - i);
+}
+
+TARGET_AVX2 static void ResampleAVX2(short* dst, int numFrames, const short* src, int srcFrames,
+	int64_t pos, int64_t step)
+{
+	int i = 0, last = srcFrames - 1;
+	for(; i + 8 <= numFrames; i += 8)
+	{
+		int i0[8], i1[8], w[8];
+		for(int k = 0; k < 8; ++k, pos += step)
+		{
+			int index = (int)(pos >> 32);
+			i0[k] = min(index, last);
+			i1[k] = min(index + 1, last);
+			w[k] = WeightPair(FracOf(pos));
+		}
+
+		// An interleaved stereo frame is a single 32-bit value, so frames can be gathered.
+		const int* frames = (const int*)src;
+		__m256i a = _mm256_i32gather_epi32(frames, _mm256_loadu_si256((const __m256i*)i0), 4);
+		__m256i b = _mm256_i32gather_epi32(frames, _mm256_loadu_si256((const __m256i*)i1), 4);
+		__m256i weights = _mm256_loadu_si256((const __m256i*)w);
+
+		__m256i lo = _mm256_unpacklo_epi16(a, b);
+		__m256i hi = _mm256_unpackhi_epi16(a, b);
+		__m256i wlo = _mm256_unpacklo_epi32(weights, weights);
+		__m256i whi = _mm256_unpackhi_epi32(weights, weights);
+		_mm256_storeu_si256((__m256i*)(dst + i * 2), LerpPairsAVX2(lo, wlo, hi, whi));
+	}
+	ResampleSSE2(dst + i * 2, numFrames - i, src, srcFrames, pos, step);
+}
+
+TARGET_AVX2 static int AddResampledAVX2(short* dst, int numFrames, const short* srcL, const short* srcR,
+	int srcFrames, int64_t pos, int64_t step)
+{
+	int i = 0, last = srcFrames - 1;
+	for(; i + 8 <= numFrames && (int)((pos + step * 7) >> 32) < last; i += 8)
+	{
+		int index[8], w[8];
+		for(int k = 0; k < 8; ++k, pos += step)
+		{
+			index[k] = (int)(pos >> 32);
+			w[k] = WeightPair(FracOf(pos));
+		}
+
+		// Gathering with a scale of two loads a pair of consecutive samples per index.
+		__m256i indices = _mm256_loadu_si256((const __m256i*)index);
+		__m256i l = _mm256_i32gather_epi32((const int*)srcL, indices, 2);
+		__m256i r = _mm256_i32gather_epi32((const int*)srcR, indices, 2);
+		__m256i weights = _mm256_loadu_si256((const __m256i*)w);
+
+		__m256i lo = _mm256_unpacklo_epi32(l, r);
+		__m256i hi = _mm256_unpackhi_epi32(l, r);
+		__m256i wlo = _mm256_unpacklo_epi32(weights, weights);
+		__m256i whi = _mm256_unpackhi_epi32(weights, weights);
+		__m256i* out = (__m256i*)(dst + i * 2);
+		_mm256_storeu_si256(out, _mm256_adds_epi16(_mm256_loadu_si256(out), LerpPairsAVX2(lo, wlo, hi, whi)));
+	}
+	return i + AddResampledSSE2(dst + i * 2, numFrames - i, srcL, srcR, srcFrames, pos, step);
+}
+
+TARGET_AVX2 static void DeinterleaveAVX2(short* dstL, short* dstR, const short* src, int numFrames)
+{
+	int i = 0;
+	for(; i + 16 <= numFrames; i += 16)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src + i * 2 + 0));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + i * 2 + 16));
+		__m256i l = _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(a, 16), 16), _mm256_srai_epi32(_mm256_slli_epi32(b, 16), 16));
+		__m256i r = _mm256_packs_epi32(_mm256_srai_epi32(a, 16), _mm256_srai_epi32(b, 16));
+		_mm256_storeu_si256((__m256i*)(dstL + i), _mm256_permute4x64_epi64(l, 0xD8));
+		_mm256_storeu_si256((__m256i*)(dstR + i), _mm256_permute4x64_epi64(r, 0xD8));
+	}
+	DeinterleaveSSE2(dstL + i, dstR + i, src + i * 2, numFrames - i);
+}
+
+// ================================================================================================
+// Kernel selection.
+
+static bool HasAVX2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7) return false;
+
+	// The OS must save the AVX registers, otherwise AVX instructions are not usable.
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if(!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static const MixKernels SSE2Kernels =
+{
+	InterleaveSSE2, AddInterleavedSSE2, ResampleSSE2, AddResampledSSE2, DeinterleaveSSE2, "sse2"
+};
+
+static const MixKernels AVX2Kernels =
+{
+	InterleaveAVX2, AddInterleavedAVX2, ResampleAVX2, AddResampledAVX2, DeinterleaveAVX2, "avx2"
+};
+
+#endif // MIX_KERNELS_X86
+
+static const MixKernels ScalarKernels =
+{
+	InterleaveScalar, AddInterleavedScalar, ResampleScalar, AddResampledScalar, DeinterleaveScalar, "scalar"
+};
+
+const MixKernels& MixKernels::get()
+{
+#ifdef MIX_KERNELS_X86
+	static const MixKernels* kernels = HasAVX2() ? &AVX2Kernels : &SSE2Kernels;
+	return *kernels;
+#else
+	return ScalarKernels;
+#endif
+}
+
+const MixKernels& MixKernels::get(const char* name)
+{
+#ifdef MIX_KERNELS_X86
+	if(strcmp(name, "avx2") == 0 && HasAVX2()) return AVX2Kernels;
+	if(strcmp(name, "sse2") == 0) return SSE2Kernels;
+#endif
+	return ScalarKernels;
+}
+
+// ================================================================================================
+// Benchmark.
+
+#ifdef ENABLE_BENCHMARK
+
+// Feeds synthetic stereo buffers through every kernel set, verifies that the output matches the
+// scalar kernels, and logs the throughput of each kernel in frames per second. Returns false if
+// the output of any kernel differs from the scalar kernels.
+bool BenchmarkMixKernels()
+{
+	const int numFrames = 1 << 20;
+	const int blockFrames = 1024;
+	const int iterations = 16;
+
+	Vector<short> srcL(numFrames, 0), srcR(numFrames, 0), interleaved(numFrames * 2, 0);
+	for(int i = 0; i < numFrames; ++i)
+	{
+		srcL[i] = (short)(sin(i * 0.01) * 30000.0 + (int)((i * 7919u) % 1024));
+		srcR[i] = (short)(cos(i * 0.013) * 30000.0 - (int)((i * 104729u) % 1024));
+		interleaved[i * 2 + 0] = srcL[i];
+		interleaved[i * 2 + 1] = srcR[i];
+	}
+
+	Vector<short> reference[5], output(numFrames * 2, 0);
+	const char* names[] = {"scalar", "sse2", "avx2"};
+	const char* kernelNames[] = {"interleave", "addInterleaved", "resample", "addResampled", "deinterleave"};
+
+	int64_t step = (int64_t)(1.37 * (double)MixKernels::ONE_FRAME);
+	int resampledFrames = (int)(((int64_t)numFrames << 32) / step) - 1;
+
+	bool allMatch = true;
+	Debug::blockBegin(Debug::INFO, "mix kernel benchmark");
+	for(auto name : names)
+	{
+		const MixKernels& k = MixKernels::get(name);
+		if(strcmp(k.name, name) != 0) continue;
+
+		for(int kernel = 0; kernel < 5; ++kernel)
+		{
+			double start = Debug::getElapsedTime();
+			for(int it = 0; it < iterations; ++it)
+			{
+				memset(output.data(), 0, output.size() * sizeof(short));
+				for(int pos = 0; pos + blockFrames <= numFrames; pos += blockFrames)
+				{
+					short* dst = output.data() + pos * 2;
+					int64_t srcPos = (int64_t)pos * step;
+					int n = min(blockFrames, resampledFrames - pos);
+					switch(kernel)
+					{
+					case 0: k.interleave(dst, srcL.data() + pos, srcR.data() + pos, blockFrames, 20000); break;
+					case 1: k.addInterleaved(dst, srcL.data() + pos, srcR.data() + pos, blockFrames); break;
+					case 2: if(n > 0) k.resample(dst, n, interleaved.data(), numFrames, srcPos, step); break;
+					case 3: if(n > 0) k.addResampled(dst, n, srcL.data(), srcR.data(), numFrames, srcPos, step); break;
+					case 4: k.deinterleave(output.data() + pos, output.data() + numFrames + pos, interleaved.data() + pos * 2, blockFrames); break;
+					}
+				}
+			}
+			double elapsed = Debug::getElapsedTime(start);
+			double framesPerSec = (double)numFrames * iterations / max(elapsed, 1e-9);
+
+			bool matches = true;
+			if(reference[kernel].empty())
+			{
+				reference[kernel] = output;
+			}
+			else
+			{
+				matches = (memcmp(reference[kernel].data(), output.data(), output.size() * sizeof(short)) == 0);
+			}
+			allMatch = allMatch && matches;
+			Debug::log("%s %s: %.1f Mframes/s%s\n", name, kernelNames[kernel],
+				framesPerSec / 1000000.0, matches ? "" : " (MISMATCH)");
+		}
+	}
+	Debug::blockEnd();
+
+	return allMatch;
+}
+
+#endif // ENABLE_BENCHMARK
+
+}; // namespace Vortex
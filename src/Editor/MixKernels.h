@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Core/Core.h>
+
+namespace Vortex {
+
+// Inner loops of the audio mixer. Each kernel has a scalar, SSE2 and AVX2 implementation, which
+// produce identical output. Sample buffers are either planar (one buffer per channel) or
+// interleaved stereo (left and right samples alternate).
+struct MixKernels
+{
+	/// Fixed point volume that leaves the samples unchanged.
+	static const int UNITY_VOLUME = 1 << 15;
+
+	/// Fixed point position increment of one frame, positions have 32 fractional bits.
+	static const int64_t ONE_FRAME = 1LL << 32;
+
+	/// Writes planar samples to an interleaved buffer, scaled by a volume in [0, UNITY_VOLUME].
+	void (*interleave)(short* dst, const short* srcL, const short* srcR, int numFrames, int volume);
+
+	/// Adds planar samples to an interleaved buffer, saturating the result.
+	void (*addInterleaved)(short* dst, const short* srcL, const short* srcR, int numFrames);
+
+	/// Resamples an interleaved buffer of srcFrames frames to an interleaved buffer, using linear
+	/// interpolation. Output frame i is read at source position pos + i * step. Positions past
+	/// the last source frame are clamped to the last source frame.
+	void (*resample)(short* dst, int numFrames, const short* src, int srcFrames,
+		int64_t pos, int64_t step);
+
+	/// Resamples planar samples of srcFrames frames and adds them to an interleaved buffer,
+	/// saturating the result. Stops at the end of the source; returns the number of frames written.
+	int (*addResampled)(short* dst, int numFrames, const short* srcL, const short* srcR,
+		int srcFrames, int64_t pos, int64_t step);
+
+	/// Splits an interleaved stereo buffer into planar samples.
+	void (*deinterleave)(short* dstL, short* dstR, const short* src, int numFrames);
+
+	/// Name of the instruction set used by the kernels.
+	const char* name;
+
+	/// Returns the fastest kernels supported by the processor.
+	static const MixKernels& get();
+
+	/// Returns the kernels for a specific instruction set, "scalar", "sse2" or "avx2". If the
+	/// instruction set is not supported by the processor, the scalar kernels are returned.
+	static const MixKernels& get(const char* name);
+};
+
+}; // namespace Vortex
@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <stdint.h>
 #include <math.h>
+#include <algorithm>
 
 #include <Core/Vector.h>
 #include <Core/Reference.h>
@@ -19,14 +20,20 @@
 
 #include <Editor/ConvertToOgg.h>
 #include <Editor/Editor.h>
+#include <Editor/Menubar.h>
 #include <Editor/Common.h>
 #include <Editor/TextOverlay.h>
+#include <Editor/Waveform.h>
+#include <Editor/MixKernels.h>
+#include <Editor/TimeStretch.h>
+#include <Editor/SoundCache.h>
 
 #include <System/File.h>
 #include <System/Debug.h>
 #include <System/Thread.h>
 #include <System/System.h>
 #include <System/Mixer.h>
+#include <System/Profiler.h>
 
 namespace Vortex {
 
@@ -34,6 +41,7 @@ struct TickData
 {
 	Sound sound;
 	Vector<int> frames;
+	Vector<int> rows;
 	bool enabled;
 };
 
@@ -47,7 +55,9 @@ enum LoadState { LOADING_ALLOCATING_AND_READING, LOADING_ALLOCATED_AND_READING,
 struct MusicImpl : public Music, public MixSource {
 
 Mixer* myMixer;
+const MixKernels* myKernels;
 Sound mySamples;
+TimeStretch myStretch;
 double myPlayTimer;
 TickData myBeatTick, myNoteTick;
 String myTitle, myArtist;
@@ -57,6 +67,9 @@ int myTickOffsetMs;
 double myPlayPosition;
 double myPlayStartTime;
 bool myIsPaused, myIsMuted;
+bool myPreservePitch;
+bool myUseSoundCache;
+int mySoundCacheMb;
 LoadState myLoadState;
 Reference<InfoBoxWithProgress> myInfoBox;
 
@@ -76,6 +89,7 @@ OggConversionThread* myOggConversionThread;
 MusicImpl()
 {
 	myMixer = Mixer::create();
+	myKernels = &MixKernels::get();
 
 	myMusicSpeed = 100;
 	myMusicVolume = 100;
@@ -84,6 +98,9 @@ MusicImpl()
 	myPlayStartTime = 0.0;
 	myIsPaused = true;
 	myIsMuted = false;
+	myPreservePitch = false;
+	myUseSoundCache = true;
+	mySoundCacheMb = 2048;
 	myLoadState = LOADING_DONE;
 
 	myBeatTick.enabled = false;
@@ -110,7 +127,11 @@ void loadSettings(XmrNode& settings)
 	{
 		audio->get("musicVolume", &myMusicVolume);
 		audio->get("tickOffsetMs", &myTickOffsetMs);
+		audio->get("preservePitch", &myPreservePitch);
+		audio->get("soundCache", &myUseSoundCache);
+		audio->get("soundCacheMb", &mySoundCacheMb);
 	}
+	SoundCache::configure(myUseSoundCache, mySoundCacheMb);
 }
 
 void saveSettings(XmrNode& settings)
@@ -119,6 +140,9 @@ void saveSettings(XmrNode& settings)
 
 	audio->addAttrib("musicVolume", (long)myMusicVolume);
 	audio->addAttrib("tickOffsetMs", (long)myTickOffsetMs);
+	audio->addAttrib("preservePitch", myPreservePitch);
+	audio->addAttrib("soundCache", myUseSoundCache);
+	audio->addAttrib("soundCacheMb", (long)mySoundCacheMb);
 }
 
 // ================================================================================================
@@ -130,6 +154,7 @@ void unload()
 
 	myMixer->close();
 
+	if(gWaveform) gWaveform->unloadMusic();
 	mySamples.clear();
 	myTitle.clear();
 
@@ -159,6 +184,7 @@ void load()
 	{
 		myLoadState = LOADING_ALLOCATING_AND_READING;
 
+		myStretch.setup(mySamples.getFrequency());
 		myMixer->open(this, mySamples.getFrequency());
 
 		auto box = myInfoBox.create();
@@ -181,48 +207,35 @@ void WriteTickSamples(short* dst, int startFrame, int numFrames, const TickData&
 		startFrame = (int)((int64_t)startFrame * 100 / rate);
 	}
 
-	const short* srcL = tick.sound.samplesL() + startFrame;
-	const short* srcR = tick.sound.samplesR() + startFrame;
+	const short* srcL = tick.sound.samplesL();
+	const short* srcR = tick.sound.samplesR();
+	int srcFrames = tick.sound.getNumFrames();
 
 	if(rate == 100)
 	{
-		int n = min(numFrames, tick.sound.getNumFrames() - startFrame);
-		for(int i = 0; i < n; ++i)
-		{
-			*dst++ = min(max(*dst + *srcL++, SHRT_MIN), SHRT_MAX);
-			*dst++ = min(max(*dst + *srcR++, SHRT_MIN), SHRT_MAX);
-		}
+		int n = min(numFrames, srcFrames - startFrame);
+		if(n > 0) myKernels->addInterleaved(dst, srcL + startFrame, srcR + startFrame, n);
 	}
 	else
 	{
-		int idx = 0;
-		double srcPos = 0.0;
-		const int tickEndPos = tick.sound.getNumFrames() - startFrame;
-		const double srcDelta = 100.0 / (double)rate;
-		for(; numFrames > 0 && idx < tickEndPos; --numFrames)
-		{
-			const float frac = (float)(srcPos - floor(srcPos));
-
-			float sampleL = lerp((float)srcL[idx], (float)srcL[idx + 1], frac);
-			float sampleR = lerp((float)srcR[idx], (float)srcR[idx + 1], frac);
-			
-			*dst++ = min(max(*dst + (short)sampleL, SHRT_MIN), SHRT_MAX);
-			*dst++ = min(max(*dst + (short)sampleR, SHRT_MIN), SHRT_MAX);
-
-			srcPos += srcDelta;
-			idx = (int)srcPos;
-		}
+		int64_t srcPos = (int64_t)startFrame * MixKernels::ONE_FRAME;
+		int64_t srcDelta = MixKernels::ONE_FRAME * 100 / rate;
+		myKernels->addResampled(dst, numFrames, srcL, srcR, srcFrames, srcPos, srcDelta);
 	}
 }
 
-void WriteTicks(short* buf, int frames, const TickData& tick, int rate)
+void WriteTicks(short* buf, int frames, const TickData& tick, int rate, bool stretched)
 {
 	int playPos = (int)myPlayPosition;
 	int count = tick.frames.size();
 	const int* ticks = tick.frames.data();
 
+	// If the music is time-stretched, the buffer is in output frames instead of source frames.
+	int tickLength = tick.sound.getNumFrames();
+	if(stretched) tickLength = (int)((int64_t)tickLength * rate / 100);
+
 	// Jump forward to the first audible tick.
-	int first = 0, firstAudibleTickPos = playPos - tick.sound.getNumFrames();
+	int first = 0, firstAudibleTickPos = playPos - tickLength;
 	while(first < count && ticks[first] < firstAudibleTickPos) ++first;
 
 	// Write all ticks that intersect the current buffer.
@@ -230,6 +243,7 @@ void WriteTicks(short* buf, int frames, const TickData& tick, int rate)
 	for(int i = first; i < count; ++i)
 	{
 		int beginFrame = tick.frames[i] - playPos;
+		if(stretched) beginFrame = (int)((int64_t)beginFrame * 100 / rate);
 		if(beginFrame == curFrame) continue; // avoid double ticks for jumps.
 		if(beginFrame > frames) break;
 
@@ -238,7 +252,7 @@ void WriteTicks(short* buf, int frames, const TickData& tick, int rate)
 		short* dst = buf + dstPos * 2;
 		int dstFrames = frames - dstPos;
 
-		WriteTickSamples(dst, srcPos, frames - dstPos, tick, rate);
+		WriteTickSamples(dst, srcPos, frames - dstPos, tick, stretched ? 100 : rate);
 
 		curFrame = beginFrame;
 	}
@@ -266,23 +280,9 @@ void WriteSourceFrames(short* buffer, int frames, int64_t srcPos)
 		int n = (int)min(max(mySamples.getNumFrames() - srcPos, (int64_t)0), (int64_t)framesLeft);
 		const short* srcL = mySamples.samplesL() + srcPos;
 		const short* srcR = mySamples.samplesR() + srcPos;
-		if(musicVolume == 100)
-		{
-			for(int i = 0; i < n; ++i)
-			{
-				*dst++ = *srcL++;
-				*dst++ = *srcR++;
-			}
-		}
-		else
-		{
-			int vol = ((musicVolume * musicVolume) << 15) / (100 * 100);
-			for(int i = 0; i < n; ++i)
-			{
-				*dst++ = (short)(((*srcL++) * vol) >> 15);
-				*dst++ = (short)(((*srcR++) * vol) >> 15);
-			}
-		}
+		int vol = ((musicVolume * musicVolume) << 15) / (100 * 100);
+		myKernels->interleave(dst, srcL, srcR, n, vol);
+		dst += n * MIX_CHANNELS;
 		framesLeft -= n;
 	}
 
@@ -294,8 +294,30 @@ void WriteSourceFrames(short* buffer, int frames, int64_t srcPos)
 
 	// Write beat and step ticks.
 	int rate = gMusic->getSpeed();
-	if(myBeatTick.enabled) WriteTicks(buffer, frames, myBeatTick, rate);
-	if(myNoteTick.enabled) WriteTicks(buffer, frames, myNoteTick, rate);
+	if(myBeatTick.enabled) WriteTicks(buffer, frames, myBeatTick, rate, false);
+	if(myNoteTick.enabled) WriteTicks(buffer, frames, myNoteTick, rate, false);
+}
+
+void WriteStretchedFrames(short* buffer, int frames)
+{
+	int musicVolume = gMusic->getVolume();
+	int rate = gMusic->getSpeed();
+
+	// Time-stretch the music samples, which keeps them at their original pitch.
+	if(mySamples.isAllocated() && musicVolume > 0 && !myIsMuted)
+	{
+		int vol = ((musicVolume * musicVolume) << 15) / (100 * 100);
+		myStretch.process(buffer, frames, mySamples.samplesL(), mySamples.samplesR(),
+			mySamples.getNumFrames(), (double)rate / 100.0, vol);
+	}
+	else
+	{
+		memset(buffer, 0, sizeof(short) * MIX_CHANNELS * frames);
+	}
+
+	// Write beat and step ticks, which are not resampled either.
+	if(myBeatTick.enabled) WriteTicks(buffer, frames, myBeatTick, rate, true);
+	if(myNoteTick.enabled) WriteTicks(buffer, frames, myNoteTick, rate, true);
 }
 
 void writeFrames(short* buffer, int frames) override
@@ -307,6 +329,12 @@ void writeFrames(short* buffer, int frames) override
 		int64_t srcPos = llround(myPlayPosition);
 		WriteSourceFrames(buffer, frames, srcPos);
 	}
+	else if(myPreservePitch)
+	{
+		// Source and target samplerate are equal, but the music is time-stretched.
+		srcAdvance *= (double)myMusicSpeed / 100.0;
+		WriteStretchedFrames(buffer, frames);
+	}
 	else
 	{
 		double rate = (double)myMusicSpeed / 100.0;
@@ -319,30 +347,8 @@ void writeFrames(short* buffer, int frames) override
 		WriteSourceFrames(myMixBuffer.data(), tmpFrames, srcPos);
 
 		// Interpolate to the target samplerate.
-		double tmpPos = 0.0;
-		const short* tmpL = myMixBuffer.data() + 0;
-		const short* tmpR = myMixBuffer.data() + 1;
-		int tmpEnd = tmpFrames - 1;
-
-		short* dst = buffer;
-		for(int i = 0; i < frames; ++i)
-		{
-			int index0 = min((int)tmpPos, tmpEnd);
-			int index1 = min(index0 + 1, tmpEnd);
-			index0 *= MIX_CHANNELS;
-			index1 *= MIX_CHANNELS;
-
-			float w1 = (float)(tmpPos - floor(tmpPos));
-			float w0 = 1.0f - w1;
-
-			float l = (float)tmpL[index0] * w0 + (float)tmpL[index1] * w1;
-			float r = (float)tmpR[index0] * w0 + (float)tmpR[index1] * w1;
-
-			*dst++ = (short)min(max((int)l, SHRT_MIN), SHRT_MAX);
-			*dst++ = (short)min(max((int)r, SHRT_MIN), SHRT_MAX);
-
-			tmpPos += rate;
-		}
+		int64_t tmpDelta = (int64_t)llround(rate * (double)MixKernels::ONE_FRAME);
+		myKernels->resample(buffer, frames, myMixBuffer.data(), tmpFrames, 0, tmpDelta);
 	}
 
 	myPlayPosition += srcAdvance;
@@ -442,6 +448,7 @@ void resumeStream()
 	if(!myIsPaused)
 	{
 		myPlayPosition = myPlayStartTime * (double)mySamples.getFrequency();
+		myStretch.reset(myPlayPosition);
 		myPlayTimer = Debug::getElapsedTime();
 		myMixer->resume();
 	}
@@ -449,6 +456,8 @@ void resumeStream()
 
 void tick()
 {
+	VortexProfileZone("music tick");
+
 	if(myLoadState != LOADING_DONE && myInfoBox)
 	{
 		if(mySamples.getLoadingProgress() > 0)
@@ -459,6 +468,11 @@ void tick()
 		{
 			myInfoBox->setTime(mySamples.getLoadingTime());
 		}
+		double throughput = mySamples.getLoadingThroughput();
+		if(throughput > 0.0)
+		{
+			myInfoBox->left = Str::fmt("Loading music (%1 MB/s)...").arg(throughput, 0, 0);
+		}
 	}
 
 	if(myLoadState == LOADING_ALLOCATING_AND_READING)
@@ -631,18 +645,34 @@ bool hasNoteTick()
 	return myNoteTick.enabled;
 }
 
+void togglePreservePitch()
+{
+	interruptStream();
+	myPreservePitch = !myPreservePitch;
+	resumeStream();
+	gMenubar->update(Menubar::AUDIO_PRESERVE_PITCH);
+	HudNote("Preserve pitch: %s", myPreservePitch ? "on" : "off");
+}
+
+bool hasPreservePitch()
+{
+	return myPreservePitch;
+}
+
 // ================================================================================================
 // MusicImpl :: handling of external changes.
 
-void updateBeatTicks()
+// Only the ticks at or after firstRow are recomputed, the ticks before it are kept.
+void updateBeatTicks(int firstRow = 0)
 {
-	myBeatTick.frames.clear();
+	int keep = min(myBeatTick.frames.size(), (firstRow + ROWS_PER_BEAT - 1) / ROWS_PER_BEAT);
+	myBeatTick.frames.resize(keep);
 
 	double freq = (double)mySamples.getFrequency();
 	double ofs = myTickOffsetMs / 1000.0;
 
 	TempoTimeTracker tracker(gTempo->getTimingData());
-	for(int row = 0, end = gSimfile->getEndRow(); row < end; row += ROWS_PER_BEAT)
+	for(int row = keep * ROWS_PER_BEAT, end = gSimfile->getEndRow(); row < end; row += ROWS_PER_BEAT)
 	{
 		double time = tracker.advance(row);
 		int frame = (int)((time + ofs) * freq);
@@ -650,41 +680,49 @@ void updateBeatTicks()
 	}
 }
 
-void updateNoteTicks()
+void updateNoteTicks(int firstRow = 0)
 {
-	myNoteTick.frames.clear();
+	auto& rows = myNoteTick.rows;
+	int keep = (int)(std::lower_bound(rows.begin(), rows.end(), firstRow) - rows.begin());
+	myNoteTick.frames.resize(keep);
+	rows.resize(keep);
 
 	double freq = (double)mySamples.getFrequency();
 	double ofs = myTickOffsetMs / 1000.0;
 
-	for(auto& note : *gNotes)
+	// Notes are sorted by row, so the first note of which the tick is recomputed can be searched.
+	auto note = gNotes->begin(), end = gNotes->end();
+	note = std::lower_bound(note, end, firstRow,
+		[](const ExpandedNote& n, int row) { return n.row < row; });
+	for(; note != end; ++note)
 	{
-		if(!(note.isMine | note.isWarped | (note.type == NOTE_FAKE)))
+		if(!(note->isMine | note->isWarped | (note->type == NOTE_FAKE)))
 		{
-			int frame = (int)((note.time + ofs) * freq);
+			int frame = (int)((note->time + ofs) * freq);
 			myNoteTick.frames.push_back(frame);
+			rows.push_back(note->row);
 		}
 	}
 }
 
-void onChanges(int changes)
+void onChanges(const ChangeEvent& event)
 {
 	const int bits = VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED | VCM_END_ROW_CHANGED | VCM_CHART_CHANGED;
 
+	int changes = event.changes;
 	if (changes & bits)
 	{
 		if (changes & VCM_CHART_CHANGED) interruptStream();
 
-		if (changes & VCM_TEMPO_CHANGED)
-		{
-			updateNoteTicks();
-			updateBeatTicks();
-		}
-		else
-		{
-			if (changes & VCM_NOTES_CHANGED) updateNoteTicks();
-			if (changes & VCM_END_ROW_CHANGED) updateBeatTicks();
-		}
+		// The ticks before the first changed row are still valid.
+		int noteRow = INT_MAX, beatRow = INT_MAX;
+		if (changes & (VCM_NOTES_CHANGED | VCM_TEMPO_CHANGED)) noteRow = event.beginRow;
+		if (changes & VCM_TEMPO_CHANGED) beatRow = event.beginRow;
+		if (changes & VCM_END_ROW_CHANGED) beatRow = 0;
+		if (changes & VCM_CHART_CHANGED) noteRow = beatRow = 0;
+
+		if (noteRow != INT_MAX) updateNoteTicks(noteRow);
+		if (beatRow != INT_MAX) updateBeatTicks(beatRow);
     
 		if (changes & VCM_CHART_CHANGED) resumeStream();
 	}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Editor/Sound.h>
+#include <Editor/Editor.h>
 
 namespace Vortex {
 
@@ -14,7 +15,7 @@ struct Music
 	virtual void tick() = 0;
 
 	/// Called by the editor when changes were made to the simfile.
-	virtual void onChanges(int changes) = 0;
+	virtual void onChanges(const ChangeEvent& event) = 0;
 
 	/// Destroys the audio mixer and unloads the current music.
 	virtual void unload() = 0;
@@ -49,6 +50,13 @@ struct Music
 	/// Returns the playback speed of the audio mixer [10-400%].
 	virtual int getSpeed() = 0;
 
+	/// Enables/disables time-stretching, which keeps the pitch of the music unchanged at speeds
+	/// other than 100%.
+	virtual void togglePreservePitch() = 0;
+
+	/// Returns true if time-stretching is enabled, false otherwise.
+	virtual bool hasPreservePitch() = 0;
+
 	/// Enables/disables the beat tick sound.
 	virtual void toggleBeatTick() = 0;
 
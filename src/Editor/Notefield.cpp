@@ -10,12 +10,14 @@
 #include <Core/Utils.h>
 #include <Core/StringUtils.h>
 #include <Core/QuadBatch.h>
+#include <Core/TextureAtlas.h>
 #include <Core/Xmr.h>
 #include <Core/ImageLoader.h>
 #include <Core/Text.h>
 
 #include <System/System.h>
 #include <System/File.h>
+#include <System/Profiler.h>
 
 #include <Simfile/TimingData.h>
 #include <Simfile/SegmentGroup.h>
@@ -47,6 +49,11 @@ static int RoundUp(int value, int multiple)
 	return ((value + multiple - 1) / multiple) * multiple;
 }
 
+// Draw list layers of the notefield sprites, in the order they are drawn. The layers keep the
+// notes on top of the receptors and the glow on top of the notes, even if they share a texture.
+// The sprites of a layer share an atlas page, so the notefield takes one draw call per layer.
+enum DrawLayer { LAYER_RECEPTORS, LAYER_NOTES, LAYER_GLOW, LAYER_INTERFACE };
+
 struct TweakInfoBox : public InfoBox
 {
 	void draw(recti r);
@@ -115,13 +122,16 @@ struct DrawPosHelper
 struct NotefieldImpl : public Notefield {
 
 Texture mySongBg;
-Texture mySelectionTex;
-Texture mySnapIconsTex;
 Texture myTempoIconsTex;
-Texture myNoteLabelsTex;
+
+// The interface sprites are part of the shared texture atlas.
+TextureAtlas::Region mySelectionTex;
+TextureAtlas::Region mySnapIconsTex;
+TextureAtlas::Region myNoteLabelsTex;
 
 BatchSprite mySnapIcons[NUM_SNAP_TYPES];
 BatchSprite myNoteLabels[2];
+BatchSprite mySelectionBox;
 
 Reference<TweakInfoBox> myTweakInfoBox;
 
@@ -136,6 +146,14 @@ bool myShowBeatLines;
 bool myShowNotes;
 bool myShowSongPreview;
 
+// Positions of the note labels and selection boxes, which are drawn after the notes.
+struct NoteMarker { int x, y, index; };
+Vector<NoteMarker> myNoteLabelPos;
+Vector<NoteMarker> mySelectionPos;
+
+// Number of visible notes found by the last full scan, so the scan is not optimized out.
+int myNumScannedVisibleNotes;
+
 // ================================================================================================
 // NotefieldImpl :: constructor and destructor.
 
@@ -153,12 +171,20 @@ NotefieldImpl()
 	myShowNotes = true;
 	myShowSongPreview = false;
 
-	mySelectionTex = Texture("assets/selection box.png", true);
-	mySnapIconsTex = Texture("assets/icons snap.png", false);
-	myNoteLabelsTex = Texture("assets/note labels.png", false);
+	auto& atlas = TextureAtlas::shared();
+	atlas.add("assets/selection box.png", mySelectionTex);
+	atlas.add("assets/icons snap.png", mySnapIconsTex);
+	atlas.add("assets/note labels.png", myNoteLabelsTex);
 
 	BatchSprite::init(mySnapIcons, NUM_SNAP_TYPES, 4, 4, 32, 32);
 	BatchSprite::init(myNoteLabels, 2, 2, 1, 32, 32);
+	for(auto& spr : mySnapIcons) spr.mapUVs(mySnapIconsTex.uvs);
+	for(auto& spr : myNoteLabels) spr.mapUVs(myNoteLabelsTex.uvs);
+
+	mySelectionBox = BatchSprite(mySelectionTex.rect.w, mySelectionTex.rect.h);
+	mySelectionBox.mapUVs(mySelectionTex.uvs);
+
+	myNumScannedVisibleNotes = 0;
 }
 
 // ================================================================================================
@@ -229,6 +255,8 @@ int getBgAlpha()
 
 void draw()
 {
+	VortexProfileZone("notefield draw");
+
 	int cx = CenterX(gView->getRect());
 	int scale = gView->getNoteScale();
 	bool drawWaveform = myShowWaveform && gView->isTimeBased();
@@ -280,15 +308,24 @@ void draw()
 	if(drawWaveform) gWaveform->drawPeaks();
 	if(gTempoBoxes->hasShowBoxes()) drawStopsAndWarps();
 
+	// The sprites are recorded as a draw list, which draws all noteskin sprites and then all
+	// interface sprites, instead of switching textures in between.
+	Renderer::beginDrawList();
+
 	drawReceptors();
 	drawSnapDiamonds();
 
 	if(gChart->isOpen())
 	{
 		if(myShowNotes) drawNotes();
+		if(myShowNotes && gEditor->isProfilerVisible()) scanAllNotes();
 		if(!gMusic->isPaused()) drawReceptorGlow();
 	}
 
+	Renderer::endDrawList();
+
+	drawSnapQuantization();
+
 	if(myShowSongPreview) drawSongPreviewArea();
 
 	gEditing->drawGhostNotes();
@@ -514,6 +551,7 @@ void drawReceptors()
 	{
 		auto noteskin = gNoteskin->get();
 
+		Renderer::setDrawLayer(LAYER_RECEPTORS);
 		Renderer::resetColor();
 		Renderer::bindShader(Renderer::SH_TEXTURE);
 		Renderer::bindTexture(noteskin->recepTex.handle());
@@ -550,6 +588,7 @@ void drawReceptorGlow()
 	double time = gView->getCursorTime();
 	auto prevNotes = gNotes->getNotesBeforeTime(time);
 
+	Renderer::setDrawLayer(LAYER_GLOW);
 	Renderer::resetColor();
 	Renderer::bindShader(Renderer::SH_TEXTURE);
 	Renderer::bindTexture(noteskin->glowTex.handle());
@@ -579,9 +618,10 @@ void drawSnapDiamonds()
 	auto coords = gView->getReceptorCoords();
 	int x[2] = {coords.xl, coords.xr};
 
+	Renderer::setDrawLayer(LAYER_INTERFACE);
 	Renderer::resetColor();
 	Renderer::bindShader(Renderer::SH_TEXTURE);
-	Renderer::bindTexture(mySnapIconsTex.handle());
+	Renderer::bindTexture(mySnapIconsTex.page.handle());
 
 	// Row snap diamonds.
 	auto batch = Renderer::batchT();
@@ -591,8 +631,14 @@ void drawSnapDiamonds()
 		mySnapIcons[snapType].draw(&batch, vx, myY);
 	}
 	batch.flush();
+}
 
-	// Snap quantization
+void drawSnapQuantization()
+{
+	auto coords = gView->getReceptorCoords();
+	int x[2] = {coords.xl, coords.xr};
+
+	// Snap quantization, drawn on top of the snap diamonds.
 	if (gView->getSnapType() != ST_NONE)
 	{
 		TextStyle textStyle;
@@ -612,6 +658,8 @@ void drawSnapDiamonds()
 
 void drawNotes()
 {
+	VortexProfileZone("notefield notes");
+
 	const int numCols = gStyle->getNumCols();
 	const int centerX = gView->getRect().x + gView->getWidth() / 2;
 	const int scale = gView->getNoteScale();
@@ -620,18 +668,31 @@ void drawNotes()
 
 	auto noteskin = gNoteskin->get();
 
+	Renderer::setDrawLayer(LAYER_NOTES);
 	Renderer::resetColor();
 	Renderer::bindShader(Renderer::SH_TEXTURE);
 	Renderer::bindTexture(noteskin->noteTex.handle());
 
 	int targetY = gView->getNotefieldCoords().y;
 
-	// Render arrows/holds/mines interleaved, so the z-order is correct.
-	bool hasLabels = false;	
+	// Only visit the notes that overlap the visible rows, including holds that start above the
+	// screen. The row range is slightly wider than the screen, the notes are still clipped by y.
+	double firstTor = gView->yToOffset(-32), lastTor = gView->yToOffset(maxY);
+	if(firstTor > lastTor) swapValues(firstTor, lastTor);
+	int beginRow = gView->offsetToRow(firstTor) - 1;
+	int endRow = gView->offsetToRow(lastTor) + 1;
+	auto visibleNotes = gNotes->getNotesOverlapping(beginRow, endRow);
+
+	// Render arrows/holds/mines interleaved, so the z-order is correct. The labels and selection
+	// boxes use different textures, their positions are collected in the same pass.
+	myNoteLabelPos.clear();
+	mySelectionPos.clear();
 	auto batch = Renderer::batchT();
 	DrawPosHelper drawPos;
-	for(auto& note : *gNotes)
+	for(auto notePtr : visibleNotes)
 	{
+		auto& note = *notePtr;
+
 		// Determine the y-position of the note.
 		int y = drawPos.get(note.row, note.time), by;
 		if(note.row == note.endrow)
@@ -643,6 +704,21 @@ void drawNotes()
 			by = drawPos.get(note.endrow, note.endtime);
 		}
 
+		int col = note.col, x = myColX[col];
+
+		// Indicator sprites for fake notes and lift notes, and selection boxes.
+		if(y >= -32 && y <= maxY)
+		{
+			if(note.type == NOTE_LIFT || note.type == NOTE_FAKE)
+			{
+				myNoteLabelPos.push_back({x, y, note.type == NOTE_FAKE});
+			}
+			if(note.isSelected)
+			{
+				mySelectionPos.push_back({x, y, 0});
+			}
+		}
+
 		// Simulate chart preview. We want to not show arrows that go past the targets (mines go past the targets in Stepmania, so we keep those.)
 		if (!gMusic->isPaused() && gView->hasChartPreview()
 			&& (targetY > by != gView->hasReverseScroll()) && note.type != NOTE_MINE)
@@ -654,7 +730,6 @@ void drawNotes()
 		if(max(y, by) < -32 || min(y, by) > maxY) continue;
 
 		int rowtype = ToRowType(note.row);
-		int col = note.col, x = myColX[col];
 
 		// Body and tail for holds.
 		if(note.endrow > note.row)
@@ -698,41 +773,54 @@ void drawNotes()
 		case NOTE_FAKE: {
 			int index = (note.player * numCols + note.col) * NUM_ROW_TYPES + rowtype;
 			noteskin->note[index].draw(&batch, x, y);
-			hasLabels = true;
 			break; }
 		}
 	}
 	batch.flush();
 
 	// Draw indicator sprites for fake notes and lift notes.
-	Renderer::bindTexture(myNoteLabelsTex.handle());
-	batch = Renderer::batchT();
-	for(auto& note : *gNotes)
+	Renderer::setDrawLayer(LAYER_INTERFACE);
+	if(myNoteLabelPos.size())
 	{
-		if(note.type == NOTE_LIFT || note.type == NOTE_FAKE)
+		Renderer::bindTexture(myNoteLabelsTex.page.handle());
+		batch = Renderer::batchT();
+		for(auto& label : myNoteLabelPos)
 		{
-			int y = drawPos.get(note.row, note.time);
-			if(y < -32 || y > maxY) continue;
-			int col = note.col, x = myColX[col];
-			myNoteLabels[note.type == NOTE_FAKE].draw(&batch, x, y);
+			myNoteLabels[label.index].draw(&batch, label.x, label.y);
 		}
+		batch.flush();
 	}
-	batch.flush();
 
 	// Draw selection boxes over the selected notes.
-	Renderer::bindTexture(mySelectionTex.handle());
-	batch = Renderer::batchT();
-	BatchSprite select(mySelectionTex.size().x, mySelectionTex.size().y);
-	for(auto& note : *gNotes)
+	if(mySelectionPos.size())
 	{
-		if(note.isSelected)
+		Renderer::bindTexture(mySelectionTex.page.handle());
+		batch = Renderer::batchT();
+		for(auto& box : mySelectionPos)
 		{
-			int y = drawPos.get(note.row, note.time);
-			if(y < -32 || y > maxY) continue;
-			select.draw(&batch, myColX[note.col], (int)y);
+			mySelectionBox.draw(&batch, box.x, box.y);
 		}
+		batch.flush();
 	}
-	batch.flush();
+}
+
+// Tests the position of every note, which is what drawNotes did for every note before culling was
+// added. This only runs while the profiler overlay is shown, so the "notefield full scan" zone can
+// be compared with the "notefield notes" zone in the same build.
+void scanAllNotes()
+{
+	VortexProfileZone("notefield full scan");
+
+	DrawPosHelper drawPos;
+	const int maxY = gView->getHeight() + 32;
+	int numVisible = 0;
+	for(auto& note : *gNotes)
+	{
+		int y = drawPos.get(note.row, note.time);
+		int by = drawPos.get(note.endrow, note.endtime);
+		numVisible += (max(y, by) >= -32 && min(y, by) <= maxY);
+	}
+	myNumScannedVisibleNotes = numVisible;
 }
 
 void drawGhostNote(const Note& n)
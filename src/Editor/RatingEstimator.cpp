@@ -9,8 +9,11 @@
 #include <Managers/NoteMan.h>
 
 #include <Simfile/TimingData.h>
+#include <Simfile/Chart.h>
+#include <Simfile/Notes.h>
 
 #include <algorithm>
+#include <limits.h>
 
 namespace Vortex {
 
@@ -22,6 +25,7 @@ enum Constants
 };
 
 RatingEstimator::RatingEstimator(const char* databaseFile)
+	: myWeights(nullptr)
 {
 	bool success;
 	Vector<double> values;
@@ -41,17 +45,47 @@ RatingEstimator::~RatingEstimator()
 	delete[] myWeights;
 }
 
-static Vector<double> CalcDensities()
+// Returns the times of the notes of a chart, excluding mines and warped notes.
+static Vector<double> GetNoteTimes(const NoteList& notes, const TimingData& timing)
 {
-	Vector<double> stamps, out;
-	TempoTimeTracker tracker(gTempo->getTimingData());
-	for(auto& n : *gNotes)
+	Vector<double> stamps;
+	TempoTimeTracker tracker(timing);
+	auto note = notes.begin(), noteEnd = notes.end();
+	auto addNotes = [&](int endRow, bool inclusive, bool isWarped)
 	{
-		if(!(n.isMine | n.isWarped))
+		for(; note != noteEnd && (note->row < endRow || (inclusive && note->row == endRow)); ++note)
 		{
-			stamps.push_back(tracker.advance(n.row));
+			if(note->type != NOTE_MINE && !isWarped)
+			{
+				stamps.push_back(tracker.advance(note->row));
+			}
+		}
+	};
+
+	// Same rule as the note manager: notes inside a warp are warped, except on the row where the
+	// warp ends, and notes after the last event are never warped.
+	auto& events = timing.events;
+	bool insideWarp = false;
+	for(auto it = events.begin(); it != events.end() && note != noteEnd; ++it)
+	{
+		if(insideWarp)
+		{
+			addNotes(it->row, false, true);
+		}
+		else
+		{
+			addNotes(it->row, true, false);
 		}
+		insideWarp = (it->spr == 0.0);
 	}
+	addNotes(INT_MAX, true, false);
+
+	return stamps;
+}
+
+static Vector<double> CalcDensities(const Vector<double>& stamps)
+{
+	Vector<double> out;
 
 	// List densities per second of song.
 	Vector<double> densities;
@@ -104,7 +138,28 @@ inline int getDensityBin(double density)
 
 double RatingEstimator::estimateRating()
 {
-	Vector<double> densities = CalcDensities();
+	Vector<double> stamps;
+	TempoTimeTracker tracker(gTempo->getTimingData());
+	for(auto& n : *gNotes)
+	{
+		if(!(n.isMine | n.isWarped))
+		{
+			stamps.push_back(tracker.advance(n.row));
+		}
+	}
+	return estimateRating(stamps);
+}
+
+double RatingEstimator::estimateRating(const Chart* chart, const TimingData& timing) const
+{
+	return estimateRating(GetNoteTimes(chart->notes, timing));
+}
+
+double RatingEstimator::estimateRating(const Vector<double>& stamps) const
+{
+	if(!myWeights) return 1.0;
+
+	Vector<double> densities = CalcDensities(stamps);
 
 	double maxRating = 1.0;
 	for(int i = 0; i < HM_NUM_SLICES; ++i)
@@ -11,8 +11,16 @@ public:
 
 	RatingEstimator(const char* databaseFile);
 
+	/// Estimates the rating of the active chart.
 	double estimateRating();
 
+	/// Estimates the rating of the given chart, without using the editor state. The estimator is
+	/// not modified, so it can be shared by multiple threads.
+	double estimateRating(const Chart* chart, const TimingData& timing) const;
+
+	/// Estimates the rating from the times of the notes, excluding mines and warped notes.
+	double estimateRating(const Vector<double>& noteTimes) const;
+
 private:
 	double* myWeights;
 };
@@ -286,6 +286,7 @@ E(VOLUME_MUTE)
 E(SPEED_RESET)
 E(SPEED_INCREASE)
 E(SPEED_DECREASE)
+E(SPEED_PRESERVE_PITCH)
 
 E(TOGGLE_BEAT_TICK)
 E(TOGGLE_NOTE_TICK)
@@ -346,6 +347,8 @@ E(TOGGLE_STATUS_TIMING_MODE)
 E(SHOW_SHORTCUTS)
 E(SHOW_MESSAGE_LOG)
 E(SHOW_DEBUG_LOG)
+E(SHOW_PROFILER)
+E(EXPORT_PROFILER_TRACE)
 E(SHOW_ABOUT)
 #undef E
 
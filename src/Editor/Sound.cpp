@@ -1,10 +1,13 @@
 #include <Editor/Sound.h>
+#include <Editor/SoundCache.h>
+#include <Editor/MixKernels.h>
 
 #include <System/Debug.h>
 #include <System/File.h>
 #include <System/Thread.h>
 
 #include <Core/Core.h>
+#include <Core/Vector.h>
 #include <Core/Utils.h>
 #include <Core/StringUtils.h>
 
@@ -36,6 +39,10 @@ static void ConvertSamples(int numFrames, int16_t* dstL, int16_t* dstR, const vo
 			memcpy(dstL, src, numFrames * 2);
 			memcpy(dstR, src, numFrames * 2);
 		}
+		else if(numChannels == 2)
+		{
+			MixKernels::get().deinterleave(dstL, dstR, src, numFrames);
+		}
 		else
 		{
 			for(int i = 0; i < numFrames; ++i, ++dstL, ++dstR, src += numChannels)
@@ -72,28 +79,81 @@ static void ConvertSamples(int numFrames, int16_t* dstL, int16_t* dstR, const vo
 // ================================================================================================
 // Loader
 
-static const int BUFFER_SIZE = 1024;
+// Number of frames that is read from the source at once.
+static const int BLOCK_FRAMES = 1 << 16;
+
+// Number of frames per segment, for sources of which the length is not known beforehand.
+static const int SEGMENT_FRAMES = 1 << 20;
+
+SoundSource* LoadOgg(FileReader* file, String& title, String& artist); // Defined in "load_ogg.cpp".
+SoundSource* LoadMP3(FileReader* file, String& title, String& artist); // Defined in "load_mp3.cpp".
+SoundSource* LoadWav(FileReader* file, String& title, String& artist); // Defined in "load_wav.cpp".
+
+// Opens a source that reads samples from the audio file at path, or returns null on failure.
+static SoundSource* OpenSource(const char* path, String& title, String& artist)
+{
+	SoundSource* source = nullptr;
+
+	// Try to open the file.
+	FileReader* file = new FileReader;
+	if(file->open(path))
+	{
+		// Call the load function associated with the extension.
+		String ext = Path(path).ext();
+		Str::toLower(ext);
+		     if(ext == "ogg") source = LoadOgg(file, title, artist);
+		else if(ext == "mp3") source = LoadMP3(file, title, artist);
+		else if(ext == "wav") source = LoadWav(file, title, artist);
+		else
+		{
+			Debug::blockBegin(Debug::ERROR, "could not load audio file");
+			Debug::log("file: %s\n", path);
+			Debug::log("reason: unknown audio format\n");
+			Debug::blockEnd();
+		}
+	}
+
+	// The source taken ownership of the file, but if we have no source, then we delete the file.
+	if(!source)
+	{
+		delete file;
+	}
+
+	return source;
+}
 
 class Sound::Thread : public BackgroundThread
 {
 public:
 	~Thread();
-	Thread(Sound* sound, SoundSource* source);
+	Thread(Sound* sound, SoundSource* source, bool pipelined, const char* cachePath, String title,
+		String artist);
 
 	void exec();
-	bool readBlock();
+	void setSource(SoundSource* source);
+	bool verifyCachedSound();
+	void readBlock(int block);
+	bool storeBlock(int block);
+	bool joinSegments();
+	void finish();
 	void cleanup();
 	uchar progress() { return myProgress; }
 	double elapsedTime() { return Debug::getElapsedTime(myStartTime); }
+	double throughput();
 
 private:
 	SoundSource* mySource;
 	Sound* mySound;
-	short* myBuffer;
+	short* myBlocks[2];
+	int myBlockFrames[2];
+	Vector<short*> mySegmentsL, mySegmentsR;
+	int myBytesPerFrame;
 	int myCurrentFrame;
-	int myReservedFrames;
 	uchar myProgress;
 	double myStartTime;
+	String myCachePath, myTitle, myArtist;
+	bool myIsPipelined;
+	bool myIsTruncated;
 };
 
 Sound::Thread::~Thread()
@@ -102,89 +162,289 @@ Sound::Thread::~Thread()
 	cleanup();
 }
 
-Sound::Thread::Thread(Sound* sound, SoundSource* source)
+Sound::Thread::Thread(Sound* sound, SoundSource* source, bool pipelined, const char* cachePath,
+	String title, String artist)
+	: myCachePath(cachePath)
+	, myTitle(title)
+	, myArtist(artist)
+	, myIsPipelined(pipelined)
+	, myIsTruncated(false)
 {
 	myStartTime = Debug::getElapsedTime();
 
 	mySound = sound;
-	mySource = source;
+	mySource = nullptr;
 
-	int bytesPerFrame = source->getNumChannels() * source->getBytesPerSample();
-	myBuffer = (short*)malloc(BUFFER_SIZE * bytesPerFrame);
+	for(int i = 0; i < 2; ++i)
+	{
+		myBlocks[i] = nullptr;
+		myBlockFrames[i] = 0;
+	}
 
 	myCurrentFrame = 0;
-	myReservedFrames = 0;
 	myProgress = 0;
+
+	if(source) setSource(source);
+}
+
+void Sound::Thread::setSource(SoundSource* source)
+{
+	mySource = source;
+
+	myBytesPerFrame = source->getNumChannels() * source->getBytesPerSample();
+	for(int i = 0; i < 2; ++i)
+	{
+		myBlocks[i] = (short*)malloc(BLOCK_FRAMES * myBytesPerFrame);
+	}
+}
+
+// Verifies the samples that are mapped from the sound cache against the source file, and builds
+// their peaks. If the source file has changed since it was cached, it is opened to be decoded
+// instead. Returns true if there is nothing left to decode.
+bool Sound::Thread::verifyCachedSound()
+{
+	CachedSound* cached = mySound->myCachedSound;
+	if(SoundCache::verify(myCachePath.str(), cached))
+	{
+		mySound->mySamplesL = (short*)cached->samplesL;
+		mySound->mySamplesR = (short*)cached->samplesR;
+		mySound->myNumFrames = cached->numFrames;
+		myCurrentFrame = cached->numFrames;
+
+		mySound->myPeaks.reserve(myCurrentFrame);
+		mySound->myPeaks.update(mySound->mySamplesL, mySound->mySamplesR, myCurrentFrame, true);
+		mySound->myIsAllocated = true;
+		mySound->myIsCompleted = true;
+		return true;
+	}
+
+	delete cached;
+	mySound->myCachedSound = nullptr;
+
+	// The length of the source is not used, the samples are decoded as if it was unknown.
+	SoundSource* source = OpenSource(myCachePath.str(), myTitle, myArtist);
+	if(!source)
+	{
+		mySound->myIsAllocated = true;
+		mySound->myIsCompleted = true;
+		return true;
+	}
+	mySound->myFrequency = source->getFrequency();
+	setSource(source);
+	return false;
 }
 
 void Sound::Thread::exec()
 {
-	while(readBlock());
+	// Samples that are mapped from the sound cache only have to be verified.
+	if(!mySource && verifyCachedSound())
+	{
+		cleanup();
+		return;
+	}
+
+	// Sources that can decode everything at once are only used if the buffers are pre-allocated.
+	if(mySound->myIsAllocated && mySource->readAllFrames(mySound->mySamplesL,
+		mySound->mySamplesR, &myProgress, &terminationFlag_))
+	{
+		myCurrentFrame = mySound->myNumFrames;
+		finish();
+		cleanup();
+		return;
+	}
+
+	// Reading the next block from the source overlaps with storing the current block. The reader
+	// thread is created once, the blocks are handed over with a pair of events.
+	struct BlockReader : public BackgroundThread
+	{
+		Sound::Thread* owner;
+		Event request, done;
+		int block;
+		bool stop;
+		void exec()
+		{
+			for(request.wait(); !stop; request.wait())
+			{
+				owner->readBlock(block);
+				done.signal();
+			}
+		}
+	};
+
+	BlockReader reader;
+	reader.owner = this;
+	reader.stop = false;
+	if(myIsPipelined) reader.start();
+
+	readBlock(0);
+	bool stored = true;
+	for(int block = 0; myBlockFrames[block] > 0 && stored && !terminationFlag_; block ^= 1)
+	{
+		if(myIsPipelined)
+		{
+			reader.block = block ^ 1;
+			reader.request.signal();
+			stored = storeBlock(block);
+			reader.done.wait();
+		}
+		else
+		{
+			stored = storeBlock(block);
+			readBlock(block ^ 1);
+		}
+	}
+
+	if(myIsPipelined)
+	{
+		reader.stop = true;
+		reader.request.signal();
+		reader.waitUntilDone();
+	}
+
+	if(!terminationFlag_) finish();
 	cleanup();
 }
 
-bool Sound::Thread::readBlock()
+void Sound::Thread::readBlock(int block)
 {
-	if(terminationFlag_) return false;
+	myBlockFrames[block] = myBlocks[block] ? mySource->readFrames(BLOCK_FRAMES, myBlocks[block]) : 0;
+}
 
+bool Sound::Thread::storeBlock(int block)
+{
+	const uchar* src = (const uchar*)myBlocks[block];
+	int numFrames = myBlockFrames[block];
 	int srcChannels = mySource->getNumChannels();
-	int framesRead = mySource->readFrames(BUFFER_SIZE, myBuffer);
+	int srcBytesPerSample = mySource->getBytesPerSample();
 
+	// Pre-allocated buffers are filled directly.
 	if(mySound->myIsAllocated)
 	{
-		framesRead = min(framesRead, mySound->myNumFrames - myCurrentFrame);
+		numFrames = min(numFrames, mySound->myNumFrames - myCurrentFrame);
+
+		short* dstL = mySound->mySamplesL + myCurrentFrame;
+		short* dstR = mySound->mySamplesR + myCurrentFrame;
+		ConvertSamples(numFrames, dstL, dstR, src, srcChannels, srcBytesPerSample);
+		myCurrentFrame += numFrames;
+
+		mySound->myPeaks.update(mySound->mySamplesL, mySound->mySamplesR, myCurrentFrame, false);
+		myProgress = (uchar)((uint64_t)100 * myCurrentFrame / mySound->myNumFrames);
+
+		return (myCurrentFrame < mySound->myNumFrames);
 	}
 
-	if(framesRead > 0)
+	// Otherwise, the samples are written to a list of fixed size segments, which are joined once
+	// the length is known. Unlike growing a single buffer, this never copies samples twice.
+	while(numFrames > 0)
 	{
-		if(!mySound->myIsAllocated)
+		int segment = myCurrentFrame / SEGMENT_FRAMES;
+		int offset = myCurrentFrame % SEGMENT_FRAMES;
+		if(segment == mySegmentsL.size())
 		{
-			if(myCurrentFrame + framesRead > myReservedFrames)
+			short* samplesL = (short*)malloc(SEGMENT_FRAMES * sizeof(short));
+			short* samplesR = (short*)malloc(SEGMENT_FRAMES * sizeof(short));
+			if(!samplesL || !samplesR)
 			{
-				myReservedFrames = max(myReservedFrames * 2, myCurrentFrame + framesRead);
+				HudError("Insufficient memory to load the entire audio file.");
+				free(samplesL);
+				free(samplesR);
+				myIsTruncated = true;
+				return false;
+			}
+			mySegmentsL.push_back(samplesL);
+			mySegmentsR.push_back(samplesR);
+		}
 
-				short* newBufferL = (short*)realloc(mySound->mySamplesL, myReservedFrames * sizeof(short));
-				short* newBufferR = (short*)realloc(mySound->mySamplesR, myReservedFrames * sizeof(short));
+		int n = min(numFrames, SEGMENT_FRAMES - offset);
+		short* dstL = mySegmentsL[segment] + offset;
+		short* dstR = mySegmentsR[segment] + offset;
+		ConvertSamples(n, dstL, dstR, src, srcChannels, srcBytesPerSample);
 
-				if(newBufferL && newBufferR)
-				{
-					mySound->mySamplesL = newBufferL;
-					mySound->mySamplesR = newBufferR;
-				}
-				else
-				{
-					HudError("Insufficient memory to load the entire audio file.");
+		src += n * myBytesPerFrame;
+		numFrames -= n;
+		myCurrentFrame += n;
+	}
 
-					if(newBufferL) mySound->mySamplesL = newBufferL;
-					if(newBufferR) mySound->mySamplesR = newBufferR;
+	return true;
+}
 
-					framesRead = 0;
-				}
-			}
-			mySound->myNumFrames += framesRead;
-		}
+// Copies the segments of one channel to a single buffer, and frees each segment as soon as it is
+// copied. Returns null if the buffer could not be allocated, in which case the segments are kept.
+static short* JoinChannel(Vector<short*>& segments, int numFrames)
+{
+	short* samples = (short*)malloc(max(numFrames, 1) * sizeof(short));
+	if(!samples) return nullptr;
 
-		short* dstL = mySound->mySamplesL + myCurrentFrame;
-		short* dstR = mySound->mySamplesR + myCurrentFrame;
+	for(int i = 0, pos = 0; i < segments.size(); ++i, pos += SEGMENT_FRAMES)
+	{
+		int n = min(SEGMENT_FRAMES, numFrames - pos);
+		memcpy(samples + pos, segments[i], n * sizeof(short));
+		free(segments[i]);
+	}
+	segments.release();
 
-		ConvertSamples(framesRead, dstL, dstR, myBuffer,
-			mySource->getNumChannels(), mySource->getBytesPerSample());
+	return samples;
+}
 
-		myCurrentFrame += framesRead;
+bool Sound::Thread::joinSegments()
+{
+	// The channels are joined one after the other, so at most one and a half times the size of the
+	// samples is allocated at once, instead of twice the size.
+	int numFrames = myCurrentFrame;
+	short* samplesL = JoinChannel(mySegmentsL, numFrames);
+	short* samplesR = samplesL ? JoinChannel(mySegmentsR, numFrames) : nullptr;
 
-		if(mySound->myIsAllocated)
+	if(!samplesL || !samplesR)
+	{
+		HudError("Insufficient memory to load the entire audio file.");
+		free(samplesL);
+		free(samplesR);
+		return false;
+	}
+
+	mySound->mySamplesL = samplesL;
+	mySound->mySamplesR = samplesR;
+	mySound->myNumFrames = numFrames;
+	mySound->myPeaks.reserve(numFrames);
+
+	return true;
+}
+
+void Sound::Thread::finish()
+{
+	if(mySound->myIsAllocated)
+	{
+		// If the source ended early, the remainder of the pre-allocated buffers is silent.
+		int numFrames = mySound->myNumFrames;
+		if(myCurrentFrame < numFrames)
 		{
-			myProgress = (uchar)((uint64_t)100 * myCurrentFrame / mySound->myNumFrames);
+			memset(mySound->mySamplesL + myCurrentFrame, 0, (numFrames - myCurrentFrame) * sizeof(short));
+			memset(mySound->mySamplesR + myCurrentFrame, 0, (numFrames - myCurrentFrame) * sizeof(short));
 		}
 	}
+	else if(!joinSegments())
+	{
+		myCurrentFrame = 0;
+		myIsTruncated = true;
+	}
+
+	mySound->myPeaks.update(mySound->mySamplesL, mySound->mySamplesR, mySound->myNumFrames, true);
+	mySound->myIsAllocated = true;
+	mySound->myIsCompleted = true;
 
-	if(framesRead == 0)
+	if(myCachePath.len() && !myIsTruncated)
 	{
-		mySound->myIsAllocated = true;
-		mySound->myIsCompleted = true;
+		SoundCache::store(myCachePath.str(), mySound->myFrequency, mySound->myNumFrames,
+			mySound->mySamplesL, mySound->mySamplesR, myTitle, myArtist);
 	}
+}
 
-	return (framesRead > 0);
+double Sound::Thread::throughput()
+{
+	// The throughput is measured in bytes of decoded 16-bit stereo samples per second.
+	int frames = max(myCurrentFrame, (int)((int64_t)mySound->myNumFrames * myProgress / 100));
+	double elapsed = elapsedTime();
+	return (elapsed > 0.0) ? (double)frames * 4.0 / elapsed / (1024.0 * 1024.0) : 0.0;
 }
 
 void Sound::Thread::cleanup()
@@ -192,19 +452,24 @@ void Sound::Thread::cleanup()
 	delete mySource;
 	mySource = nullptr;
 
-	free(myBuffer);
-	myBuffer = nullptr;
+	for(int i = 0; i < 2; ++i)
+	{
+		free(myBlocks[i]);
+		myBlocks[i] = nullptr;
+	}
+
+	for(auto segment : mySegmentsL) free(segment);
+	for(auto segment : mySegmentsR) free(segment);
+	mySegmentsL.release();
+	mySegmentsR.release();
 }
 
 // ================================================================================================
 // Sound
 
-SoundSource* LoadOgg(FileReader* file, String& title, String& artist); // Defined in "load_ogg.cpp".
-SoundSource* LoadMP3(FileReader* file, String& title, String& artist); // Defined in "load_mp3.cpp".
-SoundSource* LoadWav(FileReader* file, String& title, String& artist); // Defined in "load_wav.cpp".
-
 Sound::Sound()
 	: myThread(nullptr)
+	, myCachedSound(nullptr)
 	, mySamplesL(nullptr)
 	, mySamplesR(nullptr)
 {
@@ -221,6 +486,15 @@ void Sound::clear()
 	delete myThread;
 	myThread = nullptr;
 
+	// Samples that are mapped from the sound cache are not owned by the sound.
+	if(myCachedSound)
+	{
+		delete myCachedSound;
+		myCachedSound = nullptr;
+		mySamplesL = nullptr;
+		mySamplesR = nullptr;
+	}
+
 	if(mySamplesL)
 	{
 		free(mySamplesL);
@@ -233,6 +507,8 @@ void Sound::clear()
 		mySamplesR = nullptr;
 	}
 
+	myPeaks.clear();
+
 	myNumFrames = 0;
 	myFrequency = 44100;
 	myIsAllocated = true;
@@ -243,37 +519,36 @@ bool Sound::load(const char* path, bool threaded, String& title, String& artist)
 {
 	clear();
 
-	SoundSource* source = nullptr;
-
-	// Try to open the file.
-	FileReader* file = new FileReader;
-	if(file->open(path))
+	// If the decoded samples are cached, they are mapped directly. Verifying them against the
+	// source file and building their peaks is left to the loading thread, which reads the samples
+	// from the source instead if it has changed.
+	myCachedSound = SoundCache::open(path);
+	if(myCachedSound)
 	{
-		// Call the load function associated with the extension.
-		String ext = Path(path).ext();
-		Str::toLower(ext);
-		     if(ext == "ogg") source = LoadOgg(file, title, artist);
-		else if(ext == "mp3") source = LoadMP3(file, title, artist);
-		else if(ext == "wav") source = LoadWav(file, title, artist);
+		title = myCachedSound->title;
+		artist = myCachedSound->artist;
+		myFrequency = myCachedSound->frequency;
+		myIsAllocated = false;
+		myIsCompleted = false;
+		if(threaded)
+		{
+			myThread = new Sound::Thread(this, nullptr, true, path, title, artist);
+			myThread->start();
+		}
 		else
 		{
-			Debug::blockBegin(Debug::ERROR, "could not load audio file");
-			Debug::log("file: %s\n", path);
-			Debug::log("reason: unknown audio format\n");
-			Debug::blockEnd();
+			Sound::Thread thread(this, nullptr, false, path, title, artist);
+			thread.exec();
 		}
+		return true;
 	}
 
-	// The source taken ownership of the file, but if we have no source, then we delete the file.
-	if(!source)
-	{
-		delete file;
-		return false;
-	}
+	SoundSource* source = OpenSource(path, title, artist);
+	if(!source) return false;
 
 	// Start a thread that reads samples from the source.
 	myFrequency = source->getFrequency();
-	myNumFrames = source->getNumFrames();
+	myNumFrames = max(source->getNumFrames(), 0);
 	myIsAllocated = false;
 	myIsCompleted = false;
 
@@ -302,18 +577,20 @@ bool Sound::load(const char* path, bool threaded, String& title, String& artist)
 			return false;
 		}
 
+		myPeaks.reserve(myNumFrames);
 		myIsAllocated = true;
 	}
 
 	// Start a sample reading thread.
+	const char* cachePath = SoundCache::isCacheable(path) ? path : "";
 	if(threaded)
 	{
-		myThread = new Sound::Thread(this, source);
+		myThread = new Sound::Thread(this, source, true, cachePath, title, artist);
 		myThread->start();
 	}
 	else
 	{
-		Sound::Thread thread(this, source);
+		Sound::Thread thread(this, source, false, cachePath, title, artist);
 		thread.exec();
 	}
 
@@ -330,4 +607,9 @@ double Sound::getLoadingTime() const
 	return myThread ? myThread->elapsedTime() : 0.0;
 }
 
+double Sound::getLoadingThroughput() const
+{
+	return myThread ? myThread->throughput() : 0.0;
+}
+
 }; // namespace Vortex
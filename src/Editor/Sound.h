@@ -1,9 +1,12 @@
 #pragma once
 
 #include <Core/Core.h>
+#include <Editor/WavePeaks.h>
 
 namespace Vortex {
 
+struct CachedSound;
+
 // In the following context, a sample refers to a single value.
 // A frame refers to a set samples, one for each audio channel.
 
@@ -19,6 +22,13 @@ struct SoundSource
 	/// Writes audio frames into the buffer until either the buffer is filled
 	/// or the source end is reached. Returns the number of frames written.
 	virtual int readFrames(int numFrames, short* buffer) = 0;
+
+	/// Decodes the entire signal into planar buffers of getNumFrames frames, as an alternative to
+	/// reading it frame by frame. Sources that can decode faster all at once, for example on
+	/// multiple threads, override this. The progress in [0, 100] is written while decoding, and
+	/// decoding stops early if the terminate flag is set. Returns false if it is not supported.
+	virtual bool readAllFrames(short* samplesL, short* samplesR, uchar* progress,
+		const uchar* terminate) { return false; }
 };
 
 class Sound
@@ -31,7 +41,8 @@ public:
 
 	/// Destroys the current sample data and starts loading audio from a file. If title/artist
 	/// fields are found in the metadata, they are written to the corresponding strings. When
-	/// threaded, "isAllocated" and "isCompleted" can be used to check loading progress.
+	/// threaded, "isAllocated" and "isCompleted" can be used to check loading progress. Decoded
+	/// MP3 and OGG files are read from the sound cache if possible, and written to it otherwise.
 	bool load(const char* path, bool threaded, String& title, String& artist);
 
 	/// Returns the number of frames per second.
@@ -46,6 +57,9 @@ public:
 	/// Returns the sample buffer for the right channel.
 	const short* samplesR() const { return mySamplesR; }
 
+	/// Returns the min/max peak pyramid of the samples, which is built while loading.
+	const WavePeaks& getPeaks() const { return myPeaks; }
+
 	/// Returns true if the sample buffers allocation is completed, false otherwise.
 	bool isAllocated() const { return myIsAllocated; }
 
@@ -58,14 +72,19 @@ public:
 	/// Returns the time elapsed since loading started.
 	double getLoadingTime() const;
 
+	/// Returns the number of megabytes of decoded samples loaded per second.
+	double getLoadingThroughput() const;
+
 	/// Returns the most recent error that occured during loading.
 	const char* lastError() const { return myError; }
 
 private:
 	class Thread;
 	Thread* myThread;
+	CachedSound* myCachedSound;
 	short* mySamplesL;
 	short* mySamplesR;
+	WavePeaks myPeaks;
 	int myFrequency;
 	int myNumFrames;
 	bool myIsAllocated;
@@ -0,0 +1,272 @@
+#include <Editor/SoundCache.h>
+
+#include <Core/Utils.h>
+#include <Core/StringUtils.h>
+
+#include <System/Debug.h>
+#include <System/Thread.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+namespace Vortex {
+namespace {
+
+static const char* CACHE_DIR = "cache";
+
+static const uint32_t CACHE_MAGIC = 0x43505641; // "AVPC"
+static const uint32_t CACHE_VERSION = 1;
+
+// The cache file starts with the header, followed by the source path, title and artist, and the
+// left and right samples, which start at a 16-byte aligned offset.
+struct CacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceSize;
+	uint64_t sourceTime;
+	uint64_t sourceHash;
+	int32_t frequency;
+	int32_t numFrames;
+	uint32_t pathLen;
+	uint32_t titleLen;
+	uint32_t artistLen;
+	uint32_t dataOffset;
+};
+
+static bool sCacheEnabled = true;
+static uint64_t sCacheMaxBytes = 2048ull << 20;
+static CriticalSection sCacheLock;
+
+static uint64_t HashBytes(uint64_t hash, const uchar* data, size_t size)
+{
+	static const uint64_t prime = 0x100000001B3ull;
+	size_t numWords = size / 8;
+	for(size_t i = 0; i < numWords; ++i, data += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data, 8);
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 29;
+	}
+	for(size_t i = numWords * 8; i < size; ++i, ++data)
+	{
+		hash = (hash ^ *data) * prime;
+	}
+	return hash;
+}
+
+static bool HashFile(const char* path, uint64_t& hash)
+{
+	FileReader file;
+	if(!file.open(path)) return false;
+
+	// Chunks are a multiple of the word size, so the hash does not depend on the chunk size.
+	Vector<uchar> buffer(1 << 16);
+	hash = 0xCBF29CE484222325ull;
+	size_t n;
+	while((n = file.read(buffer.data(), 1, buffer.size())) > 0)
+	{
+		hash = HashBytes(hash, buffer.data(), n);
+	}
+	return true;
+}
+
+static String GetCachePath(const char* path)
+{
+	String key(path);
+	Str::toLower(key);
+	Str::replace(key, '/', '\\');
+	uint64_t hash = HashBytes(0xCBF29CE484222325ull, (const uchar*)key.str(), key.len());
+	return Str::fmt("%1\\%2%3.pcm").arg(CACHE_DIR)
+		.arg((uint)(hash >> 32), 8, true)
+		.arg((uint)(hash & 0xFFFFFFFF), 8, true);
+}
+
+static bool MatchesText(const uchar*& p, const uchar* end, uint32_t len, const char* text)
+{
+	if((size_t)(end - p) < len || strlen(text) != len || memcmp(p, text, len) != 0) return false;
+	p += len;
+	return true;
+}
+
+static String ReadText(const uchar*& p, uint32_t len)
+{
+	String out((const char*)p, (int)len);
+	p += len;
+	return out;
+}
+
+// Deletes the least recently used cache files until the total size is within the limit.
+static void EvictEntries()
+{
+	struct CacheFile { Path path; uint64_t size, time; };
+	Vector<CacheFile> files;
+	uint64_t totalSize = 0;
+	for(auto& path : File::findFiles(CACHE_DIR, false, "pcm"))
+	{
+		CacheFile file = {path, 0, 0};
+		if(File::getInfo(path, &file.size, &file.time))
+		{
+			files.push_back(file);
+			totalSize += file.size;
+		}
+	}
+	std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b)
+	{
+		return a.time < b.time;
+	});
+	for(auto& file : files)
+	{
+		if(totalSize <= sCacheMaxBytes) break;
+
+		// Files that are currently mapped cannot be deleted, and are evicted later.
+		if(File::deleteFile(file.path)) totalSize -= file.size;
+	}
+}
+
+}; // anonymous namespace
+
+// ================================================================================================
+// SoundCache.
+
+void SoundCache::configure(bool enabled, int maxSizeMb)
+{
+	sCacheLock.lock();
+	sCacheEnabled = enabled;
+	sCacheMaxBytes = (uint64_t)max(maxSizeMb, 0) << 20;
+	sCacheLock.unlock();
+}
+
+bool SoundCache::isCacheable(const char* path)
+{
+	String ext = Path(path).ext();
+	Str::toLower(ext);
+	return sCacheEnabled && (ext == "mp3" || ext == "ogg");
+}
+
+CachedSound* SoundCache::open(const char* path)
+{
+	if(!isCacheable(path)) return nullptr;
+
+	uint64_t sourceSize, sourceTime;
+	if(!File::getInfo(path, &sourceSize, &sourceTime)) return nullptr;
+
+	sCacheLock.lock();
+
+	// Mark the entry as recently used before mapping it, which keeps it from being evicted.
+	String cachePath = GetCachePath(path);
+	File::touch(cachePath);
+
+	CachedSound* out = new CachedSound;
+	bool valid = out->file.open(cachePath);
+	if(valid)
+	{
+		const uchar* begin = out->file.data, *end = begin + out->file.size, *p = begin;
+
+		CacheHeader header;
+		valid = out->file.size >= sizeof(CacheHeader);
+		if(valid)
+		{
+			memcpy(&header, p, sizeof(CacheHeader));
+			p += sizeof(CacheHeader);
+			uint64_t numBytes = (uint64_t)max(header.numFrames, 0) * sizeof(short) * 2;
+			valid = header.magic == CACHE_MAGIC && header.version == CACHE_VERSION
+				&& header.sourceSize == sourceSize && header.sourceTime == sourceTime
+				&& header.dataOffset % 16 == 0 && header.dataOffset + numBytes <= out->file.size
+				&& MatchesText(p, end, header.pathLen, path)
+				&& header.titleLen + header.artistLen <= (size_t)(end - p);
+		}
+		if(valid)
+		{
+			out->title = ReadText(p, header.titleLen);
+			out->artist = ReadText(p, header.artistLen);
+			out->frequency = header.frequency;
+			out->numFrames = header.numFrames;
+			out->samplesL = (const short*)(begin + header.dataOffset);
+			out->samplesR = out->samplesL + header.numFrames;
+			out->sourceHash = header.sourceHash;
+		}
+	}
+
+	sCacheLock.unlock();
+
+	if(!valid)
+	{
+		delete out;
+		out = nullptr;
+	}
+	return out;
+}
+
+bool SoundCache::verify(const char* path, const CachedSound* sound)
+{
+	// The size and modification time can match by accident, the content hash cannot.
+	uint64_t hash;
+	return HashFile(path, hash) && hash == sound->sourceHash;
+}
+
+void SoundCache::store(const char* path, int frequency, int numFrames, const short* samplesL,
+	const short* samplesR, const String& title, const String& artist)
+{
+	if(!isCacheable(path) || numFrames <= 0) return;
+
+	uint64_t sourceSize, sourceTime, sourceHash;
+	if(!File::getInfo(path, &sourceSize, &sourceTime) || !HashFile(path, sourceHash)) return;
+
+	sCacheLock.lock();
+
+	double startTime = Debug::getElapsedTime();
+
+	CacheHeader header;
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.sourceHash = sourceHash;
+	header.frequency = frequency;
+	header.numFrames = numFrames;
+	header.pathLen = (uint32_t)strlen(path);
+	header.titleLen = (uint32_t)title.len();
+	header.artistLen = (uint32_t)artist.len();
+	uint32_t textEnd = sizeof(CacheHeader) + header.pathLen + header.titleLen + header.artistLen;
+	header.dataOffset = (textEnd + 15) & ~15u;
+
+	// The file is written under a temporary name first, so a partially written file is never
+	// mistaken for a valid entry.
+	File::createFolder(CACHE_DIR);
+	String cachePath = GetCachePath(path);
+	String tempPath = cachePath + ".tmp";
+
+	bool success = false;
+	FileWriter file;
+	if(file.open(tempPath))
+	{
+		static const uchar padding[16] = {};
+		size_t numBytes = (size_t)numFrames * sizeof(short);
+		success = file.write(&header, sizeof(CacheHeader), 1) == 1
+			&& file.write(path, 1, header.pathLen) == header.pathLen
+			&& file.write(title.str(), 1, header.titleLen) == header.titleLen
+			&& file.write(artist.str(), 1, header.artistLen) == header.artistLen
+			&& file.write(padding, 1, header.dataOffset - textEnd) == header.dataOffset - textEnd
+			&& file.write(samplesL, 1, numBytes) == numBytes
+			&& file.write(samplesR, 1, numBytes) == numBytes;
+		file.close();
+	}
+
+	if(success && File::moveFile(tempPath, cachePath, true))
+	{
+		Debug::log("cached decoded samples of %s (%.1f MB in %.2f s)\n", path,
+			(double)numFrames * 4.0 / (1 << 20), Debug::getElapsedTime(startTime));
+		EvictEntries();
+	}
+	else
+	{
+		File::deleteFile(tempPath);
+	}
+
+	sCacheLock.unlock();
+}
+
+}; // namespace Vortex
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Core/String.h>
+#include <System/File.h>
+
+namespace Vortex {
+
+/// Decoded samples of a sound, memory-mapped from the sound cache.
+struct CachedSound
+{
+	MappedFile file;
+	const short* samplesL;
+	const short* samplesR;
+	uint64_t sourceHash;
+	int frequency;
+	int numFrames;
+	String title;
+	String artist;
+};
+
+/// On-disk cache of decoded MP3 and OGG files, stored as planar 16-bit samples. Entries are
+/// keyed by the path, size, modification time and content hash of the source file. When the
+/// total size of the cache exceeds its limit, the least recently used entries are deleted.
+struct SoundCache
+{
+	/// Enables or disables the cache, and sets the maximum total size of the cache files.
+	static void configure(bool enabled, int maxSizeMb);
+
+	/// Returns true if the decoded samples of the file at path should be cached.
+	static bool isCacheable(const char* path);
+
+	/// Maps the cached samples of the file at path, or returns null if they are not cached or the
+	/// size or modification time of the source file has changed since. The returned sound is
+	/// deleted by the caller, and should be verified before its samples are used.
+	static CachedSound* open(const char* path);
+
+	/// Returns true if the content of the file at path still matches the cached sound. This reads
+	/// the entire source file, so it is best called on a background thread.
+	static bool verify(const char* path, const CachedSound* sound);
+
+	/// Writes the decoded samples of the file at path to the cache.
+	static void store(const char* path, int frequency, int numFrames, const short* samplesL,
+		const short* samplesR, const String& title, const String& artist);
+};
+
+}; // namespace Vortex
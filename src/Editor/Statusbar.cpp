@@ -8,6 +8,7 @@
 #include <Core/Text.h>
 
 #include <System/System.h>
+#include <System/Profiler.h>
 
 #include <Editor/Menubar.h>
 #include <Editor/Action.h>
@@ -93,6 +94,8 @@ void saveSettings(XmrNode& settings)
 
 void draw()
 {
+	VortexProfileZone("statusbar draw");
+
 	Vector<String> info;
 
 	TextStyle textStyle;
@@ -5,6 +5,7 @@
 #include <Core/StringUtils.h>
 #include <Core/QuadBatch.h>
 #include <Core/Texture.h>
+#include <Core/TextureAtlas.h>
 #include <Core/Gui.h>
 #include <Core/Text.h>
 #include <Core/Draw.h>
@@ -23,17 +24,34 @@
 #include <Editor/Menubar.h>
 
 #include <System/System.h>
+#include <System/Profiler.h>
 
 #include <algorithm>
+#include <map>
 
 namespace Vortex {
 
+// If an update adds or removes more boxes than this, all boxes are recreated instead.
+static const int MAX_INCREMENTAL_CHANGES = 256;
+
+// Maximum number of box widths that are remembered.
+static const int MAX_CACHED_WIDTHS = 4096;
+
+struct BoxChange
+{
+	Segment::Type type;
+	int row;
+	const Segment* seg; ///< The new segment, or null if the box is removed.
+};
+
 // ================================================================================================
 // TempoBoxesImpl :: member data.
 
 struct TempoBoxesImpl : public TempoBoxes {
 
-Vector<TempoBox> myBoxes;
+Vector<TempoBox> myBoxes; // Sorted by row, boxes on the same row are sorted by segment type.
+SegmentList mySegments[Segment::NUM_TYPES]; // Copy of the segments that the boxes represent.
+std::map<String, int> myBoxWidths;
 int myMouseOverBox;
 TileBar myBoxBar;
 TileBar myBoxHl;
@@ -50,10 +68,20 @@ bool myShowHelp;
 
 TempoBoxesImpl()
 {
-	myBoxBar.texture = myBoxHl.texture = Texture("assets/icons tempo.png", false);
+	// The top half of the icons is the box, the bottom half is the highlight.
+	TextureAtlas::Region icons;
+	TextureAtlas::shared().add("assets/icons tempo.png", icons);
+	float midV = (icons.uvs.t + icons.uvs.b) * 0.5f;
+
+	myBoxBar.texture = myBoxHl.texture = icons.page;
 	myBoxBar.border = myBoxHl.border = 8;
-	myBoxBar.uvs = {0, 0, 1, 0.5f};
-	myBoxHl.uvs = {0, 0.5f, 1, 1};
+	myBoxBar.uvs = {icons.uvs.l, icons.uvs.t, icons.uvs.r, midV};
+	myBoxHl.uvs = {icons.uvs.l, midV, icons.uvs.r, icons.uvs.b};
+
+	for(int i = 0; i < Segment::NUM_TYPES; ++i)
+	{
+		mySegments[i].setType((Segment::Type)i);
+	}
 
 	myShowBoxes = true;
 	myShowHelp = true;
@@ -83,22 +111,112 @@ void saveSettings(XmrNode& settings)
 // ================================================================================================
 // TempoBoxesImpl :: update.
 
-void update()
+static bool BoxBefore(const TempoBox& box, int row, Segment::Type type)
 {
-	myBoxes.clear();
+	return box.row < row || (box.row == row && box.type < type);
+}
 
-	if(gSimfile->isClosed()) return;
+// Returns the index of the first box that is not before the given row and type.
+int myFindBox(int row, Segment::Type type) const
+{
+	auto it = std::lower_bound(myBoxes.begin(), myBoxes.end(), row,
+	[type](const TempoBox& box, int row)
+	{
+		return BoxBefore(box, row, type);
+	});
+	return it - myBoxes.begin();
+}
+
+int myGetBoxWidth(const String& desc)
+{
+	auto it = myBoxWidths.find(desc);
+	if(it != myBoxWidths.end()) return it->second;
+
+	TextStyle textStyle;
+	Text::arrange(Text::MC, textStyle, desc.str());
+	int width = max(32, Text::getWidth() + 24);
+
+	if(myBoxWidths.size() >= MAX_CACHED_WIDTHS) myBoxWidths.clear();
+	myBoxWidths[desc] = width;
+
+	return width;
+}
+
+TempoBox myCreateBox(Segment::Type type, const Segment* seg)
+{
+	String desc = Segment::meta[type]->getDescription(seg);
+	int width = myGetBoxWidth(desc);
+	return TempoBox{desc, seg->row, type, 0, (uint)width, 0};
+}
+
+// Calculates the x-position of the boxes on the row of the box at the given index.
+void myLayoutRow(int index)
+{
+	int row = myBoxes[index].row;
+	while(index > 0 && myBoxes[index - 1].row == row) --index;
+
+	int stacks[2] = {0, 0};
+	for(int n = myBoxes.size(); index < n && myBoxes[index].row == row; ++index)
+	{
+		TempoBox& box = myBoxes[index];
+		int side = Segment::meta[box.type]->side;
+		box.x = (side - 1) * (int)box.width + stacks[side];
+		stacks[side] += (int)box.width * (side * 2 - 1);
+	}
+}
+
+// Compares the current segments with the segments the boxes were created from.
+void myFindChanges(Vector<BoxChange>& out)
+{
+	auto segments = gTempo->getSegments();
+	for(auto list = segments->begin(), listEnd = segments->end(); list != listEnd; ++list)
+	{
+		auto type = list->type();
+		auto meta = Segment::meta[type];
+		auto& prev = mySegments[type];
+		int numChanges = out.size();
+
+		auto a = list->begin(), aEnd = list->end();
+		auto b = prev.begin(), bEnd = prev.end();
+		while(a != aEnd || b != bEnd)
+		{
+			if(b == bEnd || (a != aEnd && a->row < b->row))
+			{
+				out.push_back({type, a->row, a.ptr});
+				++a;
+			}
+			else if(a == aEnd || b->row < a->row)
+			{
+				out.push_back({type, b->row, nullptr});
+				++b;
+			}
+			else
+			{
+				if(!meta->isEquivalent(a.ptr, b.ptr))
+				{
+					out.push_back({type, b->row, nullptr});
+					out.push_back({type, a->row, a.ptr});
+				}
+				++a, ++b;
+			}
+		}
+
+		if(out.size() != numChanges) prev = *list;
+	}
+}
+
+void myRecreateBoxes()
+{
+	myBoxes.clear();
 
 	// Create a box for every segment.
 	auto segments = gTempo->getSegments();
 	for(auto it = segments->begin(), end = segments->end(); it != end; ++it)
 	{
 		auto type = it->type();
-		auto meta = Segment::meta[type];
 		for(auto seg = it->begin(), segEnd = it->end(); seg != segEnd; ++seg)
 		{
-			String desc = meta->getDescription(seg.ptr);
-			myBoxes.push_back(TempoBox{desc, seg->row, type, 0, 0, 0});
+			myBoxes.push_back(myCreateBox(type, seg.ptr));
 		}
 	}
 
@@ -109,31 +227,50 @@ void update()
 		return (a.row < b.row);
 	});
 
-	// Precalculate the x-position and width of each box.
-	TextStyle textStyle;
-	int previousRow = -1;
-	int stacks[2] = {0, 0};
-	for(TempoBox& box : myBoxes)
+	// Precalculate the x-position of each box.
+	for(int i = 0, n = myBoxes.size(); i < n; ++i)
 	{
-		Text::arrange(Text::MC, textStyle, box.str.str());
-		int width = max(32, Text::getWidth() + 24);
-		box.width = width;
-		
-		int side = Segment::meta[box.type]->side;
-		int offset = width * (side * 2 - 1);
+		if(i == 0 || myBoxes[i - 1].row != myBoxes[i].row) myLayoutRow(i);
+	}
+}
+
+void update()
+{
+	if(gSimfile->isClosed())
+	{
+		myBoxes.clear();
+		for(auto& list : mySegments) list.clear();
+		return;
+	}
 
-		box.x = (side - 1) * width;
-		if(box.row == previousRow)
+	// Only the boxes of segments that were added, removed or changed are updated.
+	Vector<BoxChange> changes;
+	myFindChanges(changes);
+	if(changes.empty()) return;
+
+	if(changes.size() > MAX_INCREMENTAL_CHANGES)
+	{
+		myRecreateBoxes();
+		return;
+	}
+
+	for(auto& change : changes)
+	{
+		int index = myFindBox(change.row, change.type);
+		if(change.seg)
 		{
-			box.x += stacks[side];
-			stacks[side] += offset;
+			myBoxes.insert(index, myCreateBox(change.type, change.seg), 1);
 		}
-		else
+		else if(index < myBoxes.size() && myBoxes[index].row == change.row && myBoxes[index].type == change.type)
 		{
-			stacks[side] = offset;
-			stacks[1 - side] = 0;
-			previousRow = box.row;
-		}		
+			myBoxes.erase(index);
+		}
+	}
+
+	for(auto& change : changes)
+	{
+		int index = myFindBox(change.row, (Segment::Type)0);
+		if(index < myBoxes.size() && myBoxes[index].row == change.row) myLayoutRow(index);
 	}
 }
 
@@ -311,8 +448,36 @@ bool noneSelected() const
 // ================================================================================================
 // TempoBoxesImpl :: tick.
 
+// Returns the range of boxes that are within the given vertical range of the view.
+void myGetVisibleBoxes(int top, int bottom, int& outBegin, int& outEnd) const
+{
+	bool timeBased = gView->isTimeBased();
+	double a = gView->yToOffset(top), b = gView->yToOffset(bottom);
+	double minOfs = min(a, b), maxOfs = max(a, b);
+
+	// The row and time of the boxes never decrease, so the range can be found with a binary search.
+	auto boxOfs = [timeBased](const TempoBox& box)
+	{
+		return timeBased ? gTempo->rowToTime(box.row) : (double)box.row;
+	};
+	auto begin = std::partition_point(myBoxes.begin(), myBoxes.end(),
+		[&](const TempoBox& box) { return boxOfs(box) < minOfs; });
+	auto end = std::partition_point(begin, myBoxes.end(),
+		[&](const TempoBox& box) { return boxOfs(box) <= maxOfs; });
+
+	outBegin = begin - myBoxes.begin();
+	outEnd = end - myBoxes.begin();
+}
+
+int myGetBoxY(const TempoBox& box, bool timeBased, double oy, double dy) const
+{
+	return (int)(oy + dy * (timeBased ? gTempo->rowToTime(box.row) : (double)box.row));
+}
+
 void tick()
 {
+	VortexProfileZone("tempo boxes tick");
+
 	myMouseOverBox = -1;
 	if(!GuiMain::isCapturingMouse())
 	{
@@ -320,14 +485,16 @@ void tick()
 		double oy = gView->offsetToY(0.0);
 		double dy = gView->getPixPerOfs();
 
-		TempoTimeTracker tracker;
 		auto coords = gView->getNotefieldCoords();
 		const int baseX[2] = {coords.xl, coords.xr};
 		vec2i mpos = gSystem->getMousePos();
-		for(int i = 0; i < myBoxes.size(); ++i)
+
+		int begin, end;
+		myGetVisibleBoxes(mpos.y - 17, mpos.y + 17, begin, end);
+		for(int i = begin; i < end; ++i)
 		{
 			auto& box = myBoxes[i];
-			int y = (int)(oy + dy * (timeBased ? tracker.advance(box.row) : (double)box.row));
+			int y = myGetBoxY(box, timeBased, oy, dy);
 			int side = Segment::meta[box.type]->side;
 			int x = baseX[side] + box.x;
 			if(IsInside(recti{x, y - 16, (int)box.width, 32}, mpos.x, mpos.y))
@@ -344,6 +511,8 @@ void tick()
 
 void draw()
 {
+	VortexProfileZone("tempo boxes draw");
+
 	if(myShowBoxes == false || myBoxes.empty() || gView->getScaleLevel() < 2) return;
 
 	auto coords = gView->getNotefieldCoords();
@@ -355,46 +524,52 @@ void draw()
 	int viewTop = gView->getRect().y;
 	int viewBtm = viewTop + gView->getHeight();
 
+	int begin, end;
+	myGetVisibleBoxes(viewTop - 17, viewBtm + 17, begin, end);
+
+	// Calculate the position of the visible boxes once, they are used by both passes.
+	Vector<vec2i> positions;
+	positions.reserve(end - begin);
+	for(int i = begin; i < end; ++i)
+	{
+		const TempoBox& box = myBoxes[i];
+		int side = Segment::meta[box.type]->side;
+		positions.push_back({baseX[side] + box.x, myGetBoxY(box, timeBased, oy, dy)});
+	}
+
 	Renderer::resetColor();
 	Renderer::bindTexture(myBoxHl.texture.handle());
 	Renderer::bindShader(Renderer::SH_TEXTURE);
 
 	// First pass, draw the box sprites.
-	int previousRow = 0;	
-	TempoTimeTracker tracker;
 	auto batch = Renderer::batchTC();
-	for(const TempoBox& box : myBoxes)
+	for(int i = begin; i < end; ++i)
 	{
-		int y = (int)(oy + dy * (timeBased ? tracker.advance(box.row) : (double)box.row));
-		if(y < viewTop - 16 || y > viewBtm + 16) continue;
+		const TempoBox& box = myBoxes[i];
+		vec2i pos = positions[i - begin];
+		if(pos.y < viewTop - 16 || pos.y > viewBtm + 16) continue;
 
 		int side = Segment::meta[box.type]->side;
-		int x = baseX[side] + box.x;
-
 		int flags = side * TileBar::FLIP_H;
-		recti r = {x, y - 16, (int)box.width, 32};
+		recti r = {pos.x, pos.y - 16, (int)box.width, 32};
 
 		color32 color = Segment::meta[box.type]->color;
 		myBoxBar.draw(&batch, r, color, flags);
 		if(box.isSelected) myBoxHl.draw(&batch, r, Colors::white, flags);
-
-		previousRow = box.row;
 	}
 	batch.flush();
 
 	// Second pass, draw the text labels.
-	tracker = TempoTimeTracker();
 	TextStyle textStyle;
-	for(const TempoBox& box : myBoxes)
+	for(int i = begin; i < end; ++i)
 	{
-		int y = (int)(oy + dy * (timeBased ? tracker.advance(box.row) : (double)box.row));
-		if(y < viewTop - 16 || y > viewBtm + 16) continue;
+		const TempoBox& box = myBoxes[i];
+		vec2i pos = positions[i - begin];
+		if(pos.y < viewTop - 16 || pos.y > viewBtm + 16) continue;
 
 		int side = Segment::meta[box.type]->side;
-		int x = baseX[side] + box.x + side * 4 - 2;
-
 		Text::arrange(Text::MC, textStyle, box.str.str());
-		Text::draw(recti{x, y - 17, (int)box.width, 32});
+		Text::draw(recti{pos.x + side * 4 - 2, pos.y - 17, (int)box.width, 32});
 	}
 
 	// Display detailed info of the mouse over box.
@@ -15,6 +15,7 @@
 #include <Editor/Common.h>
 #include <Editor/Shortcuts.h>
 #include <Editor/Action.h>
+#include <Editor/History.h>
 
 namespace Vortex {
 
@@ -217,6 +218,7 @@ void UpdateScrollValues()
 
 void tick()
 {
+	FlushHudMessages();
 	UpdateScrollValues();
 	switch(textOverlayMode_)
 	{
@@ -287,6 +289,15 @@ void show(Mode mode)
 		{
 			debugLog_ = "(could not open ArrowVortex.log)";
 		}
+
+		// Show the memory usage of the undo history above the log.
+		auto stats = gHistory->getStats();
+		String header = Str::fmt("History: %1 entries, %2 KB resident, %3 KB compressed, %4 KB spilled\n\n")
+			.arg(stats.numEntries)
+			.arg((int)(stats.residentBytes >> 10))
+			.arg((int)(stats.compressedBytes >> 10))
+			.arg((int)(stats.spilledBytes >> 10));
+		Str::insert(debugLog_, 0, header);
 	}
 
 	UpdateScrollValues();
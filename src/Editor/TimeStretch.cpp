@@ -0,0 +1,282 @@
+#include <Editor/TimeStretch.h>
+
+#include <Core/Utils.h>
+
+#include <System/Debug.h>
+
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+
+namespace Vortex {
+
+// Length of the hop between output segments in milliseconds. Segments are two hops long and
+// overlap by half. Shorter segments smear transients less, longer segments keep more of the bass.
+static const int HOP_MS = 12;
+
+TimeStretch::TimeStretch()
+	: mySrcL(nullptr)
+	, mySrcR(nullptr)
+	, mySrcFrames(0)
+	, myVolume(1.0f)
+	, myHop(0)
+	, mySearchRadius(0)
+	, myOutputPos(0)
+	, myNominalPos(0.0)
+	, myPrevSegment(0)
+	, myHasTail(false)
+{
+}
+
+void TimeStretch::setup(int samplerate)
+{
+	// The hop and search radius are kept even, so they can be searched at half resolution.
+	myHop = max(64, samplerate * HOP_MS / 1000) & ~1;
+	mySearchRadius = (myHop / 2) & ~1;
+
+	// A periodic Hann window, the two overlapping halves of which add up to one.
+	int size = myHop * 2;
+	myWindow.resize(size);
+	for(int i = 0; i < size; ++i)
+	{
+		myWindow[i] = (float)(0.5 - 0.5 * cos(6.283185307179586 * i / size));
+	}
+
+	mySegL.resize(size);
+	mySegR.resize(size);
+	myTailL.resize(myHop);
+	myTailR.resize(myHop);
+	myTarget.resize(myHop / 2);
+	mySearch.resize((myHop + mySearchRadius * 2) / 2);
+	myOutput.resize(myHop * 2);
+
+	reset(0.0);
+}
+
+void TimeStretch::reset(double srcPos)
+{
+	// Pretend the previous segment ended right at the new position. The first hop then matches it
+	// perfectly, and the output starts as an exact copy of the source.
+	myNominalPos = srcPos;
+	myPrevSegment = llround(srcPos) - myHop;
+	myOutputPos = myHop;
+	myHasTail = false;
+}
+
+void TimeStretch::readSegment(float* outL, float* outR, int64_t pos, int numFrames)
+{
+	for(int i = 0; i < numFrames; ++i, ++pos)
+	{
+		bool inside = (pos >= 0 && pos < mySrcFrames);
+		outL[i] = inside ? (float)mySrcL[pos] : 0.0f;
+		outR[i] = inside ? (float)mySrcR[pos] : 0.0f;
+	}
+}
+
+void TimeStretch::readMono(float* out, int64_t pos, int numFrames, int step)
+{
+	for(int i = 0, n = numFrames / step; i < n; ++i)
+	{
+		int sum = 0;
+		for(int j = 0; j < step; ++j, ++pos)
+		{
+			if(pos >= 0 && pos < mySrcFrames) sum += mySrcL[pos] + mySrcR[pos];
+		}
+		out[i] = (float)sum;
+	}
+}
+
+int64_t TimeStretch::findBestOffset(int64_t nominal)
+{
+	// The target is the natural continuation of the previous segment. It is compared against
+	// every candidate position within the search radius of the nominal position, on a downmixed
+	// signal at half resolution. The score is the correlation normalized by the candidate energy.
+	int targetSize = myHop / 2;
+	int numCandidates = mySearchRadius + 1;
+	int64_t searchBegin = nominal - mySearchRadius;
+
+	const float* target = myTarget.data();
+	const float* search = mySearch.data();
+	readMono(myTarget.data(), myPrevSegment + myHop, myHop, 2);
+	readMono(mySearch.data(), searchBegin, myHop + mySearchRadius * 2, 2);
+
+	double energy = 0.0;
+	for(int i = 0; i < targetSize; ++i)
+	{
+		energy += (double)search[i] * search[i];
+	}
+
+	int best = numCandidates / 2;
+	double bestScore = 0.0;
+	for(int c = 0; c < numCandidates; ++c)
+	{
+		if(c > 0)
+		{
+			double out = search[c - 1], in = search[c + targetSize - 1];
+			energy += in * in - out * out;
+		}
+		float corr = 0.0f;
+		for(int i = 0; i < targetSize; ++i)
+		{
+			corr += target[i] * search[c + i];
+		}
+		if(energy > 1.0)
+		{
+			double score = (double)corr * fabs((double)corr) / energy;
+			if(score > bestScore)
+			{
+				bestScore = score;
+				best = c;
+			}
+		}
+	}
+	int64_t pos = searchBegin + best * 2;
+
+	// Refine the match at full resolution, between the neighbouring half resolution positions.
+	float* fullTarget = mySegL.data();
+	float* fullSearch = mySegR.data();
+	readMono(fullTarget, myPrevSegment + myHop, myHop, 1);
+	readMono(fullSearch, pos - 1, myHop + 2, 1);
+
+	int bestOffset = 0;
+	bestScore = -1.0;
+	for(int offset = -1; offset <= 1; ++offset)
+	{
+		const float* candidate = fullSearch + 1 + offset;
+		double corr = 0.0, energy = 0.0;
+		for(int i = 0; i < myHop; ++i)
+		{
+			corr += (double)fullTarget[i] * candidate[i];
+			energy += (double)candidate[i] * candidate[i];
+		}
+		double score = (energy > 1.0) ? corr * fabs(corr) / energy : 0.0;
+		if(score > bestScore)
+		{
+			bestScore = score;
+			bestOffset = offset;
+		}
+	}
+
+	return pos + bestOffset;
+}
+
+void TimeStretch::nextHop(double rate)
+{
+	const float* window = myWindow.data();
+	float* segL = mySegL.data();
+	float* segR = mySegR.data();
+	float* tailL = myTailL.data();
+	float* tailR = myTailR.data();
+
+	// After a reset, the second half of the previous segment has not been read yet.
+	if(!myHasTail)
+	{
+		readSegment(segL, segR, myPrevSegment, myHop * 2);
+		for(int i = 0; i < myHop; ++i)
+		{
+			tailL[i] = segL[myHop + i] * window[myHop + i];
+			tailR[i] = segR[myHop + i] * window[myHop + i];
+		}
+	}
+
+	int64_t nominal = llround(myNominalPos);
+	int64_t pos = myHasTail ? findBestOffset(nominal) : nominal;
+
+	// Overlap-add the first half of the new segment with the tail of the previous segment.
+	readSegment(segL, segR, pos, myHop * 2);
+	short* out = myOutput.data();
+	for(int i = 0; i < myHop; ++i)
+	{
+		float l = (tailL[i] + segL[i] * window[i]) * myVolume;
+		float r = (tailR[i] + segR[i] * window[i]) * myVolume;
+		*out++ = (short)clamp((int)lrintf(l), SHRT_MIN, SHRT_MAX);
+		*out++ = (short)clamp((int)lrintf(r), SHRT_MIN, SHRT_MAX);
+		tailL[i] = segL[myHop + i] * window[myHop + i];
+		tailR[i] = segR[myHop + i] * window[myHop + i];
+	}
+
+	myPrevSegment = pos;
+	myNominalPos += myHop * rate;
+	myOutputPos = 0;
+	myHasTail = true;
+}
+
+void TimeStretch::process(short* dst, int numFrames, const short* srcL, const short* srcR,
+	int srcFrames, double rate, int volume)
+{
+	mySrcL = srcL;
+	mySrcR = srcR;
+	mySrcFrames = srcFrames;
+	myVolume = (float)volume / 32768.0f;
+
+	while(numFrames > 0)
+	{
+		if(myOutputPos == myHop) nextHop(rate);
+
+		int n = min(numFrames, myHop - myOutputPos);
+		memcpy(dst, myOutput.data() + myOutputPos * 2, sizeof(short) * 2 * n);
+		dst += n * 2;
+		myOutputPos += n;
+		numFrames -= n;
+	}
+}
+
+// ================================================================================================
+// Benchmark.
+
+#ifdef ENABLE_BENCHMARK
+
+// Stretches a synthetic song in blocks of the size requested by the mixer thread, and logs the
+// average and worst time per block against the time it takes to play a block. Returns false if
+// the worst block of any speed takes longer than playing it.
+bool BenchmarkTimeStretch()
+{
+	const int samplerate = 44100;
+	const int numFrames = samplerate * 240;
+	const int blockFrames = 8192;
+	const int speeds[] = {50, 100, 200, 400};
+
+	Vector<short> srcL(numFrames, 0), srcR(numFrames, 0), output(blockFrames * 2, 0);
+	for(int i = 0; i < numFrames; ++i)
+	{
+		double t = (double)i / samplerate;
+		double beat = exp(-fmod(t, 0.5) * 20.0);
+		srcL[i] = (short)(sin(t * 2764.6) * 8000.0 + sin(t * 345.6) * 8000.0 * beat + (int)((i * 7919u) % 2048));
+		srcR[i] = (short)(sin(t * 2073.5) * 8000.0 + sin(t * 345.6) * 8000.0 * beat - (int)((i * 104729u) % 2048));
+	}
+
+	TimeStretch stretch;
+	stretch.setup(samplerate);
+
+	double budget = (double)blockFrames / samplerate;
+	bool realtime = true;
+
+	Debug::blockBegin(Debug::INFO, "time stretch benchmark");
+	for(int speed : speeds)
+	{
+		double rate = speed / 100.0;
+		int numBlocks = (int)(numFrames / rate / blockFrames);
+
+		stretch.reset(0.0);
+		double total = 0.0, worst = 0.0;
+		for(int b = 0; b < numBlocks; ++b)
+		{
+			double start = Debug::getElapsedTime();
+			stretch.process(output.data(), blockFrames, srcL.data(), srcR.data(), numFrames, rate, 32768);
+			double elapsed = Debug::getElapsedTime(start);
+			total += elapsed;
+			worst = max(worst, elapsed);
+		}
+		double average = total / max(numBlocks, 1);
+		Debug::log("%i%%: %.3f ms avg, %.3f ms worst, budget %.1f ms (%.1f%% of one core)\n",
+			speed, average * 1000.0, worst * 1000.0, budget * 1000.0, worst / budget * 100.0);
+		realtime = realtime && (worst < budget);
+	}
+	Debug::blockEnd();
+
+	return realtime;
+}
+
+#endif // ENABLE_BENCHMARK
+
+}; // namespace Vortex
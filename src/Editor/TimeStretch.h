@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Core/Vector.h>
+
+namespace Vortex {
+
+/// Changes the playback speed of a stereo signal without changing its pitch, using waveform
+/// similarity overlap-add (WSOLA). The signal is cut into overlapping segments that are taken
+/// further apart (faster) or closer together (slower) than they are played back. Each segment is
+/// shifted slightly to the position where it lines up best with the previous one, which avoids
+/// the phase cancellation of plain overlap-add. The cost per output frame does not depend on the
+/// playback speed.
+class TimeStretch
+{
+public:
+	TimeStretch();
+
+	/// Sets the segment size for the given samplerate and resets the stretcher.
+	void setup(int samplerate);
+
+	/// Restarts the output at the given source frame. The next output frame is an exact copy of
+	/// that source frame, without blending with the previously played segments.
+	void reset(double srcPos);
+
+	/// Writes numFrames interleaved stereo frames to dst, read from planar samples of srcFrames
+	/// frames at the given speed ratio. Frames outside the source are read as silence. The volume
+	/// is a fixed point value in [0, 32768], where 32768 leaves the samples unchanged.
+	void process(short* dst, int numFrames, const short* srcL, const short* srcR, int srcFrames,
+		double rate, int volume);
+
+private:
+	void readSegment(float* outL, float* outR, int64_t pos, int numFrames);
+	void readMono(float* out, int64_t pos, int numFrames, int step);
+	int64_t findBestOffset(int64_t nominal);
+	void nextHop(double rate);
+
+	const short* mySrcL;
+	const short* mySrcR;
+	int mySrcFrames;
+	float myVolume;
+
+	int myHop, mySearchRadius;
+	Vector<float> myWindow;
+	Vector<float> mySegL, mySegR;
+	Vector<float> myTailL, myTailR;
+	Vector<float> myTarget, mySearch;
+	Vector<short> myOutput;
+	int myOutputPos;
+
+	double myNominalPos;
+	int64_t myPrevSegment;
+	bool myHasTail;
+};
+
+}; // namespace Vortex
@@ -9,6 +9,7 @@
 #include <Core/Gui.h>
 
 #include <System/System.h>
+#include <System/Profiler.h>
 
 #include <Editor/Music.h>
 #include <Editor/Editor.h>
@@ -305,6 +306,8 @@ void onChanges(int changes)
 
 void tick()
 {
+	VortexProfileZone("view tick");
+
 	vec2i windowSize = gSystem->getWindowSize();
 	rect_ = {0, 0, windowSize.x, windowSize.y};
 
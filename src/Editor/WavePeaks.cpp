@@ -0,0 +1,216 @@
+#include <Editor/WavePeaks.h>
+
+#include <Core/Utils.h>
+
+#include <limits.h>
+#include <stdint.h>
+#include <math.h>
+#include <utility>
+
+namespace Vortex {
+
+// The smallest bucket size of the pyramid, as a power of two.
+static const int BASE_SHIFT = 6;
+
+WavePeaks::WavePeaks()
+	: myReservedFrames(0)
+	, myNumBuiltFrames(0)
+{
+}
+
+void WavePeaks::swapLevels(WavePeaks& other)
+{
+	myLock.lock();
+	myPeaks[0].swap(other.myPeaks[0]);
+	myPeaks[1].swap(other.myPeaks[1]);
+	myLevelOffset.swap(other.myLevelOffset);
+	myLevelSize.swap(other.myLevelSize);
+	std::swap(myReservedFrames, other.myReservedFrames);
+	myNumBuiltFrames = other.myNumBuiltFrames.exchange(myNumBuiltFrames);
+	myLock.unlock();
+}
+
+void WavePeaks::clear()
+{
+	// The levels are released after they are swapped out, since other threads may be reading them.
+	WavePeaks empty;
+	swapLevels(empty);
+}
+
+void WavePeaks::reserve(int numFrames)
+{
+	// Each level halves the number of buckets, until a single bucket covers the entire signal.
+	WavePeaks reserved;
+	int total = 0;
+	for(int shift = BASE_SHIFT; numFrames > 0; ++shift)
+	{
+		int size = (int)(((int64_t)numFrames + (1LL << shift) - 1) >> shift);
+		reserved.myLevelOffset.push_back(total);
+		reserved.myLevelSize.push_back(0);
+		total += size;
+		if(size == 1) break;
+	}
+
+	reserved.myPeaks[0].resize(total);
+	reserved.myPeaks[1].resize(total);
+	reserved.myReservedFrames = numFrames;
+	swapLevels(reserved);
+}
+
+void WavePeaks::update(const short* samplesL, const short* samplesR, int numFrames, bool final)
+{
+	if(numFrames > myReservedFrames)
+	{
+		if(!final)
+		{
+			numFrames = myReservedFrames;
+		}
+		else
+		{
+			// The current levels may be read by other threads, so the peaks of the entire signal
+			// are built into new levels, which replace the current ones once they are finished.
+			WavePeaks rebuilt;
+			rebuilt.reserve(numFrames);
+			rebuilt.update(samplesL, samplesR, numFrames, true);
+			swapLevels(rebuilt);
+			return;
+		}
+	}
+
+	// The level sizes and the last bucket of each level are rewritten while other threads may be
+	// sampling lines, so the levels are only written while holding the lock.
+	myLock.lock();
+
+	int numLevels = myLevelSize.size();
+	if(numLevels == 0)
+	{
+		myLock.unlock();
+		return;
+	}
+
+	// The first level is read directly from the samples, and only contains full buckets.
+	int oldSize = myLevelSize[0];
+	int newSize = numFrames >> BASE_SHIFT;
+	if(final) newSize = myLevelOffset.size() > 1 ? myLevelOffset[1] : myPeaks[0].size();
+	for(int ch = 0; ch < 2; ++ch)
+	{
+		const short* samples = (ch == 0) ? samplesL : samplesR;
+		Peak* dst = myPeaks[ch].begin();
+		for(int b = oldSize; b < newSize; ++b)
+		{
+			int begin = b << BASE_SHIFT;
+			int end = min(begin + (1 << BASE_SHIFT), numFrames);
+			if(begin >= end)
+			{
+				dst[b] = {0, 0};
+				continue;
+			}
+			short lo = SHRT_MAX, hi = SHRT_MIN;
+			for(const short* s = samples + begin, *e = samples + end; s != e; ++s)
+			{
+				lo = min(lo, *s);
+				hi = max(hi, *s);
+			}
+			dst[b] = {lo, hi};
+		}
+	}
+	myLevelSize[0] = newSize;
+
+	// The other levels are combined from pairs of buckets of the previous level. The last bucket
+	// may only have one child yet, in which case it is rebuilt when the second child is added.
+	for(int level = 1; level < numLevels; ++level)
+	{
+		int childSize = myLevelSize[level - 1];
+		int begin = oldSize / 2;
+		int end = (childSize + 1) / 2;
+		for(int ch = 0; ch < 2; ++ch)
+		{
+			const Peak* src = myPeaks[ch].begin() + myLevelOffset[level - 1];
+			Peak* dst = myPeaks[ch].begin() + myLevelOffset[level];
+			for(int b = begin; b < end; ++b)
+			{
+				Peak peak = src[b * 2];
+				if(b * 2 + 1 < childSize)
+				{
+					peak.lo = min(peak.lo, src[b * 2 + 1].lo);
+					peak.hi = max(peak.hi, src[b * 2 + 1].hi);
+				}
+				dst[b] = peak;
+			}
+		}
+		oldSize = myLevelSize[level];
+		myLevelSize[level] = end;
+	}
+
+	// Only publish the new frame count once all levels are up to date.
+	myNumBuiltFrames = final ? numFrames : min(numFrames, myLevelSize[0] << BASE_SHIFT);
+
+	myLock.unlock();
+}
+
+void WavePeaks::sampleLines(Peak* out, int numLines, int channel, const short* samples,
+	double startFrame, double framesPerLine) const
+{
+	myLock.lock();
+
+	int numFrames = myNumBuiltFrames;
+	int numLevels = myLevelSize.size();
+
+	// Pick the level with the largest buckets that still fit within a single line, so each line
+	// is covered by at most a few buckets. Lines smaller than the base bucket read the samples.
+	int level = -1;
+	while(level + 1 < numLevels && (double)(1LL << (BASE_SHIFT + level + 1)) <= framesPerLine)
+	{
+		++level;
+	}
+
+	const Peak* peaks = nullptr;
+	int shift = 0, levelSize = 0;
+	if(level >= 0)
+	{
+		peaks = myPeaks[channel].begin() + myLevelOffset[level];
+		levelSize = myLevelSize[level];
+		shift = BASE_SHIFT + level;
+	}
+
+	for(int i = 0; i < numLines; ++i, ++out)
+	{
+		int64_t begin = llround(startFrame + framesPerLine * i);
+		int64_t end = llround(startFrame + framesPerLine * (i + 1));
+		begin = clamp(begin, (int64_t)0, (int64_t)numFrames);
+		end = clamp(end, (int64_t)0, (int64_t)numFrames);
+
+		short lo = SHRT_MAX, hi = SHRT_MIN;
+		if(begin < end)
+		{
+			if(levelSize > 0)
+			{
+				// Round the line boundaries to the nearest bucket boundaries, so consecutive
+				// lines partition the buckets between them.
+				int64_t half = 1LL << (shift - 1);
+				int b = (int)((begin + half) >> shift);
+				int e = (int)((end + half) >> shift);
+				e = min(max(e, b + 1), levelSize);
+				b = min(b, e - 1);
+				for(; b < e; ++b)
+				{
+					lo = min(lo, peaks[b].lo);
+					hi = max(hi, peaks[b].hi);
+				}
+			}
+			else
+			{
+				for(const short* s = samples + begin, *e = samples + end; s != e; ++s)
+				{
+					lo = min(lo, *s);
+					hi = max(hi, *s);
+				}
+			}
+		}
+		*out = {lo, hi};
+	}
+
+	myLock.unlock();
+}
+
+}; // namespace Vortex
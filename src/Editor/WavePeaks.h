@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Core/Vector.h>
+
+#include <System/Thread.h>
+
+#include <atomic>
+
+namespace Vortex {
+
+/// A pyramid of minimum/maximum amplitudes over a stereo pair of sample buffers. Each level
+/// stores one peak per bucket of frames, with the bucket size doubling from one level to the
+/// next. This allows the peaks of any range of frames to be found without scanning all of them.
+class WavePeaks
+{
+public:
+	struct Peak { short lo, hi; };
+
+	WavePeaks();
+
+	/// Removes all peaks and releases the reserved memory.
+	void clear();
+
+	/// Allocates the levels for a signal of the given number of frames. After reserving, "update"
+	/// can be called from a loading thread while other threads read the peaks that are finished.
+	void reserve(int numFrames);
+
+	/// Adds the peaks of the frames in the range [numBuiltFrames, numFrames). Buckets that are not
+	/// completely filled yet are skipped, unless the signal is final. If a final signal is longer
+	/// than the reserved frames, its peaks are built into new levels that replace the current ones.
+	void update(const short* samplesL, const short* samplesR, int numFrames, bool final);
+
+	/// Returns the number of frames covered by the finished peaks.
+	int getNumBuiltFrames() const { return myNumBuiltFrames; }
+
+	/// Writes the minimum and maximum amplitude of numLines consecutive lines, where line i covers
+	/// the frames [startFrame + i * framesPerLine, startFrame + (i + 1) * framesPerLine). If a line
+	/// contains no frames, it is written with lo > hi. For lines that are shorter than the smallest
+	/// bucket, the peaks are read directly from the channel samples.
+	void sampleLines(Peak* out, int numLines, int channel, const short* samples,
+		double startFrame, double framesPerLine) const;
+
+private:
+	void swapLevels(WavePeaks& other);
+
+	// Held while the levels are replaced or written by update, and while sampleLines reads them.
+	mutable CriticalSection myLock;
+
+	Vector<Peak> myPeaks[2];
+	Vector<int> myLevelOffset;
+	Vector<int> myLevelSize;
+	int myReservedFrames;
+	std::atomic<int> myNumBuiltFrames;
+};
+
+}; // namespace Vortex
@@ -12,6 +12,8 @@
 
 #include <System/System.h>
 #include <System/Debug.h>
+#include <System/Thread.h>
+#include <System/Profiler.h>
 
 #include <Editor/Music.h>
 #include <Editor/View.h>
@@ -20,19 +22,133 @@
 #include <Editor/Menubar.h>
 #include <Editor/TextOverlay.h>
 #include <Editor/Butterworth.h>
+#include <Editor/WavePeaks.h>
 
 namespace Vortex {
 
 static const int TEX_W = 256;
 static const int TEX_H = 128;
 static const int UNUSED_BLOCK = -1;
+static const int PREFETCH_BLOCKS = 2;
+static const int MAX_WORKERS = 4;
 
 struct WaveBlock
 {
 	int id;
+	int version;
 	Texture tex[4];
 };
 
+// ================================================================================================
+// WaveFilterCache.
+
+// The filtered samples are evaluated lazily, in chunks of a fixed number of frames. The chunks are
+// kept in a cache that is shared by all filters, so changing the filter strength and changing it
+// back again does not require the samples to be filtered again.
+
+static const int FILTER_CHUNK_FRAMES = 1 << 16;
+static const int FILTER_WARMUP_FRAMES = 4096;
+static const int FILTER_CACHE_CHUNKS = 64;
+static const int FILTER_PROBES = 32;
+static const int FILTER_PROBE_FRAMES = 8192;
+
+struct WaveFilterChunk
+{
+	int index;
+	Waveform::FilterType type;
+	double strength;
+	int lastUse;
+	int users;
+	Vector<short> samples[2];
+	WavePeaks peaks;
+};
+
+struct WaveFilterCache
+{
+	CriticalSection lock;
+	Vector<WaveFilterChunk*> chunks;
+	int useCounter;
+
+	WaveFilterCache() : useCounter(0) {}
+	~WaveFilterCache() { clear(); }
+
+	// Removes all chunks, should only be called when no jobs are running.
+	void clear()
+	{
+		for(auto chunk : chunks) delete chunk;
+		chunks.clear();
+	}
+
+	// Returns the chunk with the given key, or null if the chunk is not cached.
+	WaveFilterChunk* acquire(int index, Waveform::FilterType type, double strength)
+	{
+		WaveFilterChunk* out = nullptr;
+		lock.lock();
+		for(auto chunk : chunks)
+		{
+			if(chunk->index == index && chunk->type == type && chunk->strength == strength)
+			{
+				chunk->lastUse = ++useCounter;
+				++chunk->users;
+				out = chunk;
+				break;
+			}
+		}
+		lock.unlock();
+		return out;
+	}
+
+	// Adds a newly filtered chunk, evicting the least recently used chunks that are not in use.
+	// If another thread already added the same chunk, the new one is deleted and the cached
+	// one is returned instead.
+	WaveFilterChunk* insert(WaveFilterChunk* chunk)
+	{
+		WaveFilterChunk* out = chunk;
+		lock.lock();
+		for(auto it : chunks)
+		{
+			if(it->index == chunk->index && it->type == chunk->type && it->strength == chunk->strength)
+			{
+				out = it;
+				break;
+			}
+		}
+		if(out != chunk)
+		{
+			delete chunk;
+		}
+		else
+		{
+			while(chunks.size() >= FILTER_CACHE_CHUNKS)
+			{
+				int oldest = -1;
+				for(int i = 0; i < chunks.size(); ++i)
+				{
+					if(chunks[i]->users == 0 && (oldest < 0 || chunks[i]->lastUse < chunks[oldest]->lastUse))
+					{
+						oldest = i;
+					}
+				}
+				if(oldest < 0) break;
+				delete chunks[oldest];
+				chunks.erase(oldest);
+			}
+			chunks.push_back(chunk);
+		}
+		out->lastUse = ++useCounter;
+		++out->users;
+		lock.unlock();
+		return out;
+	}
+
+	void release(WaveFilterChunk* chunk)
+	{
+		lock.lock();
+		--chunk->users;
+		lock.unlock();
+	}
+};
+
 // ================================================================================================
 // WaveFilter.
 
@@ -41,56 +157,451 @@ struct WaveFilter {
 Waveform::FilterType type;
 double strength;
 
-Vector<short> samplesL;
-Vector<short> samplesR;
+WaveFilterCache* cache;
+double coefB[4], coefA[4];
+short maxAmp[2];
+bool isReady;
 
-static void lowPassFilter(const short* src, short* dst,
-	int numFrames, int samplerate, double strength)
+WaveFilter(Waveform::FilterType type, double strength, WaveFilterCache* cache)
+	: type(type), strength(strength), cache(cache)
 {
-	double cutoff = 0.01 + 0.1 * (1.0 - strength);
-	LowPassFilter(dst, src, numFrames, cutoff);
+	if(type == Waveform::FT_LOW_PASS)
+	{
+		double cutoff = 0.01 + 0.1 * (1.0 - strength);
+		ButterLowPassCoefs(3, cutoff, coefB, coefA);
+	}
+	else
+	{
+		double cutoff = 0.10 + 0.80 * strength;
+		ButterHighPassCoefs(3, cutoff, coefB, coefA);
+	}
+	update();
 }
 
-static void highPassFilter(const short* src, short* dst,
-	int numFrames, int samplerate, double strength)
+// Filters the frames [begin, end) of a channel. The filter starts a number of frames before the
+// range, so the filter state has settled by the time the range is reached.
+void filterRange(int channel, int begin, int end, Vector<short>& out, Vector<short>& tmp)
 {
-	double cutoff = 0.10 + 0.80 * strength;
-	HighPassFilter(dst, src, numFrames, cutoff);
-}
+	auto& music = gMusic->getSamples();
+	const short* src = (channel == 0) ? music.samplesL() : music.samplesR();
 
-WaveFilter(Waveform::FilterType type, double strength)
-	: type(type), strength(strength)
-{
-	update();
+	int warmup = min(begin, FILTER_WARMUP_FRAMES);
+	tmp.resize(warmup + end - begin);
+	FilterOrder3Raw(coefB, coefA, src + begin - warmup, tmp.begin(), tmp.size());
+
+	out.resize(end - begin);
+	memcpy(out.begin(), tmp.begin() + warmup, sizeof(short) * (end - begin));
 }
 
+// The amplitude of the filtered signal is normalized. Since the entire signal is never filtered,
+// the maximum amplitude is estimated from a number of probe windows spread over the song.
 void update()
 {
-	auto filter = highPassFilter;
-	if(type == Waveform::FT_LOW_PASS)
+	auto& music = gMusic->getSamples();
+	isReady = music.isCompleted() && music.getNumFrames() > 0;
+	maxAmp[0] = maxAmp[1] = 1;
+	if(!isReady) return;
+
+	Vector<short> out, tmp;
+	int numFrames = music.getNumFrames();
+	for(int i = 0; i < FILTER_PROBES; ++i)
 	{
-		filter = lowPassFilter;
+		int center = (int)((int64_t)numFrames * (i * 2 + 1) / (FILTER_PROBES * 2));
+		int begin = max(0, center - FILTER_PROBE_FRAMES / 2);
+		int end = min(numFrames, begin + FILTER_PROBE_FRAMES);
+		for(int ch = 0; ch < 2; ++ch)
+		{
+			filterRange(ch, begin, end, out, tmp);
+			for(auto v : out) maxAmp[ch] = max(maxAmp[ch], v);
+		}
 	}
+}
 
-	samplesL.release();
-	samplesR.release();
+// Returns the filtered chunk with the given index. The chunk is filtered if it is not cached yet,
+// and must be released to the cache after use.
+WaveFilterChunk* getChunk(int index)
+{
+	WaveFilterChunk* chunk = cache->acquire(index, type, strength);
+	if(chunk) return chunk;
 
 	auto& music = gMusic->getSamples();
-	if(music.isCompleted())
+	int begin = index * FILTER_CHUNK_FRAMES;
+	int end = min(begin + FILTER_CHUNK_FRAMES, music.getNumFrames());
+
+	chunk = new WaveFilterChunk;
+	chunk->index = index;
+	chunk->type = type;
+	chunk->strength = strength;
+	chunk->users = 0;
+
+	Vector<short> tmp;
+	for(int ch = 0; ch < 2; ++ch)
+	{
+		filterRange(ch, begin, end, chunk->samples[ch], tmp);
+		NormalizeAmplitude(chunk->samples[ch].begin(), end - begin, maxAmp[ch]);
+	}
+	chunk->peaks.update(chunk->samples[0].begin(), chunk->samples[1].begin(), end - begin, true);
+
+	return cache->insert(chunk);
+}
+
+// Same as WavePeaks::sampleLines, but for the filtered signal. The lines are sampled from each
+// chunk they overlap with, and the results are merged. Uses tmp as scratch buffer.
+void sampleLines(WavePeaks::Peak* out, WavePeaks::Peak* tmp, int numLines, int channel,
+	double startFrame, double framesPerLine)
+{
+	for(int i = 0; i < numLines; ++i)
 	{
-		int numFrames = music.getNumFrames();
-		int samplerate = music.getFrequency();
+		out[i] = {SHRT_MAX, SHRT_MIN};
+	}
+	if(!isReady) return;
 
-		samplesL.resize(numFrames, 0);
-		samplesR.resize(numFrames, 0);
+	int numFrames = gMusic->getSamples().getNumFrames();
+	double endFrame = min(startFrame + framesPerLine * numLines, (double)numFrames);
+	if(endFrame <= startFrame) return;
 
-		filter(music.samplesL(), samplesL.begin(), numFrames, samplerate, strength);
-		filter(music.samplesR(), samplesR.begin(), numFrames, samplerate, strength);
+	int first = max(0, (int)startFrame / FILTER_CHUNK_FRAMES);
+	int last = ((int)ceil(endFrame) - 1) / FILTER_CHUNK_FRAMES;
+	for(int index = first; index <= last; ++index)
+	{
+		WaveFilterChunk* chunk = getChunk(index);
+		double chunkStart = startFrame - (double)index * FILTER_CHUNK_FRAMES;
+		const short* samples = chunk->samples[channel].begin();
+		chunk->peaks.sampleLines(tmp, numLines, channel, samples, chunkStart, framesPerLine);
+		for(int i = 0; i < numLines; ++i)
+		{
+			out[i].lo = min(out[i].lo, tmp[i].lo);
+			out[i].hi = max(out[i].hi, tmp[i].hi);
+		}
+		cache->release(chunk);
 	}
 }
 
 }; // WaveFilter.
 
+// ================================================================================================
+// WaveRaster :: luminance functions.
+
+struct WaveEdge { int l, r; uchar lum; };
+
+static void EdgeLumUniform(WaveEdge* edge, int h)
+{
+	for(int y = 0; y < h; ++y, ++edge)
+	{
+		edge->lum = 255;
+	}
+}
+
+static void EdgeLumAmplitude(WaveEdge* edge, int w, int h)
+{
+	int scalar = (255 << 16) * 2 / w;
+	for(int y = 0; y < h; ++y, ++edge)
+	{
+		int mag = max(abs(edge->l), abs(edge->r));
+		edge->lum = (mag * scalar) >> 16;
+	}
+}
+
+// ================================================================================================
+// WaveRaster :: edge shape functions.
+
+static void EdgeShapeRectified(uchar* dst, const WaveEdge* edge, int w, int h)
+{
+	int cx = w / 2;
+	for(int y = 0; y < h; ++y, dst += w, ++edge)
+	{
+		int mag = max(abs(edge->l), abs(edge->r));
+		int l = cx - mag;
+		int r = cx + mag;
+		for(int x = l; x < r; ++x) dst[x] = edge->lum;
+	}
+}
+
+static void EdgeShapeSigned(uchar* dst, const WaveEdge* edge, int w, int h)
+{
+	int cx = w / 2;
+	for(int y = 0; y < h; ++y, dst += w, ++edge)
+	{
+		int l = cx + min(edge->l, 0);
+		int r = cx + max(edge->r, 0);
+		for(int x = l; x < r; ++x) dst[x] = edge->lum;
+	}
+}
+
+// ================================================================================================
+// WaveRaster :: anti-aliasing functions.
+
+// The anti-aliasing functions downsample the buffer in place, the result is written to the start.
+
+static void AntiAlias2x(uchar* buf, int w, int h)
+{
+	uchar* dst = buf;
+	int newW = w / 2, newH = h / 2;
+	for(int y = 0; y < newH; ++y)
+	{
+		const uchar* line = buf + (y * 2) * w;
+		for(int x = 0; x < newW; ++x, ++dst)
+		{
+			const uchar* a = line + (x * 2), *b = a + w;
+			int sum = 0;
+			sum += a[0] + a[1];
+			sum += b[0] + b[1];
+			*dst = sum / 4;
+		}
+	}
+}
+
+static void AntiAlias3x(uchar* buf, int w, int h)
+{
+	uchar* dst = buf;
+	int newW = w / 3, newH = h / 3;
+	for(int y = 0; y < newH; ++y)
+	{
+		const uchar* line = buf + (y * 3) * w;
+		for(int x = 0; x < newW; ++x, ++dst)
+		{
+			const uchar* a = line + (x * 3);
+			const uchar* b = a + w, *c = b + w;
+			int sum = 0;
+			sum += a[0] + a[1] + a[2];
+			sum += b[0] + b[1] + b[2];
+			sum += c[0] + c[1] + c[2];
+			*dst = sum / 9;
+		}
+	}
+}
+
+static void AntiAlias4x(uchar* buf, int w, int h)
+{
+	uchar* dst = buf;
+	int newW = w / 4, newH = h / 4;
+	for(int y = 0; y < newH; ++y)
+	{
+		const uchar* line = buf + (y * 4) * w;
+		for(int x = 0; x < newW; ++x, ++dst)
+		{
+			const uchar* a = line + (x * 4), *b = a + w;
+			const uchar* c = b + w, *d = c + w;
+			int sum = 0;
+			sum += a[0] + a[1] + a[2] + a[3];
+			sum += b[0] + b[1] + b[2] + b[3];
+			sum += c[0] + c[1] + c[2] + c[3];
+			sum += d[0] + d[1] + d[2] + d[3];
+			*dst = sum / 16;
+		}
+	}
+}
+
+// ================================================================================================
+// WaveJob.
+
+// A request to rasterize a single block. Everything that affects the block is copied into the job
+// when it is queued, so the job can be processed on a worker thread without touching the editor.
+struct WaveJob
+{
+	enum State { QUEUED, RUNNING, DONE };
+
+	struct Source
+	{
+		const WavePeaks* peaks;
+		const short* samples[2];
+		WaveFilter* filter;
+	};
+
+	int blockId;
+	int version;
+	State state;
+
+	int blockW;
+	int antiAliasing;
+	Waveform::Luminance luminance;
+	Waveform::WaveShape shape;
+	double samplesPerPixel;
+
+	int numSources;
+	Source sources[2];
+
+	Vector<uchar> pixels[4];
+};
+
+// ================================================================================================
+// WaveRaster.
+
+// Scratch buffers for rasterizing blocks, each worker thread has its own.
+struct WaveRaster {
+
+Vector<uchar> buffer;
+Vector<WaveEdge> edges;
+Vector<WavePeaks::Peak> lines;
+Vector<WavePeaks::Peak> scratch;
+
+void sampleEdges(const WaveJob* job, const WaveJob::Source& src, int channel, int w, int h)
+{
+	// Find the minimum/maximum amplitude of each line, lines outside the song are left empty.
+	double startFrame = job->samplesPerPixel * TEX_H * (double)max(job->blockId, 0);
+	double framesPerLine = job->samplesPerPixel * TEX_H / h;
+	if(src.filter)
+	{
+		src.filter->sampleLines(lines.begin(), scratch.begin(), h, channel, startFrame, framesPerLine);
+	}
+	else
+	{
+		src.peaks->sampleLines(lines.begin(), h, channel, src.samples[channel], startFrame, framesPerLine);
+	}
+
+	int wh = w / 2 - 1;
+	for(int y = 0; y < h; ++y)
+	{
+		// Clamp the minimum/maximum amplitude.
+		int l = (lines[y].lo * wh) >> 15;
+		int r = (lines[y].hi * wh) >> 15;
+		if(r >= l)
+		{
+			edges[y] = {clamp(l, -wh, wh), clamp(r, -wh, wh), 0};
+		}
+		else
+		{
+			edges[y] = {0, 0, 0};
+		}
+	}
+}
+
+void render(WaveJob* job)
+{
+	int w = job->blockW * (job->antiAliasing + 1);
+	int h = TEX_H * (job->antiAliasing + 1);
+
+	buffer.resize(w * h);
+	edges.resize(h);
+	lines.resize(h);
+	scratch.resize(h);
+
+	uchar* texBuf = buffer.begin();
+	WaveEdge* edgeBuf = edges.begin();
+	for(int i = 0; i < job->numSources * 2; ++i)
+	{
+		memset(texBuf, 0, w * h);
+
+		// Process edges
+		sampleEdges(job, job->sources[i / 2], i % 2, w, h);
+
+		// Apply luminance
+		if(job->luminance == Waveform::LL_UNIFORM) {
+			EdgeLumUniform(edgeBuf, h);
+		}
+		else if(job->luminance == Waveform::LL_AMPLITUDE) {
+			EdgeLumAmplitude(edgeBuf, w, h);
+		}
+
+		// Apply wave shape
+		if(job->shape == Waveform::WS_RECTIFIED) {
+			EdgeShapeRectified(texBuf, edgeBuf, w, h);
+		}
+		else if(job->shape == Waveform::WS_SIGNED) {
+			EdgeShapeSigned(texBuf, edgeBuf, w, h);
+		}
+
+		// Apply anti-aliasing
+		switch(job->antiAliasing) {
+		case 1: AntiAlias2x(texBuf, w, h); break;
+		case 2: AntiAlias3x(texBuf, w, h); break;
+		case 3: AntiAlias4x(texBuf, w, h); break;
+		}
+
+		job->pixels[i] = Vector<uchar>(texBuf, texBuf + job->blockW * TEX_H);
+	}
+}
+
+}; // WaveRaster.
+
+// ================================================================================================
+// WaveJobQueue.
+
+struct WaveJobQueue
+{
+	CriticalSection lock;
+	Vector<WaveJob*> jobs;
+
+	// Wakes up an idle worker when jobs are queued, or when the workers have to stop.
+	Event wake;
+
+	// Signaled whenever a running job is done.
+	Event finished;
+
+	bool stop;
+
+	WaveJobQueue() : stop(false) {}
+
+	// Takes the first queued job, or returns null if there are no queued jobs left. If more jobs
+	// are queued, another worker is woken up to take them.
+	WaveJob* next()
+	{
+		WaveJob* out = nullptr;
+		bool hasMore = false;
+		lock.lock();
+		for(auto job : jobs)
+		{
+			if(job->state != WaveJob::QUEUED) continue;
+			if(out)
+			{
+				hasMore = true;
+				break;
+			}
+			job->state = WaveJob::RUNNING;
+			out = job;
+		}
+		lock.unlock();
+		if(hasMore) wake.signal();
+		return out;
+	}
+
+	void finish(WaveJob* job)
+	{
+		lock.lock();
+		job->state = WaveJob::DONE;
+		lock.unlock();
+		finished.signal();
+	}
+
+	// Returns true if a worker is still rendering one of the jobs.
+	bool isRunning()
+	{
+		bool running = false;
+		lock.lock();
+		for(auto job : jobs)
+		{
+			running |= (job->state == WaveJob::RUNNING);
+		}
+		lock.unlock();
+		return running;
+	}
+};
+
+// A worker thread that waits until jobs are queued, and processes them until the queue is empty.
+// The workers are created once, so scrolling does not keep creating and joining threads.
+struct WaveWorker : public BackgroundThread
+{
+	WaveJobQueue* queue;
+	WaveRaster raster;
+
+	WaveWorker(WaveJobQueue* queue) : queue(queue) {}
+
+	void exec() override
+	{
+		for(queue->wake.wait(); !queue->stop; queue->wake.wait())
+		{
+			for(WaveJob* job = queue->next(); job; job = queue->next())
+			{
+				raster.render(job);
+				queue->finish(job);
+			}
+		}
+
+		// Pass the stop request on to the next worker.
+		queue->wake.signal();
+	}
+};
+
 // ================================================================================================
 // WaveformImpl :: member data.
 
@@ -98,10 +609,17 @@ struct WaveformImpl : public Waveform {
 
 Vector<WaveBlock*> waveformBlocks_;
 
+WaveJobQueue waveformJobs_;
+Vector<WaveWorker*> waveformWorkers_;
+WaveRaster waveformRaster_;
+
+WaveFilterCache waveformFilterCache_;
 WaveFilter* waveformFilter_;
-Vector<uchar> waveformTextureBuffer_;
 
 int waveformBlockWidth_, waveformSpacing_;
+int waveformBuiltFrames_;
+int waveformVersion_, waveformClearVersion_;
+int waveformScrollY_, waveformScrollDir_;
 
 ColorScheme waveformColorScheme_;
 WaveShape waveformShape_;
@@ -114,19 +632,26 @@ bool waveformOverlayFilter_;
 
 ~WaveformImpl()
 {
+	cancelJobs();
+	stopWorkers();
 	for(auto block : waveformBlocks_) delete block;
 	delete waveformFilter_;
 }
 
 WaveformImpl()
 {
+	waveformVersion_ = 0;
+	waveformClearVersion_ = 0;
+	waveformScrollY_ = 0;
+	waveformScrollDir_ = 1;
+
 	setPreset(PRESET_VORTEX);
 
 	waveformFilter_ = nullptr;
 	waveformOverlayFilter_ = true;
+	waveformBuiltFrames_ = 0;
 
 	updateBlockW();
-	waveformTextureBuffer_.resize(TEX_W * TEX_H);
 
 	clearBlocks();
 }
@@ -205,10 +730,15 @@ void saveSettings(XmrNode& settings)
 
 void clearBlocks()
 {
-	for(auto block : waveformBlocks_)
-	{
-		block->id = UNUSED_BLOCK;
-	}
+	// Existing blocks are no longer shown, and queued jobs are dropped on the next draw.
+	++waveformVersion_;
+	waveformClearVersion_ = waveformVersion_;
+}
+
+void refreshBlocks()
+{
+	// Existing blocks are still shown until their replacement is rendered.
+	++waveformVersion_;
 }
 
 void setOverlayFilter(bool enabled)
@@ -225,20 +755,29 @@ bool getOverlayFilter()
 
 void enableFilter(FilterType type, double strength)
 {
+	cancelJobs();
 	delete waveformFilter_;
-	waveformFilter_ = new WaveFilter(type, strength);
+	waveformFilter_ = new WaveFilter(type, strength, &waveformFilterCache_);
 
 	clearBlocks();
 }
 
 void disableFilter()
 {
+	cancelJobs();
 	delete waveformFilter_;
 	waveformFilter_ = nullptr;
 
 	clearBlocks();
 }
 
+void unloadMusic()
+{
+	cancelJobs();
+	waveformFilterCache_.clear();
+	if(waveformFilter_) waveformFilter_->isReady = false;
+}
+
 int getWidth()
 {
 	return waveformBlockWidth_ * 2 + waveformSpacing_ * 2 + 8;
@@ -248,12 +787,30 @@ void onChanges(int changes)
 {
 	if(changes & VCM_MUSIC_IS_LOADED)
 	{
+		cancelJobs();
+		waveformFilterCache_.clear();
 		if(waveformFilter_) waveformFilter_->update();
 	}
 }
 
 void tick()
 {
+	VortexProfileZone("waveform tick");
+
+	// While the music is streaming in, redraw the blocks once the new peaks cover at least another
+	// block, instead of rendering all visible blocks again on every frame.
+	auto& music = gMusic->getSamples();
+	int builtFrames = music.getPeaks().getNumBuiltFrames();
+	if(builtFrames != waveformBuiltFrames_)
+	{
+		double blockFrames = music.getFrequency() * TEX_H / max(fabs(gView->getPixPerSec()), 1.0);
+		if(builtFrames < waveformBuiltFrames_ || music.isCompleted()
+			|| builtFrames - waveformBuiltFrames_ >= blockFrames)
+		{
+			waveformBuiltFrames_ = builtFrames;
+			refreshBlocks();
+		}
+	}
 }
 
 void setPreset(Preset preset)
@@ -324,283 +881,218 @@ int getAntiAliasing()
 }
 
 // ================================================================================================
-// Waveform :: luminance functions.
-
-struct WaveEdge { int l, r; uchar lum; };
+// WaveformImpl :: block jobs.
 
-void edgeLumUniform(WaveEdge* edge, int h)
+void cancelJobs()
 {
-	for(int y = 0; y < h; ++y, ++edge)
+	// Drop the queued jobs, and wait until the workers are done with their running jobs.
+	waveformJobs_.lock.lock();
+	for(int i = waveformJobs_.jobs.size() - 1; i >= 0; --i)
 	{
-		edge->lum = 255;
+		WaveJob* job = waveformJobs_.jobs[i];
+		if(job->state == WaveJob::QUEUED)
+		{
+			delete job;
+			waveformJobs_.jobs.erase(i);
+		}
 	}
-}
+	waveformJobs_.lock.unlock();
 
-void edgeLumAmplitude(WaveEdge* edge, int w, int h)
-{
-	int scalar = (255 << 16) * 2 / w;
-	for(int y = 0; y < h; ++y, ++edge)
+	while(waveformJobs_.isRunning())
 	{
-		int mag = max(abs(edge->l), abs(edge->r));
-		edge->lum = (mag * scalar) >> 16;
+		waveformJobs_.finished.wait();
 	}
-}
-
-// ================================================================================================
-// Waveform :: edge shape functions.
 
-void edgeShapeRectified(uchar* dst, const WaveEdge* edge, int w, int h)
-{
-	int cx = w / 2;
-	for(int y = 0; y < h; ++y, dst += w, ++edge)
-	{
-		int mag = max(abs(edge->l), abs(edge->r));
-		int l = cx - mag;
-		int r = cx + mag;
-		for(int x = l; x < r; ++x) dst[x] = edge->lum;
-	}
+	for(auto job : waveformJobs_.jobs) delete job;
+	waveformJobs_.jobs.clear();
 }
 
-void edgeShapeSigned(uchar* dst, const WaveEdge* edge, int w, int h)
+void startWorkers()
 {
-	int cx = w / 2;
-	for(int y = 0; y < h; ++y, dst += w, ++edge)
+	int numWorkers = min(MAX_WORKERS, max(1, ParallelThreads::concurrency() - 1));
+	while(waveformWorkers_.size() < numWorkers)
 	{
-		int l = cx + min(edge->l, 0);
-		int r = cx + max(edge->r, 0);
-		for(int x = l; x < r; ++x) dst[x] = edge->lum;
+		WaveWorker* worker = new WaveWorker(&waveformJobs_);
+		waveformWorkers_.push_back(worker);
+		worker->start();
 	}
 }
 
-// ================================================================================================
-// Waveform :: anti-aliasing functions.
-
-void antiAlias2x(uchar* dst, int w, int h)
+void stopWorkers()
 {
-	int newW = w / 2, newH = h / 2;
-	for(int y = 0; y < newH; ++y)
+	waveformJobs_.stop = true;
+	waveformJobs_.wake.signal();
+	for(auto worker : waveformWorkers_)
 	{
-		uchar* line = waveformTextureBuffer_.begin() + (y * 2) * w;
-		for(int x = 0; x < newW; ++x, ++dst)
-		{
-			uchar* a = line + (x * 2), *b = a + w;
-			int sum = 0;
-			sum += a[0] + a[1];
-			sum += b[0] + b[1];
-			*dst = sum / 4;
-		}
+		worker->waitUntilDone();
+		delete worker;
 	}
+	waveformWorkers_.clear();
 }
 
-void antiAlias3x(uchar* dst, int w, int h)
+WaveBlock* getBlock(int id)
 {
-	int newW = w / 3, newH = h / 3;
-	for(int y = 0; y < newH; ++y)
+	for(auto block : waveformBlocks_)
 	{
-		uchar* line = waveformTextureBuffer_.begin() + (y * 3) * w;
-		for(int x = 0; x < newW; ++x, ++dst)
+		if(block->id == id)
 		{
-			uchar* a = line + (x * 3);
-			uchar* b = a + w, *c = b + w;
-			int sum = 0;
-			sum += a[0] + a[1] + a[2];
-			sum += b[0] + b[1] + b[2];
-			sum += c[0] + c[1] + c[2];
-			*dst = sum / 9;
+			return block;
 		}
 	}
+	return nullptr;
 }
 
-void antiAlias4x(uchar* dst, int w, int h)
+WaveBlock* acquireBlock(int id)
 {
-	int newW = w / 4, newH = h / 4;
-	for(int y = 0; y < newH; ++y)
+	// Check if we already have the requested block.
+	WaveBlock* block = getBlock(id);
+	if(block) return block;
+
+	// If not, check if we have any free blocks available.
+	for(auto block : waveformBlocks_)
 	{
-		uchar* line = waveformTextureBuffer_.begin() + (y * 4) * w;
-		for(int x = 0; x < newW; ++x, ++dst)
+		if(block->id == UNUSED_BLOCK)
 		{
-			uchar* a = line + (x * 4), *b = a + w;
-			uchar* c = b + w, *d = c + w;
-			int sum = 0;
-			sum += a[0] + a[1] + a[2] + a[3];
-			sum += b[0] + b[1] + b[2] + b[3];
-			sum += c[0] + c[1] + c[2] + c[3];
-			sum += d[0] + d[1] + d[2] + d[3];
-			*dst = sum / 16;
+			block->id = id;
+			block->version = -1;
+			return block;
 		}
 	}
-}
 
-// ================================================================================================
-// Waveform :: block rendering functions.
+	// If not, create a new block.
+	block = new WaveBlock;
+	waveformBlocks_.push_back(block);
 
-void sampleEdges(WaveEdge* edges, int w, int h, int channel, int blockId, bool filtered)
-{
-	auto& music = gMusic->getSamples();
+	block->id = id;
+	block->version = -1;
+	return block;
+}
 
-	double samplesPerSec = (double)music.getFrequency();
-	double samplesPerPixel = samplesPerSec / fabs(gView->getPixPerSec());
-	double samplesPerBlock = (double)TEX_H * samplesPerPixel;
+void requestBlock(int id)
+{
+	if(id < 0) return;
 
-	int64_t srcFrames = filtered ? waveformFilter_->samplesL.size() : music.getNumFrames();
-	int64_t samplePos = max((int64_t)0, (int64_t)(samplesPerBlock * (double)blockId));
-	double sampleCount = min((double) srcFrames - samplePos, samplesPerBlock);
+	// Check if the block is up to date, or if a job for it is already queued.
+	WaveBlock* block = getBlock(id);
+	if(block && block->version == waveformVersion_) return;
 
-	if (samplePos >= srcFrames || sampleCount <= 0)
+	for(auto job : waveformJobs_.jobs)
 	{
-		// A crash could occur if we try to access out-of-bounds memory.
-		// Fill the edges with zeroes to avoid this issue.
-		for (int y = 0; y < h; ++y)
-		{
-			edges[y] = {0, 0, 0};
-		}
-		return;
+		if(job->blockId == id && job->version == waveformVersion_) return;
 	}
 
-	double sampleSkip = max(0.001, (samplesPerPixel / 200.0));
-	int wh = w / 2 - 1;
-
-	const short* in = nullptr;
-	if(filtered)
-	{
-		in = ((channel == 0) ? waveformFilter_->samplesL.begin() : waveformFilter_->samplesR.begin());
-	}
-	else
-	{
-		in = ((channel == 0) ? music.samplesL() : music.samplesR());
-	}
-	in += samplePos;
+	auto& music = gMusic->getSamples();
 
-	double advance = samplesPerPixel * TEX_H / h;
-	double ofs = 0;
-	for(int y = 0; y < h; ++y)
+	WaveJob* job = new WaveJob;
+	job->blockId = id;
+	job->version = waveformVersion_;
+	job->state = WaveJob::QUEUED;
+	job->blockW = waveformBlockWidth_;
+	job->antiAliasing = waveformAntiAliasingMode_;
+	job->luminance = waveformLuminance_;
+	job->shape = waveformShape_;
+	job->samplesPerPixel = (double)music.getFrequency() / fabs(gView->getPixPerSec());
+
+	WaveJob::Source source = {&music.getPeaks(), {music.samplesL(), music.samplesR()}, nullptr};
+	job->numSources = 1;
+	job->sources[0] = source;
+	if(waveformFilter_)
 	{
-		// Determine the last sample of the line.
-		double end = min(sampleCount, (double)(y + 1) * advance);
-
-		// Find the minimum/maximum amplitude within the line.
-		int minAmp = SHRT_MAX;
-		int maxAmp = SHRT_MIN;
-		while(ofs < end)
-		{
-			maxAmp = max(maxAmp, (int)*(in + (int) round(ofs)));
-			minAmp = min(minAmp, (int)*(in + (int) round(ofs)));
-			ofs += sampleSkip;
-		}
-
-		// Clamp the minimum/maximum amplitude.
-		int l = (minAmp * wh) >> 15;
-		int r = (maxAmp * wh) >> 15;
-		if(r >= l)
+		WaveJob::Source filtered = {nullptr, {nullptr, nullptr}, waveformFilter_};
+		if(waveformOverlayFilter_)
 		{
-			edges[y] = {clamp(l, -wh, wh), clamp(r, -wh, wh), 0};
+			job->numSources = 2;
+			job->sources[1] = filtered;
 		}
 		else
 		{
-			edges[y] = {0, 0, 0};
+			job->sources[0] = filtered;
 		}
 	}
+
+	waveformJobs_.lock.lock();
+	waveformJobs_.jobs.push_back(job);
+	waveformJobs_.lock.unlock();
 }
 
-void renderWaveform(Texture* textures, WaveEdge* edgeBuf, int w, int h, int blockId, bool filtered)
+void updateJobs(int keepBegin, int keepEnd)
 {
-	uchar* texBuf = waveformTextureBuffer_.begin();
-	for(int channel = 0; channel < 2; ++channel)
+	// Without multithreading, the queued jobs are rendered right away.
+	if(!gEditor->hasMultithreading())
 	{
-		memset(texBuf, 0, w * h);
-
-		// Process edges
-		sampleEdges(edgeBuf, w, h, channel, blockId, filtered);
-
-		// Apply luminance
-		if (waveformLuminance_ == LL_UNIFORM) {
-			edgeLumUniform(edgeBuf, h);
-		}
-		else if (waveformLuminance_ == LL_AMPLITUDE) {
-			edgeLumAmplitude(edgeBuf, w, h);
-		}
-
-		// Apply wave shape
-		if (waveformShape_ == WS_RECTIFIED) {
-			edgeShapeRectified(texBuf, edgeBuf, w, h);
-		}
-		else if (waveformShape_ == WS_SIGNED) {
-			edgeShapeSigned(texBuf, edgeBuf, w, h);
-		}
-
-		// Apply anti-aliasing
-		switch (waveformAntiAliasingMode_) {
-		case 1: antiAlias2x(texBuf, w, h); break;
-		case 2: antiAlias3x(texBuf, w, h); break;
-		case 3: antiAlias4x(texBuf, w, h); break;
-		}
-
-		// Create or update texture
-		if (!textures[channel].handle()) {
-			textures[channel] = Texture(TEX_W, TEX_H, Texture::ALPHA);
+		for(auto job : waveformJobs_.jobs)
+		{
+			if(job->state == WaveJob::QUEUED)
+			{
+				waveformRaster_.render(job);
+				job->state = WaveJob::DONE;
+			}
 		}
-		textures[channel].modify(0, 0, waveformBlockWidth_, TEX_H, texBuf);
 	}
-}
 
-void renderBlock(WaveBlock* block)
-{
-	int w = waveformBlockWidth_ * (waveformAntiAliasingMode_ + 1);
-	int h = TEX_H * (waveformAntiAliasingMode_ + 1);
-	waveformTextureBuffer_.resize(w * h);
+	// Collect the finished jobs, and drop queued jobs that are outdated or out of range.
+	Vector<WaveJob*> finished;
+	int numQueued = 0;
 
-	Vector<WaveEdge> edges;
-	edges.resize(h);
-
-	if(waveformFilter_)
+	waveformJobs_.lock.lock();
+	for(int i = waveformJobs_.jobs.size() - 1; i >= 0; --i)
 	{
-		if(waveformOverlayFilter_)
+		WaveJob* job = waveformJobs_.jobs[i];
+		bool inRange = (job->blockId >= keepBegin && job->blockId <= keepEnd);
+		if(job->state == WaveJob::DONE)
 		{
-			renderWaveform(block->tex + 0, edges.begin(), w, h, block->id, false);
-			renderWaveform(block->tex + 2, edges.begin(), w, h, block->id, true);
+			finished.push_back(job);
+			waveformJobs_.jobs.erase(i);
 		}
-		else
+		else if(job->state == WaveJob::QUEUED)
 		{
-			renderWaveform(block->tex, edges.begin(), w, h, block->id, true);
+			if(job->version != waveformVersion_ || !inRange)
+			{
+				delete job;
+				waveformJobs_.jobs.erase(i);
+			}
+			else
+			{
+				++numQueued;
+			}
 		}
 	}
-	else
-	{
-		renderWaveform(block->tex, edges.begin(), w, h, block->id, false);
-	}
-}
+	waveformJobs_.lock.unlock();
 
-WaveBlock* getBlock(int id)
-{
-	// Check if we already have the requested block.
-	for(auto block : waveformBlocks_)
+	// Upload the finished jobs to the block textures.
+	for(auto job : finished)
 	{
-		if(block->id == id)
+		bool inRange = (job->blockId >= keepBegin && job->blockId <= keepEnd);
+		if(inRange && job->version >= waveformClearVersion_ && job->blockW == waveformBlockWidth_)
 		{
-			return block;
+			WaveBlock* block = acquireBlock(job->blockId);
+			if(job->version > block->version)
+			{
+				for(int i = 0; i < job->numSources * 2; ++i)
+				{
+					if(!block->tex[i].handle())
+					{
+						block->tex[i] = Texture(TEX_W, TEX_H, Texture::ALPHA);
+					}
+					block->tex[i].modify(0, 0, job->blockW, TEX_H, job->pixels[i].begin());
+				}
+				block->version = job->version;
+			}
 		}
+		delete job;
 	}
 
-	// If not, check if we have any free blocks available.
-	for(auto block : waveformBlocks_)
+	// Wake up an idle worker for the remaining jobs, the workers are started by the first jobs.
+	if(numQueued > 0 && gEditor->hasMultithreading())
 	{
-		if(block->id == UNUSED_BLOCK)
-		{
-			block->id = id;
-			renderBlock(block);
-			return block;
-		}
+		startWorkers();
+		waveformJobs_.wake.signal();
 	}
-
-	// If not, create a new block.
-	WaveBlock* block = new WaveBlock;
-	waveformBlocks_.push_back(block);
-
-	block->id = id;
-	renderBlock(block);
-	return block;
 }
 
+// ================================================================================================
+// WaveformImpl :: drawing.
+
 void updateBlockW()
 {
 	int width = waveformBlockWidth_;
@@ -613,6 +1105,8 @@ void updateBlockW()
 
 void drawBackground()
 {
+	VortexProfileZone("waveform background");
+
 	updateBlockW();
 
 	int w = waveformBlockWidth_ * 2 + waveformSpacing_ * 2 + 8;
@@ -624,6 +1118,8 @@ void drawBackground()
 
 void drawPeaks()
 {
+	VortexProfileZone("waveform peaks");
+
 	updateBlockW();
 
 	bool reversed = gView->hasReverseScroll();
@@ -639,16 +1135,35 @@ void drawPeaks()
 		visibilityEndY = visibilityStartY + gView->getHeight();
 	}
 
-	// Free up blocks that are no longer visible.
+	// Track the scroll direction, so blocks ahead of the view can be prefetched.
+	if(visibilityStartY != waveformScrollY_)
+	{
+		waveformScrollDir_ = (visibilityStartY > waveformScrollY_) ? 1 : -1;
+		waveformScrollY_ = visibilityStartY;
+	}
+
+	// Request the visible blocks first, then the blocks ahead of and behind the view.
+	int beginId = max(0, visibilityStartY / TEX_H), endId = beginId;
+	for(; endId * TEX_H < visibilityEndY; ++endId)
+	{
+		requestBlock(endId);
+	}
+	for(int i = 0; i < PREFETCH_BLOCKS; ++i)
+	{
+		requestBlock((waveformScrollDir_ > 0) ? (endId + i) : (beginId - 1 - i));
+	}
+	requestBlock((waveformScrollDir_ > 0) ? (beginId - 1) : endId);
+
+	int keepBegin = beginId - PREFETCH_BLOCKS;
+	int keepEnd = endId - 1 + PREFETCH_BLOCKS;
+	updateJobs(keepBegin, keepEnd);
+
+	// Free up blocks that are no longer visible or prefetched.
 	for(auto block : waveformBlocks_)
 	{
-		if(block->id != UNUSED_BLOCK)
+		if(block->id != UNUSED_BLOCK && (block->id < keepBegin || block->id > keepEnd))
 		{
-			int y = block->id * TEX_H;
-			if(y >= visibilityEndY || y + TEX_H <= visibilityStartY)
-			{
-				block->id = UNUSED_BLOCK;
-			}
+			block->id = UNUSED_BLOCK;
 		}
 	}
 
@@ -661,18 +1176,27 @@ void drawPeaks()
 	areaf uvs = {0, 0, waveformBlockWidth_ / (float)TEX_W, 1};
 	if(reversed) swapValues(uvs.t, uvs.b);
 
-	int id = max(0, visibilityStartY / TEX_H);
-	for(; id * TEX_H < visibilityEndY; ++id)
-	{
-		auto block = getBlock(id);
+	color32 waveCol = ToColor32(waveformColorScheme_.wave);
+	colorf placeholder = waveformColorScheme_.wave;
+	placeholder.a *= 0.1f;
 
+	for(int id = beginId; id < endId; ++id)
+	{
 		int y = id * TEX_H - visibilityStartY;
 		if(reversed) y = gView->getHeight() - y - TEX_H;
 
+		// If the block is still being rendered, draw a placeholder in the meantime.
+		auto block = getBlock(id);
+		if(!block || block->version < waveformClearVersion_)
+		{
+			Draw::fill({xl - pw, y, pw * 2, TEX_H}, ToColor32(placeholder));
+			Draw::fill({xr - pw, y, pw * 2, TEX_H}, ToColor32(placeholder));
+			continue;
+		}
+
 		TextureHandle texL = block->tex[0].handle();
 		TextureHandle texR = block->tex[1].handle();
 
-		color32 waveCol = ToColor32(waveformColorScheme_.wave);
 		Draw::fill({xl - pw, y, pw * 2, TEX_H}, waveCol, texL, uvs, Texture::ALPHA);
 		Draw::fill({xr - pw, y, pw * 2, TEX_H}, waveCol, texR, uvs, Texture::ALPHA);
 
@@ -28,6 +28,10 @@ public:
 
 	virtual void clearBlocks() = 0;
 
+	/// Stops all work that reads from the music samples. Must be called before the music
+	/// samples are released.
+	virtual void unloadMusic() = 0;
+
 	virtual void setOverlayFilter(bool enabled) = 0;
 	virtual bool getOverlayFilter() = 0;
 	virtual void enableFilter(FilterType type, double strength) = 0;
@@ -1,6 +1,7 @@
 #include <Managers/NoteMan.h>
 
 #include <algorithm>
+#include <limits.h>
 
 #include <Core/Utils.h>
 #include <Core/StringUtils.h>
@@ -26,6 +27,10 @@ namespace Vortex {
 
 #define NOTE_MAN ((NotesManImpl*)gNotes)
 
+// Number of changed notes above which the column spans are rebuilt in one pass, instead of
+// shifting the spans of a column for every added or removed note.
+static const int SPAN_REBUILD_THRESHOLD = 64;
+
 const char* NotesMan::clipboardTag = "notes";
 
 struct NotesManImpl : public NotesMan {
@@ -33,8 +38,15 @@ struct NotesManImpl : public NotesMan {
 // ================================================================================================
 // NotesManImpl :: member data.
 
+// Row range of a note, used to look up the notes of a column by row.
+struct NoteSpan { int row, endrow; };
+
 Vector<ExpandedNote> myNotes;
 
+// The notes of a column do not overlap, so the spans of each column are sorted by both their
+// start and end row. This finds the hold or roll that covers a row without scanning the notes.
+Vector<NoteSpan> myColumnSpans[SIM_MAX_COLUMNS];
+
 int myNumSteps, myNumJumps;
 int myNumHolds, myNumRolls;
 int myNumMines, myNumWarps;
@@ -83,60 +95,101 @@ void myUpdateNotes()
 	auto it = myNotes.begin();
 	for(auto& note : myChart->notes)
 	{
-		it->row = note.row;
-		it->col = note.col;
-		it->endrow = note.endrow;
-		it->isMine = note.type == NOTE_MINE;
-		it->isRoll = note.type == NOTE_ROLL;
-		it->isSelected = 0;
-		it->type = note.type;
-		it->player = note.player;
-		it->quant = note.quant;
+		ExpandNote(*it, note);
 		++it;
 	}
 
-	myUpdateNoteTimes();
-	myUpdateWarpedNotes();
+	myUpdateNoteTimes(myNotes.begin(), myNotes.end());
+	myUpdateWarpedNotes(myNotes.begin(), myNotes.end());
 	myUpdateNoteStats();
-	myUpdateCheckQuants();
+	myUpdateCheckQuants(myNotes.begin(), myNotes.end());
+	myUpdateColumnSpans();
+}
+
+void myUpdateColumnSpans()
+{
+	for(auto& spans : myColumnSpans)
+	{
+		spans.clear();
+	}
+	for(auto& note : myNotes)
+	{
+		myColumnSpans[note.col].push_back({note.row, note.endrow});
+	}
+}
+
+// Returns the index of the first span in the column that starts after the given row.
+int myFindSpanAfter(int col, int row) const
+{
+	auto& spans = myColumnSpans[col];
+	auto it = std::upper_bound(spans.begin(), spans.end(), row,
+		[](int row, const NoteSpan& span) { return row < span.row; });
+	return (int)(it - spans.begin());
+}
+
+// Returns the last span in the column that starts at or before the given row, or null.
+const NoteSpan* myFindSpan(int col, int row) const
+{
+	int index = myFindSpanAfter(col, row);
+	return (index > 0) ? &myColumnSpans[col][index - 1] : nullptr;
+}
+
+static void ExpandNote(ExpandedNote& out, const Note& note)
+{
+	out.row = note.row;
+	out.col = note.col;
+	out.endrow = note.endrow;
+	out.isMine = note.type == NOTE_MINE;
+	out.isRoll = note.type == NOTE_ROLL;
+	out.isSelected = 0;
+	out.type = note.type;
+	out.player = note.player;
+	out.quant = note.quant;
 }
 
-void myUpdateCheckQuants()
+void myUpdateCheckQuants(ExpandedNote* note, ExpandedNote* noteEnd)
 {
-	for (auto& note : myNotes)
+	for (; note != noteEnd; ++note)
 	{
-		if (note.quant < 0 || note.quant > 192)
+		if (note->quant < 0 || note->quant > 192)
 		{
-			HudError("Missing quant at %d, value %d", note.row, note.quant);
-			note.quant = 192;
+			HudError("Missing quant at %d, value %d", note->row, note->quant);
+			note->quant = 192;
 		}
 	}
 }
 
-void myUpdateNoteTimes()
+void myUpdateNoteTimes(ExpandedNote* note, ExpandedNote* noteEnd)
 {
 	TempoTimeTracker tracker;
-	for(auto& note : myNotes)
+	for(; note != noteEnd; ++note)
 	{
-		note.time = tracker.advance(note.row);
-		if(note.endrow == note.row)
+		note->time = tracker.advance(note->row);
+		if(note->endrow == note->row)
 		{
-			note.endtime = note.time;
+			note->endtime = note->time;
 		}
 		else
 		{
-			note.endtime = gTempo->rowToTime(note.endrow);
+			note->endtime = gTempo->rowToTime(note->endrow);
 		}
 	}
 }
 
-void myUpdateWarpedNotes()
+void myUpdateWarpedNotes(ExpandedNote* note, ExpandedNote* noteEnd)
 {
-	uint insideWarp = 0;
-	auto note = myNotes.begin(), noteEnd = myNotes.end();
+	if(note == noteEnd) return;
+
+	// Events before the first note do not affect the notes, so start at the first event that is
+	// not before the first note and continue with the warp state of the event preceding it.
 	auto& events = gTempo->getTimingData().events;
-	auto it = events.begin(), end = events.end();
-	for(; it != end; ++it)
+	int firstRow = note->row;
+	auto it = std::lower_bound(events.begin(), events.end(), firstRow,
+		[](const TimingData::Event& e, int row) { return e.row < row; });
+	auto end = events.end();
+
+	uint insideWarp = (it != events.begin() && it[-1].spr == 0.0);
+	for(; it != end && note != noteEnd; ++it)
 	{
 		if(insideWarp)
 		{
@@ -169,21 +222,177 @@ void myUpdateNoteStats()
 	int lastRow = -1;
 	for(auto& note : myNotes)
 	{
+		myCountNote(note, 1);
 		if(!note.isMine)
 		{
-			int isHoldOrRoll = note.endrow > note.row;
-			myNumRolls += isHoldOrRoll & note.isRoll;
-			myNumHolds += isHoldOrRoll & (note.isRoll ^ 1);
 			myNumJumps += lastRow == note.row;
 			lastRow = note.row;
-			++myNumSteps;
+		}
+	}
+}
+
+// Adds (sign = 1) or subtracts (sign = -1) the note from the statistics, except for jumps.
+void myCountNote(const ExpandedNote& note, int sign)
+{
+	if(!note.isMine)
+	{
+		int isHoldOrRoll = note.endrow > note.row;
+		myNumRolls += sign * (isHoldOrRoll & note.isRoll);
+		myNumHolds += sign * (isHoldOrRoll & (note.isRoll ^ 1));
+		myNumSteps += sign;
+	}
+	else
+	{
+		myNumMines += sign;
+	}
+	myNumWarps += sign * note.isWarped;
+}
+
+// Returns the number of jumps the given row adds to the statistics.
+int myCountJumps(int row)
+{
+	int numSteps = 0;
+	auto note = myFindRow(row), end = myNotes.end();
+	for(; note != end && note->row == row; ++note)
+	{
+		numSteps += note->isMine ^ 1;
+	}
+	return max(numSteps - 1, 0);
+}
+
+// Returns the first note that is not before the given row.
+ExpandedNote* myFindRow(int row)
+{
+	return std::lower_bound(myNotes.begin(), myNotes.end(), row,
+		[](const ExpandedNote& n, int row) { return n.row < row; });
+}
+
+// Applies added and removed notes to the expanded notes of the active chart, without touching the
+// notes that did not change. Returns false if the result does not match the chart notes, which
+// happens if sanitizing removed notes. In that case, all notes have to be rebuilt.
+bool myApplyNoteChanges(const NoteList& add, const NoteList& rem)
+{
+	bool rebuildSpans = (add.size() + rem.size() > SPAN_REBUILD_THRESHOLD);
+
+	// Collect the rows of which the jump count might change, and remove their jumps.
+	Vector<int> rows;
+	auto addIt = add.begin(), addEnd = add.end();
+	auto remIt = rem.begin(), remEnd = rem.end();
+	while(addIt != addEnd || remIt != remEnd)
+	{
+		int row;
+		if(remIt == remEnd || (addIt != addEnd && addIt->row < remIt->row))
+		{
+			row = (addIt++)->row;
 		}
 		else
 		{
-			++myNumMines;
+			row = (remIt++)->row;
+		}
+		if(rows.empty() || rows.back() != row) rows.push_back(row);
+	}
+	for(int row : rows)
+	{
+		myNumJumps -= myCountJumps(row);
+	}
+
+	// Invalidate the removed notes, and move the remaining notes over them.
+	if(rem.size())
+	{
+		auto note = myFindRow(rem.begin()->row);
+		auto noteEnd = myNotes.end();
+		auto write = note;
+		for(auto& r : rem)
+		{
+			for(; note != noteEnd && LessThanRowCol(*note, r); ++note)
+			{
+				*write++ = *note;
+			}
+			if(note != noteEnd && !LessThanRowCol(r, *note))
+			{
+				myCountNote(*note, -1);
+				if(!rebuildSpans)
+				{
+					myColumnSpans[note->col].erase(myFindSpanAfter(note->col, note->row) - 1);
+				}
+				++note;
+			}
+		}
+		for(; note != noteEnd; ++note)
+		{
+			*write++ = *note;
+		}
+		myNotes.truncate(write - myNotes.begin());
+	}
+
+	// Merge the added notes, working backwards so the notes can be moved in place.
+	if(add.size())
+	{
+		int oldSize = myNotes.size();
+		myNotes.resize(oldSize + add.size());
+
+		auto write = myNotes.end() - 1;
+		auto read = myNotes.begin() + oldSize - 1;
+		auto readEnd = myNotes.begin() - 1;
+		auto ins = add.end() - 1;
+		auto insEnd = add.begin() - 1;
+		while(ins != insEnd)
+		{
+			for(; read != readEnd && LessThanRowCol(*ins, *read); --read, --write)
+			{
+				*write = *read;
+			}
+			ExpandNote(*write, *ins);
+			--ins, --write;
+		}
+	}
+
+	if(myNotes.size() != myChart->notes.size()) return false;
+
+	// Update the time, warp state and statistics of the added notes.
+	auto& timing = gTempo->getTimingData();
+	for(auto& a : add)
+	{
+		auto note = myFindRow(a.row);
+		while(note->col != a.col) ++note;
+
+		note->time = timing.rowToTime(note->row);
+		note->endtime = (note->endrow == note->row) ? note->time : timing.rowToTime(note->endrow);
+		myUpdateWarpedNotes(note, note + 1);
+		myUpdateCheckQuants(note, note + 1);
+		myCountNote(*note, 1);
+
+		if(!rebuildSpans)
+		{
+			NoteSpan span = {note->row, note->endrow};
+			myColumnSpans[note->col].insert(myFindSpanAfter(note->col, note->row), span, 1);
 		}
-		myNumWarps += note.isWarped;
 	}
+	if(rebuildSpans)
+	{
+		myUpdateColumnSpans();
+	}
+
+	// Add the jumps of the changed rows again.
+	for(int row : rows)
+	{
+		myNumJumps += myCountJumps(row);
+	}
+
+	// Editing clears the note selection, like rebuilding does. The selected notes are drawn
+	// differently, so the clearing is reported if any note was selected.
+	uint wasSelected = 0;
+	for(auto& note : myNotes)
+	{
+		wasSelected |= note.isSelected;
+		note.isSelected = 0;
+	}
+	if(wasSelected)
+	{
+		gEditor->reportChanges(VCM_SELECTION_CHANGED);
+	}
+
+	return true;
 }
 
 void update(Simfile* simfile, Chart* chart)
@@ -199,15 +408,34 @@ void update(Simfile* simfile, Chart* chart)
 	{
 		myNotes.release();
 		myUpdateNoteStats();
+		myUpdateColumnSpans();
 	}
 
 	gEditor->reportChanges(VCM_NOTES_CHANGED);
 }
 
-void updateTempo()
+void updateTempo(int firstRow)
 {
-	myUpdateNoteTimes();
-	myUpdateWarpedNotes();
+	// Holds that start before the first changed row can still end after it.
+	auto note = myNotes.begin(), noteEnd = myNotes.end();
+	for(; note != noteEnd && note->row < firstRow; ++note)
+	{
+		if(note->endrow >= firstRow)
+		{
+			note->endtime = gTempo->rowToTime(note->endrow);
+		}
+	}
+
+	for(auto it = note; it != noteEnd; ++it)
+	{
+		myNumWarps -= it->isWarped;
+	}
+	myUpdateNoteTimes(note, noteEnd);
+	myUpdateWarpedNotes(note, noteEnd);
+	for(auto it = note; it != noteEnd; ++it)
+	{
+		myNumWarps += it->isWarped;
+	}
 }
 
 // ================================================================================================
@@ -231,7 +459,18 @@ static String GetNoteName(const Note& note)
 	return "note";
 }
 
-void myApplyNotes(Chart* chart, const NoteList& add, const NoteList& rem, bool firstTime)
+// Extends the range of rows [begin, end) to include the rows of the given notes.
+static void GetRowRange(const NoteList& notes, int& begin, int& end)
+{
+	for(auto& note : notes)
+	{
+		begin = min(begin, note.row);
+		end = max(end, note.endrow + 1);
+	}
+}
+
+void myApplyNotes(Chart* chart, const NoteList& add, const NoteList& rem, bool firstTime,
+	bool deferUpdate = false)
 {
 	// Remove notes before inserting rows.
 	chart->notes.remove(rem);
@@ -262,11 +501,27 @@ void myApplyNotes(Chart* chart, const NoteList& add, const NoteList& rem, bool f
 
 	if(myChart == chart)
 	{
-		if(!firstTime) select(SELECT_SET, add.begin(), add.size());
+		bool applied = false;
+		if(!updated && !deferUpdate)
+		{
+			applied = myApplyNoteChanges(add, rem);
+			if(!applied) myUpdateNotes();
+		}
 
-		if(!updated) myUpdateNotes();
+		if(!firstTime && !deferUpdate) select(SELECT_SET, add.begin(), add.size());
 
-		gEditor->reportChanges(VCM_NOTES_CHANGED);
+		// If the changes were applied to the expanded notes, only the edited rows changed.
+		if(applied)
+		{
+			int beginRow = INT_MAX, endRow = 0;
+			GetRowRange(add, beginRow, endRow);
+			GetRowRange(rem, beginRow, endRow);
+			gEditor->reportChanges(VCM_NOTES_CHANGED, beginRow, endRow);
+		}
+		else
+		{
+			gEditor->reportChanges(VCM_NOTES_CHANGED);
+		}
 	}
 }
 
@@ -485,13 +740,14 @@ String myApplyInsertRows(ReadStream& in, bool undo, bool redo)
 		}
 
 		// Then, insert or remove segments.
+		// The row offsets invalidate the expanded notes, they are rebuilt afterwards.
 		if(undo)
 		{
-			myApplyNotes(target, rem, dummy, false);
+			myApplyNotes(target, rem, dummy, false, true);
 		}
 		else
 		{
-			myApplyNotes(target, dummy, rem, !redo);
+			myApplyNotes(target, dummy, rem, !redo, true);
 		}
 
 		// Apply negative offsets after the notes are removed.
@@ -546,12 +802,25 @@ void forAllSelectedNotes(Func f)
 
 template <typename Predicate>
 int performSelection(SelectModifier mod, Predicate pred)
+{
+	return performSelection(mod, myNotes.begin(), myNotes.end(), pred);
+}
+
+// Only tests the notes in [note, end), the notes outside are treated as not matching.
+template <typename Predicate>
+int performSelection(SelectModifier mod, ExpandedNote* note, ExpandedNote* end, Predicate pred)
 {
 	int numSelected = 0;
-	auto note = myNotes.begin();
-	auto end = myNotes.end();
 	if(mod == SELECT_SET)
 	{
+		for(auto it = myNotes.begin(); it != note; ++it)
+		{
+			it->isSelected = 0;
+		}
+		for(auto it = end; it != myNotes.end(); ++it)
+		{
+			it->isSelected = 0;
+		}
 		for(; note != end; ++note)
 		{
 			uint set = pred(note);
@@ -623,20 +892,26 @@ int selectQuant(int rowType)
 
 int selectRows(SelectModifier mod, int firstCol, int lastCol, int firstRow, int lastRow)
 {
-	return performSelection(mod, [&](const ExpandedNote* note)
+	auto first = myFindRow(firstRow);
+	auto last = max(first, myFindRow(lastRow));
+	return performSelection(mod, first, last, [&](const ExpandedNote* note)
 	{
-		return (note->col >= firstCol && note->col < lastCol &&
-		        note->row >= firstRow && note->row < lastRow);
+		return (note->col >= firstCol && note->col < lastCol);
 	});
 }
 
 int selectTime(SelectModifier mod, int firstCol, int lastCol, double firstTime, double lastTime)
 {
+	// Note times increase with their rows, so the notes in the time range are contiguous.
+	auto first = std::lower_bound(myNotes.begin(), myNotes.end(), firstTime,
+		[](const ExpandedNote& n, double time) { return n.time < time; });
+	auto last = std::upper_bound(first, myNotes.end(), lastTime,
+		[](double time, const ExpandedNote& n) { return time < n.time; });
+
 	gSelection->setType(Selection::NOTES);
-	return performSelection(mod, [&](const ExpandedNote* note)
+	return performSelection(mod, first, last, [&](const ExpandedNote* note)
 	{
-		return (note->col >= firstCol && note->col < lastCol &&
-		        note->time >= firstTime && note->time <= lastTime);
+		return (note->col >= firstCol && note->col < lastCol);
 	});
 }
 
@@ -895,23 +1170,59 @@ const ExpandedNote* getNoteAt(int row, int col) const
 
 const ExpandedNote* getNoteIntersecting(int row, int col) const
 {
-	auto it = myNotes.begin(), end = myNotes.end();
-	for(; it != end && it->endrow < row; ++it);
-	for(; it != end && it->row <= row; ++it)
+	if(col < 0 || col >= SIM_MAX_COLUMNS) return nullptr;
+
+	auto span = myFindSpan(col, row);
+	if(span && span->endrow >= row)
 	{
-		if(it->col == col && it->endrow >= row) return it;
+		return getNoteAt(span->row, col);
 	}
 	return nullptr;
 }
 
+Vector<const ExpandedNote*> getNotesOverlapping(int beginRow, int endRow) const
+{
+	Vector<const ExpandedNote*> out;
+
+	// Each column has at most one note that starts before the begin row and overlaps it.
+	for(int col = 0; col < SIM_MAX_COLUMNS; ++col)
+	{
+		auto span = myFindSpan(col, beginRow - 1);
+		if(span && span->endrow >= beginRow)
+		{
+			out.push_back(getNoteAt(span->row, col));
+		}
+	}
+	std::sort(out.begin(), out.end(), [](const ExpandedNote* a, const ExpandedNote* b)
+	{
+		return LessThanRowCol(*a, *b);
+	});
+
+	// The other notes start inside the row range.
+	auto note = std::lower_bound(myNotes.begin(), myNotes.end(), beginRow,
+		[](const ExpandedNote& n, int row) { return n.row < row; });
+	for(; note != myNotes.end() && note->row <= endRow; ++note)
+	{
+		out.push_back(note);
+	}
+	return out;
+}
+
 Vector<const ExpandedNote*> getNotesBeforeTime(double time) const
 {
-	Vector<const ExpandedNote*> out(gStyle->getNumCols(), nullptr);
-	auto cols = out.begin();
-	for(auto& n : myNotes)
+	int numCols = gStyle->getNumCols();
+	Vector<const ExpandedNote*> out(numCols, nullptr);
+
+	// Note times increase with their rows, so the notes before the time are the notes that
+	// precede the row of the first note after the time.
+	auto next = std::upper_bound(myNotes.begin(), myNotes.end(), time,
+		[](double time, const ExpandedNote& n) { return time < n.time; });
+	int lastRow = (next != myNotes.end()) ? next->row - 1 : INT_MAX;
+
+	for(int col = 0; col < numCols && col < SIM_MAX_COLUMNS; ++col)
 	{
-		if(n.time > time) break;
-		cols[n.col] = &n;
+		auto span = myFindSpan(col, lastRow);
+		if(span) out[col] = getNoteAt(span->row, col);
 	}
 	return out;
 }
@@ -33,8 +33,8 @@ struct NotesMan
 	/// Called by simfile when the active chart or simfile changes.
 	virtual void update(Simfile* simfile, Chart* chart) = 0;
 
-	/// Called by tempo when the active tempo changes.
-	virtual void updateTempo() = 0;
+	/// Called by tempo when the active tempo changes, notes before firstRow keep their times.
+	virtual void updateTempo(int firstRow) = 0;
 
 	// Selection functions.
 	virtual void deselectAll() = 0;
@@ -79,6 +79,9 @@ struct NotesMan
 	/// Returns a pointer to the note that contains the given row/column, or null if there is none.
 	virtual const ExpandedNote* getNoteIntersecting(int row, int col) const = 0;
 
+	/// Returns pointers to all notes that overlap the rows from beginRow to endRow, sorted by row.
+	virtual Vector<const ExpandedNote*> getNotesOverlapping(int beginRow, int endRow) const = 0;
+
 	/// Returns the indices of all notes preceding the given time for each column.
 	virtual Vector<const ExpandedNote*> getNotesBeforeTime(double time) const = 0;
 };
@@ -1,6 +1,7 @@
 #include <Managers/NoteskinMan.h>
 
 #include <Core/QuadBatch.h>
+#include <Core/TextureAtlas.h>
 #include <Core/StringUtils.h>
 #include <Core/Vector.h>
 #include <Core/Utils.h>
@@ -18,6 +19,9 @@
 namespace Vortex {
 namespace {
 
+// Size of the texture that the noteskin images are packed into.
+static const int ATLAS_PAGE_SIZE = 1024;
+
 struct SkinType
 {
 	String name;
@@ -37,13 +41,12 @@ struct SpriteTransform
 	int x, y, w, h, rot, mir;
 };
 
-static bool LoadTexture(StringRef path, StringRef dir, Texture& out)
+static bool LoadTexture(StringRef path, StringRef dir, TextureAtlas& atlas, TextureAtlas::Region& out)
 {
-	out = Texture((dir + path).str());
-	if(out.handle()) return true;
+	if(atlas.add((dir + path).str(), out)) return true;
 
 	uchar dummyTex[4] = {255, 0, 255, 255};
-	out = Texture(1, 1, dummyTex);
+	atlas.add(1, 1, dummyTex, out);
 	return false;
 }
 
@@ -167,22 +170,24 @@ static void ParseSpriteAttrib(const XmrNode* node, const char* attrib, int* dst,
 	}
 }
 
-static void SetUVS(const Texture& tex, SpriteTransform& t, BatchSprite& spr)
+static void SetUVS(const TextureAtlas::Region& tex, SpriteTransform& t, BatchSprite& spr)
 {
 	spr.width = (t.w >= 0) ? t.w : 64;
 	spr.height = (t.h >= 0) ? t.h : 64;
 
-	if(tex.size().x == 0 || tex.size().y == 0)
+	vec2i size = tex.page.size();
+	if(size.x == 0 || size.y == 0)
 	{
 		float tmp[8] = {0, 0, 1, 0, 0, 1, 1, 1};
 		memcpy(spr.uvs, tmp, sizeof(float) * 8);
 	}
 	else
 	{
-		double du = 1.0f / (double)tex.size().x;
-		double dv = 1.0f / (double)tex.size().y;
-		double ul = du * (double)t.x, ur = ul + du * (double)spr.width;
-		double vt = dv * (double)t.y, vb = vt + dv * (double)spr.height;
+		// The sprite position is relative to the image, which is part of the atlas texture.
+		double du = 1.0f / (double)size.x;
+		double dv = 1.0f / (double)size.y;
+		double ul = du * (double)(tex.rect.x + t.x), ur = ul + du * (double)spr.width;
+		double vt = dv * (double)(tex.rect.y + t.y), vb = vt + dv * (double)spr.height;
 		double uvs[8] = {ul, vt, ur, vt, ul, vb, ur, vb};
 		for(int i = 0; i < 8; ++i) spr.uvs[i] = (float)uvs[i];
 
@@ -346,22 +351,28 @@ static void LoadNoteskin(NoteskinImpl* skin, const SkinType& type)
 		ParseSpriteAttrib(n, "x", skin->colX, numCols);
 	}
 
-	// Load the noteskin textures.
+	// Load the noteskin textures, they are packed into a single texture if they fit, so the
+	// receptors, notes and glow can be drawn without changing textures.
+	TextureAtlas atlas(ATLAS_PAGE_SIZE);
+	TextureAtlas::Region noteTex, recepTex, glowTex;
 	auto notesPath = node->get("Texture-notes", "");
-	if(!LoadTexture(notesPath, dir, skin->noteTex))
+	if(!LoadTexture(notesPath, dir, atlas, noteTex))
 	{
 		HudError("Could not load notes texture.");
 	}
 	auto receptorsPath = node->get("Texture-receptors", "");
-	if(!LoadTexture(receptorsPath, dir, skin->recepTex))
+	if(!LoadTexture(receptorsPath, dir, atlas, recepTex))
 	{
 		HudError("Could not load receptors texture.");
 	}
 	auto glowPath = node->get("Texture-glow", "");
-	if(!LoadTexture(glowPath, dir, skin->glowTex))
+	if(!LoadTexture(glowPath, dir, atlas, glowTex))
 	{
 		HudError("Could not load glow texture.");
 	}
+	skin->noteTex = noteTex.page;
+	skin->recepTex = recepTex.page;
+	skin->glowTex = glowTex.page;
 
 	// Compute all the sprite UVS.
 	for(int c = 0; c < numCols; ++c)
@@ -371,18 +382,18 @@ static void LoadNoteskin(NoteskinImpl* skin, const SkinType& type)
 			for(int r = 0; r < NUM_ROW_TYPES; ++r)
 			{
 				int idx = (pn * numCols + c) * NUM_ROW_TYPES + r;
-				SetUVS(skin->noteTex, note[idx], skin->note[idx]);
+				SetUVS(noteTex, note[idx], skin->note[idx]);
 			}
 			int idx = pn * numCols + c;
-			SetUVS(skin->noteTex, mine[idx], skin->mine[idx]);
+			SetUVS(noteTex, mine[idx], skin->mine[idx]);
 		}
-		SetUVS(skin->recepTex, receptorOn[c], skin->recepOn[c]);
-		SetUVS(skin->recepTex, receptorOff[c], skin->recepOff[c]);
-		SetUVS(skin->glowTex, receptorGlow[c], skin->recepGlow[c]);
-		SetUVS(skin->noteTex, holdBody[c], skin->holdBody[c]);
-		SetUVS(skin->noteTex, holdTail[c], skin->holdTail[c]);
-		SetUVS(skin->noteTex, rollBody[c], skin->holdBody[numCols + c]);
-		SetUVS(skin->noteTex, rollTail[c], skin->holdTail[numCols + c]);
+		SetUVS(recepTex, receptorOn[c], skin->recepOn[c]);
+		SetUVS(recepTex, receptorOff[c], skin->recepOff[c]);
+		SetUVS(glowTex, receptorGlow[c], skin->recepGlow[c]);
+		SetUVS(noteTex, holdBody[c], skin->holdBody[c]);
+		SetUVS(noteTex, holdTail[c], skin->holdTail[c]);
+		SetUVS(noteTex, rollBody[c], skin->holdBody[numCols + c]);
+		SetUVS(noteTex, rollTail[c], skin->holdTail[numCols + c]);
 	}
 
 	// Calculate the x-positions of the left and right side of the note field.
@@ -4,6 +4,8 @@
 #include <Core/Utils.h>
 #include <Core/StringUtils.h>
 
+#include <System/Thread.h>
+
 #include <Editor/Common.h>
 #include <Managers/NoteskinMan.h>
 #include <Managers/ChartMan.h>
@@ -255,6 +257,7 @@ struct StyleManImpl : public StyleMan {
 Vector<Style*> myStyles;
 int myNumDefaultStyles;
 Style* myActiveStyle;
+CriticalSection myLock;
 
 // ================================================================================================
 // StyleManImpl :: constructor / destructor.
@@ -312,7 +315,7 @@ const Style* createFallbackStyle(StringRef id, int numCols, int numPlayers)
 	return style;
 }
 
-const Style* findStyle(StringRef styleId)
+const Style* myFindStyle(StringRef styleId)
 {
 	for(int i = 0; i < myStyles.size(); ++i)
 	{
@@ -324,7 +327,7 @@ const Style* findStyle(StringRef styleId)
 	return nullptr;
 }
 
-const Style* findStyle(StringRef chartName, int numCols, int numPlayers)
+const Style* myFindStyle(StringRef chartName, int numCols, int numPlayers)
 {
 	// First, check if an existing style matches the requested column and player count.
 	for(int i = 0; i < myStyles.size(); ++i)
@@ -342,7 +345,7 @@ const Style* findStyle(StringRef chartName, int numCols, int numPlayers)
 	return createFallbackStyle(String(), numCols, numPlayers);
 }
 
-const Style* findStyle(StringRef chartName, int numCols, int numPlayers, StringRef id)
+const Style* myFindStyle(StringRef chartName, int numCols, int numPlayers, StringRef id)
 {
 	/// Use lookup by column and player count if the id string is empty.
 	if(id.empty())
@@ -380,6 +383,32 @@ const Style* findStyle(StringRef chartName, int numCols, int numPlayers, StringR
 	return createFallbackStyle(id, numCols, numPlayers);
 }
 
+// The lookups can create fallback styles, and simfiles are also loaded on worker threads by the
+// batch processing, so the lookups are serialized.
+const Style* findStyle(StringRef styleId)
+{
+	myLock.lock();
+	auto style = myFindStyle(styleId);
+	myLock.unlock();
+	return style;
+}
+
+const Style* findStyle(StringRef chartName, int numCols, int numPlayers)
+{
+	myLock.lock();
+	auto style = myFindStyle(chartName, numCols, numPlayers);
+	myLock.unlock();
+	return style;
+}
+
+const Style* findStyle(StringRef chartName, int numCols, int numPlayers, StringRef id)
+{
+	myLock.lock();
+	auto style = myFindStyle(chartName, numCols, numPlayers, id);
+	myLock.unlock();
+	return style;
+}
+
 void update(Chart* chart)
 {
 	myActiveStyle = (Style*)(chart ? chart->style : nullptr);
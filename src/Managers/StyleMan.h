@@ -34,7 +34,8 @@ struct StyleMan
 	// Called when the active chart changes.
 	virtual void update(Chart* chart) = 0;
 
-	/// Returns the first style that matches the given id, or null if none was found.
+	/// Returns the first style that matches the given id, or null if none was found. The find
+	/// functions can be called from any thread.
 	virtual const Style* findStyle(StringRef id) = 0;
 
 	/// Returns the first style that matches the given column and player count.
@@ -75,25 +75,58 @@ TempoManImpl()
 // ================================================================================================
 // TempoManImpl :: update functions.
 
-void myUpdateTimingData()
+// Compares the previous events from index first onwards with the current events after first,
+// the events before first are the same in both.
+static int FirstChangedRow(const Vector<TimingData::Event>& prev,
+	const Vector<TimingData::Event>& events, int first)
 {
+	// The time of a row only depends on the most recent event at or before that row, so times
+	// are unchanged up to the first event that differs.
+	const TimingData::Event* a = prev.begin();
+	const TimingData::Event* b = events.begin() + first;
+	int na = prev.size(), nb = events.size() - first;
+	int n = min(na, nb);
+	for(int i = 0; i < n; ++i)
+	{
+		auto& x = a[i];
+		auto& y = b[i];
+		if(x.row != y.row || x.time != y.time || x.rowTime != y.rowTime ||
+		   x.endTime != y.endTime || x.spr != y.spr)
+		{
+			return (first + i > 0) ? min(x.row, y.row) : 0;
+		}
+	}
+	if(na > n) return a[n].row;
+	if(nb > n) return b[n].row;
+	return INT_MAX;
+}
+
+// Segments before firstRow must be unchanged since the previous update of the same tempo.
+void myUpdateTimingData(int firstRow = 0)
+{
+	// Only the events that are not kept by the update are compared with the new events.
+	Vector<TimingData::Event> prevEvents;
+	int numKept = 0;
+
 	if(myTweakTempo)
 	{
-		myTimingData.update(myTweakTempo);
+		numKept = myTimingData.update(myTweakTempo, firstRow, &prevEvents);
 	}
 	else if(myTempo)
 	{
-		myTimingData.update(myTempo);
+		myTimingData.update(myTempo, 0, &prevEvents);
 	}
 	else
 	{
+		prevEvents.swap(myTimingData.events);
 		myTimingData = TimingData();
 	}
 
-	if(gNotes) gNotes->updateTempo();
-
-	gEditor->reportChanges(VCM_TEMPO_CHANGED);
+	int changedRow = FirstChangedRow(prevEvents, myTimingData.events, numKept);
+	if(gNotes && changedRow != INT_MAX) gNotes->updateTempo(changedRow);
 
+	// The times before the first changed row are unaffected.
+	gEditor->reportChanges(VCM_TEMPO_CHANGED, changedRow, INT_MAX);
 }
 
 void update(Simfile* sim, Chart* chart)
@@ -136,7 +169,6 @@ void myFinishEdit(Tempo* tempo)
 	if(myTempo == tempo)
 	{
 		myUpdateTimingData();
-		gEditor->reportChanges(VCM_TEMPO_CHANGED);
 	}
 }
 
@@ -681,8 +713,8 @@ void setTweakValue(double value)
 		myTweakTempo->segments->insert(Stop(myTweakRow, value));
 	}
 
-	myUpdateTimingData();
-	gEditor->reportChanges(VCM_TEMPO_CHANGED);
+	// Only the segments at the tweak row change, the events before it can be kept.
+	myUpdateTimingData(myTweakRow);
 }
 
 void stopTweaking(bool apply)
@@ -719,7 +751,6 @@ void stopTweaking(bool apply)
 	}
 
 	myUpdateTimingData();
-	gEditor->reportChanges(VCM_TEMPO_CHANGED);
 }
 
 // ================================================================================================
@@ -2,6 +2,7 @@
 
 #include <map>
 #include <algorithm>
+#include <math.h>
 
 #include <Core/StringUtils.h>
 
@@ -15,6 +15,8 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
+#include <math.h>
 
 namespace Vortex {
 namespace {
@@ -3,6 +3,8 @@
 #include <set>
 #include <map>
 #include <algorithm>
+#include <limits.h>
+#include <math.h>
 
 #include <Core/WideString.h>
 #include <Core/Utils.h>
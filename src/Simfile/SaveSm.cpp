@@ -11,6 +11,7 @@
 
 #include <Managers/StyleMan.h>
 #include <list>
+#include <math.h>
 
 namespace Vortex {
 namespace Sm {
@@ -593,7 +594,7 @@ static void WriteSections(ExportData& data)
 							{
 								int pos = ((int)hold->endrow - startRow) * numCols + (int)hold->col;
 								section[pos] = '3';
-								quantVec.push_front(it->quant);
+								quantVec.push_front(hold->quant);
 								--remainingHolds;
 							}
 						}
@@ -616,7 +617,7 @@ static void WriteSections(ExportData& data)
 							int pos = (hold->endrow - startRow) * numCols + hold->col;
 							section[pos] = '3';
 							holds[col] = nullptr;
-							quantVec.push_front(it->quant);
+							quantVec.push_front(hold->quant);
 							--remainingHolds;
 						}
 					}
@@ -4,6 +4,8 @@
 #include <Core/StringUtils.h>
 #include <Core/Utils.h>
 
+#include <limits.h>
+
 namespace Vortex {
 
 #define ForEachType(type)\
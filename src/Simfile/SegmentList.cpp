@@ -8,6 +8,7 @@
 #include <Simfile/Chart.h>
 
 #include <stdlib.h>
+#include <limits.h>
 
 namespace Vortex {
 namespace {
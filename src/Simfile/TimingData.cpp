@@ -13,6 +13,8 @@
 #include <Managers/TempoMan.h>
 
 #include <float.h>
+#include <limits.h>
+#include <algorithm>
 
 namespace Vortex {
 namespace {
@@ -29,21 +31,28 @@ struct MergedTS
 	Segment::Type type;
 };
 
-static void Merge(Vector<MergedTS>& out, const SegmentList& in)
+// Merges the segments at or after minRow into the output list.
+static void Merge(Vector<MergedTS>& out, const SegmentList& in, int minRow)
 {
 	if(in.empty()) return;
 
-	out.grow(out.size() + in.size());
+	auto ins = in.rbegin();
+	auto insEnd = ins;
+	int count = 0;
+	for(auto rend = in.rend(); insEnd != rend && insEnd->row >= minRow; --insEnd)
+	{
+		++count;
+	}
+	if(count == 0) return;
+
+	out.grow(out.size() + count);
 
 	// Work backwards, that way insertion can be done on the fly.
 	auto write = out.end() - 1;
 
-	auto read = out.end() - in.size() - 1;
+	auto read = out.end() - count - 1;
 	auto readEnd = out.begin() - 1;
 
-	auto ins = in.rbegin();
-	auto insEnd = in.rend();
-
 	while(read != readEnd)
 	{
 		// Copy segments from the in list.
@@ -169,10 +178,13 @@ static WarpResult HandleWarp(Vector<Event>& out, MergedTS* it, MergedTS* end, in
 	return {row, targetTime, it};
 }
 
-static void CreateEvents(Vector<Event>& out, double time, MergedTS* it, MergedTS* end)
+// Creates events for the segments in [it, end), starting at the given row, time and seconds per
+// row. Returns the first row at which a warp takes effect, or INT_MAX if there are no warps.
+static int CreateEvents(Vector<Event>& out, int row, double time, double spr, MergedTS* it,
+	MergedTS* end)
 {
-	int row = 0, warp;
-	double spr = 1.0, stop, delay;
+	int warp, firstWarpRow = INT_MAX;
+	double stop, delay;
 	while(it != end)
 	{
 		warp = 0;
@@ -202,6 +214,7 @@ static void CreateEvents(Vector<Event>& out, double time, MergedTS* it, MergedTS
 
 		if(endTime < time || spr < 0 || warp > 0)
 		{
+			firstWarpRow = min(firstWarpRow, row);
 			auto result = HandleWarp(out, it, end, warp);
 			spr = out.back().spr;
 			endTime = result.time;
@@ -218,6 +231,7 @@ static void CreateEvents(Vector<Event>& out, double time, MergedTS* it, MergedTS
 	{
 		out.push_back({0, 0.0, 0.0, 0.0, BEATS_PER_ROW});
 	}
+	return firstWarpRow;
 }
 
 // ================================================================================================
@@ -270,40 +284,81 @@ static const TimeSig* MostRecentTimeSig(const Vector<TimeSig>& sigs, int row)
 	return it;
 }
 
-static const Event* MostRecentEvent(const Vector<Event>& events, int row)
+// Fills the subtree at node k with the events starting at index i, returns the next index.
+static int FillSearchTree(TimingData::SearchNode* tree, const Event* events, int n, int i, int k)
 {
-	const Event* it = events.begin(), *mid;
-	int count = events.size(), step;
-	while(count > 1)
+	if(k <= n)
 	{
-		step = count >> 1;
-		mid = it + step;
-		if(mid->row <= row)
-		{
-			it = mid;
-			count -= step;
-		}
-		else count = step;
+		i = FillSearchTree(tree, events, n, i, k * 2);
+		tree[k] = {events[i].time, events[i].row, i};
+		i = FillSearchTree(tree, events, n, i + 1, k * 2 + 1);
 	}
-	return it;
+	return i;
 }
 
-static const Event* MostRecentEvent(const Vector<Event>& events, double time)
+// Updates the nodes of the subtree at node k that hold an event at or after index first. The
+// layout only depends on the number of events, so the left subtree of a node before first, and the
+// node itself, are unchanged.
+static void RefreshSearchTree(TimingData::SearchNode* tree, const Event* events, int n, int first,
+	int k)
 {
-	const Event* it = events.begin(), *mid;
-	int count = events.size(), step;
-	while(count > 1)
+	for(; k <= n; k = k * 2 + 1)
 	{
-		step = count >> 1;
-		mid = it + step;
-		if(mid->time <= time)
+		int i = tree[k].index;
+		if(i >= first)
 		{
-			it = mid;
-			count -= step;
+			RefreshSearchTree(tree, events, n, first, k * 2);
+			tree[k].time = events[i].time;
+			tree[k].row = events[i].row;
 		}
-		else count = step;
 	}
-	return it;
+}
+
+// Builds the search tree, or only refreshes the nodes of the events from index first onwards if the
+// number of events did not change.
+static void CreateSearchTree(Vector<TimingData::SearchNode>& out, const Vector<Event>& events,
+	int first = 0)
+{
+	int n = events.size();
+	if(first > 0 && out.size() == n + 1)
+	{
+		RefreshSearchTree(out.begin(), events.begin(), n, first, 1);
+		return;
+	}
+	out.resize(n + 1);
+	out[0] = {0.0, 0, 0};
+	FillSearchTree(out.begin(), events.begin(), n, 0, 1);
+}
+
+// The descent always goes through all levels of the tree, and remembers the last node that was
+// past the key. That node is the first event past the key, the event before it is the result.
+
+static const Event* MostRecentEvent(const TimingData& data, int row)
+{
+	auto tree = data.searchTree.begin();
+	int n = data.events.size(), k = 1, next = 0;
+	while(k <= n)
+	{
+		bool before = (tree[k].row <= row);
+		next = before ? next : k;
+		k = k * 2 + before;
+	}
+	int index = next ? tree[next].index - 1 : n - 1;
+	return data.events.begin() + max(index, 0);
+}
+
+static const Event* MostRecentEvent(const TimingData& data, double time)
+{
+	auto tree = data.searchTree.begin();
+	int n = data.events.size(), k = 1, next = 0;
+	while(k <= n)
+	{
+		bool before = (tree[k].time <= time);
+		next = before ? next : k;
+		k = k * 2 + before;
+	}
+	int index = next ? tree[next].index - 1 : n - 1;
+	return data.events.begin() + max(index, 0);
 }
 
 static double TimeToBeat(const Event* it, double time)
@@ -357,50 +412,113 @@ static double BeatToMeasure(const TimeSig* sig, double beat)
 // Tempo list :: implementation.
 
 TimingData::TimingData()
+	: firstWarpRow(INT_MAX)
 {
 	events.push_back({0, 0.0, 0.0, 0.0, BEATS_PER_ROW});
 	sigs.push_back({0, 0, ROWS_PER_BEAT * 4});
+	CreateSearchTree(searchTree, events);
 }
 
 void TimingData::update(const Tempo* tempo)
 {
+	update(tempo, 0);
+}
+
+int TimingData::update(const Tempo* tempo, int firstRow, Vector<Event>* replaced)
+{
+	// Events before the first row are kept, as long as none of them is affected by a warp. The
+	// first new event continues from the last kept event.
+	int numKept = 0;
+	if(firstRow > 0 && firstRow <= firstWarpRow)
+	{
+		numKept = (int)(std::lower_bound(events.begin(), events.end(), firstRow,
+			[](const Event& e, int row) { return e.row < row; }) - events.begin());
+	}
+	if(numKept == 0) firstRow = 0;
+
+	if(replaced)
+	{
+		replaced->clear();
+		replaced->insert(0, events.begin() + numKept, events.size() - numKept);
+	}
+
 	// Create an event list from BPM changes, stops, delays and warps.
 	Vector<MergedTS> items(128);
 	auto segments = tempo->segments;
-	Merge(items, segments->getList<BpmChange>());
-	Merge(items, segments->getList<Stop>());
-	Merge(items, segments->getList<Delay>());
-	Merge(items, segments->getList<Warp>());
+	Merge(items, segments->getList<BpmChange>(), firstRow);
+	Merge(items, segments->getList<Stop>(), firstRow);
+	Merge(items, segments->getList<Delay>(), firstRow);
+	Merge(items, segments->getList<Warp>(), firstRow);
 
-	events.clear();
-	CreateEvents(events, -tempo->offset, items.begin(), items.end());
+	if(numKept > 0)
+	{
+		events.truncate(numKept);
+		const Event& last = events.back();
+		int row = items.empty() ? last.row : items.begin()->seg->row;
+		double time = last.endTime + (row - last.row) * last.spr;
+		firstWarpRow = CreateEvents(events, row, time, last.spr, items.begin(), items.end());
+	}
+	else
+	{
+		events.clear();
+		firstWarpRow = CreateEvents(events, 0, -tempo->offset, 1.0, items.begin(), items.end());
+	}
 	events.squeeze();
+	CreateSearchTree(searchTree, events, numKept);
 
 	// Create a measure list from time signatures.
 	sigs.clear();
 	CreateTimeSigs(sigs, segments->begin<TimeSignature>(), segments->end<TimeSignature>());
 	sigs.squeeze();
+
+	return numKept;
 }
 
 double TimingData::timeToBeat(double time) const
 {
-	return TimeToBeat(MostRecentEvent(events, time), time);
+	return TimeToBeat(MostRecentEvent(*this, time), time);
 }
 
 int TimingData::timeToRow(double time) const
 {
-	return TimeToRow(MostRecentEvent(events, time), time);
+	return TimeToRow(MostRecentEvent(*this, time), time);
 }
 
 double TimingData::rowToTime(int row) const
 {
-	return RowToTime(MostRecentEvent(events, row), row);
+	return RowToTime(MostRecentEvent(*this, row), row);
+}
+
+void TimingData::rowToTime(const int* rows, double* outTimes, int count) const
+{
+	if(count <= 0) return;
+	const Event* it = MostRecentEvent(*this, rows[0]);
+	const Event* last = events.end() - 1;
+	for(int i = 0; i < count; ++i)
+	{
+		int row = rows[i];
+		while(it != last && it[1].row <= row) ++it;
+		outTimes[i] = RowToTime(it, row);
+	}
+}
+
+void TimingData::timeToRow(const double* times, int* outRows, int count) const
+{
+	if(count <= 0) return;
+	const Event* it = MostRecentEvent(*this, times[0]);
+	const Event* last = events.end() - 1;
+	for(int i = 0; i < count; ++i)
+	{
+		double time = times[i];
+		while(it != last && it[1].time <= time) ++it;
+		outRows[i] = TimeToRow(it, time);
+	}
 }
 
 double TimingData::beatToTime(double beat) const
 {
 	int row = (int)ceil(beat * ROWS_PER_BEAT);
-	return BeatToTime(MostRecentEvent(events, row), beat);
+	return BeatToTime(MostRecentEvent(*this, row), beat);
 }
 
 double TimingData::beatToMeasure(double beat) const
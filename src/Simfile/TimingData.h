@@ -18,10 +18,21 @@ struct TimingData
 	{
 		int row, measure, rowsPerMeasure;
 	};
+	struct SearchNode
+	{
+		double time;
+		int row, index;
+	};
 
 	TimingData();
 
 	void update(const Tempo* tempo);
+
+	// Recomputes the events from the given row onwards, and keeps the events before it. The
+	// segments before that row and the offset must be unchanged since the previous update.
+	// Returns the number of kept events. If replaced is not null, it receives the previous events
+	// that were not kept, so the caller can compare them with the new events.
+	int update(const Tempo* tempo, int firstRow, Vector<Event>* replaced = nullptr);
 	
 	// Returns the row corresponding to the given time.
 	int timeToRow(double time) const;
@@ -32,6 +43,12 @@ struct TimingData
 	// Returns the time corresponding to the given row.
 	double rowToTime(int row) const;
 
+	// Converts rows sorted in ascending order to times, in a single pass over the events.
+	void rowToTime(const int* rows, double* outTimes, int count) const;
+
+	// Converts times sorted in ascending order to rows, in a single pass over the events.
+	void timeToRow(const double* times, int* outRows, int count) const;
+
 	// Returns the time corresponding to the given beat.
 	double beatToTime(double beat) const;
 
@@ -40,6 +57,15 @@ struct TimingData
 
 	Vector<Event> events;
 	Vector<TimeSig> sigs;
+
+	// The first row at which a warp, negative BPM or negative stop takes effect. Events after it
+	// depend on later segments, so incremental updates can not start after it.
+	int firstWarpRow;
+
+	// The events in Eytzinger order (the layout of a binary heap, starting at index one), which
+	// is used to look up the event of a row or time. The nodes visited by a lookup are close
+	// together in memory, and the top levels of the tree stay cached between lookups.
+	Vector<SearchNode> searchTree;
 };
 
 // ================================================================================================
@@ -2,6 +2,8 @@
 
 #include <Core/WideString.h>
 
+#include <System/Thread.h>
+
 #include <io.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -42,6 +44,7 @@ static wchar_t sLogPath[] = L"ArrowVortex.log";
 
 static bool sHasConsole = false;
 static bool sHasLogFile = false;
+static HANDLE sConsoleOut = nullptr;
 
 void openLogFile()
 {
@@ -75,15 +78,40 @@ void openConsole()
 	setvbuf(stdin, nullptr, _IONBF, 0);
 	setvbuf(stderr, nullptr, _IONBF, 0);
 
+	sConsoleOut = GetStdHandle(STD_OUTPUT_HANDLE);
 	sHasConsole = true;
 }
 
+bool attachConsole()
+{
+	if(sHasConsole) return true;
+
+	if(!AttachConsole(ATTACH_PARENT_PROCESS)) return false;
+
+	// The standard handles of a windows application are not set up by attaching a console, so
+	// the console output is opened directly.
+	sConsoleOut = CreateFileW(L"CONOUT$", GENERIC_READ | GENERIC_WRITE,
+		FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+	if(sConsoleOut == INVALID_HANDLE_VALUE)
+	{
+		FreeConsole();
+		sConsoleOut = nullptr;
+		return false;
+	}
+
+	sHasConsole = true;
+	return true;
+}
+
 // ================================================================================================
 // Debug :: logging functions.
 
 static const int sBufsize = 1024;
 static bool sLogBlankLine = false;
 
+// Messages can be logged from worker threads, so writing a message is serialized.
+static CriticalSection sLogLock;
+
 static void WriteToLogAndConsole(const char* msg)
 {
 	FILE* fp = nullptr;
@@ -95,35 +123,40 @@ static void WriteToLogAndConsole(const char* msg)
 	if(sHasConsole)
 	{
 		WideString wmsg = Widen(msg);
-		WriteConsoleW(GetStdHandle(STD_OUTPUT_HANDLE), wmsg.str(), wmsg.length(), nullptr, 0);
+		WriteConsoleW(sConsoleOut, wmsg.str(), wmsg.length(), nullptr, 0);
 	}
 }
 
 void log(const char* fmt, ...)
 {
-	if(sLogBlankLine)
-	{
-		WriteToLogAndConsole("\n");
-		sLogBlankLine = false;
-	}
 	va_list args;
 	va_start(args, fmt);
 	char buffer[sBufsize];
 	int n = vsnprintf(buffer, sBufsize - 1, fmt, args);
 	if(n < 0 || n > sBufsize - 1) n = sBufsize - 1;
 	buffer[n] = 0;
-	WriteToLogAndConsole(buffer);
 	va_end(args);
+
+	sLogLock.lock();
+	if(sLogBlankLine)
+	{
+		WriteToLogAndConsole("\n");
+		sLogBlankLine = false;
+	}
+	WriteToLogAndConsole(buffer);
+	sLogLock.unlock();
 }
 
 void logBlankLine()
 {
+	sLogLock.lock();
 	sLogBlankLine = true;
+	sLogLock.unlock();
 }
 
 void blockBegin(Type type, const char* title)
 {
-	sLogBlankLine = true;
+	logBlankLine();
 	switch(type)
 	{
 	case ERROR:
@@ -140,7 +173,7 @@ void blockBegin(Type type, const char* title)
 
 void blockEnd()
 {
-	sLogBlankLine = true;
+	logBlankLine();
 }
 
 }; // namespace Debug.
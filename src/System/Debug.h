@@ -26,6 +26,10 @@ namespace Debug
 	/// Opens a debug console to which log messages are written.
 	void openConsole();
 
+	/// Writes log messages to the console of the process that started the program. Returns false
+	/// if the program was not started from a console.
+	bool attachConsole();
+
 	/// Writes a message to the log.
 	void log(const char* fmt, ...);
 
@@ -7,14 +7,24 @@
 #include <vector>
 #include <array>
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <shellapi.h>
 #undef DeleteFile
 #undef MoveFile
 #undef ERROR
+#else
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
 
 #include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 
 namespace Vortex {
@@ -26,8 +36,12 @@ namespace {
 static FILE* OpenFile(StringRef path, bool write)
 {
 	FILE* file;
+#ifdef _WIN32
 	WideString wpath = Widen(path);
 	if(!(file = _wfopen(wpath.str(), write ? L"wb" : L"rb")))
+#else
+	if(!(file = fopen(path.str(), write ? "wb" : "rb")))
+#endif
 	{
 		const char* reason = "file not found";
 		if(errno == EACCES) reason = "permission denied, file might be read only";
@@ -43,10 +57,20 @@ static FILE* OpenFile(StringRef path, bool write)
 // ================================================================================================
 // Path iteration functions.
 
+// Separator of the items in a path, paths are normalized to use it.
+#ifdef _WIN32
+static const char PATH_SEPARATOR = '\\';
+#else
+static const char PATH_SEPARATOR = '/';
+#endif
+
 // Returns a pointer to the first character past the prefix of path.
 static const char* GetDirStart(StringRef path)
 {
 	auto p = path.str();
+#ifndef _WIN32
+	if(p[0] == '/') return p + 1;
+#endif
 	if(p[0] == '\\' && p[1] == '\\')
 	{
 		p += 2;
@@ -70,7 +94,7 @@ static bool IsAbsolutePath(StringRef path)
 static const char* GetDirEnd(StringRef path)
 {
 	auto p = GetDirStart(path), out = p;
-	for(; *p; ++p) { if(p[0] == '\\') out = p; }
+	for(; *p; ++p) { if(p[0] == PATH_SEPARATOR) out = p; }
 	return out;
 }
 
@@ -78,7 +102,7 @@ static const char* GetDirEnd(StringRef path)
 static const char* GetFileStart(StringRef path)
 {
 	auto p = GetDirStart(path), out = p;
-	for(; *p; ++p) { if(p[0] == '\\') out = p + 1; }
+	for(; *p; ++p) { if(p[0] == PATH_SEPARATOR) out = p + 1; }
 	return out;
 }
 
@@ -104,7 +128,7 @@ static const char* GetExtStart(const char* filename)
 static const char* GetTopDir(StringRef path)
 {
 	auto p = GetDirStart(path), out = p, tmp = p;
-	for(; *p; ++p) { if(p[0] == '\\') out = tmp, tmp = p + 1; }
+	for(; *p; ++p) { if(p[0] == PATH_SEPARATOR) out = tmp, tmp = p + 1; }
 	return out;
 }
 
@@ -112,7 +136,7 @@ static const char* GetTopDir(StringRef path)
 static const char* GetTopItem(StringRef path)
 {
 	auto p = GetDirStart(path), out = p;
-	for(; *p; ++p) { if(p[0] == '\\' && p[1]) out = p + 1; }
+	for(; *p; ++p) { if(p[0] == PATH_SEPARATOR && p[1]) out = p + 1; }
 	return out;
 }
 
@@ -182,7 +206,7 @@ static String Concatenate(StringRef first, StringRef second, EndSlash slash = SL
 	String out(pathBegin->begin(), static_cast<int>(dirBegin - pathBegin->begin()));
 
 	// If the first character after the prefix was a slash, append a slash.
-	if(*dirBegin == '\\' || *dirBegin == '/') Str::append(out, '\\');
+	if(*dirBegin == '\\' || *dirBegin == '/') Str::append(out, PATH_SEPARATOR);
 
 	// If the path is empty, we're done.
 	if(items.empty()) return out;
@@ -192,19 +216,19 @@ static String Concatenate(StringRef first, StringRef second, EndSlash slash = SL
 	Str::append(out, i->p, static_cast<int>(i->n));
 	for(++i; i != items.end(); ++i)
 	{
-		Str::append(out, '\\');
+		Str::append(out, PATH_SEPARATOR);
 		Str::append(out, i->p, static_cast<int>(i->n));
 	}
 
 	// End with a slash if requested.
 	if(slash == SLASH_YES)
 	{
-		Str::append(out, '\\');
+		Str::append(out, PATH_SEPARATOR);
 	}
 	else if(slash == SLASH_AS_IS)
 	{
 		StringRef pathEnd = second.len() ? second : first;
-		if(EndsWithSlash(pathEnd)) Str::append(out, '\\');
+		if(EndsWithSlash(pathEnd)) Str::append(out, PATH_SEPARATOR);
 	}
 
 	return out;
@@ -289,6 +313,7 @@ void Path::dropFile()
 
 int Path::attributes() const
 {
+#ifdef _WIN32
 	DWORD out = 0, a = GetFileAttributesW(Widen(str).str());
 	if(a != INVALID_FILE_ATTRIBUTES)
 	{
@@ -298,6 +323,18 @@ int Path::attributes() const
 		if(a & FILE_ATTRIBUTE_READONLY)  out |= File::ATR_READ_ONLY;
 	}
 	return out;
+#else
+	int out = 0;
+	struct stat st;
+	if(stat(str.str(), &st) == 0)
+	{
+		out |= File::ATR_EXISTS;
+		if(S_ISDIR(st.st_mode)) out |= File::ATR_DIR;
+		if(GetFileStart(str)[0] == '.') out |= File::ATR_HIDDEN;
+		if(access(str.str(), W_OK) != 0) out |= File::ATR_READ_ONLY;
+	}
+	return out;
+#endif
 }
 
 bool Path::hasExt(const char* ext) const
@@ -466,6 +503,99 @@ void FileWriter::printf(const char* fmt, ...)
 	va_end(args);
 }
 
+// ================================================================================================
+// Mapped file.
+
+MappedFile::MappedFile() : file(nullptr), mapping(nullptr), data(nullptr), size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(StringRef path)
+{
+	close();
+
+	WideString wpath = Widen(path);
+	HANDLE hFile = CreateFileW(wpath.str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(hFile == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* view = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if(!view)
+	{
+		if(hMapping) CloseHandle(hMapping);
+		CloseHandle(hFile);
+		return false;
+	}
+
+	file = hFile;
+	mapping = hMapping;
+	data = (const uchar*)view;
+	size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(data) UnmapViewOfFile(data);
+	if(mapping) CloseHandle(mapping);
+	if(file) CloseHandle(file);
+	file = nullptr;
+	mapping = nullptr;
+	data = nullptr;
+	size = 0;
+}
+
+#else // _WIN32
+
+bool MappedFile::open(StringRef path)
+{
+	close();
+
+	int fd = ::open(path.str(), O_RDONLY);
+	if(fd < 0) return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(view == MAP_FAILED) return false;
+
+	data = (const uchar*)view;
+	size = (size_t)st.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if(data) munmap((void*)data, size);
+	file = nullptr;
+	mapping = nullptr;
+	data = nullptr;
+	size = 0;
+}
+
+#endif // _WIN32
+
 // ================================================================================================
 // File utilities.
 
@@ -486,6 +616,63 @@ long getSize(StringRef path)
 	return size;
 }
 
+#ifdef _WIN32
+
+bool getInfo(StringRef path, uint64_t* size, uint64_t* modifiedTime)
+{
+	WideString wpath = Widen(path);
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if(!GetFileAttributesExW(wpath.str(), GetFileExInfoStandard, &info)) return false;
+	if(size)
+	{
+		*size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	}
+	if(modifiedTime)
+	{
+		auto& time = info.ftLastWriteTime;
+		*modifiedTime = ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+	}
+	return true;
+}
+
+bool touch(StringRef path)
+{
+	WideString wpath = Widen(path);
+	HANDLE hFile = CreateFileW(wpath.str(), FILE_WRITE_ATTRIBUTES,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(hFile == INVALID_HANDLE_VALUE) return false;
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	BOOL result = SetFileTime(hFile, nullptr, nullptr, &now);
+	CloseHandle(hFile);
+	return result != FALSE;
+}
+
+#else // _WIN32
+
+bool getInfo(StringRef path, uint64_t* size, uint64_t* modifiedTime)
+{
+	struct stat st;
+	if(stat(path.str(), &st) != 0) return false;
+	if(size)
+	{
+		*size = (uint64_t)st.st_size;
+	}
+	if(modifiedTime)
+	{
+		*modifiedTime = (uint64_t)st.st_mtime;
+	}
+	return true;
+}
+
+bool touch(StringRef path)
+{
+	return utime(path.str(), nullptr) == 0;
+}
+
+#endif // _WIN32
+
 String getText(StringRef path, bool* success)
 {
 	FILE* fp = OpenFile(path, false);
@@ -546,6 +733,8 @@ Vector<String> getLines(StringRef path, bool* success)
 	return out;
 }
 
+#ifdef _WIN32
+
 static void LogMoveFileError(StringRef path, StringRef newPath)
 {
 	int code = GetLastError();
@@ -590,6 +779,68 @@ bool deleteFolder(StringRef path)
 	return (SHFileOperationW(&file_op) == 0);
 }
 
+#else // _WIN32
+
+static void LogMoveFileError(StringRef path, StringRef newPath)
+{
+	int code = errno;
+	Debug::blockBegin(Debug::ERROR, "could not move file");
+	Debug::log("old path: %s\n", path.str());
+	Debug::log("new path: %s\n", newPath.str());
+	Debug::log("error code: %i\n", code);
+	Debug::blockEnd();
+}
+
+bool moveFile(StringRef path, StringRef newPath, bool replace)
+{
+	struct stat st;
+	if(!replace && stat(newPath.str(), &st) == 0)
+	{
+		errno = EEXIST;
+		LogMoveFileError(path, newPath);
+		return false;
+	}
+	bool result = (rename(path.str(), newPath.str()) == 0);
+	if(!result) LogMoveFileError(path, newPath);
+	return result;
+}
+
+bool createFolder(StringRef path)
+{
+	return (mkdir(path.str(), 0777) == 0);
+}
+
+bool deleteFile(StringRef path)
+{
+	return (unlink(path.str()) == 0);
+}
+
+bool deleteFolder(StringRef path)
+{
+	DIR* dir = opendir(path.str());
+	if(!dir) return false;
+	while(dirent* entry = readdir(dir))
+	{
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+		String item = path;
+		if(!EndsWithSlash(item)) Str::append(item, '/');
+		Str::append(item, entry->d_name);
+		struct stat st;
+		if(lstat(item.str(), &st) == 0 && S_ISDIR(st.st_mode))
+		{
+			deleteFolder(item);
+		}
+		else
+		{
+			unlink(item.str());
+		}
+	}
+	closedir(dir);
+	return (rmdir(path.str()) == 0);
+}
+
+#endif // _WIN32
+
 static bool HasValidExt(StringRef filename, const Vector<String>& filters)
 {
 	const char* ext = GetExtStart(filename.str());
@@ -603,6 +854,8 @@ static bool HasValidExt(StringRef filename, const Vector<String>& filters)
 	return filters.empty();
 }
 
+#ifdef _WIN32
+
 static void AddFilesInDir(Vector<Path>& out, const WideString& path, bool recursive, bool findDirs, const Vector<String>& filters)
 {
 	WIN32_FIND_DATAW ffd;
@@ -646,6 +899,50 @@ static void AddFilesInDir(Vector<Path>& out, const WideString& path, bool recurs
 	FindClose(hFind);
 }
 
+#else // _WIN32
+
+static void AddFilesInDir(Vector<Path>& out, StringRef path, bool recursive, bool findDirs, const Vector<String>& filters)
+{
+	DIR* dir = opendir(path.str());
+	if(!dir) return;
+	while(dirent* entry = readdir(dir))
+	{
+		if(strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+		{
+			String subpath(path);
+			Str::append(subpath, '/');
+			Str::append(subpath, entry->d_name);
+			struct stat st;
+			bool isSubDirectory = (stat(subpath.str(), &st) == 0 && S_ISDIR(st.st_mode));
+			if(isSubDirectory)
+			{
+				if(recursive)
+				{
+					AddFilesInDir(out, subpath, true, findDirs, filters);
+				}
+				if(findDirs)
+				{
+					out.push_back({subpath, String(), String()});
+				}
+			}
+			else
+			{
+				if(!findDirs)
+				{
+					String filename(entry->d_name);
+					if(HasValidExt(filename, filters))
+					{
+						out.push_back({path, filename});
+					}
+				}
+			}
+		}
+	}
+	closedir(dir);
+}
+
+#endif // _WIN32
+
 Vector<Path> findFiles(StringRef path, bool recursive, const char* filters)
 {
 	Vector<Path> out;
@@ -666,9 +963,8 @@ Vector<Path> findFiles(StringRef path, bool recursive, const char* filters)
 	}
 
 	// If the given path is not a directory but a file, return it as-is.
-	WideString wpath = Widen(path);
-	DWORD attr = GetFileAttributesW(wpath.str());
-	if(attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY) == 0)
+	int attr = Path(path).attributes();
+	if((attr & File::ATR_EXISTS) && (attr & File::ATR_DIR) == 0)
 	{
 		if(HasValidExt(path.str(), filterlist))
 		{
@@ -677,7 +973,11 @@ Vector<Path> findFiles(StringRef path, bool recursive, const char* filters)
 	}
 	else // Search for files.
 	{
-		AddFilesInDir(out, wpath, recursive, false, filterlist);
+#ifdef _WIN32
+		AddFilesInDir(out, Widen(path), recursive, false, filterlist);
+#else
+		AddFilesInDir(out, path, recursive, false, filterlist);
+#endif
 	}
 
 	return out;
@@ -686,7 +986,11 @@ Vector<Path> findFiles(StringRef path, bool recursive, const char* filters)
 Vector<Path> findDirs(StringRef path, bool recursive)
 {
 	Vector<Path> out;
+#ifdef _WIN32
 	AddFilesInDir(out, Widen(path), recursive, true, Vector<String>());
+#else
+	AddFilesInDir(out, path, recursive, true, Vector<String>());
+#endif
 	return out;
 }
 
@@ -111,6 +111,22 @@ struct FileWriter
 	void* file;
 };
 
+/// Maps the contents of a file into memory for reading.
+struct MappedFile
+{
+	MappedFile();
+	~MappedFile();
+
+	/// Maps the file at path. Returns false if the file does not exist or is empty.
+	bool open(StringRef path);
+	void close();
+
+	void* file;
+	void* mapping;
+	const uchar* data;
+	size_t size;
+};
+
 namespace File
 {
 	/// Enumeration of file/directory attributes.
@@ -125,6 +141,13 @@ namespace File
 	/// Returns the size in bytes of a file.
 	extern long getSize(StringRef path, bool* success);
 
+	/// Returns the size in bytes and the last modification time of a file. The modification
+	/// time is only meaningful for comparing against other modification times.
+	extern bool getInfo(StringRef path, uint64_t* size, uint64_t* modifiedTime);
+
+	/// Sets the last modification time of a file to the current time.
+	extern bool touch(StringRef path);
+
 	/// Returns a string with the contents of a file.
 	extern String getText(StringRef path, bool* success);
 
@@ -0,0 +1,228 @@
+#include <System/Profiler.h>
+
+#include <Core/Utils.h>
+
+#include <System/Debug.h>
+#include <System/File.h>
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace Vortex {
+namespace Profiler {
+namespace {
+
+// Number of frames over which the zone statistics are computed.
+static const int HISTORY_FRAMES = 256;
+
+// Number of zones that are kept for exporting traces, older zones are overwritten.
+static const int TRACE_CAPACITY = 1 << 16;
+
+struct OpenZone
+{
+	int index;
+	double begin;
+};
+
+struct TraceZone
+{
+	const char* name;
+	double begin, end;
+};
+
+struct ZoneHistory
+{
+	const char* name;
+	int depth;
+	double frameTime;
+	double times[HISTORY_FRAMES];
+};
+
+struct ProfilerData
+{
+	Vector<ZoneHistory> zones;
+	Vector<OpenZone> openZones;
+	Vector<TraceZone> trace;
+	int traceHead;
+	int numFrames;
+	double frameBegin;
+};
+
+static ProfilerData* PD = nullptr;
+
+// The thread that runs the main loop. Zones started on other threads are not recorded, since the
+// profiler data is not protected by a lock.
+static std::atomic<std::thread::id> sMainThread{std::thread::id()};
+
+static bool IsMainThread()
+{
+	return sMainThread.load(std::memory_order_relaxed) == std::this_thread::get_id();
+}
+
+static ProfilerData* GetData()
+{
+	if(!PD)
+	{
+		PD = new ProfilerData;
+		PD->traceHead = 0;
+		PD->numFrames = 0;
+		PD->frameBegin = Debug::getElapsedTime();
+		PD->trace.reserve(TRACE_CAPACITY);
+	}
+	return PD;
+}
+
+// Returns the index of the zone with the given name, which is added if it does not exist yet.
+static int GetZone(const char* name, int depth)
+{
+	auto& zones = GetData()->zones;
+	for(int i = 0; i < zones.size(); ++i)
+	{
+		if(zones[i].name == name || strcmp(zones[i].name, name) == 0) return i;
+	}
+	ZoneHistory& zone = zones.append();
+	zone.name = name;
+	zone.depth = depth;
+	zone.frameTime = 0.0;
+	memset(zone.times, 0, sizeof(zone.times));
+	return zones.size() - 1;
+}
+
+static void AddTraceZone(const char* name, double begin, double end)
+{
+	auto& trace = PD->trace;
+	if(trace.size() < TRACE_CAPACITY)
+	{
+		trace.push_back({name, begin, end});
+	}
+	else
+	{
+		trace[PD->traceHead] = {name, begin, end};
+		PD->traceHead = (PD->traceHead + 1) % TRACE_CAPACITY;
+	}
+}
+
+static void WriteEscaped(FileWriter& file, const char* str)
+{
+	for(; *str; ++str)
+	{
+		if(*str == '"' || *str == '\\') file.write("\\", 1, 1);
+		file.write(str, 1, 1);
+	}
+}
+
+}; // anonymous namespace
+
+// ================================================================================================
+// Profiler :: frames and zones.
+
+void frameBegin()
+{
+	sMainThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+	auto data = GetData();
+	data->openZones.clear();
+	data->frameBegin = Debug::getElapsedTime();
+}
+
+void frameEnd()
+{
+	auto data = GetData();
+	double end = Debug::getElapsedTime();
+
+	// The first zone is always the frame itself.
+	int frame = GetZone("frame", 0);
+	data->zones[frame].frameTime = end - data->frameBegin;
+	AddTraceZone("frame", data->frameBegin, end);
+
+	int slot = data->numFrames % HISTORY_FRAMES;
+	for(auto& zone : data->zones)
+	{
+		zone.times[slot] = zone.frameTime;
+		zone.frameTime = 0.0;
+	}
+	++data->numFrames;
+}
+
+void zoneBegin(const char* name)
+{
+	if(!IsMainThread()) return;
+	auto data = GetData();
+	if(data->zones.empty()) GetZone("frame", 0);
+	int index = GetZone(name, data->openZones.size() + 1);
+	data->openZones.push_back({index, Debug::getElapsedTime()});
+}
+
+void zoneEnd()
+{
+	if(!IsMainThread()) return;
+	auto data = GetData();
+	if(data->openZones.empty()) return;
+
+	OpenZone open = data->openZones.back();
+	data->openZones.pop_back();
+
+	double end = Debug::getElapsedTime();
+	auto& zone = data->zones[open.index];
+	zone.frameTime += end - open.begin;
+	AddTraceZone(zone.name, open.begin, end);
+}
+
+// ================================================================================================
+// Profiler :: statistics and trace export.
+
+void getStats(Vector<ZoneStats>& out)
+{
+	out.clear();
+	auto data = GetData();
+	int n = min(data->numFrames, HISTORY_FRAMES);
+	if(n == 0) return;
+
+	double sorted[HISTORY_FRAMES];
+	int p99 = min(n - 1, n * 99 / 100);
+	for(auto& zone : data->zones)
+	{
+		double sum = 0.0;
+		for(int i = 0; i < n; ++i)
+		{
+			sum += zone.times[i];
+			sorted[i] = zone.times[i];
+		}
+		std::nth_element(sorted, sorted + p99, sorted + n);
+		out.push_back({zone.name, zone.depth, sum / n, sorted[p99]});
+	}
+}
+
+bool exportTrace(StringRef path)
+{
+	auto data = GetData();
+	auto& trace = data->trace;
+
+	FileWriter file;
+	if(!file.open(path)) return false;
+
+	// Zones are written from oldest to newest, with timestamps in microseconds. Zones are stored
+	// when they end, so a parent zone comes after its children; the origin is the earliest begin.
+	double origin = trace.size() ? trace[0].begin : 0.0;
+	for(auto& zone : trace)
+	{
+		origin = min(origin, zone.begin);
+	}
+	file.printf("{\"traceEvents\":[\n");
+	for(int i = 0; i < trace.size(); ++i)
+	{
+		auto& zone = trace[(data->traceHead + i) % trace.size()];
+		file.printf("%s{\"name\":\"", i ? ",\n" : "");
+		WriteEscaped(file, zone.name);
+		file.printf("\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+			(zone.begin - origin) * 1000000.0, (zone.end - zone.begin) * 1000000.0);
+	}
+	file.printf("\n],\"displayTimeUnit\":\"ms\"}\n");
+	file.close();
+
+	return true;
+}
+
+}; // namespace Profiler
+}; // namespace Vortex
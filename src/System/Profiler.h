@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Core/Vector.h>
+#include <Core/String.h>
+
+namespace Vortex {
+
+/// Measures the time spent in named zones of the main loop. Zones can be nested. The profiler is
+/// not thread-safe: the thread that calls "frameBegin" is treated as the main thread, and zones
+/// that are started on any other thread are ignored. All other functions must be called from the
+/// main thread. The zone names are stored by pointer, so they must stay valid for the lifetime of
+/// the program, e.g. string literals.
+namespace Profiler
+{
+	/// Statistics of a zone over the most recent frames.
+	struct ZoneStats
+	{
+		const char* name;
+		int depth; ///< Nesting depth of the first occurrence, the frame has depth zero.
+		double average, p99; ///< Average and 99th percentile time per frame, in seconds.
+	};
+
+	/// Starts a new frame, and makes the calling thread the main thread.
+	void frameBegin();
+
+	/// Ends the current frame and adds its zones to the statistics.
+	void frameEnd();
+
+	/// Starts a zone with the given name, nested in the current zone. Does nothing if it is not
+	/// called from the main thread.
+	void zoneBegin(const char* name);
+
+	/// Ends the most recently started zone. Does nothing if it is not called from the main thread.
+	void zoneEnd();
+
+	/// Returns the time per frame of each zone, in order of first appearance. The first zone is
+	/// the frame itself. Zones that occur more than once per frame report the sum of their times.
+	void getStats(Vector<ZoneStats>& out);
+
+	/// Writes the zones of the most recent frames to a file in the Chrome trace event format,
+	/// which can be opened with chrome://tracing or Perfetto. Returns true on success.
+	bool exportTrace(StringRef path);
+};
+
+/// Measures the time from its construction until it goes out of scope as a profiler zone.
+struct ProfilerZone
+{
+	ProfilerZone(const char* name) { Profiler::zoneBegin(name); }
+	~ProfilerZone() { Profiler::zoneEnd(); }
+};
+
+/// Adds a profiler zone that lasts until the end of the current scope.
+#define VortexProfileZone(name) \
+	ProfilerZone profilerZone_(name)
+
+}; // namespace Vortex
@@ -8,6 +8,8 @@
 #include <System/Resources.h>
 #include <System/File.h>
 #include <System/Debug.h>
+#include <System/Profiler.h>
+#include <System/Thread.h>
 
 #include <Core/String.h>
 #include <Core/WideString.h>
@@ -16,6 +18,9 @@
 
 #include <Editor/Editor.h>
 #include <Editor/Menubar.h>
+#include <Editor/BatchProcess.h>
+
+#include <Managers/StyleMan.h>
 
 #define UNICODE
 
@@ -33,7 +38,6 @@
 #include <stdio.h>
 #include <ctime>
 #include <bitset>
-#include <list>
 #include <vector>
 
 #undef DELETE
@@ -52,6 +56,11 @@ namespace {
 static wchar_t sRunDir[MAX_PATH + 1] = {};
 static wchar_t sExeDir[MAX_PATH + 1] = {};
 
+// Child processes inherit every inheritable handle that exists when they are created. Commands can
+// run on multiple threads, so the pipe of one command must not exist as an inheritable handle
+// while another command creates its process.
+static CriticalSection sCreateProcessLock;
+
 // Swap interval extension for enabling/disabling vsync.
 typedef BOOL(APIENTRY *PFNWGLSWAPINTERVALFARPROC)(int);
 static PFNWGLSWAPINTERVALFARPROC wglSwapInterval;
@@ -140,6 +149,22 @@ static String ShowFileDialog(String title, String path, String filters, int* ind
 	return Narrow(outPath, wcslen(outPath));
 }
 
+// ================================================================================================
+// SystemImpl :: command line.
+
+static Vector<String> GetCommandLineArgs()
+{
+	int numArgs = 0;
+	LPWSTR* wideArgs = CommandLineToArgvW(GetCommandLineW(), &numArgs);
+	Vector<String> args(numArgs, String());
+	for(int i = 0; i < numArgs; ++i)
+	{
+		args[i] = Narrow(wideArgs[i], wcslen(wideArgs[i]));
+	}
+	LocalFree(wideArgs);
+	return args;
+}
+
 // ================================================================================================
 // SystemImpl :: Debug logging.
 
@@ -255,13 +280,16 @@ bool myIsInsideMessageLoop;
 	UnregisterClassW(myClassName, myInstance);
 }
 
-SystemImpl()
+SystemImpl(bool headless)
 	: myInstance(GetModuleHandle(nullptr))
 	, myClassName(L"ArrowVortex")
 	, myCursor(Cursor::ARROW)
 	, myMousePos({0, 0})
 	, mySize({0, 0})
 	, myTitle("ArrowVortex")
+	, myHWND(nullptr)
+	, myHDC(nullptr)
+	, myHRC(nullptr)
 	, myIsActive(false)
 	, myInitSuccesful(false)
 	, myIsTerminated(false)
@@ -269,6 +297,9 @@ SystemImpl()
 {
 	myApplicationStartTime = Debug::getElapsedTime();
 
+	// Batch processing runs without a window or rendering context.
+	if(headless) return;
+
 	// Register the window class.
 	WNDCLASSW wndclass = {};
 	wndclass.style = CS_HREDRAW | CS_VREDRAW | CS_DBLCLKS;
@@ -378,15 +409,8 @@ SystemImpl()
 
 void forwardArgs()
 {
-	int numArgs = 0;
-	LPWSTR* wideArgs = CommandLineToArgvW(GetCommandLineW(), &numArgs);
-	Vector<String> args(numArgs, String());
-	for(int i = 0; i < numArgs; ++i)
-	{
-		args[i] = Narrow(wideArgs[i], wcslen(wideArgs[i]));
-	}
+	Vector<String> args = GetCommandLineArgs();
 	gEditor->onCommandLineArgs(args.data(), args.size());
-	LocalFree(wideArgs);
 }
 
 void createMenu()
@@ -400,13 +424,6 @@ void CALLBACK messageLoop()
 {
 	if(!myInitSuccesful) return;
 
-#ifdef DEBUG
-	long long frames = 0;
-	auto lowcounts = 0;
-	std::list<double> fpsList, sleepList, frameList, inputList, waitList; 
-	auto frameGuess = 960;
-#endif
-
 	Editor::create();
 	forwardArgs();
 	createMenu();
@@ -416,17 +433,19 @@ void CALLBACK messageLoop()
 	double prevTime = Debug::getElapsedTime();
 	while(!myIsTerminated)
 	{
-
-		auto startTime = Debug::getElapsedTime();
+		Profiler::frameBegin();
 
 		myEvents.clear();
 		// Process all windows messages.
 		myIsInsideMessageLoop = true;
-		while (PeekMessage(&message, nullptr, 0, 0, PM_NOREMOVE | PM_NOYIELD))
 		{
-			GetMessageW(&message, nullptr, 0, 0);
-			TranslateMessage(&message);
-			DispatchMessage(&message);
+			VortexProfileZone("messages");
+			while (PeekMessage(&message, nullptr, 0, 0, PM_NOREMOVE | PM_NOYIELD))
+			{
+				GetMessageW(&message, nullptr, 0, 0);
+				TranslateMessage(&message);
+				DispatchMessage(&message);
+			}
 		}
 		myIsInsideMessageLoop = false;
 
@@ -451,10 +470,18 @@ void CALLBACK messageLoop()
 		deltaTime = (float)min(max(0.00025, curTime - prevTime), 0.25);
 		prevTime = curTime;
 
-		gEditor->tick();
+		{
+			VortexProfileZone("editor tick");
+			gEditor->tick();
+		}
 
 		// Display.
-		SwapBuffers(myHDC);
+		{
+			VortexProfileZone("swap buffers");
+			SwapBuffers(myHDC);
+		}
+
+		Profiler::frameEnd();
 	}
 	Editor::destroy();
 }
@@ -831,7 +858,9 @@ bool runSystemCommand(StringRef cmd, CommandPipe* pipe, void* buffer)
 	startupInfo.cb = sizeof(startupInfo);
 	ZeroMemory(&startupInfo, sizeof(startupInfo));
 
-	HANDLE readPipe, writePipe;
+	sCreateProcessLock.lock();
+
+	HANDLE readPipe = nullptr, writePipe = nullptr;
 	if(pipe)
 	{
 		// Set the bInheritHandle flag so pipe handles are inherited. 
@@ -852,8 +881,14 @@ bool runSystemCommand(StringRef cmd, CommandPipe* pipe, void* buffer)
 	int flags = CREATE_NO_WINDOW;
 	PROCESS_INFORMATION processInfo;
 	ZeroMemory(&processInfo, sizeof(processInfo));
-	if(CreateProcessW(NULL, wbuffer.data(), NULL, NULL,
-		TRUE, flags, NULL, NULL, &startupInfo, &processInfo))
+	bool created = (CreateProcessW(NULL, wbuffer.data(), NULL, NULL,
+		TRUE, flags, NULL, NULL, &startupInfo, &processInfo) != 0);
+
+	// The child has its own copy of the read end now, so ours can be closed.
+	if(readPipe) CloseHandle(readPipe);
+	sCreateProcessLock.unlock();
+
+	if(created)
 	{
 		if(pipe)
 		{
@@ -871,6 +906,10 @@ bool runSystemCommand(StringRef cmd, CommandPipe* pipe, void* buffer)
 		CloseHandle(processInfo.hThread);
 		result = true;
 	}
+	else if(writePipe)
+	{
+		CloseHandle(writePipe);
+	}
 
 	return result;
 }
@@ -1013,6 +1052,34 @@ static void ApplicationStart()
 	Debug::logBlankLine();
 }
 
+// Processes a song pack without creating the window and the editor. Only the styles are loaded,
+// since the simfile loaders need them.
+// Returns the exit code of the program, which is nonzero if the arguments are invalid or any of
+// the songs failed.
+static int RunBatchHeadless(const Vector<String>& args)
+{
+	// Write the output to the console that started the program, if there is one. The output also
+	// goes to the log file, so the run never waits for input and can be scripted.
+	Debug::attachConsole();
+
+	gSystem = new SystemImpl(true);
+	StyleMan::create();
+
+	int exitCode = 1;
+	BatchOptions options;
+	if(ParseBatchArgs(args.data(), args.size(), Narrow(sRunDir), options))
+	{
+		int numFailed = RunBatch(options);
+		exitCode = (numFailed > 0) ? 2 : 0;
+	}
+
+	StyleMan::destroy();
+	delete (SystemImpl*)gSystem;
+	gSystem = nullptr;
+
+	return exitCode;
+}
+
 static void ApplicationEnd()
 {
 	// Log the application termination time.
@@ -1027,10 +1094,19 @@ int APIENTRY WinMain(HINSTANCE, HINSTANCE, char*, int)
 	//_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF | _CRTDBG_CHECK_ALWAYS_DF);
 
 	ApplicationStart();
+
+	Vector<String> args = GetCommandLineArgs();
+	if(IsBatchCommandLine(args.data(), args.size()))
+	{
+		int exitCode = RunBatchHeadless(args);
+		ApplicationEnd();
+		return exitCode;
+	}
+
 #ifdef DEBUG
 	Debug::openConsole();
 #endif
-	gSystem = new SystemImpl;
+	gSystem = new SystemImpl(false);
 	((SystemImpl*)gSystem)->messageLoop();
 	delete (SystemImpl*)gSystem;
 	ApplicationEnd();
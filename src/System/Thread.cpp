@@ -1,18 +1,28 @@
 #include <System/Thread.h>
 
 #include <Core/Utils.h>
-#include <Core/AlignedMemory.h>
 
 #include <vector>
 
+#ifdef _WIN32
+#include <Core/AlignedMemory.h>
+
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
 #undef min
 #undef max
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
 
 namespace Vortex {
 
+#ifdef _WIN32
+
 // ================================================================================================
 // BackgroundThread.
 
@@ -154,7 +164,13 @@ void ParallelThreads::run(int numItems, int numThreads)
 		handles[i] = CreateThread(0, 0, ParallelThreadsFunc, &threads[i], 0, 0);
 	}
 
-	WaitForMultipleObjects(numThreads, handles.data(), TRUE, INFINITE);
+	// A single wait can only take MAXIMUM_WAIT_OBJECTS handles, so larger numbers of threads are
+	// waited for in chunks. The shared data must stay alive until every thread has finished.
+	for(int i = 0; i < numThreads; i += MAXIMUM_WAIT_OBJECTS)
+	{
+		DWORD count = (DWORD)min(numThreads - i, MAXIMUM_WAIT_OBJECTS);
+		WaitForMultipleObjects(count, handles.data() + i, TRUE, INFINITE);
+	}
 	for(HANDLE handle : handles)
 	{
 		CloseHandle(handle);
@@ -166,6 +182,29 @@ void ParallelThreads::run(int numItems, int numThreads)
 	};
 }
 
+// ================================================================================================
+// Event.
+
+Event::Event()
+	: eventHandle(CreateEventW(nullptr, FALSE, FALSE, nullptr))
+{
+}
+
+Event::~Event()
+{
+	if(eventHandle) CloseHandle((HANDLE)eventHandle);
+}
+
+void Event::signal()
+{
+	if(eventHandle) SetEvent((HANDLE)eventHandle);
+}
+
+void Event::wait()
+{
+	if(eventHandle) WaitForSingleObject((HANDLE)eventHandle, INFINITE);
+}
+
 // ================================================================================================
 // CriticalSection.
 
@@ -199,4 +238,175 @@ void CriticalSection::unlock()
 		LeaveCriticalSection((LPCRITICAL_SECTION)criticalSectionHandle);
 }
 
+#else // _WIN32
+
+// ================================================================================================
+// BackgroundThread.
+
+#define BTDATA ((BackgroundThreadData*)data_)
+
+struct BackgroundThreadData
+{
+	BackgroundThread* owner;
+	std::thread* handle;
+	std::atomic<uchar> done;
+};
+
+BackgroundThread::BackgroundThread()
+{
+	auto data = new BackgroundThreadData;
+	terminationFlag_ = 0;
+	data->owner = this;
+	data->done = 0;
+	data->handle = nullptr;
+	data_ = data;
+}
+
+BackgroundThread::~BackgroundThread()
+{
+	terminate();
+	delete BTDATA;
+}
+
+void BackgroundThread::start()
+{
+	if(BTDATA->handle == nullptr && BTDATA->done == 0)
+	{
+		auto data = BTDATA;
+		data->handle = new std::thread([data]
+		{
+			data->owner->exec();
+			data->done = 1;
+		});
+	}
+}
+
+void BackgroundThread::terminate()
+{
+	if(BTDATA->handle)
+	{
+		terminationFlag_ = 1;
+		waitUntilDone();
+	}
+}
+
+void BackgroundThread::waitUntilDone()
+{
+	if(BTDATA->handle)
+	{
+		BTDATA->handle->join();
+		delete BTDATA->handle;
+		BTDATA->handle = nullptr;
+	}
+}
+
+bool BackgroundThread::isDone() const
+{
+	return BTDATA->done != 0;
+}
+
+// ================================================================================================
+// ParallelThreads.
+
+ParallelThreads::ParallelThreads()
+{
+}
+
+ParallelThreads::~ParallelThreads()
+{
+}
+
+int ParallelThreads::concurrency()
+{
+	static int s_num_of_procs = 0;
+	if(s_num_of_procs == 0)
+	{
+		s_num_of_procs = clamp<int>(std::thread::hardware_concurrency(), 1, 16);
+	}
+	return s_num_of_procs;
+}
+
+void ParallelThreads::run(int numItems, int numThreads)
+{
+	if(numItems <= 0 || numThreads <= 0) return;
+
+	std::atomic<int> counter(0);
+	std::vector<std::thread> threads;
+	for(int i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([this, &counter, numItems, i]
+		{
+			for(int item; (item = counter++) < numItems;)
+			{
+				exec(item, i);
+			}
+		});
+	}
+	for(auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+// ================================================================================================
+// Event.
+
+struct EventData
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool signaled = false;
+};
+
+#define EVDATA ((EventData*)eventHandle)
+
+Event::Event()
+	: eventHandle(new EventData)
+{
+}
+
+Event::~Event()
+{
+	delete EVDATA;
+}
+
+void Event::signal()
+{
+	std::lock_guard<std::mutex> lock(EVDATA->mutex);
+	EVDATA->signaled = true;
+	EVDATA->condition.notify_one();
+}
+
+void Event::wait()
+{
+	std::unique_lock<std::mutex> lock(EVDATA->mutex);
+	EVDATA->condition.wait(lock, [this] { return EVDATA->signaled; });
+	EVDATA->signaled = false;
+}
+
+// ================================================================================================
+// CriticalSection.
+
+CriticalSection::CriticalSection()
+	: criticalSectionHandle(new std::recursive_mutex)
+{
+}
+
+CriticalSection::~CriticalSection()
+{
+	delete (std::recursive_mutex*)criticalSectionHandle;
+}
+
+void CriticalSection::lock()
+{
+	((std::recursive_mutex*)criticalSectionHandle)->lock();
+}
+
+void CriticalSection::unlock()
+{
+	((std::recursive_mutex*)criticalSectionHandle)->unlock();
+}
+
+#endif // _WIN32
+
 }; // namespace Vortex
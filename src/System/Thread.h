@@ -54,6 +54,24 @@ public:
 	virtual void exec(int item, int thread) = 0;
 };
 
+/// A wrapper around an auto-reset event, which lets one thread wake up another thread.
+class Event
+{
+public:
+	Event();
+	~Event();
+
+	/// Wakes up a thread that waits for the event. If no thread is waiting, the next call to
+	/// "wait" returns immediately.
+	void signal();
+
+	/// Waits until the event is signaled.
+	void wait();
+
+private:
+	void* eventHandle;
+};
+
 /// A wrapper around critical section.
 class CriticalSection
 {